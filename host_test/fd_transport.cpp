@@ -0,0 +1,125 @@
+/*
+  fd_transport.cpp - printer connection over a file descriptor, i.e. a pty or a socket
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <esp_log.h>
+#include <freertos/task.h>
+
+#include "fd_transport.h"
+
+static const char TAG[] = "esp3d-print-fd";
+
+FdTransport::FdTransport(int fd) {
+    this->fd = fd;
+}
+
+esp_err_t FdTransport::init(int baud) {
+    int flags = fcntl(fd, F_GETFL);
+    if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)) {
+        ESP_LOGE(TAG, "Can't make descriptor %d non-blocking, errno %d", fd, errno);
+        return ESP_FAIL;
+    }
+
+    if (isatty(fd)) {
+        termios tio{};
+        if (tcgetattr(fd, &tio) < 0) return ESP_FAIL;
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+        set_baud_rate(baud);
+    }
+
+    ESP_LOGI(TAG, "Descriptor %d initialized", fd);
+    return ESP_OK;
+}
+
+void FdTransport::set_baud_rate(int baud) {
+    if (!isatty(fd)) return;
+    termios tio{};
+    if (tcgetattr(fd, &tio) < 0) return;
+    cfsetspeed(&tio, (baud >= 115200) ? B115200 : B9600);   // pty takes any rate, a real tty needs a close one
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+/**
+ * XON and XOFF are handled by SerialPort, so there's nothing to set for them.
+ * @param mode
+ */
+esp_err_t FdTransport::set_flow_control(FlowControl mode) {
+    if (mode == FLOW_CONTROL_RTS_CTS) {
+        ESP_LOGE(TAG, "Descriptor has no RTS and CTS lines");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Writes everything, waiting for room when the other side reads slower.
+ */
+int FdTransport::write(const void *data, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::write(fd, (const char *) data + done, len - done);
+        if (n > 0) {
+            done += n;
+        } else if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR))) {
+            pollfd pfd = { .fd = fd, .events = POLLOUT, .revents = 0 };
+            poll(&pfd, 1, -1);
+        } else {
+            ESP_LOGE(TAG, "Write failed, errno %d", errno);
+            break;
+        }
+    }
+    return (int) done;
+}
+
+int FdTransport::read(void *data, size_t len, TickType_t wait) {
+    if (wait_event(wait) != TRANSPORT_EVENT_DATA) return 0;
+    ssize_t n = ::read(fd, data, len);
+    return (n > 0) ? (int) n : 0;
+}
+
+size_t FdTransport::available() {
+    int buffered = 0;
+    if (ioctl(fd, FIONREAD, &buffered) < 0) return 0;
+    return buffered;
+}
+
+void FdTransport::flush_input() {
+    char discard[64];
+    if (isatty(fd)) tcflush(fd, TCIFLUSH);
+    while (::read(fd, discard, sizeof(discard)) > 0);
+}
+
+TransportEvent FdTransport::wait_event(TickType_t wait) {
+    pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+    int timeout = (wait == portMAX_DELAY) ? -1 : (int) (wait * portTICK_PERIOD_MS);
+    if (poll(&pfd, 1, timeout) <= 0) return TRANSPORT_EVENT_NONE;
+    if (pfd.revents & (POLLERR | POLLHUP)) {
+        // Other side is gone, don't spin on it
+        vTaskDelay(pdMS_TO_TICKS(timeout < 0 ? 100 : timeout));
+        return TRANSPORT_EVENT_NONE;
+    }
+    return TRANSPORT_EVENT_DATA;
+}
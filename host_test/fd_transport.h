@@ -0,0 +1,50 @@
+/*
+  fd_transport.h - printer connection over a file descriptor, i.e. a pty or a socket
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_FD_TRANSPORT_H
+#define ESP32_PRINT_FD_TRANSPORT_H
+
+#include "transport.h"
+
+/**
+ * Transport over a Linux file descriptor, so SerialPort runs on a host against whatever is
+ * behind a pty or a socket. Terminals are put into raw mode; baud rate only matters to real ones.
+ * There are no modem lines on a pty or a socket, so only XON/XOFF flow control is possible.
+ */
+class FdTransport : public Transport {
+private:
+    int fd;
+
+public:
+    explicit FdTransport(int fd);
+
+    esp_err_t init(int baud) override;
+    void set_baud_rate(int baud) override;
+    esp_err_t set_flow_control(FlowControl mode) override;
+
+    int write(const void *data, size_t len) override;
+    int read(void *data, size_t len, TickType_t wait) override;
+    size_t available() override;
+    void flush_input() override;
+
+    TransportEvent wait_event(TickType_t wait) override;
+};
+
+#endif //ESP32_PRINT_FD_TRANSPORT_H
@@ -0,0 +1,155 @@
+; Clockwise partial arcs, relative extrusion
+G90
+M83
+G0 X60.000 Y85.000 F6000
+G1 F1200 ; arc 0
+G1 X61.178 Y84.972 E0.04712
+G1 X62.353 Y84.889 E0.04712
+G1 X63.523 Y84.751 E0.04712
+G1 X64.685 Y84.557 E0.04712
+G1 X65.836 Y84.309 E0.04712
+G1 X66.975 Y84.007 E0.04712
+G1 X68.098 Y83.652 E0.04712
+G1 X69.203 Y83.244 E0.04712
+G1 X70.288 Y82.785 E0.04712
+G1 X71.350 Y82.275 E0.04712
+G1 X72.386 Y81.716 E0.04712
+G1 X73.396 Y81.108 E0.04712
+G1 X74.375 Y80.454 E0.04712
+G1 X75.323 Y79.754 E0.04712
+G1 X76.236 Y79.010 E0.04712
+G1 X77.114 Y78.224 E0.04712
+G1 X77.953 Y77.398 E0.04712
+G1 X78.753 Y76.533 E0.04712
+G1 X79.511 Y75.631 E0.04712
+G1 X80.225 Y74.695 E0.04712
+G1 X80.895 Y73.726 E0.04712
+G1 X81.519 Y72.726 E0.04712
+G1 X82.094 Y71.698 E0.04712
+G1 X82.621 Y70.644 E0.04712
+G1 X83.097 Y69.567 E0.04712
+G1 X83.522 Y68.468 E0.04712
+G1 X83.895 Y67.351 E0.04712
+G1 X84.215 Y66.217 E0.04712
+G1 X84.481 Y65.070 E0.04712
+G1 X84.692 Y63.911 E0.04712
+G1 X84.849 Y62.743 E0.04712
+G1 X84.951 Y61.570 E0.04712
+G1 X84.997 Y60.393 E0.04712
+G1 X84.988 Y59.215 E0.04712
+G1 X84.923 Y58.039 E0.04712
+G1 X84.803 Y56.867 E0.04712
+G1 X84.628 Y55.702 E0.04712
+G1 X84.398 Y54.546 E0.04712
+G1 X84.114 Y53.403 E0.04712
+G1 X83.776 Y52.275 E0.04712
+G1 X83.386 Y51.163 E0.04712
+G1 X82.944 Y50.071 E0.04712
+G1 X82.451 Y49.002 E0.04712
+G1 X81.908 Y47.956 E0.04712
+G1 X81.316 Y46.938 E0.04712
+G1 X80.677 Y45.948 E0.04712
+G1 X79.992 Y44.989 E0.04712
+G1 X79.263 Y44.064 E0.04712
+G1 X78.491 Y43.175 E0.04712
+G1 X77.678 Y42.322 E0.04712
+G1 X76.825 Y41.509 E0.04712
+G1 X75.936 Y40.737 E0.04712
+G1 X75.011 Y40.008 E0.04712
+G1 X74.052 Y39.323 E0.04712
+G1 X73.062 Y38.684 E0.04712
+G1 X72.044 Y38.092 E0.04712
+G1 X70.998 Y37.549 E0.04712
+G1 X69.929 Y37.056 E0.04712
+G1 X68.837 Y36.614 E0.04712
+G1 X67.725 Y36.224 E0.04712
+G1 X66.597 Y35.886 E0.04712
+G1 X65.454 Y35.602 E0.04712
+G1 X64.298 Y35.372 E0.04712
+G1 X63.133 Y35.197 E0.04712
+G1 X61.961 Y35.077 E0.04712
+G1 X60.785 Y35.012 E0.04712
+G1 X59.607 Y35.003 E0.04712
+G1 X58.430 Y35.049 E0.04712
+G1 X57.257 Y35.151 E0.04712
+G1 X56.089 Y35.308 E0.04712
+G1 X54.930 Y35.519 E0.04712
+G1 X53.783 Y35.785 E0.04712
+G1 X52.649 Y36.105 E0.04712
+G1 X51.532 Y36.478 E0.04712
+G1 X50.433 Y36.903 E0.04712
+G1 X49.356 Y37.379 E0.04712
+G1 X48.302 Y37.906 E0.04712
+G1 X47.274 Y38.481 E0.04712
+G1 X46.274 Y39.105 E0.04712
+G1 X45.305 Y39.775 E0.04712
+G1 X44.369 Y40.489 E0.04712
+G1 X43.467 Y41.247 E0.04712
+G1 X42.602 Y42.047 E0.04712
+G1 X41.776 Y42.886 E0.04712
+G1 X40.990 Y43.764 E0.04712
+G1 X40.246 Y44.677 E0.04712
+G1 X39.546 Y45.625 E0.04712
+G1 X38.892 Y46.604 E0.04712
+G1 X38.284 Y47.614 E0.04712
+G1 X37.725 Y48.650 E0.04712
+G1 X37.215 Y49.712 E0.04712
+G1 X36.756 Y50.797 E0.04712
+G1 X36.348 Y51.902 E0.04712
+G1 X35.993 Y53.025 E0.04712
+G1 X35.691 Y54.164 E0.04712
+G1 X35.443 Y55.315 E0.04712
+G1 X35.249 Y56.477 E0.04712
+G1 X35.111 Y57.647 E0.04712
+G1 X35.028 Y58.822 E0.04712
+G1 X35.000 Y60.000 E0.04712
+G0 X100.000 Y66.000 F6000
+G1 F1200 ; arc 1
+G1 X100.314 Y65.992 E0.01256
+G1 X100.627 Y65.967 E0.01256
+G1 X100.939 Y65.926 E0.01256
+G1 X101.247 Y65.869 E0.01256
+G1 X101.553 Y65.796 E0.01256
+G1 X101.854 Y65.706 E0.01256
+G1 X102.150 Y65.601 E0.01256
+G1 X102.440 Y65.481 E0.01256
+G1 X102.724 Y65.346 E0.01256
+G1 X103.000 Y65.196 E0.01256
+G1 X103.268 Y65.032 E0.01256
+G1 X103.527 Y64.854 E0.01256
+G1 X103.776 Y64.663 E0.01256
+G1 X104.015 Y64.459 E0.01256
+G1 X104.243 Y64.243 E0.01256
+G1 X104.459 Y64.015 E0.01256
+G1 X104.663 Y63.776 E0.01256
+G1 X104.854 Y63.527 E0.01256
+G1 X105.032 Y63.268 E0.01256
+G1 X105.196 Y63.000 E0.01256
+G1 X105.346 Y62.724 E0.01256
+G1 X105.481 Y62.440 E0.01256
+G1 X105.601 Y62.150 E0.01256
+G1 X105.706 Y61.854 E0.01256
+G1 X105.796 Y61.553 E0.01256
+G1 X105.869 Y61.247 E0.01256
+G1 X105.926 Y60.939 E0.01256
+G1 X105.967 Y60.627 E0.01256
+G1 X105.992 Y60.314 E0.01256
+G1 X106.000 Y60.000 E0.01256
+G0 X140.000 Y62.000 F6000
+G1 F1200 ; arc 2
+G1 X140.390 Y61.962 E0.01568
+G1 X140.765 Y61.848 E0.01568
+G1 X141.111 Y61.663 E0.01568
+G1 X141.414 Y61.414 E0.01568
+G1 X141.663 Y61.111 E0.01568
+G1 X141.848 Y60.765 E0.01568
+G1 X141.962 Y60.390 E0.01568
+G1 X142.000 Y60.000 E0.01568
+G1 X141.962 Y59.610 E0.01568
+G1 X141.848 Y59.235 E0.01568
+G1 X141.663 Y58.889 E0.01568
+G1 X141.414 Y58.586 E0.01568
+G1 X141.111 Y58.337 E0.01568
+G1 X140.765 Y58.152 E0.01568
+G1 X140.390 Y58.038 E0.01568
+G1 X140.000 Y58.000 E0.01568
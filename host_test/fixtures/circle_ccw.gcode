@@ -0,0 +1,160 @@
+; Two layers of a round wall, counterclockwise, absolute extrusion
+G21
+G90
+M82
+G92 E0
+G28
+;LAYER:0
+G0 X110.000 Y100.000 Z0.200 F9000
+;TYPE:WALL-OUTER
+G1 F1800
+G1 X109.962 Y100.872 E0.02905
+G1 X109.848 Y101.736 E0.05810
+G1 X109.659 Y102.588 E0.08715
+G1 X109.397 Y103.420 E0.11620
+G1 X109.063 Y104.226 E0.14525
+G1 X108.660 Y105.000 E0.17430
+G1 X108.192 Y105.736 E0.20335
+G1 X107.660 Y106.428 E0.23240
+G1 X107.071 Y107.071 E0.26145
+G1 X106.428 Y107.660 E0.29051
+G1 X105.736 Y108.192 E0.31956
+G1 X105.000 Y108.660 E0.34861
+G1 X104.226 Y109.063 E0.37766
+G1 X103.420 Y109.397 E0.40671
+G1 X102.588 Y109.659 E0.43576
+G1 X101.736 Y109.848 E0.46481
+G1 X100.872 Y109.962 E0.49386
+G1 X100.000 Y110.000 E0.52291
+G1 X99.128 Y109.962 E0.55196
+G1 X98.264 Y109.848 E0.58101
+G1 X97.412 Y109.659 E0.61006
+G1 X96.580 Y109.397 E0.63911
+G1 X95.774 Y109.063 E0.66816
+G1 X95.000 Y108.660 E0.69721
+G1 X94.264 Y108.192 E0.72626
+G1 X93.572 Y107.660 E0.75531
+G1 X92.929 Y107.071 E0.78436
+G1 X92.340 Y106.428 E0.81341
+G1 X91.808 Y105.736 E0.84246
+G1 X91.340 Y105.000 E0.87152
+G1 X90.937 Y104.226 E0.90057
+G1 X90.603 Y103.420 E0.92962
+G1 X90.341 Y102.588 E0.95867
+G1 X90.152 Y101.736 E0.98772
+G1 X90.038 Y100.872 E1.01677
+G1 X90.000 Y100.000 E1.04582
+G1 X90.038 Y99.128 E1.07487
+G1 X90.152 Y98.264 E1.10392
+G1 X90.341 Y97.412 E1.13297
+G1 X90.603 Y96.580 E1.16202
+G1 X90.937 Y95.774 E1.19107
+G1 X91.340 Y95.000 E1.22012
+G1 X91.808 Y94.264 E1.24917
+G1 X92.340 Y93.572 E1.27822
+G1 X92.929 Y92.929 E1.30727
+G1 X93.572 Y92.340 E1.33632
+G1 X94.264 Y91.808 E1.36537
+G1 X95.000 Y91.340 E1.39442
+G1 X95.774 Y90.937 E1.42348
+G1 X96.580 Y90.603 E1.45253
+G1 X97.412 Y90.341 E1.48158
+G1 X98.264 Y90.152 E1.51063
+G1 X99.128 Y90.038 E1.53968
+G1 X100.000 Y90.000 E1.56873
+G1 X100.872 Y90.038 E1.59778
+G1 X101.736 Y90.152 E1.62683
+G1 X102.588 Y90.341 E1.65588
+G1 X103.420 Y90.603 E1.68493
+G1 X104.226 Y90.937 E1.71398
+G1 X105.000 Y91.340 E1.74303
+G1 X105.736 Y91.808 E1.77208
+G1 X106.428 Y92.340 E1.80113
+G1 X107.071 Y92.929 E1.83018
+G1 X107.660 Y93.572 E1.85923
+G1 X108.192 Y94.264 E1.88828
+G1 X108.660 Y95.000 E1.91733
+G1 X109.063 Y95.774 E1.94638
+G1 X109.397 Y96.580 E1.97543
+G1 X109.659 Y97.412 E2.00449
+G1 X109.848 Y98.264 E2.03354
+G1 X109.962 Y99.128 E2.06259
+G1 X110.000 Y100.000 E2.09164
+;LAYER:1
+G0 X110.000 Y100.000 Z0.400 F9000
+;TYPE:WALL-OUTER
+G1 F1800
+G1 X109.962 Y100.872 E2.12069
+G1 X109.848 Y101.736 E2.14974
+G1 X109.659 Y102.588 E2.17879
+G1 X109.397 Y103.420 E2.20784
+G1 X109.063 Y104.226 E2.23689
+G1 X108.660 Y105.000 E2.26594
+G1 X108.192 Y105.736 E2.29499
+G1 X107.660 Y106.428 E2.32404
+G1 X107.071 Y107.071 E2.35309
+G1 X106.428 Y107.660 E2.38214
+G1 X105.736 Y108.192 E2.41119
+G1 X105.000 Y108.660 E2.44024
+G1 X104.226 Y109.063 E2.46929
+G1 X103.420 Y109.397 E2.49834
+G1 X102.588 Y109.659 E2.52739
+G1 X101.736 Y109.848 E2.55645
+G1 X100.872 Y109.962 E2.58550
+G1 X100.000 Y110.000 E2.61455
+G1 X99.128 Y109.962 E2.64360
+G1 X98.264 Y109.848 E2.67265
+G1 X97.412 Y109.659 E2.70170
+G1 X96.580 Y109.397 E2.73075
+G1 X95.774 Y109.063 E2.75980
+G1 X95.000 Y108.660 E2.78885
+G1 X94.264 Y108.192 E2.81790
+G1 X93.572 Y107.660 E2.84695
+G1 X92.929 Y107.071 E2.87600
+G1 X92.340 Y106.428 E2.90505
+G1 X91.808 Y105.736 E2.93410
+G1 X91.340 Y105.000 E2.96315
+G1 X90.937 Y104.226 E2.99220
+G1 X90.603 Y103.420 E3.02125
+G1 X90.341 Y102.588 E3.05030
+G1 X90.152 Y101.736 E3.07935
+G1 X90.038 Y100.872 E3.10840
+G1 X90.000 Y100.000 E3.13746
+G1 X90.038 Y99.128 E3.16651
+G1 X90.152 Y98.264 E3.19556
+G1 X90.341 Y97.412 E3.22461
+G1 X90.603 Y96.580 E3.25366
+G1 X90.937 Y95.774 E3.28271
+G1 X91.340 Y95.000 E3.31176
+G1 X91.808 Y94.264 E3.34081
+G1 X92.340 Y93.572 E3.36986
+G1 X92.929 Y92.929 E3.39891
+G1 X93.572 Y92.340 E3.42796
+G1 X94.264 Y91.808 E3.45701
+G1 X95.000 Y91.340 E3.48606
+G1 X95.774 Y90.937 E3.51511
+G1 X96.580 Y90.603 E3.54416
+G1 X97.412 Y90.341 E3.57321
+G1 X98.264 Y90.152 E3.60226
+G1 X99.128 Y90.038 E3.63131
+G1 X100.000 Y90.000 E3.66036
+G1 X100.872 Y90.038 E3.68942
+G1 X101.736 Y90.152 E3.71847
+G1 X102.588 Y90.341 E3.74752
+G1 X103.420 Y90.603 E3.77657
+G1 X104.226 Y90.937 E3.80562
+G1 X105.000 Y91.340 E3.83467
+G1 X105.736 Y91.808 E3.86372
+G1 X106.428 Y92.340 E3.89277
+G1 X107.071 Y92.929 E3.92182
+G1 X107.660 Y93.572 E3.95087
+G1 X108.192 Y94.264 E3.97992
+G1 X108.660 Y95.000 E4.00897
+G1 X109.063 Y95.774 E4.03802
+G1 X109.397 Y96.580 E4.06707
+G1 X109.659 Y97.412 E4.09612
+G1 X109.848 Y98.264 E4.12517
+G1 X109.962 Y99.128 E4.15422
+G1 X110.000 Y100.000 E4.18327
+G1 E3.18327 F2400 ; retract
+M107
@@ -0,0 +1,65 @@
+; Noisy points on a large radius
+G90
+M83
+G0 X40.000 Y39.999 F6000
+G1 F1500
+G1 X40.014 Y41.747 E0.06120
+G1 X40.065 Y43.488 E0.06096
+G1 X40.138 Y45.232 E0.06109
+G1 X40.244 Y46.975 E0.06111
+G1 X40.378 Y48.713 E0.06101
+G1 X40.545 Y50.456 E0.06129
+G1 X40.745 Y52.185 E0.06090
+G1 X40.976 Y53.921 E0.06132
+G1 X41.231 Y55.641 E0.06083
+G1 X41.517 Y57.362 E0.06106
+G1 X41.836 Y59.078 E0.06109
+G1 X42.183 Y60.789 E0.06113
+G1 X42.564 Y62.498 E0.06128
+G1 X42.972 Y64.191 E0.06097
+G1 X43.407 Y65.882 E0.06109
+G1 X43.873 Y67.562 E0.06103
+G1 X44.366 Y69.235 E0.06104
+G1 X44.898 Y70.899 E0.06112
+G1 X45.448 Y72.558 E0.06118
+G1 X46.034 Y74.200 E0.06101
+G1 X46.640 Y75.835 E0.06104
+G1 X47.281 Y77.460 E0.06115
+G1 X47.953 Y79.076 E0.06125
+G1 X48.648 Y80.670 E0.06086
+G1 X49.365 Y82.264 E0.06116
+G1 X50.124 Y83.837 E0.06113
+G1 X50.900 Y85.395 E0.06093
+G1 X51.704 Y86.951 E0.06129
+G1 X52.541 Y88.484 E0.06113
+G1 X53.401 Y89.998 E0.06096
+G1 X54.280 Y91.501 E0.06094
+G1 X55.195 Y92.993 E0.06127
+G1 X56.136 Y94.466 E0.06116
+G1 X57.097 Y95.921 E0.06105
+G1 X58.084 Y97.358 E0.06101
+G1 X59.095 Y98.781 E0.06107
+G1 X60.134 Y100.185 E0.06115
+G1 X61.200 Y101.565 E0.06102
+G1 X62.282 Y102.930 E0.06098
+G1 X63.397 Y104.280 E0.06127
+G1 X64.526 Y105.602 E0.06086
+G1 X65.686 Y106.914 E0.06127
+G1 X66.864 Y108.198 E0.06099
+G1 X68.067 Y109.462 E0.06108
+G1 X69.288 Y110.710 E0.06112
+G1 X70.538 Y111.935 E0.06125
+G1 X71.803 Y113.135 E0.06104
+G1 X73.085 Y114.312 E0.06091
+G1 X74.398 Y115.473 E0.06132
+G1 X75.720 Y116.601 E0.06082
+G1 X77.068 Y117.716 E0.06124
+G1 X78.433 Y118.799 E0.06100
+G1 X79.820 Y119.867 E0.06125
+G1 X81.219 Y120.898 E0.06084
+G1 X82.641 Y121.915 E0.06117
+G1 X84.082 Y122.901 E0.06113
+G1 X85.538 Y123.869 E0.06120
+G1 X87.008 Y124.802 E0.06094
+G1 X88.500 Y125.715 E0.06121
+G1 X90.003 Y126.600 E0.06104
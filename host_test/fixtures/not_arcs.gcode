@@ -0,0 +1,105 @@
+; Moves which are not arcs
+G90
+M82
+G92 E0
+G0 X10 Y10 Z0.3 F9000
+G1 F3000
+G1 X10.000 Y10.000 E0.40000
+G1 X40.000 Y10.800 E0.80000
+G1 X10.000 Y11.600 E1.20000
+G1 X40.000 Y12.400 E1.60000
+G1 X10.000 Y13.200 E2.00000
+G1 X40.000 Y14.000 E2.40000
+G1 X10.000 Y14.800 E2.80000
+G1 X40.000 Y15.600 E3.20000
+G1 X10.000 Y16.400 E3.60000
+G1 X40.000 Y17.200 E4.00000
+G1 X10.000 Y18.000 E4.40000
+G1 X40.000 Y18.800 E4.80000
+G1 X10.000 Y19.600 E5.20000
+G1 X40.000 Y20.400 E5.60000
+G1 X10.000 Y21.200 E6.00000
+G1 X40.000 Y22.000 E6.40000
+G1 X10.000 Y22.800 E6.80000
+G1 X40.000 Y23.600 E7.20000
+G1 X10.000 Y24.400 E7.60000
+G1 X40.000 Y25.200 E8.00000
+G1 X50.000 Y10 E8.20000
+G1 X52.000 Y10 E8.40000
+G1 X54.000 Y10 E8.60000
+G1 X56.000 Y10 E8.80000
+G1 X58.000 Y10 E9.00000
+G1 X60.000 Y10 E9.20000
+G1 X62.000 Y10 E9.40000
+G1 X64.000 Y10 E9.60000
+G1 X66.000 Y10 E9.80000
+G1 X68.000 Y10 E10.00000
+G0 X120.300 Y20.000
+G1 X120.260 Y20.150 E10.00466
+G1 X120.150 Y20.260 E10.00932
+G1 X120.000 Y20.300 E10.01398
+G1 X119.850 Y20.260 E10.01863
+G1 X119.740 Y20.150 E10.02329
+G1 X119.700 Y20.000 E10.02795
+G1 X119.740 Y19.850 E10.03261
+G1 X119.850 Y19.740 E10.03727
+G1 X120.000 Y19.700 E10.04193
+G1 X120.150 Y19.740 E10.04659
+G1 X120.260 Y19.850 E10.05125
+G1 X120.300 Y20.000 E10.05590
+G0 X158.000 Y50.000
+G1 X157.932 Y51.044 E10.11869
+G1 X157.727 Y52.071 E10.15009
+G1 X157.391 Y53.061 E10.21287
+G1 X156.928 Y54.000 E10.24427
+G1 X156.347 Y54.870 E10.30705
+G1 X155.657 Y55.657 E10.33845
+G1 X154.870 Y56.347 E10.40123
+G1 X154.000 Y56.928 E10.43263
+G1 X153.061 Y57.391 E10.49541
+G1 X152.071 Y57.727 E10.52681
+G1 X151.044 Y57.932 E10.58959
+G1 X150.000 Y58.000 E10.62099
+G1 X148.956 Y57.932 E10.68377
+G1 X147.929 Y57.727 E10.71517
+G1 X146.939 Y57.391 E10.77796
+G1 X146.000 Y56.928 E10.80935
+G1 X145.130 Y56.347 E10.87214
+G1 X144.343 Y55.657 E10.90353
+G1 X143.653 Y54.870 E10.96632
+G1 X143.072 Y54.000 E10.99771
+G1 X142.609 Y53.061 E11.06050
+G1 X142.273 Y52.071 E11.09189
+G1 X142.068 Y51.044 E11.15468
+G1 X142.000 Y50.000 E11.18607
+G0 X158.000 Y90.000
+G1 X157.932 Y91.044 Z0.300 E11.21746
+G1 X157.727 Y92.071 Z0.310 E11.24886
+G1 X157.391 Y93.061 Z0.320 E11.28025
+G1 X156.928 Y94.000 Z0.330 E11.31164
+G1 X156.347 Y94.870 Z0.340 E11.34304
+G1 X155.657 Y95.657 Z0.350 E11.37443
+G1 X154.870 Y96.347 Z0.360 E11.40583
+G1 X154.000 Y96.928 Z0.370 E11.43722
+G1 X153.061 Y97.391 Z0.380 E11.46861
+G1 X152.071 Y97.727 Z0.390 E11.50001
+G1 X151.044 Y97.932 Z0.400 E11.53140
+G1 X150.000 Y98.000 Z0.410 E11.56279
+G1 X148.956 Y97.932 Z0.420 E11.59419
+G1 X147.929 Y97.727 Z0.430 E11.62558
+G1 X146.939 Y97.391 Z0.440 E11.65697
+G1 X146.000 Y96.928 Z0.450 E11.68837
+G1 X145.130 Y96.347 Z0.460 E11.71976
+G1 X144.343 Y95.657 Z0.470 E11.75115
+G1 X143.653 Y94.870 Z0.480 E11.78255
+G1 X143.072 Y94.000 Z0.490 E11.81394
+G1 X142.609 Y93.061 Z0.500 E11.84533
+G1 X142.273 Y92.071 Z0.510 E11.87673
+G1 X142.068 Y91.044 Z0.520 E11.90812
+G1 X142.000 Y90.000 Z0.530 E11.93952
+G91
+G1 X1 Y1
+G1 X1 Y0.5
+G1 X1 Y0
+G1 X1 Y-0.5
+G90
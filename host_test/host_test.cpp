@@ -0,0 +1,51 @@
+/*
+  host_test.cpp - checks and test runner for host tests
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cstdlib>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include "host_test.h"
+
+int test_failures = 0;
+
+int run_tests(const host_test_t *tests, size_t count, int argc, char **argv) {
+    // HOST_TEST_LOG=4 shows firmware's info messages, 5 debug ones too
+    const char *log_level = getenv("HOST_TEST_LOG");
+    if (log_level != nullptr) esp_log_level_set("*", (esp_log_level_t) atoi(log_level));
+
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    int ran = 0;
+    for (size_t i = 0; i < count; i++) {
+        bool selected = (argc < 2);
+        for (int a = 1; a < argc; a++) selected |= (strcmp(argv[a], tests[i].name) == 0);
+        if (!selected) continue;
+
+        int failures = test_failures;
+        int64_t start = esp_timer_get_time();
+        tests[i].run();
+        printf("%s %s (%lld ms)\n", (test_failures == failures) ? "PASS" : "FAIL", tests[i].name,
+               (long long) (esp_timer_get_time() - start) / 1000);
+        ran++;
+    }
+    fflush(stdout);
+    if (ran == 0) fprintf(stderr, "No such test\n");
+    return ((ran == 0) || (test_failures > 0)) ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+/*
+  host_test.h - checks and test runner for host tests
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_HOST_TEST_H
+#define ESP32_PRINT_HOST_TEST_H
+
+#include <cstdio>
+#include <cstring>
+
+extern int test_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+typedef struct {
+    const char *name;
+    void (*run)();
+} host_test_t;
+
+/**
+ * Runs tests named on command line, or all of them with no arguments.
+ * @return process exit code
+ */
+int run_tests(const host_test_t *tests, size_t count, int argc, char **argv);
+
+#endif //ESP32_PRINT_HOST_TEST_H
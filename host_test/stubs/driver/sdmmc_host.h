@@ -0,0 +1,39 @@
+/*
+  sdmmc_host.h - host stand-in for ESP-IDF SD/MMC host driver
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_HOST_SDMMC_HOST_H
+#define ESP32_PRINT_HOST_SDMMC_HOST_H
+
+#include <cstdint>
+
+typedef struct {
+    int slot;
+} sdmmc_host_t;
+
+typedef struct {
+    uint8_t width;
+    uint32_t flags;
+} sdmmc_slot_config_t;
+
+#define SDMMC_HOST_DEFAULT()                (sdmmc_host_t) { .slot = 1 }
+#define SDMMC_SLOT_CONFIG_DEFAULT()         (sdmmc_slot_config_t) { .width = 4, .flags = 0 }
+#define SDMMC_SLOT_FLAG_INTERNAL_PULLUP     (1 << 0)
+
+#endif //ESP32_PRINT_HOST_SDMMC_HOST_H
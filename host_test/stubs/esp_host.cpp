@@ -0,0 +1,160 @@
+/*
+  esp_host.cpp - ESP-IDF logging, timer, random numbers, NVS and SD card for host tests
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cerrno>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_vfs_fat.h"
+#include "nvs.h"
+
+#define NVS_NAME_SIZE   16  // NVS_KEY_NAME_MAX_SIZE, namespaces and keys are up to 15 characters
+
+static const auto start_time = std::chrono::steady_clock::now();
+static esp_log_level_t log_level = ESP_LOG_WARN;
+static std::mutex log_mutex;
+
+static std::mt19937 random_engine(3);
+static std::mutex random_mutex;
+
+// Namespaces by handle and blobs by '<namespace>/<key>'
+static std::map<nvs_handle_t, std::string> nvs_handles;
+static std::map<std::string, std::vector<uint8_t>> nvs_blobs;
+static nvs_handle_t nvs_handle_cnt = 0;
+static std::mutex nvs_mutex;
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+/**
+ * Sets log level for every tag at once, host tests don't need more than that.
+ */
+void esp_log_level_set(const char * /* tag */, esp_log_level_t level) { log_level = level; }
+
+void esp_log_write(esp_log_level_t level, const char * /* tag */, const char *format, ...) {
+    if (level > log_level) return;
+    std::lock_guard<std::mutex> lock(log_mutex);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+int64_t esp_timer_get_time() {
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+uint32_t esp_random() {
+    std::lock_guard<std::mutex> lock(random_mutex);
+    return random_engine();
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t /* mode */, nvs_handle_t *handle) {
+    if (strlen(name) >= NVS_NAME_SIZE) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    *handle = ++nvs_handle_cnt;
+    nvs_handles[*handle] = name;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    nvs_handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t /* handle */) { return ESP_OK; }
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    if (strlen(key) >= NVS_NAME_SIZE) return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    auto ns = nvs_handles.find(handle);
+    if (ns == nvs_handles.end()) return ESP_ERR_INVALID_ARG;
+    auto bytes = (const uint8_t *) value;
+    nvs_blobs[ns->second + "/" + key].assign(bytes, bytes + length);
+    return ESP_OK;
+}
+
+/**
+ * Reads a blob, or only tells its length if value is nullptr.
+ */
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *length) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    auto ns = nvs_handles.find(handle);
+    if (ns == nvs_handles.end()) return ESP_ERR_INVALID_ARG;
+    auto blob = nvs_blobs.find(ns->second + "/" + key);
+    if (blob == nvs_blobs.end()) return ESP_ERR_NVS_NOT_FOUND;
+    if (value == nullptr) {
+        *length = blob->second.size();
+        return ESP_OK;
+    }
+    if (*length < blob->second.size()) return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(value, blob->second.data(), blob->second.size());
+    *length = blob->second.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    auto ns = nvs_handles.find(handle);
+    if (ns == nvs_handles.end()) return ESP_ERR_INVALID_ARG;
+    return (nvs_blobs.erase(ns->second + "/" + key) > 0) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+/**
+ * SD card is a directory of the build, it's made when card is mounted.
+ */
+esp_err_t esp_vfs_fat_sdmmc_mount(const char *base_path, const sdmmc_host_t * /* host */, const void * /* slot_config */,
+                                  const esp_vfs_fat_sdmmc_mount_config_t * /* mount_config */, sdmmc_card_t **card) {
+    static sdmmc_card_t host_card = { .cid = { .name = "HOST" } };
+    if ((mkdir(base_path, 0755) != 0) && (errno != EEXIST)) return ESP_FAIL;
+    *card = &host_card;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdmmc_unmount() { return ESP_OK; }
+
+void sdmmc_card_print_info(FILE * /* stream */, const sdmmc_card_t * /* card */) {}
@@ -0,0 +1,30 @@
+/*
+  esp_http_server.h - host stand-in for ESP-IDF HTTP server types, web server does not run on host
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_HOST_ESP_HTTP_SERVER_H
+#define ESP32_PRINT_HOST_ESP_HTTP_SERVER_H
+
+typedef void *httpd_handle_t;
+
+typedef struct httpd_req {
+    httpd_handle_t handle;
+} httpd_req_t;
+
+#endif //ESP32_PRINT_HOST_ESP_HTTP_SERVER_H
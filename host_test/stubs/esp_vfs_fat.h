@@ -0,0 +1,41 @@
+/*
+  esp_vfs_fat.h - host stand-in for ESP-IDF FAT file system, SD card is a directory on host
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_HOST_ESP_VFS_FAT_H
+#define ESP32_PRINT_HOST_ESP_VFS_FAT_H
+
+#include <cstddef>
+
+#include "esp_err.h"
+#include "driver/sdmmc_host.h"
+#include "sdmmc_cmd.h"
+
+typedef struct {
+    bool format_if_mount_failed;
+    int max_files;
+    size_t allocation_unit_size;
+    bool disk_status_check_enable;
+} esp_vfs_fat_sdmmc_mount_config_t;
+
+esp_err_t esp_vfs_fat_sdmmc_mount(const char *base_path, const sdmmc_host_t *host, const void *slot_config,
+                                  const esp_vfs_fat_sdmmc_mount_config_t *mount_config, sdmmc_card_t **card);
+esp_err_t esp_vfs_fat_sdmmc_unmount();
+
+#endif //ESP32_PRINT_HOST_ESP_VFS_FAT_H
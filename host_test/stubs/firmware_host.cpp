@@ -0,0 +1,54 @@
+/*
+  firmware_host.cpp - parts of firmware left out on host: web server and UART driver
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include "printer.h"
+#include "server.h"
+#include "settings.h"
+#include "uart_transport.h"
+
+// Globals main.cpp has on the device
+Server server;
+Settings settings;
+
+/**
+ * Nobody listens on host, status is only kept by Printer.
+ */
+esp_err_t Server::send_status_ws(const Printer * /* printer */) const { return ESP_OK; }
+
+/**
+ * Host has no UARTs, printers are connected with transports tests give to Printer::init().
+ */
+UartTransport::UartTransport(uart_port_t port, gpio_num_t rxd_pin, gpio_num_t txd_pin, int rts_pin, int cts_pin) {
+    this->port = port;
+    this->rxd_pin = rxd_pin;
+    this->txd_pin = txd_pin;
+    this->rts_pin = rts_pin;
+    this->cts_pin = cts_pin;
+    this->uart_queue = nullptr;
+}
+
+esp_err_t UartTransport::init(int /* baud */) { return ESP_ERR_NOT_SUPPORTED; }
+void UartTransport::set_baud_rate(int /* baud */) {}
+esp_err_t UartTransport::set_flow_control(FlowControl /* mode */) { return ESP_ERR_NOT_SUPPORTED; }
+int UartTransport::write(const void * /* data */, size_t /* len */) { return -1; }
+int UartTransport::read(void * /* data */, size_t /* len */, TickType_t /* wait */) { return -1; }
+size_t UartTransport::available() { return 0; }
+void UartTransport::flush_input() {}
+TransportEvent UartTransport::wait_event(TickType_t /* wait */) { return TRANSPORT_EVENT_NONE; }
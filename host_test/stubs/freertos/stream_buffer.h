@@ -0,0 +1,39 @@
+/*
+  stream_buffer.h - host stand-in for FreeRTOS stream buffers
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_HOST_STREAM_BUFFER_H
+#define ESP32_PRINT_HOST_STREAM_BUFFER_H
+
+#include "FreeRTOS.h"
+
+typedef struct host_stream_buffer *StreamBufferHandle_t;
+typedef struct { void *unused; } StaticStreamBuffer_t;
+
+StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t trigger_level);
+StreamBufferHandle_t xStreamBufferCreateStatic(size_t size, size_t trigger_level, uint8_t *storage,
+                                               StaticStreamBuffer_t *buffer);
+void vStreamBufferDelete(StreamBufferHandle_t buffer);
+size_t xStreamBufferSend(StreamBufferHandle_t buffer, const void *data, size_t len, TickType_t wait);
+size_t xStreamBufferReceive(StreamBufferHandle_t buffer, void *data, size_t len, TickType_t wait);
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t buffer);
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t buffer);
+BaseType_t xStreamBufferReset(StreamBufferHandle_t buffer);
+
+#endif //ESP32_PRINT_HOST_STREAM_BUFFER_H
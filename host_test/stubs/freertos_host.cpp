@@ -0,0 +1,296 @@
+/*
+  freertos_host.cpp - FreeRTOS tasks, semaphores, queues and stream buffers on top of std::thread
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "freertos/task.h"
+
+using host_clock = std::chrono::steady_clock;
+
+static const host_clock::time_point start_time = host_clock::now();
+
+struct host_semaphore {
+    std::mutex mutex;
+    std::condition_variable cond;
+    uint32_t count;
+    bool recursive;
+    std::thread::id owner;
+    uint32_t depth;
+};
+
+struct host_task {
+    std::mutex mutex;
+    std::condition_variable cond;
+    uint32_t notifications;
+};
+
+struct host_queue {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t item_size;
+};
+
+struct host_stream_buffer {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<uint8_t> data;
+    size_t first;
+    size_t count;
+    size_t trigger_level;
+};
+
+static thread_local host_task *current_task = nullptr;
+
+/**
+ * Internal function.
+ * Waits on a condition until predicate is true or given ticks pass.
+ * @return predicate value
+ */
+template<typename Predicate>
+static bool wait_for(std::condition_variable &cond, std::unique_lock<std::mutex> &lock, TickType_t wait,
+                     Predicate predicate) {
+    if (wait == portMAX_DELAY) {
+        cond.wait(lock, predicate);
+        return true;
+    }
+    return cond.wait_for(lock, std::chrono::milliseconds(wait * portTICK_PERIOD_MS), predicate);
+}
+
+static SemaphoreHandle_t create_semaphore(uint32_t count, bool recursive) {
+    auto semaphore = new host_semaphore();
+    semaphore->count = count;
+    semaphore->recursive = recursive;
+    semaphore->depth = 0;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() { return create_semaphore(0, false); }
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return create_semaphore(1, false); }
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return create_semaphore(1, true); }
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete semaphore; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait) {
+    std::unique_lock<std::mutex> lock(semaphore->mutex);
+    if (!wait_for(semaphore->cond, lock, wait, [semaphore] { return semaphore->count > 0; })) return pdFALSE;
+    semaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+    if (semaphore->count > 0) return pdFALSE;   // Binary semaphores and mutexes hold one token at most
+    semaphore->count = 1;
+    semaphore->cond.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t wait) {
+    std::unique_lock<std::mutex> lock(semaphore->mutex);
+    if ((semaphore->depth > 0) && (semaphore->owner == std::this_thread::get_id())) {
+        semaphore->depth++;
+        return pdTRUE;
+    }
+    if (!wait_for(semaphore->cond, lock, wait, [semaphore] { return semaphore->count > 0; })) return pdFALSE;
+    semaphore->count = 0;
+    semaphore->owner = std::this_thread::get_id();
+    semaphore->depth = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+    if ((semaphore->depth == 0) || (semaphore->owner != std::this_thread::get_id())) return pdFALSE;
+    if (--semaphore->depth > 0) return pdTRUE;
+    semaphore->owner = std::thread::id();
+    semaphore->count = 1;
+    semaphore->cond.notify_one();
+    return pdTRUE;
+}
+
+/**
+ * Internal function.
+ * Gives the calling thread a task control block, so that threads not made
+ * by xTaskCreate (i.e. test's main thread) may wait for notifications too.
+ */
+static host_task *this_task() {
+    if (current_task == nullptr) current_task = new host_task();
+    return current_task;
+}
+
+/**
+ * Starts a thread for a task. Tasks never end, so threads are detached and live until the process exits.
+ * Stack size and priority are up to the host scheduler.
+ */
+BaseType_t xTaskCreate(TaskFunction_t function, const char * /* name */, uint32_t /* stack_size */, void *args,
+                       UBaseType_t /* priority */, TaskHandle_t *handle) {
+    auto task = new host_task();
+    task->notifications = 0;
+    if (handle != nullptr) *handle = task;
+    std::thread([function, args, task] {
+        current_task = task;
+        function(args);
+    }).detach();
+    return pdPASS;
+}
+
+TickType_t xTaskGetTickCount() {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(host_clock::now() - start_time);
+    return (TickType_t) (elapsed.count() / portTICK_PERIOD_MS);
+}
+
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS)); }
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+    task->cond.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+    host_task *task = this_task();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    wait_for(task->cond, lock, wait, [task] { return task->notifications > 0; });
+    uint32_t value = task->notifications;
+    if (value > 0) task->notifications = clear ? 0 : value - 1;
+    return value;
+}
+
+void vPortYield() { std::this_thread::yield(); }
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    auto queue = new host_queue();
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+/**
+ * Copies item to the back of queue, waiting for room if it's full.
+ */
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!wait_for(queue->cond, lock, wait, [queue] { return queue->items.size() < queue->length; })) return pdFALSE;
+    auto bytes = (const uint8_t *) item;
+    queue->items.emplace_back(bytes, bytes + queue->item_size);
+    queue->cond.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!wait_for(queue->cond, lock, wait, [queue] { return !queue->items.empty(); })) return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    queue->cond.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->items.clear();
+    queue->cond.notify_all();
+    return pdPASS;
+}
+
+StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t trigger_level) {
+    auto buffer = new host_stream_buffer();
+    buffer->data.resize(size);
+    buffer->first = 0;
+    buffer->count = 0;
+    buffer->trigger_level = (trigger_level > 0) ? trigger_level : 1;
+    return buffer;
+}
+
+/**
+ * Buffer keeps its data on the heap, given storage is not used.
+ */
+StreamBufferHandle_t xStreamBufferCreateStatic(size_t size, size_t trigger_level, uint8_t * /* storage */,
+                                               StaticStreamBuffer_t * /* buffer */) {
+    return xStreamBufferCreate(size, trigger_level);
+}
+
+void vStreamBufferDelete(StreamBufferHandle_t buffer) { delete buffer; }
+
+/**
+ * Writes as much as fits. With a wait, waits for room for all the data first, as FreeRTOS does.
+ */
+size_t xStreamBufferSend(StreamBufferHandle_t buffer, const void *data, size_t len, TickType_t wait) {
+    std::unique_lock<std::mutex> lock(buffer->mutex);
+    size_t size = buffer->data.size();
+    size_t needed = (len < size) ? len : size;
+    if (wait > 0) wait_for(buffer->cond, lock, wait, [buffer, size, needed] { return size - buffer->count >= needed; });
+
+    size_t n = size - buffer->count;
+    if (n > len) n = len;
+    for (size_t i = 0; i < n; i++) {
+        buffer->data[(buffer->first + buffer->count + i) % size] = ((const uint8_t *) data)[i];
+    }
+    buffer->count += n;
+    if (n > 0) buffer->cond.notify_all();
+    return n;
+}
+
+/**
+ * Reads what's there, waiting until at least trigger level bytes come.
+ */
+size_t xStreamBufferReceive(StreamBufferHandle_t buffer, void *data, size_t len, TickType_t wait) {
+    std::unique_lock<std::mutex> lock(buffer->mutex);
+    wait_for(buffer->cond, lock, wait, [buffer] { return buffer->count >= buffer->trigger_level; });
+
+    size_t size = buffer->data.size();
+    size_t n = (buffer->count < len) ? buffer->count : len;
+    for (size_t i = 0; i < n; i++) ((uint8_t *) data)[i] = buffer->data[(buffer->first + i) % size];
+    buffer->first = (buffer->first + n) % size;
+    buffer->count -= n;
+    if (n > 0) buffer->cond.notify_all();
+    return n;
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t buffer) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    return buffer->count;
+}
+
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t buffer) { return xStreamBufferBytesAvailable(buffer) == 0; }
+
+BaseType_t xStreamBufferReset(StreamBufferHandle_t buffer) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->first = 0;
+    buffer->count = 0;
+    buffer->cond.notify_all();
+    return pdPASS;
+}
@@ -0,0 +1,268 @@
+/*
+  test_arc_fitter.cpp - arcs fitted to G-code fixtures stay within tolerance of the moves they replace
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "arc_fitter.h"
+#include "gcode_pipeline.h"
+#include "host_test.h"
+
+#define ARC_TOLERANCE           0.025f  // mm
+#define ROUNDING                0.001f  // mm, arcs are written with 3 decimals
+#define ARC_SAMPLE_STEP         0.01f   // mm between points an arc is checked at
+
+typedef struct {
+    std::string line;
+    uint32_t offset;
+} emitted_line_t;
+
+typedef struct {
+    float x, y;
+} point_t;
+
+typedef struct {
+    uint32_t commands_saved;
+    uint32_t bytes_saved;
+} arc_stats_t;
+
+enum Arcs { ARCS_NONE, ARCS_DISABLED, ARCS_ENABLED };
+
+/**
+ * Follows position and extrusion through canonical lines, arcs included.
+ */
+class Machine {
+public:
+    float x = 0, y = 0, e = 0;          // E is absolute, whatever mode file uses
+    bool relative = false, relative_e = false;
+
+    /**
+     * Runs a line.
+     * @param path points the tool went through, the start point is not added
+     */
+    void run(const char *line, std::vector<point_t> *path) {
+        int code = atoi(&line[1]);
+        if (line[0] == 'M') {
+            if (code == 82) relative_e = false;
+            else if (code == 83) relative_e = true;
+            return;
+        }
+        if (line[0] != 'G') return;
+        if (code == 90) relative = false;
+        else if (code == 91) relative = true;
+        if ((code > 3) && (code != 92)) return;
+
+        float v[4] = { NAN, NAN, NAN, NAN }, i = 0, j = 0;
+        for (const char *p = strchr(line, ' '); p != nullptr; p = strchr(p + 1, ' ')) {
+            float value = strtof(&p[2], nullptr);
+            switch (p[1]) {
+                case 'X': v[0] = value; break;
+                case 'Y': v[1] = value; break;
+                case 'E': v[3] = value; break;
+                case 'I': i = value; break;
+                case 'J': j = value; break;
+                default: break;
+            }
+        }
+        if (code == 92) {
+            if (!std::isnan(v[3])) e = v[3];
+            return;
+        }
+        float nx = std::isnan(v[0]) ? x : (relative ? x + v[0] : v[0]);
+        float ny = std::isnan(v[1]) ? y : (relative ? y + v[1] : v[1]);
+        if (!std::isnan(v[3])) e = relative_e ? e + v[3] : v[3];
+
+        if ((code == 2) || (code == 3)) {
+            float cx = x + i, cy = y + j, r = hypotf(i, j);
+            float a0 = atan2f(y - cy, x - cx), sweep = atan2f(ny - cy, nx - cx) - a0;
+            if ((code == 3) && (sweep <= 0)) sweep += 2 * (float) M_PI;
+            if ((code == 2) && (sweep >= 0)) sweep -= 2 * (float) M_PI;
+            int steps = (int) (fabsf(sweep) * r / ARC_SAMPLE_STEP) + 1;
+            for (int s = 1; s < steps; s++) {
+                float a = a0 + sweep * (float) s / (float) steps;
+                path->push_back({ cx + r * cosf(a), cy + r * sinf(a) });
+            }
+        }
+        x = nx;
+        y = ny;
+        path->push_back({ x, y });
+    }
+};
+
+static void sink(const char *line, uint32_t file_offset, void *context) {
+    ((std::vector<emitted_line_t> *) context)->push_back({ line, file_offset });
+}
+
+/**
+ * Runs a file through strip and canonical stages, and through an arc fitter if asked.
+ * @param stats what fitter saved, may be nullptr
+ */
+static std::vector<emitted_line_t> run_pipeline(const char *name, Arcs arcs, arc_stats_t *stats = nullptr) {
+    std::vector<emitted_line_t> out;
+    std::string path = std::string(FIXTURES_DIR) + "/" + name;
+    FILE *f = fopen(path.c_str(), "r");
+    CHECK(f != nullptr);
+    if (f == nullptr) return out;
+
+    GcodePipeline pipeline(sink, &out);
+    pipeline.add(new GcodeStripStage());
+    pipeline.add(new GcodeCanonicalStage());
+    ArcFitter *fitter = nullptr;
+    if (arcs != ARCS_NONE) {
+        fitter = new ArcFitter(ARC_TOLERANCE);
+        fitter->set_enabled(arcs == ARCS_ENABLED);
+        pipeline.add(fitter);                   // Pipeline deletes its stages
+    }
+    char line[GCODE_LINE_MAX];
+    uint32_t offset = 0;
+    while (fgets(line, sizeof(line), f) != nullptr) {
+        offset += strlen(line);
+        line[strcspn(line, "\r\n")] = 0;
+        pipeline.process(line, offset);
+    }
+    pipeline.flush();
+    fclose(f);
+    if ((fitter != nullptr) && (stats != nullptr)) {
+        stats->commands_saved = fitter->get_commands_saved();
+        stats->bytes_saved = fitter->get_bytes_saved();
+    }
+    return out;
+}
+
+static float distance_to_segment(point_t p, point_t a, point_t b) {
+    float dx = b.x - a.x, dy = b.y - a.y, len2 = dx * dx + dy * dy;
+    float t = (len2 > 0) ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / len2 : 0;
+    t = fmaxf(0, fminf(1, t));
+    return hypotf(p.x - a.x - t * dx, p.y - a.y - t * dy);
+}
+
+/**
+ * Farthest distance from any of points to the path.
+ */
+static float deviation(const std::vector<point_t> &points, const std::vector<point_t> &path) {
+    float max = 0;
+    for (const point_t &p : points) {
+        float min = INFINITY;
+        for (size_t i = 0; i + 1 < path.size(); i++) min = fminf(min, distance_to_segment(p, path[i], path[i + 1]));
+        max = fmaxf(max, min);
+    }
+    return max;
+}
+
+/**
+ * Runs a fixture with and without arc fitting and checks what arcs replaced. Every line
+ * fitter emits tells the file offset of the last line it stands for, so each arc is
+ * compared with the moves which came from the same lines.
+ * @return arcs emitted
+ */
+static int check_fixture(const char *name) {
+    arc_stats_t stats{};
+    std::vector<emitted_line_t> plain = run_pipeline(name, ARCS_NONE);
+    std::vector<emitted_line_t> fitted = run_pipeline(name, ARCS_ENABLED, &stats);
+
+    Machine ref, out;
+    size_t r = 0;
+    int arcs = 0;
+    float max_deviation = 0;
+    uint32_t last_offset = 0;
+    for (const emitted_line_t &line : fitted) {
+        CHECK(line.offset >= last_offset);
+        last_offset = line.offset;
+
+        std::vector<point_t> ref_path = { { ref.x, ref.y } }, out_path = { { out.x, out.y } };
+        size_t first = r;
+        while ((r < plain.size()) && (plain[r].offset <= line.offset)) ref.run(plain[r++].line.c_str(), &ref_path);
+        out.run(line.line.c_str(), &out_path);
+
+        bool arc = (line.line[0] == 'G') && ((line.line[1] == '2') || (line.line[1] == '3')) && (line.line[2] == ' ');
+        if (!arc) {
+            // Lines which are not fitted come out as they were, one for one
+            CHECK((r == first + 1) && (plain[first].line == line.line));
+            continue;
+        }
+        arcs++;
+
+        // Move ends and their middles must be near the arc, and the arc near the moves
+        std::vector<point_t> ref_points;
+        for (size_t i = 0; i + 1 < ref_path.size(); i++) {
+            ref_points.push_back(ref_path[i + 1]);
+            ref_points.push_back({ (ref_path[i].x + ref_path[i + 1].x) / 2, (ref_path[i].y + ref_path[i + 1].y) / 2 });
+        }
+        float d = fmaxf(deviation(ref_points, out_path), deviation(out_path, ref_path));
+        max_deviation = fmaxf(max_deviation, d);
+        CHECK(d <= ARC_TOLERANCE + ROUNDING);
+        CHECK(r - first >= ARC_SEGMENTS_MIN);
+        CHECK((fabsf(out.x - ref.x) <= ROUNDING) && (fabsf(out.y - ref.y) <= ROUNDING));
+        CHECK(fabsf(out.e - ref.e) <= 0.0001f);
+        if (d > ARC_TOLERANCE + ROUNDING) fprintf(stderr, "%s: %s is %.4f mm off\n", name, line.line.c_str(), d);
+    }
+    CHECK(r == plain.size());
+    CHECK(fabsf(out.e - ref.e) <= 0.0001f);
+
+    printf("  %s: %zu line(s) in, %zu out, %d arc(s), %lu bytes saved, deviation %.4f mm\n", name, plain.size(),
+           fitted.size(), arcs, (unsigned long) stats.bytes_saved, max_deviation);
+    CHECK(stats.commands_saved == plain.size() - fitted.size());
+    return arcs;
+}
+
+static void test_circle_ccw() {
+    CHECK(check_fixture("circle_ccw.gcode") >= 4);
+}
+
+static void test_arcs_cw_relative_e() {
+    CHECK(check_fixture("arcs_cw_relative_e.gcode") >= 3);
+}
+
+static void test_noisy_large_radius() {
+    CHECK(check_fixture("noisy_large_radius.gcode") >= 1);
+}
+
+/**
+ * Zigzags, straight lines, a radius below the minimum, changing extrusion rate,
+ * changing height and relative moves are all sent as they are.
+ */
+static void test_not_arcs() {
+    CHECK(check_fixture("not_arcs.gcode") == 0);
+}
+
+/**
+ * Until printer reports ARC_SUPPORT, fitter passes everything.
+ */
+static void test_disabled() {
+    std::vector<emitted_line_t> plain = run_pipeline("circle_ccw.gcode", ARCS_NONE);
+    std::vector<emitted_line_t> out = run_pipeline("circle_ccw.gcode", ARCS_DISABLED);
+    CHECK(out.size() == plain.size());
+    for (size_t i = 0; (i < out.size()) && (i < plain.size()); i++) {
+        CHECK((out[i].line == plain[i].line) && (out[i].offset == plain[i].offset));
+    }
+}
+
+int main(int argc, char **argv) {
+    static const host_test_t tests[] = {
+            { "circle_ccw", test_circle_ccw },
+            { "arcs_cw_relative_e", test_arcs_cw_relative_e },
+            { "noisy_large_radius", test_noisy_large_radius },
+            { "not_arcs", test_not_arcs },
+            { "disabled", test_disabled },
+    };
+    return run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+}
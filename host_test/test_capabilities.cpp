@@ -0,0 +1,181 @@
+/*
+  test_capabilities.cpp - M115 answers of a virtual printer and recorded ones parsed into capabilities
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "fd_transport.h"
+#include "host_test.h"
+#include "test_printer.h"
+#include "utils.h"
+#include "virtual_printer.h"
+
+#define IDLE_TIMEOUT            5000    // ms
+
+static std::string read_fixture(const char *name) {
+    std::string data;
+    FILE *f = fopen((std::string(FIXTURES_DIR) + "/" + name).c_str(), "rb");
+    CHECK(f != nullptr);
+    if (f == nullptr) return data;
+    char buf[256];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;) data.append(buf, n);
+    fclose(f);
+    return data;
+}
+
+/**
+ * Printer which plays recorded answer to M115 and says 'ok' to anything else.
+ * @return printer connected to it
+ */
+static Printer *scripted_printer(const char *fixture) {
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    std::string answer = read_fixture(fixture);
+    std::thread([fd = fds[1], answer] {
+        std::string line;
+        char c;
+        while (read(fd, &c, 1) == 1) {
+            if (c != '\n') {
+                line += c;
+                continue;
+            }
+            const std::string &out = (line == "M115") ? answer : std::string("ok\n");
+            for (size_t done = 0; done < out.size();) {
+                ssize_t n = write(fd, &out[done], out.size() - done);
+                if (n > 0) done += n;
+                else if (errno != EINTR) return;
+            }
+            line.clear();
+        }
+    }).detach();
+
+    Printer *printer = test_printer("", new FdTransport(fds[0]));
+    CHECK(printer != nullptr);
+    return printer;
+}
+
+/**
+ * Gets capabilities printer reported when status task asked for them.
+ */
+static void request_caps(Printer *printer, printer_caps_t *caps) {
+    *caps = {};
+    if (printer == nullptr) return;
+    CHECK(test_wait_caps(printer, IDLE_TIMEOUT));
+    *caps = *printer->get_caps();
+}
+
+/**
+ * Marlin 2.1 lists many more capabilities than are used, and a temperature report may come in between.
+ */
+static void test_marlin() {
+    printer_caps_t caps;
+    request_caps(scripted_printer("m115_marlin.txt"), &caps);
+    CHECK(caps.received);
+    CHECK(strcmp(caps.firmware_name, "Marlin 2.1.2.1 (Jun 26 2023 12:00:00)") == 0);
+    CHECK(caps.autoreport_temp && !caps.autoreport_pos);
+    CHECK(caps.emergency_parser && caps.extended_m20 && caps.arc_support);
+    CHECK(!caps.binary_file_transfer && !caps.serial_xon_xoff && !caps.progress);
+}
+
+/**
+ * Marlin 1.1 answers with firmware name only: printer is known, none of the features is.
+ */
+static void test_no_caps() {
+    printer_caps_t caps;
+    request_caps(scripted_printer("m115_no_caps.txt"), &caps);
+    CHECK(caps.received);
+    CHECK(strcmp(caps.firmware_name, "Marlin 1.1.9 (Github)") == 0);
+    CHECK(!caps.autoreport_temp && !caps.autoreport_pos && !caps.emergency_parser && !caps.arc_support);
+}
+
+/**
+ * Prusa firmware has its own names: AUTOREPORT_TEMPERATURE is not Marlin's AUTOREPORT_TEMP,
+ * so M155 is not relied on, and its name is followed by FIRMWARE_URL.
+ */
+static void test_prusa() {
+    printer_caps_t caps;
+    request_caps(scripted_printer("m115_prusa.txt"), &caps);
+    CHECK(caps.received);
+    CHECK(strcmp(caps.firmware_name, "Prusa-Firmware 3.13.2 based on Marlin") == 0);
+    CHECK(caps.extended_m20);
+    CHECK(!caps.autoreport_temp && !caps.autoreport_pos);
+}
+
+/**
+ * Virtual printer tells about XON/XOFF only while it's on, as Marlin built with SERIAL_XON_XOFF would.
+ */
+static void test_virtual_printer() {
+    auto vp = new VirtualPrinter("16,4,1,0,1");
+    Printer *printer = test_printer("checksum=1\n", vp);
+    CHECK(printer != nullptr);
+    if (printer == nullptr) return;
+    printer_caps_t caps;
+    request_caps(printer, &caps);
+    CHECK(caps.received);
+    CHECK(strncmp(caps.firmware_name, "Marlin virtual printer", 22) == 0);
+    CHECK(caps.autoreport_temp && caps.autoreport_pos && caps.emergency_parser && caps.arc_support);
+    CHECK(!caps.serial_xon_xoff);
+
+    // Answer to M115 sent from console is parsed as well
+    CHECK(vp->set_flow_control(FLOW_CONTROL_XON_XOFF) == ESP_OK);
+    printer->send_cmd("M115", COMMAND_SOURCE_CONSOLE, 0, portMAX_DELAY);
+    CHECK(test_wait_idle(printer, IDLE_TIMEOUT));
+    CHECK(printer->get_caps()->serial_xon_xoff);
+}
+
+/**
+ * Firmware name is escaped in JSON, the worst case fits CAPS_JSON_SIZE and a short buffer gets nothing.
+ */
+static void test_json() {
+    printer_caps_t caps;
+    CHECK(caps_parse_line("FIRMWARE_NAME:Fork \"x\" \\ 1 SOURCE_CODE_URL:x", &caps));
+    char json[CAPS_JSON_SIZE];
+    size_t len = caps_to_json(&caps, json, sizeof(json));
+    CHECK((len > 0) && (len == strlen(json)));
+    CHECK(strstr(json, R"("firmware":"Fork \"x\" \\ 1")") != nullptr);
+
+    std::string worst = "FIRMWARE_NAME:" + std::string(CAPS_FIRMWARE_NAME_LENGTH, '\x01');
+    CHECK(caps_parse_line(worst.c_str(), &caps));
+    CHECK(strlen(caps.firmware_name) == CAPS_FIRMWARE_NAME_LENGTH - 1);
+    caps.autoreport_temp = caps.autoreport_pos = caps.emergency_parser = caps.binary_file_transfer = true;
+    caps.extended_m20 = caps.serial_xon_xoff = caps.arc_support = caps.progress = true;
+    len = caps_to_json(&caps, json, sizeof(json));
+    CHECK((len > 0) && (json[len - 1] == '}'));
+
+    CHECK(caps_to_json(&caps, json, len) == 0);
+    CHECK(json[0] == 0);
+}
+
+int main(int argc, char **argv) {
+    static const host_test_t tests[] = {
+            { "marlin", test_marlin },
+            { "no caps", test_no_caps },
+            { "prusa", test_prusa },
+            { "virtual printer", test_virtual_printer },
+            { "json", test_json },
+    };
+    // Tasks never end, so the process leaves without tearing them down
+    int res = run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+    _exit(res);
+}
@@ -0,0 +1,317 @@
+/*
+  test_motion_estimator.cpp - print time estimate against exact times, a full lookahead planner and the clock
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <esp_timer.h>
+
+#include "gcode_pipeline.h"
+#include "host_test.h"
+#include "motion_estimator.h"
+
+#define ARC_SEGMENT_LEN         1.0f    // mm, Marlin's MM_PER_ARC_SEGMENT
+#define REFERENCE_ERROR_MAX     0.10f   // Estimate may differ from full lookahead planner that much
+#define BENCHMARK_LINES         500000
+#define BENCHMARK_RATE_MIN      1.0f    // MB/s, far below what any host does, catches only a blunder
+
+/**
+ * Runs lines through strip, canonical and estimator stages.
+ * @param lines canonical lines which came out, may be nullptr
+ * @return estimated time, ms
+ */
+static uint32_t estimate(const std::vector<std::string> &gcode, std::vector<std::string> *lines) {
+    GcodePipeline pipeline([](const char *line, uint32_t /* file_offset */, void *context) {
+        if (context != nullptr) ((std::vector<std::string> *) context)->push_back(line);
+    }, lines);
+    pipeline.add(new GcodeStripStage());
+    pipeline.add(new GcodeCanonicalStage());
+    auto estimator = new MotionEstimator();
+    pipeline.add(estimator);
+
+    char line[GCODE_LINE_MAX];
+    uint32_t offset = 0;
+    for (const std::string &l : gcode) {
+        snprintf(line, sizeof(line), "%s", l.c_str());
+        offset += l.size() + 1;
+        pipeline.process(line, offset);
+    }
+    pipeline.flush();
+    return estimator->get_time();
+}
+
+static std::vector<std::string> read_fixture(const char *name) {
+    std::vector<std::string> gcode;
+    FILE *f = fopen((std::string(FIXTURES_DIR) + "/" + name).c_str(), "r");
+    CHECK(f != nullptr);
+    if (f == nullptr) return gcode;
+    char line[GCODE_LINE_MAX];
+    while (fgets(line, sizeof(line), f) != nullptr) {
+        line[strcspn(line, "\r\n")] = 0;
+        gcode.emplace_back(line);
+    }
+    fclose(f);
+    return gcode;
+}
+
+typedef struct {
+    float len;                          // mm
+    float speed;                        // mm/s
+    float acceleration;                 // mm/s^2
+    float dir[3];                       // Unit vector, zero for extruder only moves
+    float entry;                        // mm/s
+    float wait;                         // s printer stands still before the block
+} block_t;
+
+/**
+ * Plans canonical lines as Marlin does with a planner deep enough to hold the whole file:
+ * arcs are cut into short segments, junction speed follows junction deviation, and speeds are
+ * lowered backwards from every stop and forwards from every start before time is added up.
+ * That's how long printer takes, heating aside.
+ * @return seconds
+ */
+static double reference_time(const std::vector<std::string> &lines) {
+    std::vector<block_t> blocks;
+    float pos[4] = { 0, 0, 0, 0 }, feedrate = MOTION_FEEDRATE / 60.0f, acceleration = MOTION_ACCELERATION;
+    bool relative = false, relative_e = false;
+    float wait = 0;
+
+    auto add_block = [&](const float *target, float speed) {
+        float d[3] = { target[0] - pos[0], target[1] - pos[1], target[2] - pos[2] };
+        float len = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        block_t b = { len, speed, acceleration, { 0, 0, 0 }, 0, wait };
+        if (len > 0) for (int i = 0; i < 3; i++) b.dir[i] = d[i] / len;
+        else b.len = fabsf(target[3] - pos[3]);
+        memcpy(pos, target, sizeof(pos));
+        if (b.len <= 0) return;
+        blocks.push_back(b);
+        wait = 0;
+    };
+
+    for (const std::string &l : lines) {
+        const char *line = l.c_str();
+        int code = atoi(&line[1]);
+        float v[26];
+        for (float &x : v) x = NAN;
+        for (const char *p = strchr(line, ' '); p != nullptr; p = strchr(p + 1, ' ')) {
+            if ((p[1] >= 'A') && (p[1] <= 'Z')) v[p[1] - 'A'] = strtof(&p[2], nullptr);
+        }
+        auto has = [&v](char c) { return !std::isnan(v[c - 'A']); };
+        if (line[0] == 'M') {
+            if (code == 82) relative_e = false;
+            else if (code == 83) relative_e = true;
+            else if ((code == 204) && has('S')) acceleration = v['S' - 'A'];
+            continue;
+        }
+        if (line[0] != 'G') continue;
+        if (code == 90) relative = false;
+        else if (code == 91) relative = true;
+        else if (code == 92) {
+            for (int i = 0; i < 4; i++) if (has("XYZE"[i])) pos[i] = v["XYZE"[i] - 'A'];
+        } else if (code == 4) {
+            wait += has('P') ? v['P' - 'A'] / 1000 : (has('S') ? v['S' - 'A'] : 0);
+        } else if (code == 28) {
+            wait += MOTION_HOMING_TIME / 1000.0f;
+            pos[0] = pos[1] = pos[2] = 0;
+        } else if ((code >= 0) && (code <= 3)) {
+            if (has('F')) feedrate = v['F' - 'A'] / 60.0f;
+            float target[4];
+            for (int i = 0; i < 4; i++) {
+                bool rel = (i == 3) ? relative_e : relative;
+                target[i] = has("XYZE"[i]) ? (rel ? pos[i] + v["XYZE"[i] - 'A'] : v["XYZE"[i] - 'A']) : pos[i];
+            }
+            if (code < 2) {
+                add_block(target, feedrate);
+                continue;
+            }
+
+            // Arc goes as short straight segments, as Marlin's plan_arc() sends it to planner
+            float cx = pos[0] + (has('I') ? v['I' - 'A'] : 0), cy = pos[1] + (has('J') ? v['J' - 'A'] : 0);
+            float r = hypotf(pos[0] - cx, pos[1] - cy);
+            float a0 = atan2f(pos[1] - cy, pos[0] - cx), sweep = atan2f(target[1] - cy, target[0] - cx) - a0;
+            if ((code == 3) && (sweep <= 0)) sweep += 2 * (float) M_PI;
+            if ((code == 2) && (sweep >= 0)) sweep -= 2 * (float) M_PI;
+            int segments = (int) fmaxf(1, floorf(fabsf(sweep) * r / ARC_SEGMENT_LEN));
+            float start[4];
+            memcpy(start, pos, sizeof(start));
+            for (int s = 1; s <= segments; s++) {
+                float t = (float) s / (float) segments, a = a0 + sweep * t, p[4];
+                p[0] = (s == segments) ? target[0] : cx + r * cosf(a);
+                p[1] = (s == segments) ? target[1] : cy + r * sinf(a);
+                p[2] = start[2] + (target[2] - start[2]) * t;
+                p[3] = start[3] + (target[3] - start[3]) * t;
+                add_block(p, feedrate);
+            }
+        }
+    }
+
+    // Junction limits, then backward and forward passes
+    size_t n = blocks.size();
+    for (size_t i = 1; i < n; i++) {
+        block_t &b = blocks[i], &prev = blocks[i - 1];
+        float v_max = fminf(b.speed, prev.speed);
+        float cos_theta = -(prev.dir[0] * b.dir[0] + prev.dir[1] * b.dir[1] + prev.dir[2] * b.dir[2]);
+        bool still = (b.wait > 0) || ((b.dir[0] == 0) && (b.dir[1] == 0) && (b.dir[2] == 0)) ||
+                ((prev.dir[0] == 0) && (prev.dir[1] == 0) && (prev.dir[2] == 0));
+        if (still || (cos_theta > 0.999999f)) b.entry = 0;
+        else if (cos_theta < -0.999999f) b.entry = v_max;
+        else {
+            float sin_theta_d2 = sqrtf(0.5f * (1.0f - cos_theta));
+            b.entry = fminf(v_max, sqrtf(b.acceleration * MOTION_JUNCTION_DEVIATION * sin_theta_d2 / (1.0f - sin_theta_d2)));
+        }
+    }
+    float exit = 0;
+    for (size_t i = n; i-- > 0;) {
+        blocks[i].entry = fminf(blocks[i].entry, sqrtf(exit * exit + 2 * blocks[i].acceleration * blocks[i].len));
+        exit = blocks[i].entry;
+    }
+    for (size_t i = 0; i + 1 < n; i++) {
+        float reachable = sqrtf(blocks[i].entry * blocks[i].entry + 2 * blocks[i].acceleration * blocks[i].len);
+        blocks[i + 1].entry = fminf(blocks[i + 1].entry, reachable);
+    }
+
+    double time = wait;
+    for (size_t i = 0; i < n; i++) {
+        const block_t &b = blocks[i];
+        double v0 = b.entry, v1 = (i + 1 < n) ? blocks[i + 1].entry : 0, a = b.acceleration, v = b.speed;
+        double d_acc = (v * v - v0 * v0) / (2 * a), d_dec = (v * v - v1 * v1) / (2 * a);
+        if (d_acc + d_dec > b.len) {
+            v = sqrt((2 * a * b.len + v0 * v0 + v1 * v1) / 2);
+            d_acc = (v * v - v0 * v0) / (2 * a);
+            d_dec = (v * v - v1 * v1) / (2 * a);
+        }
+        time += b.wait + (v - v0) / a + (v - v1) / a + (b.len - d_acc - d_dec) / v;
+    }
+    return time;
+}
+
+/**
+ * Moves whose time is known exactly: trapezoid, triangle, a straight chain which is
+ * as fast as one move, dwell, homing and acceleration set by G-code.
+ */
+static void test_exact() {
+    // 100 mm at 100 mm/s with 1000 mm/s^2: 0.1 s up, 0.1 s down, 90 mm cruising
+    CHECK(abs((int) estimate({ "G1 X100 F6000" }, nullptr) - 1100) <= 1);
+
+    // 2 mm never gets to cruise speed, peak is sqrt(a * len)
+    CHECK(abs((int) estimate({ "G1 X2 F6000" }, nullptr) - (int) (2000 * sqrtf(2000) / 1000)) <= 1);
+
+    std::vector<std::string> chain;
+    for (int i = 1; i <= 10; i++) chain.push_back("G1 X" + std::to_string(i * 10) + " F6000");
+    CHECK(abs((int) estimate(chain, nullptr) - 1100) <= 2);
+
+    CHECK(abs((int) estimate({ "G1 X100 F6000", "G4 P500" }, nullptr) - 1600) <= 1);
+    CHECK(estimate({ "G28" }, nullptr) == MOTION_HOMING_TIME);
+    CHECK(abs((int) estimate({ "M204 S4000", "G1 X100 F6000" }, nullptr) - 1025) <= 1);
+
+    // Relative and absolute moves end at the same place, in the same time
+    CHECK(estimate({ "G91", "G1 X50 F6000", "G1 X50" }, nullptr) == estimate({ "G1 X50 F6000", "G1 X100" }, nullptr));
+}
+
+/**
+ * Estimate against a planner which looks ahead through the whole file.
+ */
+static void compare(const char *name, const std::vector<std::string> &gcode) {
+    std::vector<std::string> lines;
+    uint32_t estimated = estimate(gcode, &lines);
+    double reference = reference_time(lines) * 1000;
+    double error = (estimated - reference) / reference;
+    printf("  %s: estimated %lu ms, planned %.0f ms, %+.1f%%\n", name, (unsigned long) estimated, reference,
+           error * 100);
+    CHECK(fabs(error) <= REFERENCE_ERROR_MAX);
+}
+
+static void test_fixtures() {
+    for (const char *name : { "circle_ccw.gcode", "arcs_cw_relative_e.gcode", "noisy_large_radius.gcode", "not_arcs.gcode" }) {
+        compare(name, read_fixture(name));
+    }
+}
+
+/**
+ * Generated infill and perimeters, the kind of G-code most of print time goes to.
+ */
+static void test_infill() {
+    std::vector<std::string> gcode = { "M204 S1500", "G1 Z0.2 F600", "M83" };
+    char line[64];
+    for (int layer = 0; layer < 5; layer++) {
+        for (int i = 0; i < 60; i++) {
+            snprintf(line, sizeof(line), "G1 X%d Y%.1f E%.4f F3600", (i % 2) ? 10 : 110, 10 + i * 0.45, 100 * 0.033);
+            gcode.emplace_back(line);
+        }
+        for (int i = 0; i <= 180; i++) {
+            float a = (float) i / 180 * 2 * (float) M_PI;
+            snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.4f F1800", 60 + 45 * cosf(a), 40 + 45 * sinf(a), 0.05);
+            gcode.emplace_back(line);
+        }
+        snprintf(line, sizeof(line), "G0 X10 Y10 Z%.1f F9000", 0.2 * (layer + 2));
+        gcode.emplace_back(line);
+    }
+    compare("infill", gcode);
+}
+
+/**
+ * Short segments of a gentle curve at high speed: junctions are fast, so planner needs
+ * many blocks ahead to stop in time, which is where one move lookahead is worst.
+ */
+static void test_dense_curve() {
+    std::vector<std::string> gcode = { "G1 X0 Y0 F12000" };
+    char line[64];
+    for (int i = 1; i <= 400; i++) {
+        float a = (float) i * 0.002f;
+        snprintf(line, sizeof(line), "G1 X%.3f Y%.3f", 100 * sinf(a), 100 * (1 - cosf(a)));
+        gcode.emplace_back(line);
+    }
+    compare("dense curve", gcode);
+}
+
+/**
+ * Strip, canonical and estimator stages over a generated file, as cache is built at upload.
+ * Rate is logged, the check only catches a blunder.
+ */
+static void test_throughput() {
+    std::vector<std::string> gcode;
+    char line[64];
+    size_t bytes = 0;
+    for (int i = 0; i < BENCHMARK_LINES; i++) {
+        snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f ; wall", 100 + 50 * sinf(i * 0.01f), 100 + 50 * cosf(i * 0.01f),
+                 i * 0.01f);
+        gcode.emplace_back(line);
+        bytes += strlen(line) + 1;
+    }
+    int64_t start = esp_timer_get_time();
+    estimate(gcode, nullptr);
+    float seconds = (float) (esp_timer_get_time() - start) / 1000000.0f;
+    float rate = (float) bytes / 1048576.0f / seconds;
+    printf("  %d lines, %.1f MB in %.2f s: %.1f MB/s, %.0f lines/s\n", BENCHMARK_LINES, (float) bytes / 1048576.0f,
+           seconds, rate, BENCHMARK_LINES / seconds);
+    CHECK(rate >= BENCHMARK_RATE_MIN);
+}
+
+int main(int argc, char **argv) {
+    static const host_test_t tests[] = {
+            { "exact", test_exact },
+            { "fixtures", test_fixtures },
+            { "infill", test_infill },
+            { "dense curve", test_dense_curve },
+            { "throughput", test_throughput },
+    };
+    return run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+}
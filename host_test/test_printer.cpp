@@ -0,0 +1,74 @@
+/*
+  test_printer.cpp - firmware's Printer set up for host tests
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include "sdcard.h"
+#include "settings.h"
+#include "test_printer.h"
+
+#define TEST_SETTINGS_DIR       "esp3d"
+#define TEST_SETTINGS_FILE      TEST_SETTINGS_DIR "/settings"
+
+extern Settings settings;
+
+Printer *test_printer(const char *settings_file, Transport *transport) {
+    sdcard_make_dir(TEST_SETTINGS_DIR);
+    FILE *f = sdcard_open_file(TEST_SETTINGS_FILE, "w");
+    if (f == nullptr) return nullptr;
+    fputs(settings_file, f);
+    fclose(f);
+    settings = Settings();      // Values of the previous printer are not kept
+    if (settings.load() != ESP_OK) return nullptr;
+
+    auto printer = new Printer(0);
+    if (printer->init(transport) != ESP_OK) return nullptr;
+    return printer;
+}
+
+unsigned long test_stream(Printer *printer, const char *command) {
+    return printer->send_cmd(command, COMMAND_SOURCE_PRINT, 0, portMAX_DELAY);
+}
+
+bool test_wait_idle(Printer *printer, uint32_t timeout_ms) {
+    SerialPort *uart = printer->get_uart();
+    TickType_t start = xTaskGetTickCount();
+    while ((uart->get_queued() > 0) || (uart->get_in_flight() > 0)) {
+        if ((xTaskGetTickCount() - start) * portTICK_PERIOD_MS >= timeout_ms) return false;
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    return true;
+}
+
+bool test_wait_caps(Printer *printer, uint32_t timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+    while (!printer->get_caps()->received) {
+        if ((xTaskGetTickCount() - start) * portTICK_PERIOD_MS >= timeout_ms) return false;
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return test_wait_idle(printer, timeout_ms);     // The rest of the answer comes before its 'ok'
+}
+
+bool test_wait_job(Printer *printer, uint32_t timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+    while ((printer->get_opened_file() != nullptr) || (printer->get_status() == PRINTER_PRINTING)) {
+        if ((xTaskGetTickCount() - start) * portTICK_PERIOD_MS >= timeout_ms) return false;
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return test_wait_idle(printer, timeout_ms);
+}
@@ -0,0 +1,64 @@
+/*
+  test_printer.h - firmware's Printer set up for host tests
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_TEST_PRINTER_H
+#define ESP32_PRINT_TEST_PRINTER_H
+
+#include "printer.h"
+
+#define TEST_BAUD_RATE          115200
+
+/**
+ * Makes a printer as firmware does at start: settings file is written to SD card and loaded,
+ * then printer is connected with given transport and its tasks are started. Every printer
+ * takes the first printer's settings, tasks never end so printer is never deleted.
+ * @param settings_file settings file content, lines end with newline
+ * @param transport connection to printer
+ * @return nullptr if printer was not connected
+ */
+Printer *test_printer(const char *settings_file, Transport *transport);
+
+/**
+ * Queues a command of print stream, waiting for room.
+ * @return command id, 0 if it was refused
+ */
+unsigned long test_stream(Printer *printer, const char *command);
+
+/**
+ * Waits until every queued command is confirmed.
+ * @param timeout_ms
+ * @return false if printer is still working after given time
+ */
+bool test_wait_idle(Printer *printer, uint32_t timeout_ms);
+
+/**
+ * Waits until printer answers M115 status task sends when printer gets connected,
+ * and the whole answer is parsed.
+ * @return false if capabilities did not come in given time
+ */
+bool test_wait_caps(Printer *printer, uint32_t timeout_ms);
+
+/**
+ * Waits until print job is done and print task is idle again.
+ * @return false if it's still printing after given time
+ */
+bool test_wait_job(Printer *printer, uint32_t timeout_ms);
+
+#endif //ESP32_PRINT_TEST_PRINTER_H
@@ -0,0 +1,245 @@
+/*
+  test_reports.cpp - temperature, position and ADVANCED_OK reports parsed and timed
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <esp_timer.h>
+
+#include "fd_transport.h"
+#include "host_test.h"
+#include "reports.h"
+#include "test_printer.h"
+
+#define BENCHMARK_LINES         1000000
+#define BENCHMARK_LINE_MAX_NS   2000    // Far above what any host takes, catches only a blunder
+
+static void test_temperatures() {
+    float hot_end = 0, hot_end_target = 0, bed = -1, bed_target = -1;
+    report_parse_temperatures("T:210.50 /215.00 B:60.20 /60.00 @:127 B@:0", &hot_end, &hot_end_target, &bed, &bed_target);
+    CHECK((hot_end == 210.5f) && (hot_end_target == 215.0f) && (bed == 60.2f) && (bed_target == 60.0f));
+
+    // Extruders of a multi extruder printer and chamber are skipped, T is the active one
+    report_parse_temperatures("T:200.00 /205.00 B:55.00 /55.00 C:30.00 /0.00 T0:200.00 /205.00 T1:25.00 /0.00 @:0 B@:0 @0:0 @1:0",
+                              &hot_end, &hot_end_target, &bed, &bed_target);
+    CHECK((hot_end == 200.0f) && (hot_end_target == 205.0f) && (bed == 55.0f) && (bed_target == 55.0f));
+
+    // Printer with no heat bed leaves it as it was
+    report_parse_temperatures("T:24.80 /0.00 @:0", &hot_end, &hot_end_target, &bed, &bed_target);
+    CHECK((hot_end == 24.8f) && (hot_end_target == 0.0f) && (bed == 55.0f) && (bed_target == 55.0f));
+}
+
+static void test_position() {
+    float x = -1, y = -1, z = -1, e = -1;
+    report_parse_position("X:10.00 Y:20.00 Z:0.30 E:1.50 Count X:800 Y:1600 Z:120", &x, &y, &z, &e);
+    CHECK((x == 10.0f) && (y == 20.0f) && (z == 0.3f) && (e == 1.5f));
+
+    report_parse_position("X:-5.25 Y:0.00 Z:12.00", &x, &y, &z, &e);
+    CHECK((x == -5.25f) && (y == 0.0f) && (z == 12.0f) && (e == 1.5f));
+}
+
+static void test_ok() {
+    int planner_free, buffer_free;
+    CHECK(report_parse_ok("ok N10 P15 B3", &planner_free, &buffer_free));
+    CHECK((planner_free == 15) && (buffer_free == 3));
+    CHECK(!report_parse_ok("ok", &planner_free, &buffer_free));
+    CHECK((planner_free == -1) && (buffer_free == -1));
+    CHECK(!report_parse_ok("ok T:210.00 /210.00 B:60.00 /60.00 @:64 B@:0", &planner_free, &buffer_free));
+    CHECK(report_parse_ok("ok P0 B0", &planner_free, &buffer_free));
+    CHECK((planner_free == 0) && (buffer_free == 0));
+}
+
+/**
+ * Printer state the old parser wrote to.
+ */
+typedef struct {
+    bool connected;
+    float hot_end, hot_end_target, bed, bed_target;
+    float pos[4];
+    int planner_free;
+    bool autoreport;
+    unsigned int last_sent_command_time;
+    unsigned int temp_report_time;
+    printer_caps_t caps;
+    char last_report[256];
+} legacy_state_t;
+
+/**
+ * Internal function.
+ * Temperature parser of the old Printer::parse_report(), scans the report byte by byte.
+ */
+static void legacy_parse_temperature(legacy_state_t *state, const char *report) {
+    unsigned short flag = 0, cnt = 0, pos = 0;
+    char val[10];
+    do {
+        unsigned short len;
+        switch (report[cnt]) {
+            case 'T': flag = (1 << 0); break;
+            case 'B': flag = (1 << 1); break;
+            case '@': if (flag & (1 << 1)) flag = ((1 << 2) | (1 << 1)); else flag = ((1 << 2) | (1 << 0)); break;
+            case ':': case '/':
+                pos = cnt + 1;
+                if (report[cnt] == '/') flag |= (1 << 3);
+                break;
+            case 'W': flag = (1 << 5); break;
+            case ' ': case 0:
+                len = (cnt - pos > 9) ? 10 : cnt - pos;
+                strncpy(val, &report[pos], len);
+                val[len] = 0;
+                char *end;
+                float val_f = strtof(val, &end);
+                if (flag & (1 << 0)) {
+                    if (flag & (1 << 3)) { state->hot_end_target = val_f; flag = 0; }
+                    else if (!(flag & (1 << 2))) state->hot_end = val_f;
+                } else if (flag & (1 << 1)) {
+                    if (flag & (1 << 3)) { state->bed_target = val_f; flag = 0; }
+                    else if (!(flag & (1 << 2))) state->bed = val_f;
+                }
+                break;
+        }
+    } while (report[cnt++] != 0);
+    state->temp_report_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    state->autoreport = true;
+}
+
+/**
+ * Internal function.
+ * Printer::parse_report() as it was before lines were dispatched by their first bytes: a chain
+ * of strncmp() checks, own parsers, and every line but 'ok' copied. It's kept here only as the
+ * baseline new dispatch is timed against, and it calls the same SerialPort methods.
+ */
+static bool strncmp_chain_parse(legacy_state_t *state, SerialPort *uart, const char *report, size_t len) {
+    if ((report[0] == 'o') && (report[1] == 'k')) {
+        state->last_sent_command_time = (uart->get_in_flight() > 1) ? xTaskGetTickCount() * portTICK_PERIOD_MS : 0;
+        int planner_free = -1, buffer_free = -1;
+        const char *p = report + 2;
+        while (*p == ' ') {
+            p++;
+            char field = *p++;
+            if ((*p < '0') || (*p > '9')) break;
+            char *end;
+            long val = strtol(p, &end, 10);
+            if (field == 'P') planner_free = (int) val;
+            else if (field == 'B') buffer_free = (int) val;
+            p = end;
+        }
+        if (buffer_free >= 0) {
+            state->planner_free = planner_free;
+            uart->set_free_slots(buffer_free);
+        }
+        if ((report[2] != 0) && (strncmp(&report[3], "T:", 2) == 0)) legacy_parse_temperature(state, &report[3]);
+        state->connected = true;
+        uart->lock(false);
+        return true;
+    }
+
+    if (len >= sizeof(state->last_report)) len = sizeof(state->last_report) - 1;
+    memcpy(state->last_report, report, len);
+    state->last_report[len] = 0;
+
+    if (strncmp(report, "Resend:", 7) == 0) {
+        uart->resend(strtoul(&report[7], nullptr, 10));
+        return false;
+    }
+    if ((report[0] == 'r') && (report[1] == 's') && (report[2] == ' ')) {
+        uart->resend(strtoul(&report[3], nullptr, 10));
+        return false;
+    }
+    if (strncmp(report, "echo:busy: ", 11) == 0) uart->lock(true);
+    else if (strncmp(report, "T:", 2) == 0) legacy_parse_temperature(state, report);
+    else if (strncmp(report, " T:", 3) == 0) legacy_parse_temperature(state, &report[1]);
+    else if (strncmp(report, "X:", 2) == 0) {
+        const char *p = report;
+        while ((*p != 0) && (strncmp(p, "Count", 5) != 0)) {
+            if (p[1] == ':') {
+                char *end;
+                float val = strtof(&p[2], &end);
+                switch (p[0]) {
+                    case 'X': state->pos[0] = val; break;
+                    case 'Y': state->pos[1] = val; break;
+                    case 'Z': state->pos[2] = val; break;
+                    case 'E': state->pos[3] = val; break;
+                    default: break;
+                }
+                p = end;
+            } else p++;
+            while (*p == ' ') p++;
+        }
+    }
+    else if (strncmp(report, "echo:Unknown command: \"M155", 27) == 0) state->autoreport = false;
+    else if (strcmp(report, "start") == 0) state->autoreport = false;
+    else caps_parse_line(report, &state->caps);
+    return false;
+}
+
+/**
+ * What printer says while printing: mostly 'ok' with ADVANCED_OK, with temperature and position
+ * auto-reports in between. The same lines go through the old strncmp() chain and through
+ * Printer::parse_report() of a printer whose link never answers, so nothing else parses them.
+ */
+static void test_throughput() {
+    static const char *lines[] = {
+            "ok N1201 P14 B3", "ok N1202 P13 B3", "ok N1203 P14 B2", "ok N1204 P15 B3",
+            " T:210.12 /210.00 B:60.03 /60.00 @:74 B@:21",
+            "ok N1205 P14 B3", "ok N1206 P13 B3", "ok N1207 P15 B3",
+            "X:112.40 Y:98.21 Z:0.30 E:1523.11 Count X:8992 Y:7857 Z:120",
+    };
+    static const size_t count = sizeof(lines) / sizeof(lines[0]);
+    size_t lens[count];
+    for (size_t i = 0; i < count; i++) lens[i] = strlen(lines[i]);
+
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    Printer *printer = test_printer("", new FdTransport(fds[0]));
+    CHECK(printer != nullptr);
+    if (printer == nullptr) return;
+
+    auto legacy = new legacy_state_t();
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < BENCHMARK_LINES; i++) {
+        strncmp_chain_parse(legacy, printer->get_uart(), lines[i % count], lens[i % count]);
+    }
+    float chain_ns = (float) (esp_timer_get_time() - start) * 1000.0f / BENCHMARK_LINES;
+    CHECK((legacy->hot_end == 210.12f) && (legacy->pos[3] == 1523.11f));
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < BENCHMARK_LINES; i++) printer->parse_report(lines[i % count], lens[i % count]);
+    float dispatch_ns = (float) (esp_timer_get_time() - start) * 1000.0f / BENCHMARK_LINES;
+    float x, y, z, e;
+    printer->get_position(&x, &y, &z, &e);
+    CHECK((printer->get_temp_hot_end() == 210.12f) && (e == 1523.11f) && printer->has_advanced_ok());
+
+    printf("  %d lines: strncmp chain %.0f ns per line, first byte dispatch %.0f ns per line (%+.0f%%)\n",
+           BENCHMARK_LINES, chain_ns, dispatch_ns, (dispatch_ns / chain_ns - 1.0f) * 100.0f);
+    CHECK(dispatch_ns < BENCHMARK_LINE_MAX_NS);
+}
+
+int main(int argc, char **argv) {
+    static const host_test_t tests[] = {
+            { "temperatures", test_temperatures },
+            { "position", test_position },
+            { "ok", test_ok },
+            { "throughput", test_throughput },
+    };
+    // Tasks never end, so the process leaves without tearing them down
+    int res = run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+    _exit(res);
+}
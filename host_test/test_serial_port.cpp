@@ -0,0 +1,366 @@
+/*
+  test_serial_port.cpp - Printer streaming to a virtual printer, directly and over a pty or a socket
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <esp_timer.h>
+
+#include "fd_transport.h"
+#include "host_test.h"
+#include "test_printer.h"
+#include "sdcard.h"
+#include "virtual_printer.h"
+
+#define SETTINGS_CHECKSUM       "checksum=1\n"
+#define STREAM_MOVES            400
+#define STREAM_BUFSIZE          4       // Virtual printer's command buffer, '16,4,...' settings
+#define IDLE_TIMEOUT            20000   // ms
+#define TWO_PRINTERS_SHARE_MIN  0.7f    // Slower of two printers streamed at once keeps this share of the faster one's rate
+#define LINK_LATENCY            8       // ms, between FTDI's default 16 ms and what a tuned adapter does
+#define JOB_FILE                "moves.gcode"
+#define JOB_MOVES               1000
+#define JOB_MOVE_TIME           "2"     // ms, '16,4,...' settings of virtual printer
+#define JOB_TIMEOUT             60000   // ms
+#define JOB_UNDERRUNS_MAX       3       // Planner runs dry once at the end of job, the rest is a stutter
+
+/**
+ * Streams relative unit moves and asks for position. Every move lost or run twice
+ * shows up in the reported position.
+ * @return moves per second
+ */
+static float stream_moves(Printer *printer, int moves) {
+    int64_t start = esp_timer_get_time();
+    test_stream(printer, "G91");
+    for (int i = 0; i < moves; i++) test_stream(printer, "G1 X1 F6000");
+    test_stream(printer, "G90");
+    test_stream(printer, "M114");
+    CHECK(test_wait_idle(printer, IDLE_TIMEOUT));
+    float seconds = (float) (esp_timer_get_time() - start) / 1000000.0f;
+
+    float x = -1, y, z, e;
+    printer->get_position(&x, &y, &z, &e);
+    CHECK(x == (float) moves);
+    if (x != (float) moves) fprintf(stderr, "Position X:%.2f, expected %d\n", x, moves);
+    return (float) moves / seconds;
+}
+
+/**
+ * Moves bytes between a descriptor and a virtual printer, as a USB serial adapter would.
+ * @param latency_ms printer output is collected for that long before it's passed on
+ */
+static void bridge(int fd, VirtualPrinter *printer, uint32_t latency_ms = 0) {
+    std::thread([fd, printer] {
+        char buf[64];
+        while (true) {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n > 0) printer->write(buf, n);
+            else if ((n < 0) && (errno != EINTR)) vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }).detach();
+    std::thread([fd, printer, latency_ms] {
+        char buf[512];
+        while (true) {
+            if (latency_ms > 0) {
+                if (printer->wait_event(pdMS_TO_TICKS(100)) == TRANSPORT_EVENT_NONE) continue;
+                vTaskDelay(pdMS_TO_TICKS(latency_ms));
+            }
+            int n = printer->read(buf, sizeof(buf), pdMS_TO_TICKS(100));
+            for (int done = 0; done < n;) {
+                ssize_t w = write(fd, &buf[done], n - done);
+                if (w > 0) done += (int) w;
+                else if (errno != EINTR) break;
+            }
+        }
+    }).detach();
+}
+
+/**
+ * ADVANCED_OK reports free buffer slots, so more than one command is in flight.
+ */
+static void test_stream() {
+    auto vp = new VirtualPrinter("16,4,1,0,1");
+    Printer *printer = test_printer(SETTINGS_CHECKSUM, vp);
+    CHECK(printer != nullptr);
+    if (printer == nullptr) return;
+    float rate = stream_moves(printer, STREAM_MOVES);
+    CHECK(printer->has_advanced_ok());
+
+    // Window counts commands printer holds, so its whole command buffer gets filled
+    vp_stats_t stats;
+    vp->get_stats(&stats);
+    CHECK(stats.checksum_errors == 0);
+    CHECK(printer->get_uart()->get_window() == STREAM_BUFSIZE);
+    CHECK(stats.buffer_peak == STREAM_BUFSIZE);
+    CHECK(stats.dropped == 0);
+    printf("  %.0f cmd/s, window %d, printer buffer held up to %d\n", rate, printer->get_uart()->get_window(),
+           stats.buffer_peak);
+}
+
+/**
+ * Command which would not fit into Marlin's MAX_CMD_SIZE is refused, with line number and checksum
+ * counted when they are added.
+ */
+static void test_max_length() {
+    auto vp = new VirtualPrinter("16,4,1,0,1");
+    Printer *printer = test_printer(SETTINGS_CHECKSUM, vp);
+    CHECK(printer != nullptr);
+    if (printer == nullptr) return;
+    SerialPort *uart = printer->get_uart();
+    CHECK(uart->get_command_max_length() == COMMAND_MAX_LENGTH - 1 - LINE_NUMBER_OVERHEAD);
+    std::string command = "M117 " + std::string(uart->get_command_max_length() - 5, 'x');
+    CHECK(printer->send_cmd(command.c_str(), COMMAND_SOURCE_CONSOLE, 0, portMAX_DELAY) != 0);
+    CHECK(printer->send_cmd((command + "x").c_str(), COMMAND_SOURCE_CONSOLE, 0, portMAX_DELAY) == 0);
+    CHECK(test_wait_idle(printer, IDLE_TIMEOUT));
+    vp_stats_t stats;
+    vp->get_stats(&stats);
+    CHECK(stats.checksum_errors == 0);
+
+    uart->set_line_numbers(false);
+    CHECK(uart->get_command_max_length() == COMMAND_MAX_LENGTH - 1);
+    command = "M117 " + std::string(uart->get_command_max_length() - 5, 'x');
+    CHECK(printer->send_cmd(command.c_str(), COMMAND_SOURCE_CONSOLE, 0, portMAX_DELAY) != 0);
+    CHECK(printer->send_cmd((command + "x").c_str(), COMMAND_SOURCE_CONSOLE, 0, portMAX_DELAY) == 0);
+    CHECK(test_wait_idle(printer, IDLE_TIMEOUT));
+}
+
+/**
+ * Corrupted lines are asked for again and get to printer exactly once.
+ */
+static void test_noise() {
+    auto vp = new VirtualPrinter("16,4,1,50,1");
+    Printer *printer = test_printer(SETTINGS_CHECKSUM, vp);
+    CHECK(printer != nullptr);
+    if (printer == nullptr) return;
+    float rate = stream_moves(printer, STREAM_MOVES);
+    vp_stats_t stats;
+    vp->get_stats(&stats);
+    CHECK(stats.checksum_errors > 0);
+    printf("  %.0f cmd/s, %lu line(s) corrupted and sent again\n", rate, (unsigned long) stats.checksum_errors);
+}
+
+/**
+ * M410 drops what is not sent yet, and the stream is held till printer answers everything it had.
+ */
+static void test_emergency() {
+    Printer *printer = test_printer(SETTINGS_CHECKSUM, new VirtualPrinter("16,4,1,0,20"));
+    CHECK(printer != nullptr);
+    if (printer == nullptr) return;
+    SerialPort *uart = printer->get_uart();
+
+    std::atomic<bool> stop(false);
+    std::thread producer([printer, &stop] {
+        test_stream(printer, "G91");
+        for (int i = 0; (i < STREAM_MOVES) && !stop; i++) test_stream(printer, "G1 X1 F6000");
+    });
+    vTaskDelay(pdMS_TO_TICKS(300));
+    stop = true;
+    uart->emergency("M410");
+    producer.join();
+
+    TickType_t start = xTaskGetTickCount();
+    while (uart->is_stopping() && (xTaskGetTickCount() - start < pdMS_TO_TICKS(IDLE_TIMEOUT))) vTaskDelay(1);
+    CHECK(!uart->is_stopping());
+    CHECK(uart->get_in_flight() == 0);
+    int64_t latency, latency_max;
+    uart->get_stop_latency(&latency, &latency_max);
+    CHECK(latency > 0);
+
+    // Stream goes on after it is released, and no moves were sent after the stop
+    uart->release_stream();
+    test_stream(printer, "G90");
+    test_stream(printer, "M114");
+    CHECK(test_wait_idle(printer, IDLE_TIMEOUT));
+    float x = -1, y, z, e;
+    printer->get_position(&x, &y, &z, &e);
+    CHECK((x > 0) && (x < STREAM_MOVES));
+    printf("  stopped in %lld us at X:%.0f\n", (long long) latency, x);
+}
+
+/**
+ * Link which holds answers back, as USB serial adapter's latency timer does: 'ok' pacing gets
+ * a window of commands through per round trip, with flow control host keeps sending until
+ * printer's receive buffer is full.
+ */
+static void test_flow_control() {
+    float rates[2];
+    for (int flow = 0; flow < 2; flow++) {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        auto vp = new VirtualPrinter("16,4,0,0,0");
+        CHECK(vp->init(TEST_BAUD_RATE) == ESP_OK);
+        if (flow) CHECK(vp->set_flow_control(FLOW_CONTROL_XON_XOFF) == ESP_OK);
+        bridge(fds[1], vp, LINK_LATENCY);
+
+        Printer *printer = test_printer(flow ? SETTINGS_CHECKSUM "flow_control=xonxoff\n" : SETTINGS_CHECKSUM,
+                                        new FdTransport(fds[0]));
+        CHECK(printer != nullptr);
+        if (printer == nullptr) return;
+        CHECK(test_wait_caps(printer, IDLE_TIMEOUT));
+        rates[flow] = stream_moves(printer, STREAM_MOVES);
+
+        // Printer said it can do XON/XOFF in its M115 answer, so it's kept on
+        vp_stats_t stats;
+        vp->get_stats(&stats);
+        CHECK(stats.checksum_errors == 0);
+        CHECK(printer->get_uart()->get_flow_control() == (flow ? FLOW_CONTROL_XON_XOFF : FLOW_CONTROL_NONE));
+    }
+    printf("  %d ms link: 'ok' paced %.0f cmd/s, XON/XOFF %.0f cmd/s\n", LINK_LATENCY, rates[0], rates[1]);
+    CHECK(rates[1] > 2 * rates[0]);
+}
+
+/**
+ * Two printers streamed at once, as from one module with two UARTs. Neither may lose moves
+ * or get much less of the module than the other.
+ */
+static void test_two_printers() {
+    Printer *printers[3];
+    float rates[2];
+    for (Printer *&printer : printers) {
+        printer = test_printer(SETTINGS_CHECKSUM, new VirtualPrinter("16,4,1,0,1"));
+        CHECK(printer != nullptr);
+        if (printer == nullptr) return;
+    }
+    float solo = stream_moves(printers[2], STREAM_MOVES);
+
+    std::thread second([&printers, &rates] { rates[1] = stream_moves(printers[1], STREAM_MOVES); });
+    rates[0] = stream_moves(printers[0], STREAM_MOVES);
+    second.join();
+    printf("  alone %.0f cmd/s, together %.0f and %.0f cmd/s\n", solo, rates[0], rates[1]);
+    CHECK(fminf(rates[0], rates[1]) > fmaxf(rates[0], rates[1]) * TWO_PRINTERS_SHARE_MIN);
+}
+
+/**
+ * Job printed from SD card by print task: file is read ahead and goes through G-code pipeline.
+ * Moves are short and link holds answers back, so with 'ok' pacing printer's planner runs dry
+ * between moves. Underruns count only the times printer had no command waiting.
+ */
+static void test_print_job() {
+    FILE *f = sdcard_open_file(JOB_FILE, "w");
+    CHECK(f != nullptr);
+    if (f == nullptr) return;
+    fprintf(f, "; %d unit moves\nG91\n", JOB_MOVES);
+    for (int i = 0; i < JOB_MOVES; i++) fprintf(f, "G1 X1 F6000 ; move %d\n", i + 1);
+    fprintf(f, "G90\n");
+    fclose(f);
+
+    uint32_t underruns[2];
+    for (int flow = 0; flow < 2; flow++) {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        auto vp = new VirtualPrinter("16,4,0,0," JOB_MOVE_TIME);
+        CHECK(vp->init(TEST_BAUD_RATE) == ESP_OK);
+        if (flow) CHECK(vp->set_flow_control(FLOW_CONTROL_XON_XOFF) == ESP_OK);
+        bridge(fds[1], vp, LINK_LATENCY);
+
+        Printer *printer = test_printer(flow ? SETTINGS_CHECKSUM "flow_control=xonxoff\n" : SETTINGS_CHECKSUM,
+                                        new FdTransport(fds[0]));
+        CHECK(printer != nullptr);
+        if (printer == nullptr) return;
+        CHECK(test_wait_caps(printer, IDLE_TIMEOUT));
+        f = sdcard_open_file(JOB_FILE, "r");
+        CHECK(f != nullptr);
+        if (f == nullptr) return;
+
+        // Print task takes the job within a second
+        vp_stats_t before, after;
+        CHECK(printer->start(f, JOB_FILE) == ESP_OK);
+        while ((printer->get_status() != PRINTER_PRINTING) && (printer->get_opened_file() != nullptr)) vTaskDelay(1);
+        vp->get_stats(&before);
+        int64_t start = esp_timer_get_time();
+        CHECK(test_wait_job(printer, JOB_TIMEOUT));
+        float seconds = (float) (esp_timer_get_time() - start) / 1000000.0f;
+        vp->get_stats(&after);
+        underruns[flow] = after.underruns - before.underruns;
+
+        test_stream(printer, "M114");
+        CHECK(test_wait_idle(printer, IDLE_TIMEOUT));
+        float x = -1, y, z, e;
+        printer->get_position(&x, &y, &z, &e);
+        CHECK(x == (float) JOB_MOVES);
+        printf("  %s: %d moves of %s ms in %.1f s, %lu planner underrun(s)\n", flow ? "XON/XOFF" : "'ok' paced",
+               JOB_MOVES, JOB_MOVE_TIME, seconds, (unsigned long) underruns[flow]);
+    }
+    CHECK(underruns[1] <= JOB_UNDERRUNS_MAX);
+    CHECK(underruns[0] > underruns[1]);
+}
+
+/**
+ * Same stream through a socket, bytes come in pieces as they do from a real device.
+ */
+static void test_socket() {
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    auto vp = new VirtualPrinter("16,4,1,0,1");
+    CHECK(vp->init(TEST_BAUD_RATE) == ESP_OK);
+    bridge(fds[1], vp);
+
+    Printer *printer = test_printer(SETTINGS_CHECKSUM, new FdTransport(fds[0]));
+    CHECK(printer != nullptr);
+    if (printer == nullptr) return;
+    float rate = stream_moves(printer, STREAM_MOVES);
+    printf("  %.0f cmd/s\n", rate);
+}
+
+/**
+ * Same stream through a pseudo terminal, SerialPort sees it as a tty device.
+ */
+static void test_pty() {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0);
+    if (master < 0) return;
+    CHECK((grantpt(master) == 0) && (unlockpt(master) == 0));
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    CHECK(slave >= 0);
+    if (slave < 0) return;
+
+    auto vp = new VirtualPrinter("16,4,1,0,1");
+    CHECK(vp->init(TEST_BAUD_RATE) == ESP_OK);
+    bridge(master, vp);
+    Printer *printer = test_printer(SETTINGS_CHECKSUM, new FdTransport(slave));
+    CHECK(printer != nullptr);
+    if (printer == nullptr) return;
+    float rate = stream_moves(printer, STREAM_MOVES);
+    printf("  %.0f cmd/s\n", rate);
+}
+
+int main(int argc, char **argv) {
+    static const host_test_t tests[] = {
+            { "stream", test_stream },
+            { "max length", test_max_length },
+            { "noise", test_noise },
+            { "emergency", test_emergency },
+            { "flow control", test_flow_control },
+            { "two printers", test_two_printers },
+            { "print job", test_print_job },
+            { "socket", test_socket },
+            { "pty", test_pty },
+    };
+    // Tasks never end, so the process leaves without tearing them down
+    int res = run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+    _exit(res);
+}
@@ -53,213 +53,401 @@ const char server_main_js[] = {
   0x24, 0x28, 0x22, 0x23, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x5f, 0x62, 0x74,
   0x6e, 0x22, 0x29, 0x2e, 0x6f, 0x6e, 0x28, 0x22, 0x63, 0x6c, 0x69, 0x63,
   0x6b, 0x22, 0x2c, 0x20, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x29, 0x3b, 0x0d,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x64, 0x65, 0x6c,
-  0x65, 0x74, 0x65, 0x5f, 0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e, 0x6f, 0x6e,
-  0x28, 0x22, 0x63, 0x6c, 0x69, 0x63, 0x6b, 0x22, 0x2c, 0x20, 0x64, 0x65,
-  0x6c, 0x65, 0x74, 0x65, 0x46, 0x69, 0x6c, 0x65, 0x29, 0x3b, 0x0d, 0x0a,
-  0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x63, 0x6d, 0x64, 0x5f,
-  0x66, 0x6f, 0x72, 0x6d, 0x22, 0x29, 0x2e, 0x6f, 0x6e, 0x28, 0x22, 0x6b,
-  0x65, 0x79, 0x70, 0x72, 0x65, 0x73, 0x73, 0x22, 0x2c, 0x20, 0x66, 0x75,
-  0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x65, 0x29, 0x20, 0x7b, 0x20,
-  0x69, 0x66, 0x20, 0x28, 0x65, 0x2e, 0x6b, 0x65, 0x79, 0x43, 0x6f, 0x64,
-  0x65, 0x20, 0x3d, 0x3d, 0x3d, 0x20, 0x31, 0x33, 0x29, 0x20, 0x7b, 0x20,
-  0x65, 0x2e, 0x70, 0x72, 0x65, 0x76, 0x65, 0x6e, 0x74, 0x44, 0x65, 0x66,
-  0x61, 0x75, 0x6c, 0x74, 0x28, 0x29, 0x3b, 0x20, 0x24, 0x28, 0x22, 0x23,
-  0x73, 0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d, 0x64, 0x5f, 0x62, 0x74, 0x6e,
-  0x22, 0x29, 0x2e, 0x63, 0x6c, 0x69, 0x63, 0x6b, 0x28, 0x29, 0x3b, 0x20,
-  0x7d, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x46, 0x69, 0x6c, 0x65, 0x73, 0x4c,
-  0x69, 0x73, 0x74, 0x28, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x69, 0x6e, 0x69, 0x74, 0x53, 0x74, 0x61, 0x74, 0x75, 0x73, 0x57, 0x53,
-  0x28, 0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a,
-  0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73, 0x74, 0x61,
-  0x74, 0x65, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61,
-  0x67, 0x65, 0x2e, 0x73, 0x74, 0x61, 0x74, 0x65, 0x3b, 0x0d, 0x0a, 0x7d,
-  0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73,
-  0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x6e, 0x65, 0x77, 0x53,
-  0x74, 0x61, 0x74, 0x65, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x73, 0x74, 0x61,
-  0x74, 0x65, 0x20, 0x3d, 0x20, 0x7b, 0x2e, 0x2e, 0x2e, 0x73, 0x74, 0x6f,
-  0x72, 0x61, 0x67, 0x65, 0x2e, 0x73, 0x74, 0x61, 0x74, 0x65, 0x2c, 0x20,
-  0x2e, 0x2e, 0x2e, 0x6e, 0x65, 0x77, 0x53, 0x74, 0x61, 0x74, 0x65, 0x7d,
-  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61,
-  0x67, 0x65, 0x2e, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x64, 0x20, 0x3d,
-  0x20, 0x74, 0x72, 0x75, 0x65, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x0d,
-  0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x75, 0x70,
-  0x64, 0x61, 0x74, 0x65, 0x49, 0x6e, 0x74, 0x65, 0x72, 0x66, 0x61, 0x63,
-  0x65, 0x41, 0x6c, 0x6c, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x21, 0x73, 0x74, 0x6f, 0x72, 0x61,
-  0x67, 0x65, 0x2e, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x64, 0x29, 0x20,
-  0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x64, 0x69, 0x73, 0x70, 0x6c, 0x61, 0x79, 0x46, 0x69,
-  0x6c, 0x65, 0x73, 0x28, 0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65,
-  0x72, 0x5f, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x5f, 0x73, 0x74, 0x61,
-  0x74, 0x75, 0x73, 0x27, 0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x73,
-  0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74,
-  0x65, 0x72, 0x2e, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x29, 0x3b, 0x0d,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x70, 0x72, 0x69,
-  0x6e, 0x74, 0x65, 0x72, 0x5f, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x5f,
-  0x68, 0x6f, 0x74, 0x5f, 0x65, 0x6e, 0x64, 0x27, 0x29, 0x2e, 0x68, 0x74,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x74, 0x72, 0x61,
+  0x6e, 0x73, 0x66, 0x65, 0x72, 0x5f, 0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e,
+  0x6f, 0x6e, 0x28, 0x22, 0x63, 0x6c, 0x69, 0x63, 0x6b, 0x22, 0x2c, 0x20,
+  0x74, 0x72, 0x61, 0x6e, 0x73, 0x66, 0x65, 0x72, 0x29, 0x3b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x71, 0x75, 0x65, 0x75,
+  0x65, 0x5f, 0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e, 0x6f, 0x6e, 0x28, 0x22,
+  0x63, 0x6c, 0x69, 0x63, 0x6b, 0x22, 0x2c, 0x20, 0x71, 0x75, 0x65, 0x75,
+  0x65, 0x41, 0x64, 0x64, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x24, 0x28, 0x22, 0x23, 0x71, 0x75, 0x65, 0x75, 0x65, 0x5f, 0x73, 0x74,
+  0x61, 0x72, 0x74, 0x5f, 0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e, 0x6f, 0x6e,
+  0x28, 0x22, 0x63, 0x6c, 0x69, 0x63, 0x6b, 0x22, 0x2c, 0x20, 0x71, 0x75,
+  0x65, 0x75, 0x65, 0x53, 0x74, 0x61, 0x72, 0x74, 0x29, 0x3b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x64, 0x65, 0x6c, 0x65,
+  0x74, 0x65, 0x5f, 0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e, 0x6f, 0x6e, 0x28,
+  0x22, 0x63, 0x6c, 0x69, 0x63, 0x6b, 0x22, 0x2c, 0x20, 0x64, 0x65, 0x6c,
+  0x65, 0x74, 0x65, 0x46, 0x69, 0x6c, 0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x63, 0x6d, 0x64, 0x5f, 0x66,
+  0x6f, 0x72, 0x6d, 0x22, 0x29, 0x2e, 0x6f, 0x6e, 0x28, 0x22, 0x6b, 0x65,
+  0x79, 0x70, 0x72, 0x65, 0x73, 0x73, 0x22, 0x2c, 0x20, 0x66, 0x75, 0x6e,
+  0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x65, 0x29, 0x20, 0x7b, 0x20, 0x69,
+  0x66, 0x20, 0x28, 0x65, 0x2e, 0x6b, 0x65, 0x79, 0x43, 0x6f, 0x64, 0x65,
+  0x20, 0x3d, 0x3d, 0x3d, 0x20, 0x31, 0x33, 0x29, 0x20, 0x7b, 0x20, 0x65,
+  0x2e, 0x70, 0x72, 0x65, 0x76, 0x65, 0x6e, 0x74, 0x44, 0x65, 0x66, 0x61,
+  0x75, 0x6c, 0x74, 0x28, 0x29, 0x3b, 0x20, 0x24, 0x28, 0x22, 0x23, 0x73,
+  0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d, 0x64, 0x5f, 0x62, 0x74, 0x6e, 0x22,
+  0x29, 0x2e, 0x63, 0x6c, 0x69, 0x63, 0x6b, 0x28, 0x29, 0x3b, 0x20, 0x7d,
+  0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x75,
+  0x70, 0x64, 0x61, 0x74, 0x65, 0x46, 0x69, 0x6c, 0x65, 0x73, 0x4c, 0x69,
+  0x73, 0x74, 0x28, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x69,
+  0x6e, 0x69, 0x74, 0x53, 0x74, 0x61, 0x74, 0x75, 0x73, 0x57, 0x53, 0x28,
+  0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x66,
+  0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73, 0x74, 0x61, 0x74,
+  0x65, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x72,
+  0x65, 0x74, 0x75, 0x72, 0x6e, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67,
+  0x65, 0x2e, 0x73, 0x74, 0x61, 0x74, 0x65, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d,
+  0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73, 0x65,
+  0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x6e, 0x65, 0x77, 0x53, 0x74,
+  0x61, 0x74, 0x65, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x73, 0x74, 0x61, 0x74,
+  0x65, 0x20, 0x3d, 0x20, 0x7b, 0x2e, 0x2e, 0x2e, 0x73, 0x74, 0x6f, 0x72,
+  0x61, 0x67, 0x65, 0x2e, 0x73, 0x74, 0x61, 0x74, 0x65, 0x2c, 0x20, 0x2e,
+  0x2e, 0x2e, 0x6e, 0x65, 0x77, 0x53, 0x74, 0x61, 0x74, 0x65, 0x7d, 0x3b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67,
+  0x65, 0x2e, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x64, 0x20, 0x3d, 0x20,
+  0x74, 0x72, 0x75, 0x65, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x0d, 0x0a,
+  0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x75, 0x70, 0x64,
+  0x61, 0x74, 0x65, 0x49, 0x6e, 0x74, 0x65, 0x72, 0x66, 0x61, 0x63, 0x65,
+  0x41, 0x6c, 0x6c, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x69, 0x66, 0x20, 0x28, 0x21, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67,
+  0x65, 0x2e, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x64, 0x29, 0x20, 0x72,
+  0x65, 0x74, 0x75, 0x72, 0x6e, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x64, 0x69, 0x73, 0x70, 0x6c, 0x61, 0x79, 0x46, 0x69, 0x6c,
+  0x65, 0x73, 0x28, 0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x24, 0x28, 0x27, 0x23, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72,
+  0x5f, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x5f, 0x73, 0x74, 0x61, 0x74,
+  0x75, 0x73, 0x27, 0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x73, 0x74,
+  0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65,
+  0x72, 0x2e, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x29, 0x3b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x70, 0x72, 0x69, 0x6e,
+  0x74, 0x65, 0x72, 0x5f, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x5f, 0x68,
+  0x6f, 0x74, 0x5f, 0x65, 0x6e, 0x64, 0x27, 0x29, 0x2e, 0x68, 0x74, 0x6d,
+  0x6c, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70, 0x72,
+  0x69, 0x6e, 0x74, 0x65, 0x72, 0x2e, 0x68, 0x6f, 0x74, 0x5f, 0x65, 0x6e,
+  0x64, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27,
+  0x23, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x5f, 0x73, 0x74, 0x61,
+  0x74, 0x75, 0x73, 0x5f, 0x62, 0x65, 0x64, 0x27, 0x29, 0x2e, 0x68, 0x74,
   0x6d, 0x6c, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70,
-  0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2e, 0x68, 0x6f, 0x74, 0x5f, 0x65,
-  0x6e, 0x64, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28,
-  0x27, 0x23, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x5f, 0x73, 0x74,
-  0x61, 0x74, 0x75, 0x73, 0x5f, 0x62, 0x65, 0x64, 0x27, 0x29, 0x2e, 0x68,
-  0x74, 0x6d, 0x6c, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e,
-  0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2e, 0x62, 0x65, 0x64, 0x29,
-  0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20,
-  0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x75, 0x70, 0x6c,
-  0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x62,
-  0x6c, 0x69, 0x6e, 0x64, 0x65, 0x72, 0x22, 0x29, 0x2e, 0x63, 0x73, 0x73,
-  0x28, 0x22, 0x64, 0x69, 0x73, 0x70, 0x6c, 0x61, 0x79, 0x22, 0x2c, 0x20,
-  0x22, 0x66, 0x6c, 0x65, 0x78, 0x22, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x73, 0x74,
-  0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64,
-  0x5f, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x20, 0x3d, 0x3d,
-  0x3d, 0x20, 0x75, 0x6e, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x64, 0x29,
-  0x20, 0x24, 0x28, 0x22, 0x23, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73,
-  0x73, 0x22, 0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x22, 0x55, 0x70,
-  0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x2e, 0x2e, 0x2e, 0x22, 0x29,
-  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x65,
-  0x6c, 0x73, 0x65, 0x20, 0x24, 0x28, 0x22, 0x23, 0x70, 0x72, 0x6f, 0x67,
-  0x72, 0x65, 0x73, 0x73, 0x22, 0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28,
-  0x22, 0x55, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x3a, 0x20,
-  0x3c, 0x62, 0x72, 0x2f, 0x3e, 0x22, 0x20, 0x2b, 0x20, 0x4d, 0x61, 0x74,
-  0x68, 0x2e, 0x72, 0x6f, 0x75, 0x6e, 0x64, 0x28, 0x73, 0x74, 0x61, 0x74,
-  0x65, 0x28, 0x29, 0x2e, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x5f, 0x70,
-  0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x29, 0x20, 0x2b, 0x20, 0x27,
-  0x25, 0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20,
-  0x65, 0x6c, 0x73, 0x65, 0x20, 0x24, 0x28, 0x22, 0x23, 0x62, 0x6c, 0x69,
-  0x6e, 0x64, 0x65, 0x72, 0x22, 0x29, 0x2e, 0x63, 0x73, 0x73, 0x28, 0x22,
-  0x64, 0x69, 0x73, 0x70, 0x6c, 0x61, 0x79, 0x22, 0x2c, 0x20, 0x22, 0x6e,
-  0x6f, 0x6e, 0x65, 0x22, 0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28,
-  0x29, 0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2e, 0x73, 0x74,
-  0x61, 0x74, 0x75, 0x73, 0x20, 0x3d, 0x3d, 0x3d, 0x20, 0x27, 0x50, 0x72,
-  0x69, 0x6e, 0x74, 0x69, 0x6e, 0x67, 0x27, 0x29, 0x20, 0x7b, 0x0d, 0x0a,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20,
-  0x62, 0x61, 0x72, 0x20, 0x3d, 0x20, 0x24, 0x28, 0x27, 0x23, 0x70, 0x72,
-  0x69, 0x6e, 0x74, 0x5f, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73,
-  0x5f, 0x62, 0x61, 0x72, 0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x70, 0x65, 0x72,
-  0x63, 0x65, 0x6e, 0x74, 0x20, 0x3d, 0x20, 0x4d, 0x61, 0x74, 0x68, 0x2e,
-  0x72, 0x6f, 0x75, 0x6e, 0x64, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28,
-  0x29, 0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2e, 0x70, 0x72,
-  0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x20, 0x2a, 0x20, 0x31, 0x30, 0x30,
-  0x29, 0x20, 0x2b, 0x20, 0x27, 0x25, 0x27, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x62, 0x61, 0x72, 0x2e, 0x63, 0x73,
-  0x73, 0x28, 0x27, 0x77, 0x69, 0x64, 0x74, 0x68, 0x27, 0x2c, 0x20, 0x70,
-  0x65, 0x72, 0x63, 0x65, 0x6e, 0x74, 0x29, 0x3b, 0x20, 0x62, 0x61, 0x72,
-  0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x70, 0x65, 0x72, 0x63, 0x65, 0x6e,
-  0x74, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x24, 0x28, 0x27, 0x23, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x5f, 0x70,
-  0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x27, 0x29, 0x2e, 0x63, 0x73,
-  0x73, 0x28, 0x27, 0x64, 0x69, 0x73, 0x70, 0x6c, 0x61, 0x79, 0x27, 0x2c,
-  0x20, 0x27, 0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d,
-  0x20, 0x65, 0x6c, 0x73, 0x65, 0x20, 0x24, 0x28, 0x27, 0x23, 0x70, 0x72,
+  0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2e, 0x62, 0x65, 0x64, 0x29, 0x3b,
+  0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28,
+  0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x75, 0x70, 0x6c, 0x6f,
+  0x61, 0x64, 0x69, 0x6e, 0x67, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x62, 0x6c,
+  0x69, 0x6e, 0x64, 0x65, 0x72, 0x22, 0x29, 0x2e, 0x63, 0x73, 0x73, 0x28,
+  0x22, 0x64, 0x69, 0x73, 0x70, 0x6c, 0x61, 0x79, 0x22, 0x2c, 0x20, 0x22,
+  0x66, 0x6c, 0x65, 0x78, 0x22, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x73, 0x74, 0x61,
+  0x74, 0x65, 0x28, 0x29, 0x2e, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x5f,
+  0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x20, 0x3d, 0x3d, 0x3d,
+  0x20, 0x75, 0x6e, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x64, 0x29, 0x20,
+  0x24, 0x28, 0x22, 0x23, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73,
+  0x22, 0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x22, 0x55, 0x70, 0x6c,
+  0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x2e, 0x2e, 0x2e, 0x22, 0x29, 0x3b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x65, 0x6c,
+  0x73, 0x65, 0x20, 0x24, 0x28, 0x22, 0x23, 0x70, 0x72, 0x6f, 0x67, 0x72,
+  0x65, 0x73, 0x73, 0x22, 0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x22,
+  0x55, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x3a, 0x20, 0x3c,
+  0x62, 0x72, 0x2f, 0x3e, 0x22, 0x20, 0x2b, 0x20, 0x4d, 0x61, 0x74, 0x68,
+  0x2e, 0x72, 0x6f, 0x75, 0x6e, 0x64, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65,
+  0x28, 0x29, 0x2e, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x5f, 0x70, 0x72,
+  0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x29, 0x20, 0x2b, 0x20, 0x27, 0x25,
+  0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20, 0x65,
+  0x6c, 0x73, 0x65, 0x20, 0x24, 0x28, 0x22, 0x23, 0x62, 0x6c, 0x69, 0x6e,
+  0x64, 0x65, 0x72, 0x22, 0x29, 0x2e, 0x63, 0x73, 0x73, 0x28, 0x22, 0x64,
+  0x69, 0x73, 0x70, 0x6c, 0x61, 0x79, 0x22, 0x2c, 0x20, 0x22, 0x6e, 0x6f,
+  0x6e, 0x65, 0x22, 0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x6c, 0x65, 0x74, 0x20, 0x62, 0x75, 0x73, 0x79, 0x20, 0x3d, 0x20,
+  0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70, 0x72, 0x69,
+  0x6e, 0x74, 0x65, 0x72, 0x2e, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20,
+  0x3d, 0x3d, 0x3d, 0x20, 0x27, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x69, 0x6e,
+  0x67, 0x27, 0x29, 0x20, 0x7c, 0x7c, 0x20, 0x28, 0x73, 0x74, 0x61, 0x74,
+  0x65, 0x28, 0x29, 0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2e,
+  0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20, 0x3d, 0x3d, 0x3d, 0x20, 0x27,
+  0x54, 0x72, 0x61, 0x6e, 0x73, 0x66, 0x65, 0x72, 0x72, 0x69, 0x6e, 0x67,
+  0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20,
+  0x28, 0x62, 0x75, 0x73, 0x79, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x70, 0x72,
   0x69, 0x6e, 0x74, 0x5f, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73,
-  0x27, 0x29, 0x2e, 0x63, 0x73, 0x73, 0x28, 0x27, 0x64, 0x69, 0x73, 0x70,
-  0x6c, 0x61, 0x79, 0x27, 0x2c, 0x20, 0x27, 0x6e, 0x6f, 0x6e, 0x65, 0x27,
-  0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66,
-  0x20, 0x28, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70,
+  0x5f, 0x6c, 0x61, 0x62, 0x65, 0x6c, 0x27, 0x29, 0x2e, 0x68, 0x74, 0x6d,
+  0x6c, 0x28, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70,
   0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2e, 0x73, 0x74, 0x61, 0x74, 0x75,
-  0x73, 0x20, 0x3d, 0x3d, 0x3d, 0x20, 0x27, 0x55, 0x6e, 0x6b, 0x6e, 0x6f,
-  0x77, 0x6e, 0x27, 0x29, 0x20, 0x7c, 0x7c, 0x20, 0x28, 0x73, 0x74, 0x61,
-  0x74, 0x65, 0x28, 0x29, 0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72,
-  0x2e, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20, 0x3d, 0x3d, 0x3d, 0x20,
-  0x27, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x69, 0x6e, 0x67, 0x27, 0x29, 0x29,
-  0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x24, 0x28, 0x27, 0x23, 0x73, 0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d, 0x64,
-  0x5f, 0x62, 0x74, 0x6e, 0x27, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28,
-  0x27, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20,
-  0x74, 0x72, 0x75, 0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x73, 0x65, 0x6e, 0x64,
-  0x5f, 0x63, 0x6d, 0x64, 0x27, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28,
-  0x27, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20,
-  0x74, 0x72, 0x75, 0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x73, 0x20, 0x3d, 0x3d, 0x3d, 0x20, 0x27, 0x50, 0x72, 0x69, 0x6e, 0x74,
+  0x69, 0x6e, 0x67, 0x27, 0x29, 0x20, 0x3f, 0x20, 0x27, 0x50, 0x72, 0x69,
+  0x6e, 0x74, 0x20, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x3a,
+  0x27, 0x20, 0x3a, 0x20, 0x27, 0x43, 0x6f, 0x70, 0x79, 0x69, 0x6e, 0x67,
+  0x20, 0x74, 0x6f, 0x20, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x3a,
+  0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x6c, 0x65, 0x74, 0x20, 0x62, 0x61, 0x72, 0x20, 0x3d, 0x20, 0x24,
+  0x28, 0x27, 0x23, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x5f, 0x70, 0x72, 0x6f,
+  0x67, 0x72, 0x65, 0x73, 0x73, 0x5f, 0x62, 0x61, 0x72, 0x27, 0x29, 0x3b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65,
+  0x74, 0x20, 0x70, 0x65, 0x72, 0x63, 0x65, 0x6e, 0x74, 0x20, 0x3d, 0x20,
+  0x4d, 0x61, 0x74, 0x68, 0x2e, 0x72, 0x6f, 0x75, 0x6e, 0x64, 0x28, 0x73,
+  0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74,
+  0x65, 0x72, 0x2e, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x20,
+  0x2a, 0x20, 0x31, 0x30, 0x30, 0x29, 0x20, 0x2b, 0x20, 0x27, 0x25, 0x27,
+  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x62,
+  0x61, 0x72, 0x2e, 0x63, 0x73, 0x73, 0x28, 0x27, 0x77, 0x69, 0x64, 0x74,
+  0x68, 0x27, 0x2c, 0x20, 0x70, 0x65, 0x72, 0x63, 0x65, 0x6e, 0x74, 0x29,
+  0x3b, 0x20, 0x62, 0x61, 0x72, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x70,
+  0x65, 0x72, 0x63, 0x65, 0x6e, 0x74, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x72, 0x65,
+  0x6d, 0x61, 0x69, 0x6e, 0x69, 0x6e, 0x67, 0x20, 0x3d, 0x20, 0x73, 0x74,
+  0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65,
+  0x72, 0x2e, 0x72, 0x65, 0x6d, 0x61, 0x69, 0x6e, 0x69, 0x6e, 0x67, 0x3b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65,
+  0x74, 0x20, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x73, 0x20, 0x3d, 0x20, 0x73,
+  0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74,
+  0x65, 0x72, 0x2e, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x73, 0x3b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28,
+  0x28, 0x28, 0x72, 0x65, 0x6d, 0x61, 0x69, 0x6e, 0x69, 0x6e, 0x67, 0x20,
+  0x21, 0x3d, 0x3d, 0x20, 0x75, 0x6e, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65,
+  0x64, 0x29, 0x20, 0x26, 0x26, 0x20, 0x28, 0x72, 0x65, 0x6d, 0x61, 0x69,
+  0x6e, 0x69, 0x6e, 0x67, 0x20, 0x3e, 0x3d, 0x20, 0x30, 0x29, 0x29, 0x20,
+  0x7c, 0x7c, 0x20, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x73, 0x29, 0x20, 0x7b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x69, 0x6e, 0x66, 0x6f, 0x20, 0x3d,
+  0x20, 0x5b, 0x5d, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x6c, 0x61,
+  0x79, 0x65, 0x72, 0x73, 0x29, 0x20, 0x69, 0x6e, 0x66, 0x6f, 0x2e, 0x70,
+  0x75, 0x73, 0x68, 0x28, 0x27, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x20, 0x27,
+  0x20, 0x2b, 0x20, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e,
+  0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2e, 0x6c, 0x61, 0x79, 0x65,
+  0x72, 0x20, 0x2b, 0x20, 0x31, 0x29, 0x20, 0x2b, 0x20, 0x27, 0x2f, 0x27,
+  0x20, 0x2b, 0x20, 0x6c, 0x61, 0x79, 0x65, 0x72, 0x73, 0x29, 0x3b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x69, 0x66, 0x20, 0x28, 0x28, 0x72, 0x65, 0x6d, 0x61, 0x69, 0x6e,
+  0x69, 0x6e, 0x67, 0x20, 0x21, 0x3d, 0x3d, 0x20, 0x75, 0x6e, 0x64, 0x65,
+  0x66, 0x69, 0x6e, 0x65, 0x64, 0x29, 0x20, 0x26, 0x26, 0x20, 0x28, 0x72,
+  0x65, 0x6d, 0x61, 0x69, 0x6e, 0x69, 0x6e, 0x67, 0x20, 0x3e, 0x3d, 0x20,
+  0x30, 0x29, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69,
+  0x6e, 0x66, 0x6f, 0x2e, 0x70, 0x75, 0x73, 0x68, 0x28, 0x4d, 0x61, 0x74,
+  0x68, 0x2e, 0x66, 0x6c, 0x6f, 0x6f, 0x72, 0x28, 0x72, 0x65, 0x6d, 0x61,
+  0x69, 0x6e, 0x69, 0x6e, 0x67, 0x20, 0x2f, 0x20, 0x33, 0x36, 0x30, 0x30,
+  0x29, 0x20, 0x2b, 0x20, 0x27, 0x68, 0x20, 0x27, 0x20, 0x2b, 0x20, 0x4d,
+  0x61, 0x74, 0x68, 0x2e, 0x66, 0x6c, 0x6f, 0x6f, 0x72, 0x28, 0x28, 0x72,
+  0x65, 0x6d, 0x61, 0x69, 0x6e, 0x69, 0x6e, 0x67, 0x20, 0x25, 0x20, 0x33,
+  0x36, 0x30, 0x30, 0x29, 0x20, 0x2f, 0x20, 0x36, 0x30, 0x29, 0x20, 0x2b,
+  0x20, 0x27, 0x6d, 0x20, 0x6c, 0x65, 0x66, 0x74, 0x27, 0x29, 0x3b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x7d, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
   0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x70, 0x72, 0x69, 0x6e,
-  0x74, 0x5f, 0x62, 0x74, 0x6e, 0x27, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70,
-  0x28, 0x27, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c,
-  0x20, 0x74, 0x72, 0x75, 0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x7d, 0x20, 0x65, 0x6c, 0x73, 0x65, 0x20, 0x7b, 0x0d, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x73,
-  0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d, 0x64, 0x5f, 0x62, 0x74, 0x6e, 0x27,
-  0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69, 0x73, 0x61,
-  0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65,
-  0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x24, 0x28, 0x27, 0x23, 0x73, 0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d, 0x64,
-  0x27, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69, 0x73,
-  0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x66, 0x61, 0x6c, 0x73,
+  0x74, 0x5f, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x5f, 0x6c,
+  0x61, 0x62, 0x65, 0x6c, 0x27, 0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28,
+  0x27, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x20, 0x70, 0x72, 0x6f, 0x67, 0x72,
+  0x65, 0x73, 0x73, 0x2c, 0x20, 0x27, 0x20, 0x2b, 0x20, 0x69, 0x6e, 0x66,
+  0x6f, 0x2e, 0x6a, 0x6f, 0x69, 0x6e, 0x28, 0x27, 0x2c, 0x20, 0x27, 0x29,
+  0x20, 0x2b, 0x20, 0x27, 0x3a, 0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x70, 0x72, 0x69,
+  0x6e, 0x74, 0x5f, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x27,
+  0x29, 0x2e, 0x63, 0x73, 0x73, 0x28, 0x27, 0x64, 0x69, 0x73, 0x70, 0x6c,
+  0x61, 0x79, 0x27, 0x2c, 0x20, 0x27, 0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x7d, 0x20, 0x65, 0x6c, 0x73, 0x65, 0x20, 0x24, 0x28,
+  0x27, 0x23, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x5f, 0x70, 0x72, 0x6f, 0x67,
+  0x72, 0x65, 0x73, 0x73, 0x27, 0x29, 0x2e, 0x63, 0x73, 0x73, 0x28, 0x27,
+  0x64, 0x69, 0x73, 0x70, 0x6c, 0x61, 0x79, 0x27, 0x2c, 0x20, 0x27, 0x6e,
+  0x6f, 0x6e, 0x65, 0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x71, 0x75, 0x65, 0x75, 0x65, 0x5f,
+  0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27,
+  0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x21,
+  0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x68, 0x61, 0x73, 0x5f,
+  0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x29, 0x3b, 0x0d, 0x0a,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x28, 0x73,
+  0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74,
+  0x65, 0x72, 0x2e, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20, 0x3d, 0x3d,
+  0x3d, 0x20, 0x27, 0x55, 0x6e, 0x6b, 0x6e, 0x6f, 0x77, 0x6e, 0x27, 0x29,
+  0x20, 0x7c, 0x7c, 0x20, 0x62, 0x75, 0x73, 0x79, 0x29, 0x20, 0x7b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27,
+  0x23, 0x73, 0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d, 0x64, 0x5f, 0x62, 0x74,
+  0x6e, 0x27, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69,
+  0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x74, 0x72, 0x75,
+  0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x24, 0x28, 0x27, 0x23, 0x73, 0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d,
+  0x64, 0x27, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69,
+  0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x74, 0x72, 0x75,
   0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x24, 0x28, 0x22, 0x23, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x5f, 0x62,
-  0x74, 0x6e, 0x22, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64,
-  0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x21, 0x73,
+  0x20, 0x24, 0x28, 0x27, 0x23, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x5f, 0x62,
+  0x74, 0x6e, 0x27, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64,
+  0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x74, 0x72,
+  0x75, 0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x74, 0x72, 0x61, 0x6e, 0x73, 0x66,
+  0x65, 0x72, 0x5f, 0x62, 0x74, 0x6e, 0x27, 0x29, 0x2e, 0x70, 0x72, 0x6f,
+  0x70, 0x28, 0x27, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27,
+  0x2c, 0x20, 0x74, 0x72, 0x75, 0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x71, 0x75,
+  0x65, 0x75, 0x65, 0x5f, 0x73, 0x74, 0x61, 0x72, 0x74, 0x5f, 0x62, 0x74,
+  0x6e, 0x27, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69,
+  0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x74, 0x72, 0x75,
+  0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20, 0x65,
+  0x6c, 0x73, 0x65, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x73, 0x65, 0x6e, 0x64, 0x5f,
+  0x63, 0x6d, 0x64, 0x5f, 0x62, 0x74, 0x6e, 0x27, 0x29, 0x2e, 0x70, 0x72,
+  0x6f, 0x70, 0x28, 0x27, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64,
+  0x27, 0x2c, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x29, 0x3b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27, 0x23,
+  0x73, 0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d, 0x64, 0x27, 0x29, 0x2e, 0x70,
+  0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65,
+  0x64, 0x27, 0x2c, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x29, 0x3b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22,
+  0x23, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x5f, 0x62, 0x74, 0x6e, 0x22, 0x29,
+  0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69, 0x73, 0x61, 0x62,
+  0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x21, 0x73, 0x74, 0x61, 0x74, 0x65,
+  0x28, 0x29, 0x2e, 0x68, 0x61, 0x73, 0x5f, 0x73, 0x65, 0x6c, 0x65, 0x63,
+  0x74, 0x65, 0x64, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x74, 0x72, 0x61, 0x6e, 0x73,
+  0x66, 0x65, 0x72, 0x5f, 0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e, 0x70, 0x72,
+  0x6f, 0x70, 0x28, 0x27, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64,
+  0x27, 0x2c, 0x20, 0x21, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e,
+  0x68, 0x61, 0x73, 0x5f, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64,
+  0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x24, 0x28, 0x22, 0x23, 0x71, 0x75, 0x65, 0x75, 0x65, 0x5f, 0x73, 0x74,
+  0x61, 0x72, 0x74, 0x5f, 0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e, 0x70, 0x72,
+  0x6f, 0x70, 0x28, 0x27, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64,
+  0x27, 0x2c, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x29, 0x3b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24,
+  0x28, 0x22, 0x23, 0x64, 0x65, 0x6c, 0x65, 0x74, 0x65, 0x5f, 0x62, 0x74,
+  0x6e, 0x22, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69,
+  0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x28, 0x21, 0x73,
   0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x68, 0x61, 0x73, 0x5f, 0x73,
-  0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x29, 0x3b, 0x0d, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28,
-  0x22, 0x23, 0x64, 0x65, 0x6c, 0x65, 0x74, 0x65, 0x5f, 0x62, 0x74, 0x6e,
-  0x22, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69, 0x73,
-  0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x28, 0x21, 0x73, 0x74,
-  0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x68, 0x61, 0x73, 0x5f, 0x73, 0x65,
-  0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x29, 0x20, 0x7c, 0x7c, 0x20, 0x28,
-  0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29, 0x2e, 0x70, 0x72, 0x69, 0x6e,
-  0x74, 0x65, 0x72, 0x2e, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20, 0x3d,
-  0x3d, 0x3d, 0x20, 0x27, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x69, 0x6e, 0x67,
-  0x27, 0x29, 0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x75, 0x70, 0x64, 0x61,
-  0x74, 0x65, 0x64, 0x20, 0x3d, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x3b,
-  0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74,
-  0x69, 0x6f, 0x6e, 0x20, 0x69, 0x6e, 0x69, 0x74, 0x53, 0x74, 0x61, 0x74,
-  0x75, 0x73, 0x57, 0x53, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x77, 0x65,
-  0x62, 0x73, 0x6f, 0x63, 0x6b, 0x65, 0x74, 0x20, 0x3d, 0x20, 0x6e, 0x65,
-  0x77, 0x20, 0x57, 0x65, 0x62, 0x53, 0x6f, 0x63, 0x6b, 0x65, 0x74, 0x28,
-  0x60, 0x77, 0x73, 0x3a, 0x2f, 0x2f, 0x24, 0x7b, 0x77, 0x69, 0x6e, 0x64,
-  0x6f, 0x77, 0x2e, 0x6c, 0x6f, 0x63, 0x61, 0x74, 0x69, 0x6f, 0x6e, 0x2e,
-  0x68, 0x6f, 0x73, 0x74, 0x6e, 0x61, 0x6d, 0x65, 0x7d, 0x2f, 0x77, 0x73,
-  0x60, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x6f,
+  0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x29, 0x20, 0x7c, 0x7c, 0x20,
+  0x62, 0x75, 0x73, 0x79, 0x29, 0x3b, 0x0d, 0x0a, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x75, 0x70,
+  0x64, 0x61, 0x74, 0x65, 0x64, 0x20, 0x3d, 0x20, 0x66, 0x61, 0x6c, 0x73,
+  0x65, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x0d, 0x0a, 0x66, 0x75, 0x6e,
+  0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x69, 0x6e, 0x69, 0x74, 0x53, 0x74,
+  0x61, 0x74, 0x75, 0x73, 0x57, 0x53, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e,
+  0x77, 0x65, 0x62, 0x73, 0x6f, 0x63, 0x6b, 0x65, 0x74, 0x20, 0x3d, 0x20,
+  0x6e, 0x65, 0x77, 0x20, 0x57, 0x65, 0x62, 0x53, 0x6f, 0x63, 0x6b, 0x65,
+  0x74, 0x28, 0x60, 0x77, 0x73, 0x3a, 0x2f, 0x2f, 0x24, 0x7b, 0x77, 0x69,
+  0x6e, 0x64, 0x6f, 0x77, 0x2e, 0x6c, 0x6f, 0x63, 0x61, 0x74, 0x69, 0x6f,
+  0x6e, 0x2e, 0x68, 0x6f, 0x73, 0x74, 0x6e, 0x61, 0x6d, 0x65, 0x7d, 0x2f,
+  0x77, 0x73, 0x60, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x73,
+  0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x77, 0x65, 0x62, 0x73, 0x6f,
+  0x63, 0x6b, 0x65, 0x74, 0x2e, 0x6f, 0x6e, 0x6f, 0x70, 0x65, 0x6e, 0x20,
+  0x3d, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x28,
+  0x29, 0x20, 0x7b, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x6f, 0x6c, 0x65, 0x2e,
+  0x6c, 0x6f, 0x67, 0x28, 0x22, 0x57, 0x65, 0x62, 0x73, 0x6f, 0x63, 0x6b,
+  0x65, 0x74, 0x20, 0x6f, 0x70, 0x65, 0x6e, 0x65, 0x64, 0x22, 0x29, 0x3b,
+  0x20, 0x7d, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x6f,
   0x72, 0x61, 0x67, 0x65, 0x2e, 0x77, 0x65, 0x62, 0x73, 0x6f, 0x63, 0x6b,
-  0x65, 0x74, 0x2e, 0x6f, 0x6e, 0x6f, 0x70, 0x65, 0x6e, 0x20, 0x3d, 0x20,
-  0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x28, 0x29, 0x20,
-  0x7b, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x6f, 0x6c, 0x65, 0x2e, 0x6c, 0x6f,
-  0x67, 0x28, 0x22, 0x57, 0x65, 0x62, 0x73, 0x6f, 0x63, 0x6b, 0x65, 0x74,
-  0x20, 0x6f, 0x70, 0x65, 0x6e, 0x65, 0x64, 0x22, 0x29, 0x3b, 0x20, 0x7d,
-  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61,
-  0x67, 0x65, 0x2e, 0x77, 0x65, 0x62, 0x73, 0x6f, 0x63, 0x6b, 0x65, 0x74,
-  0x2e, 0x6f, 0x6e, 0x63, 0x6c, 0x6f, 0x73, 0x65, 0x20, 0x3d, 0x20, 0x66,
-  0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x28, 0x29, 0x20, 0x7b,
-  0x20, 0x63, 0x6f, 0x6e, 0x73, 0x6f, 0x6c, 0x65, 0x2e, 0x6c, 0x6f, 0x67,
-  0x28, 0x22, 0x57, 0x65, 0x62, 0x73, 0x6f, 0x63, 0x6b, 0x65, 0x74, 0x20,
-  0x63, 0x6c, 0x6f, 0x73, 0x65, 0x64, 0x22, 0x29, 0x3b, 0x20, 0x73, 0x65,
-  0x74, 0x54, 0x69, 0x6d, 0x65, 0x6f, 0x75, 0x74, 0x28, 0x69, 0x6e, 0x69,
-  0x74, 0x53, 0x74, 0x61, 0x74, 0x75, 0x73, 0x57, 0x53, 0x2c, 0x20, 0x35,
-  0x30, 0x30, 0x29, 0x20, 0x7d, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x77, 0x65, 0x62, 0x73,
-  0x6f, 0x63, 0x6b, 0x65, 0x74, 0x2e, 0x6f, 0x6e, 0x6d, 0x65, 0x73, 0x73,
-  0x61, 0x67, 0x65, 0x20, 0x3d, 0x20, 0x67, 0x65, 0x74, 0x53, 0x74, 0x61,
-  0x74, 0x75, 0x73, 0x57, 0x53, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x66,
-  0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x67, 0x65, 0x74, 0x53,
-  0x74, 0x61, 0x74, 0x75, 0x73, 0x57, 0x53, 0x28, 0x65, 0x76, 0x65, 0x6e,
-  0x74, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65,
-  0x74, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20, 0x3d, 0x20, 0x4a,
-  0x53, 0x4f, 0x4e, 0x2e, 0x70, 0x61, 0x72, 0x73, 0x65, 0x28, 0x65, 0x76,
-  0x65, 0x6e, 0x74, 0x2e, 0x64, 0x61, 0x74, 0x61, 0x29, 0x3b, 0x0d, 0x0a,
-  0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65,
-  0x28, 0x7b, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x3a, 0x20, 0x73,
-  0x74, 0x61, 0x74, 0x75, 0x73, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d,
-  0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x70, 0x72,
-  0x69, 0x6e, 0x74, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28, 0x7b, 0x20, 0x75, 0x72,
-  0x6c, 0x3a, 0x20, 0x22, 0x2f, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72,
-  0x2f, 0x73, 0x74, 0x61, 0x72, 0x74, 0x22, 0x2c, 0x20, 0x73, 0x75, 0x63,
-  0x63, 0x65, 0x73, 0x73, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69,
-  0x6f, 0x6e, 0x28, 0x72, 0x65, 0x73, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73,
-  0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x70, 0x72, 0x69,
-  0x6e, 0x74, 0x65, 0x72, 0x3a, 0x20, 0x72, 0x65, 0x73, 0x7d, 0x29, 0x3b,
+  0x65, 0x74, 0x2e, 0x6f, 0x6e, 0x63, 0x6c, 0x6f, 0x73, 0x65, 0x20, 0x3d,
+  0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x28, 0x29,
+  0x20, 0x7b, 0x20, 0x63, 0x6f, 0x6e, 0x73, 0x6f, 0x6c, 0x65, 0x2e, 0x6c,
+  0x6f, 0x67, 0x28, 0x22, 0x57, 0x65, 0x62, 0x73, 0x6f, 0x63, 0x6b, 0x65,
+  0x74, 0x20, 0x63, 0x6c, 0x6f, 0x73, 0x65, 0x64, 0x22, 0x29, 0x3b, 0x20,
+  0x73, 0x65, 0x74, 0x54, 0x69, 0x6d, 0x65, 0x6f, 0x75, 0x74, 0x28, 0x69,
+  0x6e, 0x69, 0x74, 0x53, 0x74, 0x61, 0x74, 0x75, 0x73, 0x57, 0x53, 0x2c,
+  0x20, 0x35, 0x30, 0x30, 0x29, 0x20, 0x7d, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x77, 0x65,
+  0x62, 0x73, 0x6f, 0x63, 0x6b, 0x65, 0x74, 0x2e, 0x6f, 0x6e, 0x6d, 0x65,
+  0x73, 0x73, 0x61, 0x67, 0x65, 0x20, 0x3d, 0x20, 0x67, 0x65, 0x74, 0x53,
+  0x74, 0x61, 0x74, 0x75, 0x73, 0x57, 0x53, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d,
+  0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x67, 0x65,
+  0x74, 0x53, 0x74, 0x61, 0x74, 0x75, 0x73, 0x57, 0x53, 0x28, 0x65, 0x76,
+  0x65, 0x6e, 0x74, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x6c, 0x65, 0x74, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20, 0x3d,
+  0x20, 0x4a, 0x53, 0x4f, 0x4e, 0x2e, 0x70, 0x61, 0x72, 0x73, 0x65, 0x28,
+  0x65, 0x76, 0x65, 0x6e, 0x74, 0x2e, 0x64, 0x61, 0x74, 0x61, 0x29, 0x3b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x73, 0x74,
+  0x61, 0x74, 0x75, 0x73, 0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72,
+  0x20, 0x21, 0x3d, 0x3d, 0x20, 0x75, 0x6e, 0x64, 0x65, 0x66, 0x69, 0x6e,
+  0x65, 0x64, 0x20, 0x26, 0x26, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73,
+  0x2e, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x20, 0x21, 0x3d, 0x3d,
+  0x20, 0x30, 0x29, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x3b, 0x20,
+  0x20, 0x2f, 0x2f, 0x20, 0x50, 0x61, 0x67, 0x65, 0x20, 0x73, 0x68, 0x6f,
+  0x77, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x66, 0x69, 0x72, 0x73, 0x74,
+  0x20, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x20, 0x6f, 0x6e, 0x6c,
+  0x79, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74,
+  0x61, 0x74, 0x65, 0x28, 0x7b, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72,
+  0x3a, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x7d, 0x29, 0x3b, 0x0d,
+  0x0a, 0x7d, 0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e,
+  0x20, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28, 0x7b,
+  0x20, 0x75, 0x72, 0x6c, 0x3a, 0x20, 0x22, 0x2f, 0x70, 0x72, 0x69, 0x6e,
+  0x74, 0x65, 0x72, 0x2f, 0x73, 0x74, 0x61, 0x72, 0x74, 0x22, 0x2c, 0x20,
+  0x73, 0x75, 0x63, 0x63, 0x65, 0x73, 0x73, 0x3a, 0x20, 0x66, 0x75, 0x6e,
+  0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x73, 0x29, 0x20, 0x7b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b,
+  0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x3a, 0x20, 0x72, 0x65, 0x73,
+  0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x7d, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x3a, 0x20, 0x66,
+  0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x71, 0x2c,
+  0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72,
+  0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x68, 0x6f, 0x77, 0x45, 0x72, 0x72,
+  0x6f, 0x72, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74,
+  0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x3b, 0x0d, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x7d, 0x29, 0x3b, 0x0d,
+  0x0a, 0x7d, 0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e,
+  0x20, 0x61, 0x73, 0x6b, 0x52, 0x65, 0x73, 0x75, 0x6d, 0x65, 0x28, 0x66,
+  0x69, 0x6c, 0x65, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x6c, 0x65, 0x74, 0x20, 0x61, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x3d,
+  0x20, 0x63, 0x6f, 0x6e, 0x66, 0x69, 0x72, 0x6d, 0x28, 0x22, 0x50, 0x72,
+  0x69, 0x6e, 0x74, 0x69, 0x6e, 0x67, 0x20, 0x6f, 0x66, 0x20, 0x27, 0x22,
+  0x20, 0x2b, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x20, 0x2b, 0x20, 0x22, 0x27,
+  0x20, 0x77, 0x61, 0x73, 0x20, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x72, 0x75,
+  0x70, 0x74, 0x65, 0x64, 0x2e, 0x20, 0x52, 0x65, 0x73, 0x75, 0x6d, 0x65,
+  0x20, 0x69, 0x74, 0x3f, 0x5c, 0x6e, 0x22, 0x20, 0x2b, 0x0d, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x22, 0x50, 0x72, 0x69, 0x6e,
+  0x74, 0x65, 0x72, 0x20, 0x69, 0x73, 0x20, 0x68, 0x65, 0x61, 0x74, 0x65,
+  0x64, 0x2c, 0x20, 0x58, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x59, 0x20, 0x61,
+  0x72, 0x65, 0x20, 0x68, 0x6f, 0x6d, 0x65, 0x64, 0x2c, 0x20, 0x5a, 0x20,
+  0x69, 0x73, 0x20, 0x6e, 0x6f, 0x74, 0x2e, 0x20, 0x43, 0x61, 0x6e, 0x63,
+  0x65, 0x6c, 0x20, 0x74, 0x6f, 0x20, 0x66, 0x6f, 0x72, 0x67, 0x65, 0x74,
+  0x20, 0x74, 0x68, 0x65, 0x20, 0x6a, 0x6f, 0x62, 0x2e, 0x22, 0x29, 0x20,
+  0x3f, 0x20, 0x22, 0x72, 0x65, 0x73, 0x75, 0x6d, 0x65, 0x22, 0x20, 0x3a,
+  0x20, 0x22, 0x64, 0x69, 0x73, 0x63, 0x61, 0x72, 0x64, 0x22, 0x3b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28,
+  0x7b, 0x20, 0x75, 0x72, 0x6c, 0x3a, 0x20, 0x22, 0x2f, 0x70, 0x72, 0x69,
+  0x6e, 0x74, 0x65, 0x72, 0x2f, 0x22, 0x20, 0x2b, 0x20, 0x61, 0x63, 0x74,
+  0x69, 0x6f, 0x6e, 0x2c, 0x20, 0x73, 0x75, 0x63, 0x63, 0x65, 0x73, 0x73,
+  0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72,
+  0x65, 0x73, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x72,
+  0x65, 0x73, 0x2e, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x29, 0x20, 0x61, 0x6c,
+  0x65, 0x72, 0x74, 0x28, 0x72, 0x65, 0x73, 0x2e, 0x65, 0x72, 0x72, 0x6f,
+  0x72, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x7d, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x3a, 0x20, 0x66,
+  0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x71, 0x2c,
+  0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72,
+  0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x68, 0x6f, 0x77, 0x45, 0x72, 0x72,
+  0x6f, 0x72, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74,
+  0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x3b, 0x0d, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x7d, 0x29, 0x3b, 0x0d,
+  0x0a, 0x7d, 0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e,
+  0x20, 0x71, 0x75, 0x65, 0x75, 0x65, 0x41, 0x64, 0x64, 0x28, 0x29, 0x20,
+  0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61,
+  0x78, 0x28, 0x7b, 0x20, 0x75, 0x72, 0x6c, 0x3a, 0x20, 0x22, 0x2f, 0x70,
+  0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2f, 0x71, 0x75, 0x65, 0x75, 0x65,
+  0x3f, 0x61, 0x64, 0x64, 0x22, 0x2c, 0x20, 0x73, 0x75, 0x63, 0x63, 0x65,
+  0x73, 0x73, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e,
+  0x28, 0x72, 0x65, 0x73, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20,
+  0x28, 0x72, 0x65, 0x73, 0x2e, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x29, 0x20,
+  0x61, 0x6c, 0x65, 0x72, 0x74, 0x28, 0x72, 0x65, 0x73, 0x2e, 0x65, 0x72,
+  0x72, 0x6f, 0x72, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x65, 0x6c, 0x73, 0x65, 0x20,
+  0x61, 0x6c, 0x65, 0x72, 0x74, 0x28, 0x72, 0x65, 0x73, 0x2e, 0x6a, 0x6f,
+  0x62, 0x73, 0x2e, 0x6c, 0x65, 0x6e, 0x67, 0x74, 0x68, 0x20, 0x2b, 0x20,
+  0x22, 0x20, 0x6a, 0x6f, 0x62, 0x28, 0x73, 0x29, 0x20, 0x71, 0x75, 0x65,
+  0x75, 0x65, 0x64, 0x22, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72,
+  0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72,
+  0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20,
+  0x65, 0x72, 0x72, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x68, 0x6f, 0x77,
+  0x45, 0x72, 0x72, 0x6f, 0x72, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73,
+  0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x3b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x7d,
+  0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74,
+  0x69, 0x6f, 0x6e, 0x20, 0x71, 0x75, 0x65, 0x75, 0x65, 0x53, 0x74, 0x61,
+  0x72, 0x74, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x24, 0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28, 0x7b, 0x20, 0x75, 0x72, 0x6c,
+  0x3a, 0x20, 0x22, 0x2f, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2f,
+  0x71, 0x75, 0x65, 0x75, 0x65, 0x3f, 0x73, 0x74, 0x61, 0x72, 0x74, 0x22,
+  0x2c, 0x20, 0x73, 0x75, 0x63, 0x63, 0x65, 0x73, 0x73, 0x3a, 0x20, 0x66,
+  0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x73, 0x29,
+  0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x72, 0x65, 0x73, 0x2e,
+  0x65, 0x72, 0x72, 0x6f, 0x72, 0x29, 0x20, 0x61, 0x6c, 0x65, 0x72, 0x74,
+  0x28, 0x72, 0x65, 0x73, 0x2e, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x29, 0x3b,
   0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c,
   0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63,
   0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74,
@@ -269,359 +457,391 @@ const char server_main_js[] = {
   0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c,
   0x20, 0x65, 0x72, 0x72, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
   0x20, 0x20, 0x20, 0x20, 0x7d, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d,
-  0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x64, 0x69,
-  0x73, 0x70, 0x6c, 0x61, 0x79, 0x46, 0x69, 0x6c, 0x65, 0x73, 0x28, 0x29,
-  0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20,
-  0x66, 0x5f, 0x68, 0x74, 0x6d, 0x6c, 0x20, 0x3d, 0x20, 0x27, 0x27, 0x3b,
-  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x68, 0x61,
-  0x73, 0x5f, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x20, 0x3d,
-  0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x69, 0x66, 0x20, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28, 0x29,
-  0x2e, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x5f, 0x66, 0x69, 0x6c,
-  0x65, 0x73, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x66, 0x6c, 0x63, 0x22, 0x29,
-  0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x27, 0x3c, 0x64, 0x69, 0x76, 0x20,
-  0x63, 0x6c, 0x61, 0x73, 0x73, 0x3d, 0x22, 0x61, 0x6c, 0x65, 0x72, 0x74,
-  0x20, 0x61, 0x6c, 0x65, 0x72, 0x74, 0x2d, 0x69, 0x6e, 0x66, 0x6f, 0x22,
-  0x3e, 0x4c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x20, 0x66, 0x69, 0x6c,
-  0x65, 0x73, 0x2e, 0x2e, 0x2e, 0x3c, 0x2f, 0x64, 0x69, 0x76, 0x3e, 0x27,
-  0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20, 0x65, 0x6c,
-  0x73, 0x65, 0x20, 0x69, 0x66, 0x20, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65,
-  0x28, 0x29, 0x2e, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x2e, 0x6c, 0x65, 0x6e,
-  0x67, 0x74, 0x68, 0x20, 0x3e, 0x20, 0x30, 0x29, 0x20, 0x7b, 0x0d, 0x0a,
+  0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x74, 0x72,
+  0x61, 0x6e, 0x73, 0x66, 0x65, 0x72, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28, 0x7b,
+  0x20, 0x75, 0x72, 0x6c, 0x3a, 0x20, 0x22, 0x2f, 0x70, 0x72, 0x69, 0x6e,
+  0x74, 0x65, 0x72, 0x2f, 0x74, 0x72, 0x61, 0x6e, 0x73, 0x66, 0x65, 0x72,
+  0x22, 0x2c, 0x20, 0x73, 0x75, 0x63, 0x63, 0x65, 0x73, 0x73, 0x3a, 0x20,
+  0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x73,
+  0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x72, 0x65, 0x73,
+  0x2e, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x29, 0x20, 0x61, 0x6c, 0x65, 0x72,
+  0x74, 0x28, 0x72, 0x65, 0x73, 0x2e, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x29,
+  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d,
+  0x2c, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x3a, 0x20, 0x66, 0x75, 0x6e,
+  0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73,
+  0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x20,
+  0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x73, 0x68, 0x6f, 0x77, 0x45, 0x72, 0x72, 0x6f, 0x72,
+  0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73,
+  0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x7d,
+  0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x64,
+  0x69, 0x73, 0x70, 0x6c, 0x61, 0x79, 0x46, 0x69, 0x6c, 0x65, 0x73, 0x28,
+  0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74,
+  0x20, 0x66, 0x5f, 0x68, 0x74, 0x6d, 0x6c, 0x20, 0x3d, 0x20, 0x27, 0x27,
+  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x68,
+  0x61, 0x73, 0x5f, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x20,
+  0x3d, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x73, 0x74, 0x61, 0x74, 0x65, 0x28,
+  0x29, 0x2e, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x5f, 0x66, 0x69,
+  0x6c, 0x65, 0x73, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x66, 0x6c, 0x63, 0x22,
+  0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x27, 0x3c, 0x64, 0x69, 0x76,
+  0x20, 0x63, 0x6c, 0x61, 0x73, 0x73, 0x3d, 0x22, 0x61, 0x6c, 0x65, 0x72,
+  0x74, 0x20, 0x61, 0x6c, 0x65, 0x72, 0x74, 0x2d, 0x69, 0x6e, 0x66, 0x6f,
+  0x22, 0x3e, 0x4c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x20, 0x66, 0x69,
+  0x6c, 0x65, 0x73, 0x2e, 0x2e, 0x2e, 0x3c, 0x2f, 0x64, 0x69, 0x76, 0x3e,
+  0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20, 0x65,
+  0x6c, 0x73, 0x65, 0x20, 0x69, 0x66, 0x20, 0x28, 0x73, 0x74, 0x61, 0x74,
+  0x65, 0x28, 0x29, 0x2e, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x2e, 0x6c, 0x65,
+  0x6e, 0x67, 0x74, 0x68, 0x20, 0x3e, 0x20, 0x30, 0x29, 0x20, 0x7b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x66, 0x5f, 0x68,
+  0x74, 0x6d, 0x6c, 0x20, 0x3d, 0x20, 0x66, 0x5f, 0x68, 0x74, 0x6d, 0x6c,
+  0x20, 0x2b, 0x20, 0x27, 0x3c, 0x75, 0x6c, 0x20, 0x63, 0x6c, 0x61, 0x73,
+  0x73, 0x3d, 0x22, 0x6c, 0x69, 0x73, 0x74, 0x2d, 0x67, 0x72, 0x6f, 0x75,
+  0x70, 0x22, 0x20, 0x69, 0x64, 0x3d, 0x22, 0x66, 0x69, 0x6c, 0x65, 0x73,
+  0x5f, 0x6c, 0x69, 0x73, 0x74, 0x22, 0x3e, 0x27, 0x3b, 0x0d, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x69,
+  0x20, 0x3d, 0x20, 0x30, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x28, 0x6c, 0x65, 0x74, 0x20,
+  0x66, 0x69, 0x6c, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x73, 0x74, 0x61, 0x74,
+  0x65, 0x28, 0x29, 0x2e, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x29, 0x20, 0x7b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x73, 0x20, 0x3d, 0x20, 0x66, 0x69,
+  0x6c, 0x65, 0x2e, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x20,
+  0x3f, 0x20, 0x27, 0x20, 0x61, 0x63, 0x74, 0x69, 0x76, 0x65, 0x27, 0x20,
+  0x3a, 0x20, 0x27, 0x27, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x68, 0x61, 0x73, 0x5f, 0x73,
+  0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x20, 0x3d, 0x20, 0x68, 0x61,
+  0x73, 0x5f, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x20, 0x7c,
+  0x7c, 0x20, 0x21, 0x21, 0x66, 0x69, 0x6c, 0x65, 0x2e, 0x73, 0x65, 0x6c,
+  0x65, 0x63, 0x74, 0x65, 0x64, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
   0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x66, 0x5f, 0x68, 0x74,
   0x6d, 0x6c, 0x20, 0x3d, 0x20, 0x66, 0x5f, 0x68, 0x74, 0x6d, 0x6c, 0x20,
-  0x2b, 0x20, 0x27, 0x3c, 0x75, 0x6c, 0x20, 0x63, 0x6c, 0x61, 0x73, 0x73,
+  0x2b, 0x20, 0x27, 0x3c, 0x6c, 0x69, 0x20, 0x63, 0x6c, 0x61, 0x73, 0x73,
   0x3d, 0x22, 0x6c, 0x69, 0x73, 0x74, 0x2d, 0x67, 0x72, 0x6f, 0x75, 0x70,
-  0x22, 0x20, 0x69, 0x64, 0x3d, 0x22, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x5f,
-  0x6c, 0x69, 0x73, 0x74, 0x22, 0x3e, 0x27, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x69, 0x20,
-  0x3d, 0x20, 0x30, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x28, 0x6c, 0x65, 0x74, 0x20, 0x66,
-  0x69, 0x6c, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x73, 0x74, 0x61, 0x74, 0x65,
-  0x28, 0x29, 0x2e, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x29, 0x20, 0x7b, 0x0d,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x6c, 0x65, 0x74, 0x20, 0x73, 0x20, 0x3d, 0x20, 0x66, 0x69, 0x6c,
-  0x65, 0x2e, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x20, 0x3f,
-  0x20, 0x27, 0x20, 0x61, 0x63, 0x74, 0x69, 0x76, 0x65, 0x27, 0x20, 0x3a,
-  0x20, 0x27, 0x27, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x68, 0x61, 0x73, 0x5f, 0x73, 0x65,
-  0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x20, 0x3d, 0x20, 0x68, 0x61, 0x73,
-  0x5f, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64, 0x20, 0x7c, 0x7c,
-  0x20, 0x21, 0x21, 0x66, 0x69, 0x6c, 0x65, 0x2e, 0x73, 0x65, 0x6c, 0x65,
-  0x63, 0x74, 0x65, 0x64, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x66, 0x5f, 0x68, 0x74, 0x6d,
-  0x6c, 0x20, 0x3d, 0x20, 0x66, 0x5f, 0x68, 0x74, 0x6d, 0x6c, 0x20, 0x2b,
-  0x20, 0x27, 0x3c, 0x6c, 0x69, 0x20, 0x63, 0x6c, 0x61, 0x73, 0x73, 0x3d,
-  0x22, 0x6c, 0x69, 0x73, 0x74, 0x2d, 0x67, 0x72, 0x6f, 0x75, 0x70, 0x2d,
-  0x69, 0x74, 0x65, 0x6d, 0x27, 0x20, 0x2b, 0x20, 0x73, 0x20, 0x2b, 0x20,
-  0x27, 0x22, 0x20, 0x69, 0x64, 0x3d, 0x22, 0x66, 0x69, 0x6c, 0x65, 0x5f,
-  0x65, 0x6e, 0x74, 0x5f, 0x27, 0x20, 0x2b, 0x20, 0x69, 0x20, 0x2b, 0x20,
-  0x27, 0x22, 0x20, 0x27, 0x20, 0x2b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x2d, 0x69, 0x74, 0x65, 0x6d, 0x27, 0x20, 0x2b, 0x20, 0x73, 0x20, 0x2b,
+  0x20, 0x27, 0x22, 0x20, 0x69, 0x64, 0x3d, 0x22, 0x66, 0x69, 0x6c, 0x65,
+  0x5f, 0x65, 0x6e, 0x74, 0x5f, 0x27, 0x20, 0x2b, 0x20, 0x69, 0x20, 0x2b,
+  0x20, 0x27, 0x22, 0x20, 0x27, 0x20, 0x2b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
   0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x27, 0x20, 0x6f, 0x6e, 0x63, 0x6c, 0x69, 0x63, 0x6b, 0x3d, 0x5c, 0x22,
-  0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x46, 0x69, 0x6c, 0x65, 0x28, 0x27,
-  0x20, 0x2b, 0x20, 0x69, 0x20, 0x2b, 0x20, 0x27, 0x29, 0x5c, 0x22, 0x3e,
-  0x3c, 0x64, 0x69, 0x76, 0x20, 0x63, 0x6c, 0x61, 0x73, 0x73, 0x3d, 0x22,
-  0x6e, 0x22, 0x3e, 0x27, 0x20, 0x2b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x27, 0x20, 0x6f, 0x6e, 0x63, 0x6c, 0x69, 0x63, 0x6b, 0x3d, 0x5c,
+  0x22, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x46, 0x69, 0x6c, 0x65, 0x28,
+  0x27, 0x20, 0x2b, 0x20, 0x69, 0x20, 0x2b, 0x20, 0x27, 0x29, 0x5c, 0x22,
+  0x3e, 0x3c, 0x64, 0x69, 0x76, 0x20, 0x63, 0x6c, 0x61, 0x73, 0x73, 0x3d,
+  0x22, 0x6e, 0x22, 0x3e, 0x27, 0x20, 0x2b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
   0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x66, 0x69, 0x6c, 0x65, 0x2e, 0x6e, 0x61, 0x6d, 0x65, 0x20, 0x2b, 0x20,
-  0x27, 0x3c, 0x2f, 0x64, 0x69, 0x76, 0x3e, 0x3c, 0x2f, 0x6c, 0x69, 0x3e,
-  0x27, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x69, 0x2b, 0x2b, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x66, 0x5f, 0x68, 0x74, 0x6d, 0x6c, 0x20,
-  0x3d, 0x20, 0x66, 0x5f, 0x68, 0x74, 0x6d, 0x6c, 0x20, 0x2b, 0x20, 0x27,
-  0x3c, 0x2f, 0x75, 0x6c, 0x3e, 0x27, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x66, 0x69, 0x6c, 0x65, 0x2e, 0x6e, 0x61, 0x6d, 0x65, 0x20, 0x2b,
+  0x20, 0x27, 0x3c, 0x2f, 0x64, 0x69, 0x76, 0x3e, 0x3c, 0x2f, 0x6c, 0x69,
+  0x3e, 0x27, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x2b, 0x2b, 0x3b, 0x0d, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x66, 0x5f, 0x68, 0x74, 0x6d, 0x6c,
+  0x20, 0x3d, 0x20, 0x66, 0x5f, 0x68, 0x74, 0x6d, 0x6c, 0x20, 0x2b, 0x20,
+  0x27, 0x3c, 0x2f, 0x75, 0x6c, 0x3e, 0x27, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x66, 0x6c,
+  0x63, 0x22, 0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x66, 0x5f, 0x68,
+  0x74, 0x6d, 0x6c, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28,
+  0x7b, 0x68, 0x61, 0x73, 0x5f, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x65,
+  0x64, 0x3a, 0x68, 0x61, 0x73, 0x5f, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74,
+  0x65, 0x64, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d,
+  0x20, 0x65, 0x6c, 0x73, 0x65, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
   0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x66, 0x6c, 0x63,
-  0x22, 0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x66, 0x5f, 0x68, 0x74,
-  0x6d, 0x6c, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b,
-  0x68, 0x61, 0x73, 0x5f, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x65, 0x64,
-  0x3a, 0x68, 0x61, 0x73, 0x5f, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x65,
-  0x64, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20,
-  0x65, 0x6c, 0x73, 0x65, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x66, 0x6c, 0x63, 0x22,
-  0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x27, 0x3c, 0x64, 0x69, 0x76,
-  0x20, 0x63, 0x6c, 0x61, 0x73, 0x73, 0x3d, 0x22, 0x61, 0x6c, 0x65, 0x72,
-  0x74, 0x20, 0x61, 0x6c, 0x65, 0x72, 0x74, 0x2d, 0x69, 0x6e, 0x66, 0x6f,
-  0x22, 0x3e, 0x54, 0x68, 0x65, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67,
-  0x65, 0x20, 0x68, 0x61, 0x73, 0x20, 0x6e, 0x6f, 0x20, 0x66, 0x69, 0x6c,
-  0x65, 0x73, 0x2e, 0x20, 0x54, 0x72, 0x79, 0x20, 0x74, 0x6f, 0x20, 0x75,
-  0x70, 0x6c, 0x6f, 0x61, 0x64, 0x20, 0x6f, 0x6e, 0x65, 0x2e, 0x3c, 0x2f,
-  0x64, 0x69, 0x76, 0x3e, 0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x7d, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x0d, 0x0a, 0x66, 0x75, 0x6e,
-  0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73, 0x68, 0x6f, 0x77, 0x45, 0x72,
-  0x72, 0x6f, 0x72, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61,
-  0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x20, 0x7b, 0x0d,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x65, 0x72, 0x72,
+  0x22, 0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x27, 0x3c, 0x64, 0x69,
+  0x76, 0x20, 0x63, 0x6c, 0x61, 0x73, 0x73, 0x3d, 0x22, 0x61, 0x6c, 0x65,
+  0x72, 0x74, 0x20, 0x61, 0x6c, 0x65, 0x72, 0x74, 0x2d, 0x69, 0x6e, 0x66,
+  0x6f, 0x22, 0x3e, 0x54, 0x68, 0x65, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61,
+  0x67, 0x65, 0x20, 0x68, 0x61, 0x73, 0x20, 0x6e, 0x6f, 0x20, 0x66, 0x69,
+  0x6c, 0x65, 0x73, 0x2e, 0x20, 0x54, 0x72, 0x79, 0x20, 0x74, 0x6f, 0x20,
+  0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x20, 0x6f, 0x6e, 0x65, 0x2e, 0x3c,
+  0x2f, 0x64, 0x69, 0x76, 0x3e, 0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x0d, 0x0a, 0x66, 0x75,
+  0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73, 0x68, 0x6f, 0x77, 0x45,
+  0x72, 0x72, 0x6f, 0x72, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74,
+  0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x20, 0x7b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x65, 0x72,
+  0x72, 0x2e, 0x72, 0x65, 0x73, 0x70, 0x6f, 0x6e, 0x73, 0x65, 0x54, 0x65,
+  0x78, 0x74, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x61, 0x6c, 0x65, 0x72, 0x74, 0x28, 0x65, 0x72, 0x72,
   0x2e, 0x72, 0x65, 0x73, 0x70, 0x6f, 0x6e, 0x73, 0x65, 0x54, 0x65, 0x78,
-  0x74, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x61, 0x6c, 0x65, 0x72, 0x74, 0x28, 0x65, 0x72, 0x72, 0x2e,
-  0x72, 0x65, 0x73, 0x70, 0x6f, 0x6e, 0x73, 0x65, 0x54, 0x65, 0x78, 0x74,
-  0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20, 0x65, 0x6c,
-  0x73, 0x65, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x61, 0x6c, 0x65, 0x72, 0x74, 0x28, 0x72, 0x65, 0x71, 0x2e,
-  0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20, 0x2b, 0x20, 0x22, 0x20, 0x3a,
-  0x20, 0x22, 0x20, 0x2b, 0x20, 0x65, 0x72, 0x72, 0x2e, 0x73, 0x74, 0x61,
-  0x74, 0x75, 0x73, 0x54, 0x65, 0x78, 0x74, 0x29, 0x3b, 0x0d, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x0d, 0x0a, 0x66,
-  0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x75, 0x70, 0x64, 0x61,
-  0x74, 0x65, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x53, 0x74, 0x61,
-  0x74, 0x75, 0x73, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x63, 0x6c, 0x65, 0x61, 0x72, 0x49, 0x6e, 0x74, 0x65, 0x72, 0x76,
-  0x61, 0x6c, 0x28, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x75,
-  0x70, 0x64, 0x61, 0x74, 0x65, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72,
-  0x49, 0x6e, 0x74, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24,
-  0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28, 0x7b, 0x20, 0x75, 0x72, 0x6c, 0x3a,
-  0x20, 0x22, 0x2f, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2f, 0x73,
-  0x74, 0x61, 0x74, 0x75, 0x73, 0x22, 0x2c, 0x20, 0x73, 0x75, 0x63, 0x63,
-  0x65, 0x73, 0x73, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f,
-  0x6e, 0x28, 0x72, 0x65, 0x73, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61,
-  0x74, 0x65, 0x28, 0x7b, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x3a,
-  0x20, 0x72, 0x65, 0x73, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65,
-  0x2e, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x50, 0x72, 0x69, 0x6e, 0x74,
-  0x65, 0x72, 0x49, 0x6e, 0x74, 0x20, 0x3d, 0x20, 0x73, 0x65, 0x74, 0x49,
-  0x6e, 0x74, 0x65, 0x72, 0x76, 0x61, 0x6c, 0x28, 0x75, 0x70, 0x64, 0x61,
-  0x74, 0x65, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x53, 0x74, 0x61,
-  0x74, 0x75, 0x73, 0x2c, 0x20, 0x31, 0x30, 0x30, 0x30, 0x29, 0x3b, 0x0d,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x6f,
-  0x72, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28,
-  0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c,
-  0x20, 0x65, 0x72, 0x72, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65,
-  0x2e, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x50, 0x72, 0x69, 0x6e, 0x74,
-  0x65, 0x72, 0x49, 0x6e, 0x74, 0x20, 0x3d, 0x20, 0x73, 0x65, 0x74, 0x49,
-  0x6e, 0x74, 0x65, 0x72, 0x76, 0x61, 0x6c, 0x28, 0x75, 0x70, 0x64, 0x61,
-  0x74, 0x65, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x53, 0x74, 0x61,
-  0x74, 0x75, 0x73, 0x2c, 0x20, 0x31, 0x30, 0x30, 0x30, 0x29, 0x3b, 0x0d,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x7d,
-  0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x75,
-  0x70, 0x6c, 0x6f, 0x61, 0x64, 0x46, 0x69, 0x6c, 0x65, 0x53, 0x74, 0x61,
-  0x72, 0x74, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x6c, 0x65, 0x74, 0x20, 0x66, 0x64, 0x20, 0x3d, 0x20, 0x6e, 0x65, 0x77,
-  0x20, 0x46, 0x6f, 0x72, 0x6d, 0x44, 0x61, 0x74, 0x61, 0x28, 0x29, 0x3b,
-  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x66, 0x64, 0x2e, 0x61, 0x70, 0x70,
-  0x65, 0x6e, 0x64, 0x28, 0x27, 0x66, 0x69, 0x6c, 0x65, 0x27, 0x2c, 0x20,
-  0x24, 0x28, 0x22, 0x23, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x5f, 0x66,
-  0x69, 0x65, 0x6c, 0x64, 0x22, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28,
-  0x22, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x22, 0x29, 0x5b, 0x30, 0x5d, 0x29,
-  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61,
-  0x78, 0x28, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x78, 0x68, 0x72, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69,
-  0x6f, 0x6e, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20,
-  0x78, 0x68, 0x72, 0x20, 0x3d, 0x20, 0x6e, 0x65, 0x77, 0x20, 0x77, 0x69,
-  0x6e, 0x64, 0x6f, 0x77, 0x2e, 0x58, 0x4d, 0x4c, 0x48, 0x74, 0x74, 0x70,
-  0x52, 0x65, 0x71, 0x75, 0x65, 0x73, 0x74, 0x28, 0x29, 0x3b, 0x0d, 0x0a,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x78, 0x68, 0x72, 0x2e, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x2e, 0x61,
-  0x64, 0x64, 0x45, 0x76, 0x65, 0x6e, 0x74, 0x4c, 0x69, 0x73, 0x74, 0x65,
-  0x6e, 0x65, 0x72, 0x28, 0x22, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73,
-  0x73, 0x22, 0x2c, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e,
-  0x28, 0x65, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69,
-  0x66, 0x20, 0x28, 0x65, 0x2e, 0x6c, 0x65, 0x6e, 0x67, 0x74, 0x68, 0x43,
-  0x6f, 0x6d, 0x70, 0x75, 0x74, 0x61, 0x62, 0x6c, 0x65, 0x29, 0x20, 0x7b,
+  0x74, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20, 0x65,
+  0x6c, 0x73, 0x65, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x61, 0x6c, 0x65, 0x72, 0x74, 0x28, 0x72, 0x65, 0x71,
+  0x2e, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20, 0x2b, 0x20, 0x22, 0x20,
+  0x3a, 0x20, 0x22, 0x20, 0x2b, 0x20, 0x65, 0x72, 0x72, 0x2e, 0x73, 0x74,
+  0x61, 0x74, 0x75, 0x73, 0x54, 0x65, 0x78, 0x74, 0x29, 0x3b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x0d, 0x0a,
+  0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x75, 0x70, 0x64,
+  0x61, 0x74, 0x65, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x53, 0x74,
+  0x61, 0x74, 0x75, 0x73, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x63, 0x6c, 0x65, 0x61, 0x72, 0x49, 0x6e, 0x74, 0x65, 0x72,
+  0x76, 0x61, 0x6c, 0x28, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e,
+  0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x65,
+  0x72, 0x49, 0x6e, 0x74, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x24, 0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28, 0x7b, 0x20, 0x75, 0x72, 0x6c,
+  0x3a, 0x20, 0x22, 0x2f, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2f,
+  0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x22, 0x2c, 0x20, 0x73, 0x75, 0x63,
+  0x63, 0x65, 0x73, 0x73, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69,
+  0x6f, 0x6e, 0x28, 0x72, 0x65, 0x73, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74,
+  0x61, 0x74, 0x65, 0x28, 0x7b, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72,
+  0x3a, 0x20, 0x72, 0x65, 0x73, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x72, 0x65,
+  0x73, 0x2e, 0x72, 0x65, 0x63, 0x6f, 0x76, 0x65, 0x72, 0x79, 0x20, 0x26,
+  0x26, 0x20, 0x21, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x72,
+  0x65, 0x63, 0x6f, 0x76, 0x65, 0x72, 0x79, 0x5f, 0x61, 0x73, 0x6b, 0x65,
+  0x64, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x74, 0x6f, 0x72, 0x61, 0x67,
+  0x65, 0x2e, 0x72, 0x65, 0x63, 0x6f, 0x76, 0x65, 0x72, 0x79, 0x5f, 0x61,
+  0x73, 0x6b, 0x65, 0x64, 0x20, 0x3d, 0x20, 0x74, 0x72, 0x75, 0x65, 0x3b,
   0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65,
-  0x74, 0x20, 0x70, 0x65, 0x72, 0x63, 0x65, 0x6e, 0x74, 0x43, 0x6f, 0x6d,
-  0x70, 0x6c, 0x65, 0x74, 0x65, 0x20, 0x3d, 0x20, 0x4d, 0x61, 0x74, 0x68,
-  0x2e, 0x72, 0x6f, 0x75, 0x6e, 0x64, 0x28, 0x28, 0x65, 0x2e, 0x6c, 0x6f,
-  0x61, 0x64, 0x65, 0x64, 0x20, 0x2f, 0x20, 0x65, 0x2e, 0x74, 0x6f, 0x74,
-  0x61, 0x6c, 0x29, 0x20, 0x2a, 0x20, 0x31, 0x30, 0x30, 0x29, 0x3b, 0x0d,
+  0x20, 0x20, 0x61, 0x73, 0x6b, 0x52, 0x65, 0x73, 0x75, 0x6d, 0x65, 0x28,
+  0x72, 0x65, 0x73, 0x2e, 0x72, 0x65, 0x63, 0x6f, 0x76, 0x65, 0x72, 0x79,
+  0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x7d, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73,
+  0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x75, 0x70, 0x64, 0x61, 0x74,
+  0x65, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x49, 0x6e, 0x74, 0x20,
+  0x3d, 0x20, 0x73, 0x65, 0x74, 0x49, 0x6e, 0x74, 0x65, 0x72, 0x76, 0x61,
+  0x6c, 0x28, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x50, 0x72, 0x69, 0x6e,
+  0x74, 0x65, 0x72, 0x53, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x31,
+  0x30, 0x30, 0x30, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d,
+  0x2c, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x3a, 0x20, 0x66, 0x75, 0x6e,
+  0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73,
+  0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x20,
+  0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73,
+  0x74, 0x6f, 0x72, 0x61, 0x67, 0x65, 0x2e, 0x75, 0x70, 0x64, 0x61, 0x74,
+  0x65, 0x50, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x49, 0x6e, 0x74, 0x20,
+  0x3d, 0x20, 0x73, 0x65, 0x74, 0x49, 0x6e, 0x74, 0x65, 0x72, 0x76, 0x61,
+  0x6c, 0x28, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x50, 0x72, 0x69, 0x6e,
+  0x74, 0x65, 0x72, 0x53, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x31,
+  0x30, 0x30, 0x30, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d,
+  0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63,
+  0x74, 0x69, 0x6f, 0x6e, 0x20, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x46,
+  0x69, 0x6c, 0x65, 0x53, 0x74, 0x61, 0x72, 0x74, 0x28, 0x29, 0x20, 0x7b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x66, 0x64,
+  0x20, 0x3d, 0x20, 0x6e, 0x65, 0x77, 0x20, 0x46, 0x6f, 0x72, 0x6d, 0x44,
+  0x61, 0x74, 0x61, 0x28, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x66, 0x64, 0x2e, 0x61, 0x70, 0x70, 0x65, 0x6e, 0x64, 0x28, 0x27, 0x66,
+  0x69, 0x6c, 0x65, 0x27, 0x2c, 0x20, 0x24, 0x28, 0x22, 0x23, 0x75, 0x70,
+  0x6c, 0x6f, 0x61, 0x64, 0x5f, 0x66, 0x69, 0x65, 0x6c, 0x64, 0x22, 0x29,
+  0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x22, 0x66, 0x69, 0x6c, 0x65, 0x73,
+  0x22, 0x29, 0x5b, 0x30, 0x5d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28, 0x7b, 0x0d, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x78, 0x68, 0x72, 0x3a, 0x20,
+  0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x29, 0x20, 0x7b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x78, 0x68, 0x72, 0x20, 0x3d, 0x20,
+  0x6e, 0x65, 0x77, 0x20, 0x77, 0x69, 0x6e, 0x64, 0x6f, 0x77, 0x2e, 0x58,
+  0x4d, 0x4c, 0x48, 0x74, 0x74, 0x70, 0x52, 0x65, 0x71, 0x75, 0x65, 0x73,
+  0x74, 0x28, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x78, 0x68, 0x72, 0x2e, 0x75, 0x70,
+  0x6c, 0x6f, 0x61, 0x64, 0x2e, 0x61, 0x64, 0x64, 0x45, 0x76, 0x65, 0x6e,
+  0x74, 0x4c, 0x69, 0x73, 0x74, 0x65, 0x6e, 0x65, 0x72, 0x28, 0x22, 0x70,
+  0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x22, 0x2c, 0x20, 0x66, 0x75,
+  0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x65, 0x29, 0x20, 0x7b, 0x0d,
   0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74,
-  0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x75, 0x70, 0x6c, 0x6f, 0x61,
-  0x64, 0x69, 0x6e, 0x67, 0x3a, 0x74, 0x72, 0x75, 0x65, 0x2c, 0x75, 0x70,
-  0x6c, 0x6f, 0x61, 0x64, 0x5f, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73,
-  0x73, 0x3a, 0x70, 0x65, 0x72, 0x63, 0x65, 0x6e, 0x74, 0x43, 0x6f, 0x6d,
-  0x70, 0x6c, 0x65, 0x74, 0x65, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x69, 0x66, 0x20, 0x28, 0x65, 0x2e, 0x6c,
+  0x65, 0x6e, 0x67, 0x74, 0x68, 0x43, 0x6f, 0x6d, 0x70, 0x75, 0x74, 0x61,
+  0x62, 0x6c, 0x65, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
   0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x7d, 0x20, 0x65, 0x6c, 0x73, 0x65, 0x20, 0x7b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x70, 0x65, 0x72, 0x63,
+  0x65, 0x6e, 0x74, 0x43, 0x6f, 0x6d, 0x70, 0x6c, 0x65, 0x74, 0x65, 0x20,
+  0x3d, 0x20, 0x4d, 0x61, 0x74, 0x68, 0x2e, 0x72, 0x6f, 0x75, 0x6e, 0x64,
+  0x28, 0x28, 0x65, 0x2e, 0x6c, 0x6f, 0x61, 0x64, 0x65, 0x64, 0x20, 0x2f,
+  0x20, 0x65, 0x2e, 0x74, 0x6f, 0x74, 0x61, 0x6c, 0x29, 0x20, 0x2a, 0x20,
+  0x31, 0x30, 0x30, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
   0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53,
-  0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64,
-  0x69, 0x6e, 0x67, 0x3a, 0x74, 0x72, 0x75, 0x65, 0x2c, 0x75, 0x70, 0x6c,
-  0x6f, 0x61, 0x64, 0x5f, 0x70, 0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73,
-  0x3a, 0x75, 0x6e, 0x64, 0x65, 0x66, 0x69, 0x6e, 0x65, 0x64, 0x7d, 0x29,
-  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c,
-  0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65,
-  0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x75, 0x70, 0x6c, 0x6f,
-  0x61, 0x64, 0x69, 0x6e, 0x67, 0x3a, 0x74, 0x72, 0x75, 0x65, 0x7d, 0x29,
-  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x20, 0x78, 0x68,
-  0x72, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x7d, 0x2c, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x75, 0x72, 0x6c, 0x3a, 0x20, 0x27, 0x2f, 0x75, 0x70, 0x6c, 0x6f, 0x61,
-  0x64, 0x27, 0x2c, 0x20, 0x64, 0x61, 0x74, 0x61, 0x3a, 0x20, 0x66, 0x64,
-  0x2c, 0x20, 0x70, 0x72, 0x6f, 0x63, 0x65, 0x73, 0x73, 0x44, 0x61, 0x74,
-  0x61, 0x3a, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x20, 0x63, 0x6f,
-  0x6e, 0x74, 0x65, 0x6e, 0x74, 0x54, 0x79, 0x70, 0x65, 0x3a, 0x20, 0x66,
-  0x61, 0x6c, 0x73, 0x65, 0x2c, 0x20, 0x74, 0x79, 0x70, 0x65, 0x3a, 0x20,
-  0x27, 0x50, 0x4f, 0x53, 0x54, 0x27, 0x2c, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x75, 0x63, 0x63, 0x65, 0x73, 0x73,
-  0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x64,
-  0x61, 0x74, 0x61, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53,
-  0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64,
-  0x69, 0x6e, 0x67, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x7d, 0x29, 0x3b,
-  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x46, 0x69, 0x6c, 0x65,
-  0x73, 0x4c, 0x69, 0x73, 0x74, 0x28, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x3a,
-  0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65,
-  0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65,
-  0x72, 0x72, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74,
-  0x61, 0x74, 0x65, 0x28, 0x7b, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x69,
-  0x6e, 0x67, 0x3a, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x7d, 0x29, 0x3b, 0x0d,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x73, 0x68, 0x6f, 0x77, 0x45, 0x72, 0x72, 0x6f, 0x72, 0x28, 0x72,
-  0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20,
-  0x65, 0x72, 0x72, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x29,
-  0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69,
-  0x6f, 0x6e, 0x20, 0x64, 0x65, 0x6c, 0x65, 0x74, 0x65, 0x46, 0x69, 0x6c,
-  0x65, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24,
-  0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28, 0x7b, 0x20, 0x75, 0x72, 0x6c, 0x3a,
-  0x20, 0x22, 0x2f, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x2f, 0x3f, 0x64, 0x65,
-  0x6c, 0x65, 0x74, 0x65, 0x22, 0x2c, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x73, 0x75, 0x63, 0x63, 0x65, 0x73, 0x73, 0x3a,
-  0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65,
-  0x73, 0x29, 0x20, 0x7b, 0x20, 0x2f, 0x2f, 0x20, 0x52, 0x65, 0x74, 0x75,
-  0x72, 0x6e, 0x73, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x6f, 0x66, 0x20,
-  0x66, 0x69, 0x6c, 0x65, 0x73, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74,
-  0x61, 0x74, 0x65, 0x28, 0x7b, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x3a, 0x72,
-  0x65, 0x73, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x7d, 0x2c, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x3a, 0x20, 0x66, 0x75,
-  0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20,
-  0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29,
-  0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28,
+  0x7b, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x3a, 0x74,
+  0x72, 0x75, 0x65, 0x2c, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x5f, 0x70,
+  0x72, 0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x3a, 0x70, 0x65, 0x72, 0x63,
+  0x65, 0x6e, 0x74, 0x43, 0x6f, 0x6d, 0x70, 0x6c, 0x65, 0x74, 0x65, 0x7d,
+  0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x20, 0x65, 0x6c,
+  0x73, 0x65, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b,
+  0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x3a, 0x74, 0x72,
+  0x75, 0x65, 0x2c, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x5f, 0x70, 0x72,
+  0x6f, 0x67, 0x72, 0x65, 0x73, 0x73, 0x3a, 0x75, 0x6e, 0x64, 0x65, 0x66,
+  0x69, 0x6e, 0x65, 0x64, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x7d, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65,
+  0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
   0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65,
-  0x28, 0x7b, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x3a, 0x5b, 0x5d, 0x7d, 0x29,
-  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x73, 0x68, 0x6f, 0x77, 0x45, 0x72, 0x72, 0x6f, 0x72,
-  0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73,
-  0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63,
-  0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x46,
-  0x69, 0x6c, 0x65, 0x28, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x20, 0x7b,
-  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x65, 0x6c,
-  0x65, 0x6d, 0x20, 0x3d, 0x20, 0x24, 0x28, 0x22, 0x23, 0x66, 0x69, 0x6c,
-  0x65, 0x5f, 0x65, 0x6e, 0x74, 0x5f, 0x22, 0x2b, 0x69, 0x6e, 0x64, 0x65,
-  0x78, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x2e, 0x61,
-  0x6a, 0x61, 0x78, 0x28, 0x7b, 0x20, 0x75, 0x72, 0x6c, 0x3a, 0x20, 0x22,
-  0x2f, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x2f, 0x3f, 0x73, 0x65, 0x6c, 0x65,
-  0x63, 0x74, 0x3d, 0x22, 0x2b, 0x65, 0x6c, 0x65, 0x6d, 0x2e, 0x66, 0x69,
-  0x6e, 0x64, 0x28, 0x27, 0x2e, 0x6e, 0x27, 0x29, 0x2e, 0x74, 0x65, 0x78,
-  0x74, 0x28, 0x29, 0x2c, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x73, 0x75, 0x63, 0x63, 0x65, 0x73, 0x73, 0x3a, 0x20, 0x66,
-  0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x73, 0x29,
-  0x20, 0x7b, 0x20, 0x20, 0x2f, 0x2f, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72,
-  0x6e, 0x73, 0x20, 0x6c, 0x69, 0x73, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x66,
-  0x69, 0x6c, 0x65, 0x73, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61,
-  0x74, 0x65, 0x28, 0x7b, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x3a, 0x72, 0x65,
-  0x73, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x7d, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x3a, 0x20,
-  0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x71,
-  0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72,
-  0x72, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61,
-  0x74, 0x65, 0x28, 0x7b, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x3a, 0x5b, 0x5d,
-  0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x68, 0x6f, 0x77, 0x45, 0x72, 0x72,
-  0x6f, 0x72, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74,
-  0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x3b, 0x0d, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x20, 0x74, 0x69,
-  0x6d, 0x65, 0x6f, 0x75, 0x74, 0x3a, 0x20, 0x35, 0x30, 0x30, 0x30, 0x0d,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d,
-  0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x75, 0x70,
-  0x64, 0x61, 0x74, 0x65, 0x46, 0x69, 0x6c, 0x65, 0x73, 0x4c, 0x69, 0x73,
-  0x74, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x73,
-  0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x6c, 0x6f, 0x61,
-  0x64, 0x69, 0x6e, 0x67, 0x5f, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x3a, 0x20,
+  0x28, 0x7b, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x3a,
   0x74, 0x72, 0x75, 0x65, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28, 0x7b, 0x20, 0x75, 0x72,
-  0x6c, 0x3a, 0x20, 0x22, 0x2f, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x2f, 0x22,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x72, 0x65, 0x74,
+  0x75, 0x72, 0x6e, 0x20, 0x78, 0x68, 0x72, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x75, 0x72, 0x6c, 0x3a, 0x20, 0x27,
+  0x2f, 0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x27, 0x2c, 0x20, 0x64, 0x61,
+  0x74, 0x61, 0x3a, 0x20, 0x66, 0x64, 0x2c, 0x20, 0x70, 0x72, 0x6f, 0x63,
+  0x65, 0x73, 0x73, 0x44, 0x61, 0x74, 0x61, 0x3a, 0x20, 0x66, 0x61, 0x6c,
+  0x73, 0x65, 0x2c, 0x20, 0x63, 0x6f, 0x6e, 0x74, 0x65, 0x6e, 0x74, 0x54,
+  0x79, 0x70, 0x65, 0x3a, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x2c, 0x20,
+  0x74, 0x79, 0x70, 0x65, 0x3a, 0x20, 0x27, 0x50, 0x4f, 0x53, 0x54, 0x27,
   0x2c, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73,
   0x75, 0x63, 0x63, 0x65, 0x73, 0x73, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63,
-  0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x73, 0x29, 0x20, 0x7b, 0x0d,
+  0x74, 0x69, 0x6f, 0x6e, 0x28, 0x64, 0x61, 0x74, 0x61, 0x29, 0x20, 0x7b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b,
+  0x75, 0x70, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x3a, 0x66, 0x61,
+  0x6c, 0x73, 0x65, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x75, 0x70, 0x64, 0x61,
+  0x74, 0x65, 0x46, 0x69, 0x6c, 0x65, 0x73, 0x4c, 0x69, 0x73, 0x74, 0x28,
+  0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x7d, 0x2c, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x65, 0x72, 0x72, 0x6f, 0x72, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74,
+  0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61,
+  0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x20, 0x7b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x75,
+  0x70, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x3a, 0x66, 0x61, 0x6c,
+  0x73, 0x65, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x68, 0x6f, 0x77, 0x45,
+  0x72, 0x72, 0x6f, 0x72, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74,
+  0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x3b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a,
+  0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x64, 0x65, 0x6c,
+  0x65, 0x74, 0x65, 0x46, 0x69, 0x6c, 0x65, 0x28, 0x29, 0x20, 0x7b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28,
+  0x7b, 0x20, 0x75, 0x72, 0x6c, 0x3a, 0x20, 0x22, 0x2f, 0x66, 0x69, 0x6c,
+  0x65, 0x73, 0x2f, 0x3f, 0x64, 0x65, 0x6c, 0x65, 0x74, 0x65, 0x22, 0x2c,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x75,
+  0x63, 0x63, 0x65, 0x73, 0x73, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74,
+  0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x73, 0x29, 0x20, 0x7b, 0x20, 0x2f,
+  0x2f, 0x20, 0x52, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x6c, 0x69,
+  0x73, 0x74, 0x20, 0x6f, 0x66, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x0d,
   0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
   0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x66,
-  0x69, 0x6c, 0x65, 0x73, 0x3a, 0x72, 0x65, 0x73, 0x2c, 0x20, 0x6c, 0x6f,
-  0x61, 0x64, 0x69, 0x6e, 0x67, 0x5f, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x3a,
-  0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x20, 0x65, 0x72,
-  0x72, 0x6f, 0x72, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f,
-  0x6e, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75,
-  0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20,
+  0x69, 0x6c, 0x65, 0x73, 0x3a, 0x72, 0x65, 0x73, 0x7d, 0x29, 0x3b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x65, 0x72, 0x72,
+  0x6f, 0x72, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e,
+  0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73,
+  0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65,
+  0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x66, 0x69, 0x6c, 0x65,
+  0x73, 0x3a, 0x5b, 0x5d, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x68, 0x6f,
+  0x77, 0x45, 0x72, 0x72, 0x6f, 0x72, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20,
+  0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29,
+  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x7d,
+  0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73,
+  0x65, 0x6c, 0x65, 0x63, 0x74, 0x46, 0x69, 0x6c, 0x65, 0x28, 0x69, 0x6e,
+  0x64, 0x65, 0x78, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x6c, 0x65, 0x74, 0x20, 0x65, 0x6c, 0x65, 0x6d, 0x20, 0x3d, 0x20, 0x24,
+  0x28, 0x22, 0x23, 0x66, 0x69, 0x6c, 0x65, 0x5f, 0x65, 0x6e, 0x74, 0x5f,
+  0x22, 0x2b, 0x69, 0x6e, 0x64, 0x65, 0x78, 0x29, 0x3b, 0x0d, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28, 0x7b, 0x20,
+  0x75, 0x72, 0x6c, 0x3a, 0x20, 0x22, 0x2f, 0x66, 0x69, 0x6c, 0x65, 0x73,
+  0x2f, 0x3f, 0x73, 0x65, 0x6c, 0x65, 0x63, 0x74, 0x3d, 0x22, 0x2b, 0x65,
+  0x6c, 0x65, 0x6d, 0x2e, 0x66, 0x69, 0x6e, 0x64, 0x28, 0x27, 0x2e, 0x6e,
+  0x27, 0x29, 0x2e, 0x74, 0x65, 0x78, 0x74, 0x28, 0x29, 0x2c, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x75, 0x63, 0x63,
+  0x65, 0x73, 0x73, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f,
+  0x6e, 0x28, 0x72, 0x65, 0x73, 0x29, 0x20, 0x7b, 0x20, 0x20, 0x2f, 0x2f,
+  0x20, 0x52, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x73, 0x20, 0x6c, 0x69, 0x73,
+  0x74, 0x20, 0x6f, 0x66, 0x20, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x66, 0x69,
+  0x6c, 0x65, 0x73, 0x3a, 0x72, 0x65, 0x73, 0x7d, 0x29, 0x3b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x20, 0x65,
+  0x72, 0x72, 0x6f, 0x72, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69,
+  0x6f, 0x6e, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74,
+  0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x20, 0x7b, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x66, 0x69,
+  0x6c, 0x65, 0x73, 0x3a, 0x5b, 0x5d, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20,
   0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73,
-  0x65, 0x74, 0x53, 0x74, 0x61, 0x74, 0x65, 0x28, 0x7b, 0x66, 0x69, 0x6c,
-  0x65, 0x73, 0x3a, 0x5b, 0x5d, 0x2c, 0x20, 0x6c, 0x6f, 0x61, 0x64, 0x69,
-  0x6e, 0x67, 0x5f, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x3a, 0x20, 0x66, 0x61,
-  0x6c, 0x73, 0x65, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20,
-  0x65, 0x72, 0x72, 0x6f, 0x72, 0x20, 0x3d, 0x20, 0x4a, 0x53, 0x4f, 0x4e,
-  0x2e, 0x70, 0x61, 0x72, 0x73, 0x65, 0x28, 0x65, 0x72, 0x72, 0x2e, 0x72,
-  0x65, 0x73, 0x70, 0x6f, 0x6e, 0x73, 0x65, 0x54, 0x65, 0x78, 0x74, 0x29,
-  0x2e, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x27,
-  0x23, 0x66, 0x6c, 0x63, 0x27, 0x29, 0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28,
-  0x27, 0x3c, 0x64, 0x69, 0x76, 0x20, 0x63, 0x6c, 0x61, 0x73, 0x73, 0x3d,
-  0x22, 0x65, 0x72, 0x72, 0x22, 0x3e, 0x27, 0x2b, 0x65, 0x72, 0x72, 0x6f,
-  0x72, 0x2b, 0x27, 0x3c, 0x2f, 0x64, 0x69, 0x76, 0x3e, 0x27, 0x29, 0x3b,
-  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c,
-  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x74, 0x69,
-  0x6d, 0x65, 0x6f, 0x75, 0x74, 0x3a, 0x20, 0x35, 0x30, 0x30, 0x30, 0x0d,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d,
-  0x0a, 0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20,
-  0x73, 0x65, 0x6e, 0x64, 0x43, 0x6f, 0x6d, 0x6d, 0x61, 0x6e, 0x64, 0x28,
-  0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74,
-  0x20, 0x63, 0x6d, 0x70, 0x20, 0x3d, 0x20, 0x24, 0x28, 0x22, 0x23, 0x73,
-  0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d, 0x64, 0x22, 0x29, 0x3b, 0x0d, 0x0a,
-  0x20, 0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x63, 0x6d, 0x64, 0x20,
-  0x3d, 0x20, 0x63, 0x6d, 0x70, 0x2e, 0x76, 0x61, 0x6c, 0x28, 0x29, 0x0d,
-  0x0a, 0x20, 0x20, 0x20, 0x20, 0x63, 0x6d, 0x70, 0x2e, 0x76, 0x61, 0x6c,
-  0x28, 0x22, 0x22, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24,
-  0x28, 0x22, 0x23, 0x73, 0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d, 0x64, 0x5f,
-  0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27,
-  0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x74,
-  0x72, 0x75, 0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24,
-  0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28, 0x7b, 0x20, 0x75, 0x72, 0x6c, 0x3a,
-  0x20, 0x22, 0x2f, 0x70, 0x72, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x2f, 0x73,
-  0x65, 0x6e, 0x64, 0x3f, 0x63, 0x6d, 0x64, 0x3d, 0x22, 0x20, 0x2b, 0x20,
-  0x63, 0x6d, 0x64, 0x2c, 0x20, 0x73, 0x75, 0x63, 0x63, 0x65, 0x73, 0x73,
+  0x68, 0x6f, 0x77, 0x45, 0x72, 0x72, 0x6f, 0x72, 0x28, 0x72, 0x65, 0x71,
+  0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72,
+  0x72, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x7d, 0x2c, 0x20, 0x74, 0x69, 0x6d, 0x65, 0x6f, 0x75, 0x74, 0x3a,
+  0x20, 0x35, 0x30, 0x30, 0x30, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d,
+  0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x66, 0x75, 0x6e, 0x63, 0x74,
+  0x69, 0x6f, 0x6e, 0x20, 0x75, 0x70, 0x64, 0x61, 0x74, 0x65, 0x46, 0x69,
+  0x6c, 0x65, 0x73, 0x4c, 0x69, 0x73, 0x74, 0x28, 0x29, 0x20, 0x7b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74,
+  0x65, 0x28, 0x7b, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x5f, 0x66,
+  0x69, 0x6c, 0x65, 0x73, 0x3a, 0x20, 0x74, 0x72, 0x75, 0x65, 0x7d, 0x29,
+  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61,
+  0x78, 0x28, 0x7b, 0x20, 0x75, 0x72, 0x6c, 0x3a, 0x20, 0x22, 0x2f, 0x66,
+  0x69, 0x6c, 0x65, 0x73, 0x2f, 0x22, 0x2c, 0x0d, 0x0a, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x75, 0x63, 0x63, 0x65, 0x73, 0x73,
   0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72,
   0x65, 0x73, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x73,
-  0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d, 0x64, 0x5f, 0x62, 0x74, 0x6e, 0x22,
-  0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69, 0x73, 0x61,
-  0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74,
+  0x61, 0x74, 0x65, 0x28, 0x7b, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x3a, 0x72,
+  0x65, 0x73, 0x2c, 0x20, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x5f,
+  0x66, 0x69, 0x6c, 0x65, 0x73, 0x3a, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65,
+  0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x7d, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x3a, 0x20, 0x66,
+  0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x71, 0x2c,
+  0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72,
+  0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x65, 0x74, 0x53, 0x74, 0x61, 0x74,
+  0x65, 0x28, 0x7b, 0x66, 0x69, 0x6c, 0x65, 0x73, 0x3a, 0x5b, 0x5d, 0x2c,
+  0x20, 0x6c, 0x6f, 0x61, 0x64, 0x69, 0x6e, 0x67, 0x5f, 0x66, 0x69, 0x6c,
+  0x65, 0x73, 0x3a, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x7d, 0x29, 0x3b,
+  0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x20,
+  0x3d, 0x20, 0x4a, 0x53, 0x4f, 0x4e, 0x2e, 0x70, 0x61, 0x72, 0x73, 0x65,
+  0x28, 0x65, 0x72, 0x72, 0x2e, 0x72, 0x65, 0x73, 0x70, 0x6f, 0x6e, 0x73,
+  0x65, 0x54, 0x65, 0x78, 0x74, 0x29, 0x2e, 0x65, 0x72, 0x72, 0x6f, 0x72,
+  0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x24, 0x28, 0x27, 0x23, 0x66, 0x6c, 0x63, 0x27, 0x29,
+  0x2e, 0x68, 0x74, 0x6d, 0x6c, 0x28, 0x27, 0x3c, 0x64, 0x69, 0x76, 0x20,
+  0x63, 0x6c, 0x61, 0x73, 0x73, 0x3d, 0x22, 0x65, 0x72, 0x72, 0x22, 0x3e,
+  0x27, 0x2b, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x2b, 0x27, 0x3c, 0x2f, 0x64,
+  0x69, 0x76, 0x3e, 0x27, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x74, 0x69, 0x6d, 0x65, 0x6f, 0x75, 0x74, 0x3a,
+  0x20, 0x35, 0x30, 0x30, 0x30, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d,
+  0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a, 0x0d, 0x0a, 0x66, 0x75, 0x6e,
+  0x63, 0x74, 0x69, 0x6f, 0x6e, 0x20, 0x73, 0x65, 0x6e, 0x64, 0x43, 0x6f,
+  0x6d, 0x6d, 0x61, 0x6e, 0x64, 0x28, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20,
+  0x20, 0x20, 0x20, 0x6c, 0x65, 0x74, 0x20, 0x63, 0x6d, 0x70, 0x20, 0x3d,
+  0x20, 0x24, 0x28, 0x22, 0x23, 0x73, 0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d,
+  0x64, 0x22, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x6c, 0x65,
+  0x74, 0x20, 0x63, 0x6d, 0x64, 0x20, 0x3d, 0x20, 0x63, 0x6d, 0x70, 0x2e,
+  0x76, 0x61, 0x6c, 0x28, 0x29, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x63,
+  0x6d, 0x70, 0x2e, 0x76, 0x61, 0x6c, 0x28, 0x22, 0x22, 0x29, 0x3b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x73, 0x65, 0x6e,
+  0x64, 0x5f, 0x63, 0x6d, 0x64, 0x5f, 0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e,
+  0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c,
+  0x65, 0x64, 0x27, 0x2c, 0x20, 0x74, 0x72, 0x75, 0x65, 0x29, 0x3b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x24, 0x2e, 0x61, 0x6a, 0x61, 0x78, 0x28,
+  0x7b, 0x20, 0x75, 0x72, 0x6c, 0x3a, 0x20, 0x22, 0x2f, 0x70, 0x72, 0x69,
+  0x6e, 0x74, 0x65, 0x72, 0x2f, 0x73, 0x65, 0x6e, 0x64, 0x3f, 0x63, 0x6d,
+  0x64, 0x3d, 0x22, 0x20, 0x2b, 0x20, 0x63, 0x6d, 0x64, 0x2c, 0x20, 0x73,
+  0x75, 0x63, 0x63, 0x65, 0x73, 0x73, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63,
+  0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x73, 0x29, 0x20, 0x7b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x24, 0x28, 0x22, 0x23, 0x73, 0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d,
+  0x64, 0x5f, 0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70,
+  0x28, 0x27, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c,
+  0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x2c, 0x20, 0x65, 0x72, 0x72,
+  0x6f, 0x72, 0x3a, 0x20, 0x66, 0x75, 0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e,
+  0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73,
+  0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x73, 0x68,
+  0x6f, 0x77, 0x45, 0x72, 0x72, 0x6f, 0x72, 0x28, 0x72, 0x65, 0x71, 0x2c,
+  0x20, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72,
   0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x7d, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x3a, 0x20, 0x66, 0x75,
-  0x6e, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20,
-  0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29,
-  0x20, 0x7b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x73, 0x68, 0x6f, 0x77, 0x45, 0x72, 0x72, 0x6f,
-  0x72, 0x28, 0x72, 0x65, 0x71, 0x2c, 0x20, 0x73, 0x74, 0x61, 0x74, 0x75,
-  0x73, 0x2c, 0x20, 0x65, 0x72, 0x72, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x24, 0x28,
-  0x22, 0x23, 0x73, 0x65, 0x6e, 0x64, 0x5f, 0x63, 0x6d, 0x64, 0x5f, 0x62,
-  0x74, 0x6e, 0x22, 0x29, 0x2e, 0x70, 0x72, 0x6f, 0x70, 0x28, 0x27, 0x64,
-  0x69, 0x73, 0x61, 0x62, 0x6c, 0x65, 0x64, 0x27, 0x2c, 0x20, 0x66, 0x61,
-  0x6c, 0x73, 0x65, 0x29, 0x3b, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x20,
-  0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x29,
-  0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a
+  0x20, 0x20, 0x20, 0x20, 0x24, 0x28, 0x22, 0x23, 0x73, 0x65, 0x6e, 0x64,
+  0x5f, 0x63, 0x6d, 0x64, 0x5f, 0x62, 0x74, 0x6e, 0x22, 0x29, 0x2e, 0x70,
+  0x72, 0x6f, 0x70, 0x28, 0x27, 0x64, 0x69, 0x73, 0x61, 0x62, 0x6c, 0x65,
+  0x64, 0x27, 0x2c, 0x20, 0x66, 0x61, 0x6c, 0x73, 0x65, 0x29, 0x3b, 0x0d,
+  0x0a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x7d, 0x0d, 0x0a,
+  0x20, 0x20, 0x20, 0x20, 0x7d, 0x29, 0x3b, 0x0d, 0x0a, 0x7d, 0x0d, 0x0a
 };
-const int server_main_js_len = 7482;
+const int server_main_js_len = 10128;
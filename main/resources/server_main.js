@@ -18,6 +18,9 @@ $(window).on("load", function () {
     $("#send_cmd_btn").on("click", sendCommand);
     $("#upload_btn").on("click", function() { $("#upload_field").click(); });
     $("#print_btn").on("click", print);
+    $("#transfer_btn").on("click", transfer);
+    $("#queue_btn").on("click", queueAdd);
+    $("#queue_start_btn").on("click", queueStart);
     $("#delete_btn").on("click", deleteFile);
     $("#cmd_form").on("keypress", function(e) { if (e.keyCode === 13) { e.preventDefault(); $("#send_cmd_btn").click(); }});
 
@@ -48,23 +51,41 @@ function updateInterfaceAll() {
         else $("#progress").html("Uploading: <br/>" + Math.round(state().upload_progress) + '%');
     } else $("#blinder").css("display", "none");
 
-    if (state().printer.status === 'Printing') {
+    let busy = (state().printer.status === 'Printing') || (state().printer.status === 'Transferring');
+    if (busy) {
+        $('#print_progress_label').html((state().printer.status === 'Printing') ? 'Print progress:' : 'Copying to printer:');
         let bar = $('#print_progress_bar');
         let percent = Math.round(state().printer.progress * 100) + '%';
         bar.css('width', percent); bar.html(percent);
+        let remaining = state().printer.remaining;
+        let layers = state().printer.layers;
+        if (((remaining !== undefined) && (remaining >= 0)) || layers) {
+            let info = [];
+            if (layers) info.push('layer ' + (state().printer.layer + 1) + '/' + layers);
+            if ((remaining !== undefined) && (remaining >= 0)) {
+                info.push(Math.floor(remaining / 3600) + 'h ' + Math.floor((remaining % 3600) / 60) + 'm left');
+            }
+            $('#print_progress_label').html('Print progress, ' + info.join(', ') + ':');
+        }
         $('#print_progress').css('display', '');
     } else $('#print_progress').css('display', 'none');
 
-    if ((state().printer.status === 'Unknown') || (state().printer.status === 'Printing')) {
+    $("#queue_btn").prop('disabled', !state().has_selected);
+
+    if ((state().printer.status === 'Unknown') || busy) {
         $('#send_cmd_btn').prop('disabled', true);
         $('#send_cmd').prop('disabled', true);
         $('#print_btn').prop('disabled', true);
+        $('#transfer_btn').prop('disabled', true);
+        $('#queue_start_btn').prop('disabled', true);
     } else {
         $('#send_cmd_btn').prop('disabled', false);
         $('#send_cmd').prop('disabled', false);
         $("#print_btn").prop('disabled', !state().has_selected);
+        $("#transfer_btn").prop('disabled', !state().has_selected);
+        $("#queue_start_btn").prop('disabled', false);
     }
-    $("#delete_btn").prop('disabled', (!state().has_selected) || (state().printer.status === 'Printing'));
+    $("#delete_btn").prop('disabled', (!state().has_selected) || busy);
 
     storage.updated = false;
 }
@@ -77,6 +98,7 @@ function initStatusWS() {
 }
 function getStatusWS(event) {
     let status = JSON.parse(event.data);
+    if (status.printer !== undefined && status.printer !== 0) return;  // Page shows the first printer only
     setState({printer: status});
 }
 function print() {
@@ -86,6 +108,37 @@ function print() {
             showError(req, status, err);
         }});
 }
+function askResume(file) {
+    let action = confirm("Printing of '" + file + "' was interrupted. Resume it?\n" +
+        "Printer is heated, X and Y are homed, Z is not. Cancel to forget the job.") ? "resume" : "discard";
+    $.ajax({ url: "/printer/" + action, success: function(res) {
+            if (res.error) alert(res.error);
+        }, error: function(req, status, err) {
+            showError(req, status, err);
+        }});
+}
+function queueAdd() {
+    $.ajax({ url: "/printer/queue?add", success: function(res) {
+            if (res.error) alert(res.error);
+            else alert(res.jobs.length + " job(s) queued");
+        }, error: function(req, status, err) {
+            showError(req, status, err);
+        }});
+}
+function queueStart() {
+    $.ajax({ url: "/printer/queue?start", success: function(res) {
+            if (res.error) alert(res.error);
+        }, error: function(req, status, err) {
+            showError(req, status, err);
+        }});
+}
+function transfer() {
+    $.ajax({ url: "/printer/transfer", success: function(res) {
+            if (res.error) alert(res.error);
+        }, error: function(req, status, err) {
+            showError(req, status, err);
+        }});
+}
 function displayFiles() {
     let f_html = '';
     let has_selected = false;
@@ -122,6 +175,10 @@ function updatePrinterStatus() {
     clearInterval(storage.updatePrinterInt);
     $.ajax({ url: "/printer/status", success: function(res) {
         setState({printer: res});
+        if (res.recovery && !storage.recovery_asked) {
+            storage.recovery_asked = true;
+            askResume(res.recovery);
+        }
         storage.updatePrinterInt = setInterval(updatePrinterStatus, 1000);
     }, error: function(req, status, err) {
         storage.updatePrinterInt = setInterval(updatePrinterStatus, 1000);
@@ -0,0 +1,282 @@
+/*
+  arc_fitter.cpp - G1 runs to G2/G3 arcs
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+
+#include "arc_fitter.h"
+
+static const char TAG[] = "esp3d-arc-fitter";
+
+ArcFitter::ArcFitter(float tolerance) {
+    this->tolerance = tolerance;
+    enabled = false;
+    pool = (char *) heap_caps_malloc(ARC_POOL_SIZE, MALLOC_CAP_SPIRAM);
+    if (pool == nullptr) pool = (char *) heap_caps_malloc(ARC_POOL_SIZE, MALLOC_CAP_8BIT);
+    ArcFitter::reset();
+}
+
+ArcFitter::~ArcFitter() {
+    heap_caps_free(pool);
+}
+
+void ArcFitter::reset() {
+    for (float &p : pos) p = NAN;
+    pos[3] = 0;
+    relative = false;
+    relative_e = false;
+    count = 0;
+    pool_len = 0;
+    run_e = 0;
+    run_len = 0;
+    run_feedrate = NAN;
+    run_cx = run_cy = run_r = run_angle = 0;
+    moves_in = 0;
+    arcs_out = 0;
+    bytes_in = 0;
+    bytes_out = 0;
+    GcodeStage::reset();
+}
+
+/**
+ * Internal function.
+ * Appends a word with a number, with no trailing zeros.
+ * @return length of the word
+ */
+static int append_word(char *out, char letter, float value, int decimals) {
+    int len = sprintf(out, " %c%.*f", letter, decimals, value);
+    while (out[len - 1] == '0') len--;
+    if (out[len - 1] == '.') len--;
+    out[len] = 0;
+    if (strcmp(&out[2], "-0") == 0) {
+        out[2] = '0';
+        out[3] = 0;
+        len = 3;
+    }
+    return len;
+}
+
+/**
+ * Internal function.
+ * Tells if the run with one more move still lies on an arc. The circle goes through the run's
+ * ends and its middle point, then every move end and middle must be within tolerance from it,
+ * every move must turn the same way, and arc length must be about the length of moves, so
+ * extrusion rate stays the same.
+ * @param nx end of the next move
+ * @param ny
+ * @param len its length
+ */
+bool ArcFitter::fits(float nx, float ny, float len) {
+    uint8_t n = count + 1;
+    x[n] = nx;
+    y[n] = ny;
+
+    // Coordinates are taken relative to the start, so floats keep their precision
+    uint8_t m = n / 2;
+    float bx = x[m] - x[0], by = y[m] - y[0], cx = x[n] - x[0], cy = y[n] - y[0];
+    float d = 2 * (bx * cy - by * cx);
+    if (fabsf(d) < 1e-9f) return false;                 // Straight line
+    float b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+    float ux = (cy * b2 - by * c2) / d, uy = (bx * c2 - cx * b2) / d;
+    float r = hypotf(ux, uy);
+    if ((r < ARC_RADIUS_MIN) || (r > ARC_RADIUS_MAX)) return false;
+    float center_x = x[0] + ux, center_y = y[0] + uy;
+
+    float angle = 0;
+    for (uint8_t i = 0; i <= n; i++) {
+        if (fabsf(hypotf(x[i] - center_x, y[i] - center_y) - r) > tolerance) return false;
+        if (i == n) break;
+        float mx = (x[i] + x[i + 1]) / 2 - center_x, my = (y[i] + y[i + 1]) / 2 - center_y;
+        if (fabsf(hypotf(mx, my) - r) > tolerance) return false;
+        float ax = x[i] - center_x, ay = y[i] - center_y, ex = x[i + 1] - center_x, ey = y[i + 1] - center_y;
+        float a = atan2f(ax * ey - ay * ex, ax * ex + ay * ey);
+        if ((i > 0) && ((a > 0) != (angle > 0))) return false;     // Turns the other way
+        angle += a;
+    }
+    if (fabsf(angle) > 2 * (float) M_PI - 0.01f) return false;     // Full circle is ambiguous
+
+    float moves_len = run_len + len;
+    if (fabsf(fabsf(angle) * r - moves_len) > moves_len * ARC_EXTRUSION_TOLERANCE) return false;
+
+    run_cx = center_x;
+    run_cy = center_y;
+    run_r = r;
+    run_angle = angle;
+    return true;
+}
+
+/**
+ * Internal function.
+ * Adds a move to the run.
+ */
+void ArcFitter::add(const char *line, float nx, float ny, float e, float len, float feedrate) {
+    if (count == 0) {
+        x[0] = pos[0];
+        y[0] = pos[1];
+        run_e = 0;
+        run_len = 0;
+        run_feedrate = feedrate;
+        pool_len = 0;
+    }
+    size_t l = strlen(line);
+    memcpy(&pool[pool_len], line, l + 1);
+    line_start[count] = pool_len;
+    line_offset[count] = get_file_offset();
+    pool_len += l + 1;
+    count++;
+    x[count] = nx;
+    y[count] = ny;
+    run_e += e;
+    run_len += len;
+}
+
+/**
+ * Internal function.
+ * Sends the run, as an arc if it's long enough, or as moves it was made of.
+ */
+void ArcFitter::close_run() {
+    if (count >= ARC_SEGMENTS_MIN) emit_arc();
+    else for (uint8_t i = 0; i < count; i++) emit(&pool[line_start[i]], line_offset[i]);
+    count = 0;
+    pool_len = 0;
+}
+
+/**
+ * Internal function.
+ * Sends the run as one G2 or G3. Position is at the end of the run.
+ */
+void ArcFitter::emit_arc() {
+    char line[GCODE_LINE_MAX];
+    int len = sprintf(line, "G%d", (run_angle < 0) ? 2 : 3);
+    len += append_word(&line[len], 'X', x[count], 3);
+    len += append_word(&line[len], 'Y', y[count], 3);
+    len += append_word(&line[len], 'I', run_cx - x[0], 3);
+    len += append_word(&line[len], 'J', run_cy - y[0], 3);
+    if (run_e > 0) len += append_word(&line[len], 'E', relative_e ? run_e : pos[3], 5);
+    if (!std::isnan(run_feedrate)) len += append_word(&line[len], 'F', run_feedrate, 0);
+
+    // Pool has every line with its terminator, that's as long as lines with newlines
+    moves_in += count;
+    arcs_out++;
+    bytes_in += pool_len;
+    bytes_out += len + 1;
+    emit(line, line_offset[count - 1]);
+}
+
+/**
+ * Internal function.
+ * Follows position and modes with a line which is not a part of any run.
+ */
+void ArcFitter::track(const char *line) {
+    int code = atoi(&line[1]);
+    if (line[0] == 'M') {
+        if (code == 82) relative_e = false;
+        else if (code == 83) relative_e = true;
+        return;
+    }
+    if (line[0] != 'G') return;
+    if (code == 90) relative = false;
+    else if (code == 91) relative = true;
+    else if (((code >= 0) && (code <= 3)) || (code == 28) || (code == 92)) {
+        bool axes = false;
+        for (const char *p = strchr(line, ' '); p != nullptr; p = strchr(p + 1, ' ')) {
+            const char *letter = strchr("XYZE", p[1]);
+            if ((letter == nullptr) || (p[1] == 0)) continue;
+            int i = (int) (letter - "XYZE");
+            float value = strtof(&p[2], nullptr);
+            axes = true;
+            if (code == 28) pos[i] = NAN;               // Homed axis is somewhere near its end
+            else if (code == 92) pos[i] = value;
+            else pos[i] = (((i == 3) ? relative_e : relative) ? pos[i] + value : value);
+        }
+        if ((code == 28) && !axes) pos[0] = pos[1] = pos[2] = NAN;
+    }
+}
+
+/**
+ * Line is expected to be canonical.
+ */
+void ArcFitter::process(char *line) {
+    // Run is made of 'G1' moves with X or Y, maybe E and F, and Z only if it stays the same
+    if (enabled && (pool != nullptr) && !relative && (strncmp(line, "G1 ", 3) == 0)) {
+        float v[4] = { NAN, NAN, NAN, NAN }, feedrate = NAN;
+        bool other = false;
+        for (const char *p = strchr(line, ' '); p != nullptr; p = strchr(p + 1, ' ')) {
+            float value = strtof(&p[2], nullptr);
+            switch (p[1]) {
+                case 'X': v[0] = value; break;
+                case 'Y': v[1] = value; break;
+                case 'Z': v[2] = value; break;
+                case 'E': v[3] = value; break;
+                case 'F': feedrate = value; break;
+                default: other = true; break;
+            }
+        }
+        float nx = std::isnan(v[0]) ? pos[0] : v[0], ny = std::isnan(v[1]) ? pos[1] : v[1];
+        float e = std::isnan(v[3]) ? 0 : (relative_e ? v[3] : v[3] - pos[3]);
+        float len = hypotf(nx - pos[0], ny - pos[1]);
+        bool move = !other && (!std::isnan(v[0]) || !std::isnan(v[1])) && !std::isnan(pos[0]) &&
+                !std::isnan(pos[1]) && (std::isnan(v[2]) || (v[2] == pos[2])) && !std::isnan(e) && (e >= 0) &&
+                (len > 0);
+        if (move) {
+            bool same_run = (count > 0) && (count < ARC_SEGMENTS_MAX) &&
+                    (pool_len + strlen(line) + 1 <= ARC_POOL_SIZE) &&
+                    (std::isnan(feedrate) || (feedrate == run_feedrate)) && ((e > 0) == (run_e > 0));
+            if (same_run && (e > 0)) {
+                float rate = run_e / run_len;
+                same_run = fabsf(e / len - rate) <= rate * ARC_EXTRUSION_TOLERANCE;
+            }
+            if (same_run) same_run = fits(nx, ny, len);
+            if (!same_run) close_run();
+            add(line, nx, ny, e, len, feedrate);
+            pos[0] = nx;
+            pos[1] = ny;
+            if (!std::isnan(v[3])) pos[3] = relative_e ? pos[3] + v[3] : v[3];
+            return;
+        }
+    }
+    close_run();
+    track(line);
+    emit(line);
+}
+
+void ArcFitter::flush() {
+    close_run();
+    if (moves_in > 0) {
+        ESP_LOGI(TAG, "%lu move(s) sent as %lu arc(s): %lu command(s) and %lu bytes less",
+                 (unsigned long) moves_in, (unsigned long) arcs_out, (unsigned long) get_commands_saved(),
+                 (unsigned long) get_bytes_saved());
+    }
+    GcodeStage::flush();
+}
+
+/**
+ * Arcs are only sent to printer which reported it can do them, G-code passes as it is till then.
+ * Run being held back is sent with the next line after it's disabled.
+ * @param enable
+ */
+void ArcFitter::set_enabled(bool enable) { enabled = enable; }
+
+uint32_t ArcFitter::get_commands_saved() const { return moves_in - arcs_out; }
+uint32_t ArcFitter::get_bytes_saved() const { return (bytes_in > bytes_out) ? bytes_in - bytes_out : 0; }
@@ -0,0 +1,89 @@
+/*
+  arc_fitter.h - G1 runs to G2/G3 arcs
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_ARC_FITTER_H
+#define ESP32_PRINT_ARC_FITTER_H
+
+#include <cstdint>
+
+#include "gcode_pipeline.h"
+
+#define ARC_SEGMENTS_MIN        3       // Fewer moves are sent as they are
+#define ARC_SEGMENTS_MAX        48      // Moves one arc may replace
+#define ARC_POOL_SIZE           4096    // bytes, moves held back till it's known if they make an arc
+#define ARC_RADIUS_MIN          0.5f    // mm
+#define ARC_RADIUS_MAX          1000.0f // mm, flatter runs are as good as straight lines
+#define ARC_EXTRUSION_TOLERANCE 0.05f   // Extrusion per mm may differ that much along one arc
+
+/**
+ * Replaces runs of short G1 moves which lie on a circle with one G2/G3 arc (Marlin ARC_SUPPORT),
+ * so printer gets fewer lines. Moves of a run are on the same height, with the same feed rate,
+ * and either all extrude at about the same rate per mm or none does. Every move end and middle
+ * is within tolerance from the arc, so the arc does not differ from moves by more than that.
+ * Lines are expected to be canonical, arcs are fitted in absolute XY mode only.
+ */
+class ArcFitter : public GcodeStage {
+private:
+    float tolerance;                // mm
+    bool enabled;
+    float pos[4]{};                 // X, Y, Z, E, NAN if it's unknown
+    bool relative;                  // G91
+    bool relative_e;                // M83
+
+    // Run of moves held back, point 0 is where run starts
+    uint8_t count;
+    float x[ARC_SEGMENTS_MAX + 1]{};
+    float y[ARC_SEGMENTS_MAX + 1]{};
+    float run_e;                    // Extruded by run, mm
+    float run_len;                  // mm
+    float run_feedrate;             // F of the first move, NAN if it has none
+    float run_cx, run_cy, run_r;    // Circle run fits to
+    float run_angle;                // Its sweep, signed, counterclockwise is positive
+    char *pool;                     // Lines of moves
+    uint16_t pool_len;
+    uint16_t line_start[ARC_SEGMENTS_MAX]{};
+    uint32_t line_offset[ARC_SEGMENTS_MAX]{};
+
+    // Per job statistics
+    uint32_t moves_in;
+    uint32_t arcs_out;
+    uint32_t bytes_in;
+    uint32_t bytes_out;
+
+    bool fits(float nx, float ny, float len);
+    void add(const char *line, float nx, float ny, float e, float len, float feedrate);
+    void close_run();
+    void emit_arc();
+    void track(const char *line);
+
+public:
+    explicit ArcFitter(float tolerance);
+    ~ArcFitter() override;
+
+    void process(char *line) override;
+    void flush() override;
+    void reset() override;
+
+    void set_enabled(bool enable);
+    [[nodiscard]] uint32_t get_commands_saved() const;
+    [[nodiscard]] uint32_t get_bytes_saved() const;
+};
+
+#endif //ESP32_PRINT_ARC_FITTER_H
@@ -0,0 +1,327 @@
+/*
+  binary_transfer.cpp - Marlin binary file transfer protocol
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <esp_log.h>
+#include <freertos/task.h>
+
+#include "binary_transfer.h"
+
+#define COMMAND_BINARY_MODE     "M28 B1\n"
+
+static const char TAG[] = "esp3d-binary-transfer";
+
+BinaryTransfer::BinaryTransfer(SerialPort *uart) {
+    this->uart = uart;
+    file = nullptr;
+    file_size = 0;
+    bytes_sent = 0;
+    running = false;
+    abort_requested = false;
+    done_callback = nullptr;
+    done_context = nullptr;
+    sync = 0;
+    block_size = BINARY_BLOCK_MAX;
+    packet = nullptr;
+    binary_mode = false;
+    responses = nullptr;
+    task_handle = nullptr;
+}
+
+esp_err_t BinaryTransfer::init() {
+    packet = (uint8_t *) malloc(BINARY_HEADER_SIZE + BINARY_BLOCK_MAX + BINARY_FOOTER_SIZE);
+    responses = xQueueCreate(BINARY_RESPONSE_QUEUE_SIZE, BINARY_RESPONSE_LENGTH);
+    if ((packet == nullptr) || (responses == nullptr)) return ESP_ERR_NO_MEM;
+    if (xTaskCreate(BinaryTransfer::task, "binary_transfer", BINARY_TASK_STACK_SIZE, this, tskIDLE_PRIORITY + 1,
+                    &task_handle) != pdPASS) return ESP_FAIL;
+    return ESP_OK;
+}
+
+/**
+ * Starts copying a file to printer. File is closed when it's done.
+ * @param f
+ * @param target_name file name on printer's SD card
+ * @param callback called from transfer task when transfer is over
+ * @param context passed to callback
+ * @return ESP_FAIL if other transfer is running
+ */
+esp_err_t BinaryTransfer::start(FILE *f, const char *target_name, void (*callback)(bool success, void *context),
+                                void *context) {
+    if (running || (task_handle == nullptr)) return ESP_FAIL;
+    fseek(f, 0, SEEK_END);              // Determine file size
+    file_size = ftell(f);
+    rewind(f);
+    strncpy(name, target_name, BINARY_NAME_LENGTH - 1);
+    name[BINARY_NAME_LENGTH - 1] = 0;
+    file = f;
+    bytes_sent = 0;
+    abort_requested = false;
+    done_callback = callback;
+    done_context = context;
+    running = true;
+    xTaskNotifyGive(task_handle);
+    return ESP_OK;
+}
+
+void BinaryTransfer::abort() {
+    if (running) abort_requested = true;
+}
+
+/**
+ * Task function. Waits for a transfer to start and runs it.
+ * @param args
+ */
+[[noreturn]] void BinaryTransfer::task(void *args) {
+    auto t = (BinaryTransfer *) args;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        bool success = t->transfer();
+        fclose(t->file);
+        t->file = nullptr;
+        t->running = false;
+        if (t->done_callback != nullptr) t->done_callback(success, t->done_context);
+    }
+}
+
+/**
+ * Internal function.
+ * Runs the whole transfer: switches printer to binary protocol, sends the file block by block
+ * and switches printer back to G-code.
+ * @return true if file was copied
+ */
+bool BinaryTransfer::transfer() {
+    ESP_LOGI(TAG, "Copying %s (%lu bytes) to printer", name, (unsigned long) file_size);
+    bool success = connect();
+    if (success) {
+        file_result[0] = 0;
+        uint8_t open[2 + BINARY_NAME_LENGTH] = { 0, 0 };   // Not a dummy transfer, no compression
+        size_t name_len = strlen(name);
+        memcpy(&open[2], name, name_len + 1);
+        success = send_packet(BINARY_PROTOCOL_FILE_TRANSFER, BINARY_FILE_OPEN, open, 2 + name_len + 1) &&
+                  wait_file_result("PFT:success");
+        if (!success) ESP_LOGE(TAG, "Printer can't open %s for writing", name);
+    }
+
+    // Blocks are read right into packet buffer, so they're not copied
+    while (success && !abort_requested) {
+        size_t len = fread(&packet[BINARY_HEADER_SIZE], 1, block_size, file);
+        if (len == 0) {
+            success = !ferror(file);
+            break;
+        }
+        success = send_packet(BINARY_PROTOCOL_FILE_TRANSFER, BINARY_FILE_WRITE, &packet[BINARY_HEADER_SIZE], len);
+        if (file_result[0] != 0) {     // Printer says something on writes only when it fails
+            ESP_LOGE(TAG, "Printer failed to write: %s", file_result);
+            success = false;
+        }
+        if (success) bytes_sent = bytes_sent + len;
+    }
+
+    if (binary_mode) {
+        file_result[0] = 0;
+        if (success && !abort_requested) {
+            success = send_packet(BINARY_PROTOCOL_FILE_TRANSFER, BINARY_FILE_CLOSE) && wait_file_result("PFT:success");
+        } else {
+            if (abort_requested) ESP_LOGI(TAG, "Transfer aborted");
+            send_packet(BINARY_PROTOCOL_FILE_TRANSFER, BINARY_FILE_ABORT);
+            success = false;
+        }
+    }
+    disconnect();
+
+    ESP_LOGI(TAG, "Copying %s %s, %lu bytes sent", name, success ? "done" : "failed", (unsigned long) bytes_sent);
+    return success;
+}
+
+/**
+ * Internal function.
+ * Waits until printer confirms everything it got, then switches it to binary protocol (M28 B1)
+ * and synchronizes packet numbers.
+ * @return true if printer is ready to get packets
+ */
+bool BinaryTransfer::connect() {
+    uart->hold(true);
+    for (int i = 0; uart->get_in_flight() > 0; i++) {
+        if (i >= BINARY_CONNECT_TIMEOUT / 10) {
+            ESP_LOGE(TAG, "Printer does not confirm commands, can't start transfer");
+            return false;
+        }
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+
+    xQueueReset(responses);
+    uart->set_raw_handler(BinaryTransfer::response_handler, this);
+    uart->write_raw(COMMAND_BINARY_MODE, strlen(COMMAND_BINARY_MODE));
+    char response[BINARY_RESPONSE_LENGTH];
+    do {
+        if (!wait_response(response, pdMS_TO_TICKS(BINARY_RESPONSE_TIMEOUT))) {
+            ESP_LOGE(TAG, "Printer did not switch to binary protocol");
+            return false;
+        }
+    } while ((strncmp(response, "ok", 2) != 0) || isdigit(response[2]));
+    binary_mode = true;
+
+    // Sync packet is accepted whatever packet number printer expects, it answers with ss<sync>,<block size>,<version>
+    for (int retry = 0; retry < BINARY_RETRIES; retry++) {
+        size_t len = build_packet(BINARY_PROTOCOL_CONTROL, BINARY_CONTROL_SYNC, nullptr, 0);
+        uart->write_raw(packet, len);
+        while (wait_response(response, pdMS_TO_TICKS(BINARY_RESPONSE_TIMEOUT))) {
+            unsigned int printer_sync, printer_block_size;
+            if ((strncmp(response, "ss", 2) == 0) &&
+                    (sscanf(&response[2], "%u,%u", &printer_sync, &printer_block_size) == 2)) {
+                sync = printer_sync;
+                block_size = (printer_block_size < BINARY_BLOCK_MAX) ? printer_block_size : BINARY_BLOCK_MAX;
+                ESP_LOGI(TAG, "Binary protocol synchronized, packet %d, block size %d", sync, block_size);
+
+                file_result[0] = 0;
+                return send_packet(BINARY_PROTOCOL_FILE_TRANSFER, BINARY_FILE_QUERY) &&
+                       wait_file_result("PFT:version:");
+            }
+        }
+    }
+    ESP_LOGE(TAG, "Printer does not answer binary protocol sync");
+    return false;
+}
+
+/**
+ * Internal function.
+ * Switches printer back to G-code and resumes command queues.
+ */
+void BinaryTransfer::disconnect() {
+    if (binary_mode) send_packet(BINARY_PROTOCOL_CONTROL, BINARY_CONTROL_CLOSE);
+    binary_mode = false;
+    uart->set_raw_handler(nullptr, nullptr);
+    uart->hold(false);
+}
+
+/**
+ * Internal function.
+ * Fletcher-16 like checksum Marlin uses, sums are modulo 255.
+ */
+uint16_t BinaryTransfer::checksum(uint16_t cs, uint8_t value) {
+    uint16_t cs_low = ((cs & 0xff) + value) % 255;
+    return ((((cs >> 8) + cs_low) % 255) << 8) | cs_low;
+}
+
+/**
+ * Internal function.
+ * Builds a packet with current packet number in packet buffer. Header and packet checksums
+ * do not include token, packet checksum goes on from the header one over header checksum and data.
+ * @param data may point right to packet data in packet buffer
+ * @return packet size
+ */
+size_t BinaryTransfer::build_packet(uint8_t protocol, uint8_t type, const uint8_t *data, uint16_t len) {
+    packet[0] = BINARY_TOKEN & 0xff;
+    packet[1] = BINARY_TOKEN >> 8;
+    packet[2] = sync;
+    packet[3] = (protocol << 4) | (type & 0x0f);
+    packet[4] = len & 0xff;
+    packet[5] = len >> 8;
+    uint16_t cs = 0;
+    for (int i = 2; i < 6; i++) cs = checksum(cs, packet[i]);
+    packet[6] = cs & 0xff;
+    packet[7] = cs >> 8;
+    if (len == 0) return BINARY_HEADER_SIZE;
+
+    if (data != &packet[BINARY_HEADER_SIZE]) memcpy(&packet[BINARY_HEADER_SIZE], data, len);
+    for (int i = 6; i < BINARY_HEADER_SIZE + len; i++) cs = checksum(cs, packet[i]);
+    packet[BINARY_HEADER_SIZE + len] = cs & 0xff;
+    packet[BINARY_HEADER_SIZE + len + 1] = cs >> 8;
+    return BINARY_HEADER_SIZE + len + BINARY_FOOTER_SIZE;
+}
+
+/**
+ * Internal function.
+ * Sends a packet and waits until printer confirms it with ok<sync>. Packet is sent again
+ * if printer asks for it (rs<sync>) or does not answer.
+ * @return true if packet was confirmed
+ */
+bool BinaryTransfer::send_packet(uint8_t protocol, uint8_t type, const uint8_t *data, uint16_t len) {
+    size_t size = build_packet(protocol, type, data, len);
+    char response[BINARY_RESPONSE_LENGTH];
+    for (int retry = 0; retry < BINARY_RETRIES; retry++) {
+        uart->write_raw(packet, size);
+        while (wait_response(response, pdMS_TO_TICKS(BINARY_RESPONSE_TIMEOUT))) {
+            if ((strncmp(response, "ok", 2) == 0) && isdigit(response[2])) {
+                // Confirmation of a packet sent before may come late, it's not ours
+                if (strtoul(&response[2], nullptr, 10) == sync) {
+                    sync++;
+                    return true;
+                }
+            } else if (strncmp(response, "rs", 2) == 0) break;
+            else if (strncmp(response, "fe", 2) == 0) {
+                ESP_LOGE(TAG, "Printer gave up receiving packet %d", sync);
+                return false;
+            } else if (strncmp(response, "PFT:", 4) == 0) strcpy(file_result, response);
+        }
+        ESP_LOGW(TAG, "Re-sending packet %d", sync);
+    }
+    return false;
+}
+
+/**
+ * Internal function.
+ * Waits for file transfer result which follows packet confirmation.
+ * @param expected result prefix
+ * @return true if printer answered with expected result
+ */
+bool BinaryTransfer::wait_file_result(const char *expected) {
+    char response[BINARY_RESPONSE_LENGTH];
+    while (file_result[0] == 0) {
+        if (!wait_response(response, pdMS_TO_TICKS(BINARY_RESPONSE_TIMEOUT))) return false;
+        if (strncmp(response, "PFT:", 4) == 0) strcpy(file_result, response);
+    }
+    bool res = strncmp(file_result, expected, strlen(expected)) == 0;
+    if (!res) ESP_LOGE(TAG, "Printer answered %s", file_result);
+    return res;
+}
+
+bool BinaryTransfer::wait_response(char *response, TickType_t timeout) {
+    return xQueueReceive(responses, response, timeout) == pdTRUE;
+}
+
+/**
+ * Internal function.
+ * Called by UART receiving task for every line while transfer is running. Takes binary protocol
+ * responses, everything else (i.e. temperature reports) goes to printer as usual.
+ */
+bool BinaryTransfer::response_handler(const char *line, size_t len, void *context) {
+    auto t = (BinaryTransfer *) context;
+    if ((strncmp(line, "ok", 2) != 0) && (strncmp(line, "rs", 2) != 0) && (strncmp(line, "ss", 2) != 0) &&
+        (strncmp(line, "fe", 2) != 0) && (strncmp(line, "PFT:", 4) != 0)) return false;
+
+    char response[BINARY_RESPONSE_LENGTH];
+    if (len >= BINARY_RESPONSE_LENGTH) len = BINARY_RESPONSE_LENGTH - 1;
+    memcpy(response, line, len);
+    response[len] = 0;
+    if (xQueueSend(t->responses, response, 0) != pdTRUE) ESP_LOGW(TAG, "Response '%s' dropped", response);
+    return true;
+}
+
+bool BinaryTransfer::is_running() const { return running; }
+float BinaryTransfer::get_progress() const {
+    return (file_size != 0) ? (float) bytes_sent / (float) file_size : 0;
+}
+
+BinaryTransfer::~BinaryTransfer() {
+    free(packet);
+}
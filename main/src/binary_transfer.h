@@ -0,0 +1,95 @@
+/*
+  binary_transfer.h - Marlin binary file transfer protocol
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_BINARY_TRANSFER_H
+#define ESP32_PRINT_BINARY_TRANSFER_H
+
+#include <cstdio>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#include "uart.h"
+
+#define BINARY_TOKEN                0xB5AD
+#define BINARY_HEADER_SIZE          8       // Token, sync, protocol and type, size, header checksum
+#define BINARY_FOOTER_SIZE          2       // Packet checksum
+#define BINARY_BLOCK_MAX            512     // bytes, printer may ask for smaller blocks
+#define BINARY_NAME_LENGTH          64
+#define BINARY_RESPONSE_LENGTH      48
+#define BINARY_RESPONSE_QUEUE_SIZE  8
+#define BINARY_RESPONSE_TIMEOUT     1000    // ms
+#define BINARY_RETRIES              10
+#define BINARY_CONNECT_TIMEOUT      10000   // ms to wait for printer to confirm commands sent before transfer
+#define BINARY_TASK_STACK_SIZE      4096    // bytes
+
+enum BinaryProtocol { BINARY_PROTOCOL_CONTROL, BINARY_PROTOCOL_FILE_TRANSFER };
+enum BinaryControl { BINARY_CONTROL_SYNC = 1, BINARY_CONTROL_CLOSE = 2 };
+enum BinaryFileTransfer { BINARY_FILE_QUERY, BINARY_FILE_OPEN, BINARY_FILE_CLOSE, BINARY_FILE_WRITE,
+                          BINARY_FILE_ABORT };
+
+/**
+ * Copies a file to printer's SD card with Marlin's BINARY_FILE_TRANSFER protocol. Printer answers each
+ * packet before it gets the next one, so packets go one at a time. Files are sent uncompressed.
+ */
+class BinaryTransfer {
+private:
+    SerialPort *uart;
+    FILE *file;
+    char name[BINARY_NAME_LENGTH]{};
+    volatile uint32_t file_size;
+    volatile uint32_t bytes_sent;
+    volatile bool running;
+    volatile bool abort_requested;
+    void (*done_callback)(bool success, void *context);
+    void *done_context;
+
+    uint8_t sync;
+    uint16_t block_size;
+    uint8_t *packet;
+    bool binary_mode;                               // Printer was switched to binary protocol
+    QueueHandle_t responses;
+    TaskHandle_t task_handle;
+    char file_result[BINARY_RESPONSE_LENGTH]{};     // Last 'PFT:' response
+
+    static uint16_t checksum(uint16_t cs, uint8_t value);
+    size_t build_packet(uint8_t protocol, uint8_t type, const uint8_t *data, uint16_t len);
+    bool send_packet(uint8_t protocol, uint8_t type, const uint8_t *data = nullptr, uint16_t len = 0);
+    bool wait_file_result(const char *expected);
+    bool wait_response(char *response, TickType_t timeout);
+    bool connect();
+    void disconnect();
+    bool transfer();
+
+    static bool response_handler(const char *line, size_t len, void *context);
+    [[noreturn]] static void task(void *args);
+
+public:
+    explicit BinaryTransfer(SerialPort *uart);
+    ~BinaryTransfer();
+
+    esp_err_t init();
+    esp_err_t start(FILE *f, const char *target_name, void (*callback)(bool success, void *context), void *context);
+    void abort();
+
+    [[nodiscard]] bool is_running() const;
+    [[nodiscard]] float get_progress() const;
+};
+
+#endif //ESP32_PRINT_BINARY_TRANSFER_H
@@ -0,0 +1,105 @@
+/*
+  capabilities.cpp - printer firmware capabilities
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cstdio>
+#include <cstring>
+
+#include "capabilities.h"
+#include "utils.h"
+
+static const struct {
+    const char *name;
+    bool printer_caps_t::*flag;
+} caps_names[] = {
+        { "AUTOREPORT_TEMP", &printer_caps_t::autoreport_temp },
+        { "AUTOREPORT_POS", &printer_caps_t::autoreport_pos },
+        { "EMERGENCY_PARSER", &printer_caps_t::emergency_parser },
+        { "BINARY_FILE_TRANSFER", &printer_caps_t::binary_file_transfer },
+        { "EXTENDED_M20", &printer_caps_t::extended_m20 },
+        { "SERIAL_XON_XOFF", &printer_caps_t::serial_xon_xoff },
+        { "ARC_SUPPORT", &printer_caps_t::arc_support },
+        { "PROGRESS", &printer_caps_t::progress },
+};
+
+// Keys which may follow firmware name, Prusa firmware has FIRMWARE_URL instead of SOURCE_CODE_URL
+static const char *caps_name_ends[] = { " SOURCE_CODE_URL:", " FIRMWARE_URL:", " PROTOCOL_VERSION:" };
+
+/**
+ * Parses a line of M115 answer, which looks like this:
+ * FIRMWARE_NAME:Marlin 2.1.2 (Jan 1 2023 12:00:00) SOURCE_CODE_URL:github.com/MarlinFirmware/Marlin ...
+ * Cap:AUTOREPORT_TEMP:1
+ * Cap:EMERGENCY_PARSER:1
+ * It depends on nothing but its arguments, so it can be fed with any recorded printer output.
+ * @param line
+ * @param caps capabilities to update
+ * @return true if line is a part of M115 answer
+ */
+bool caps_parse_line(const char *line, printer_caps_t *caps) {
+    if (strncmp(line, "FIRMWARE_NAME:", 14) == 0) {
+        *caps = {};
+        caps->received = true;
+        const char *name = &line[14];
+        size_t len = strlen(name);
+        for (const char *key : caps_name_ends) {
+            const char *end = strstr(name, key);
+            if ((end != nullptr) && ((size_t) (end - name) < len)) len = end - name;
+        }
+        if (len >= CAPS_FIRMWARE_NAME_LENGTH) len = CAPS_FIRMWARE_NAME_LENGTH - 1;
+        memcpy(caps->firmware_name, name, len);
+        caps->firmware_name[len] = 0;
+        return true;
+    }
+
+    if (strncmp(line, "Cap:", 4) != 0) return false;
+    const char *name = &line[4];
+    const char *value = strchr(name, ':');
+    if (value == nullptr) return true;
+    for (auto &cap : caps_names) {
+        size_t len = strlen(cap.name);
+        if ((len == (size_t) (value - name)) && (strncmp(name, cap.name, len) == 0)) {
+            caps->*cap.flag = (value[1] == '1');
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * Writes capabilities as JSON object.
+ * @param caps
+ * @param str
+ * @param size size of str buffer, CAPS_JSON_SIZE fits any capabilities
+ * @return JSON length or 0 if it did not fit, str is empty then
+ */
+size_t caps_to_json(const printer_caps_t *caps, char *str, size_t size) {
+    char name[CAPS_FIRMWARE_NAME_LENGTH * 6];
+    json_escape(name, sizeof(name), caps->firmware_name);
+    size_t pos = snprintf(str, size, R"({"received":%s,"firmware":"%s")", caps->received ? "true" : "false", name);
+    for (auto &cap : caps_names) {
+        if (pos >= size) break;
+        pos += snprintf(&str[pos], size - pos, R"(,"%s":%s)", cap.name, (caps->*cap.flag) ? "true" : "false");
+    }
+    if (pos < size) pos += snprintf(&str[pos], size - pos, "}");
+    if (pos >= size) {
+        if (size > 0) str[0] = 0;
+        return 0;
+    }
+    return pos;
+}
@@ -0,0 +1,48 @@
+/*
+  capabilities.h - printer firmware capabilities
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_CAPABILITIES_H
+#define ESP32_PRINT_CAPABILITIES_H
+
+#include <cstddef>
+
+#define CAPS_FIRMWARE_NAME_LENGTH   64
+#define CAPS_JSON_SIZE              768     // Fits every capability and firmware name escaped
+
+/**
+ * Firmware capabilities reported in answer to M115. Capabilities printer does not report are off.
+ */
+typedef struct {
+    bool received;              // Printer answered M115
+    char firmware_name[CAPS_FIRMWARE_NAME_LENGTH];
+    bool autoreport_temp;       // M155
+    bool autoreport_pos;        // M154
+    bool emergency_parser;      // M108, M112, M410 are handled as soon as they are received
+    bool binary_file_transfer;  // M28 B1
+    bool extended_m20;          // M20 L, M20 T
+    bool serial_xon_xoff;
+    bool arc_support;           // G2, G3
+    bool progress;              // M73
+} printer_caps_t;
+
+bool caps_parse_line(const char *line, printer_caps_t *caps);
+size_t caps_to_json(const printer_caps_t *caps, char *str, size_t size);
+
+#endif //ESP32_PRINT_CAPABILITIES_H
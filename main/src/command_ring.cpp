@@ -0,0 +1,215 @@
+/*
+  command_ring.cpp - lock-free command ring buffer
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "command_ring.h"
+
+#define COMMAND_ENTRY_ALIGN     4
+
+CommandRing::CommandRing(uint32_t size) {
+    this->size = size;
+    this->buffer = (char *) calloc(size, 1);  // Zeroed, so there's no ready entries
+    head = 0;
+    confirmed = 0;
+    tail = 0;
+    count = 0;
+}
+
+CommandRing::~CommandRing() {
+    free(buffer);
+}
+
+command_entry_t *CommandRing::entry_at(uint32_t pos) const {
+    return (command_entry_t *) &buffer[pos & (size - 1)];
+}
+
+/**
+ * Internal function.
+ * Gets full entry size for a command of given length, including header and zero terminator.
+ */
+uint32_t CommandRing::entry_size(uint32_t len) {
+    uint32_t s = sizeof(command_entry_t) + len + 1;
+    return (s + COMMAND_ENTRY_ALIGN - 1) & ~(COMMAND_ENTRY_ALIGN - 1);
+}
+
+/**
+ * Adds a command to the ring. May be called from any task. Space is reserved first and then
+ * filled in, so producers never wait for each other. Newline is added if command has none.
+ * @param command
+ * @param source where command came from
+ * @param file_offset position in printed file right after the command
+ * @param checksum XOR of command bytes if it's known, -1 otherwise
+ * @return true if added or false if there's no room
+ */
+bool CommandRing::push(const char *command, uint8_t source, uint32_t file_offset, int16_t checksum) {
+    size_t len = strlen(command);
+    bool add_newline = (len == 0) || (command[len - 1] != '\n');
+    uint32_t cmd_len = len + (add_newline ? 1 : 0);
+    if (cmd_len > COMMAND_ENTRY_LEN_MASK) return false;
+
+    // Reserve space, entry never wraps around, the rest of the buffer is padded instead
+    uint32_t need = entry_size(cmd_len);
+    uint32_t pos = head.load(std::memory_order_relaxed);
+    uint32_t pad, next;
+    do {
+        uint32_t idx = pos & (size - 1);
+        pad = (idx + need > size) ? size - idx : 0;
+        next = pos + pad + need;
+        if (next - confirmed.load(std::memory_order_acquire) > size) return false;    // Full
+    } while (!head.compare_exchange_weak(pos, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    if (pad > 0) __atomic_store_n(&entry_at(pos)->info, COMMAND_ENTRY_PAD | COMMAND_ENTRY_READY, __ATOMIC_RELEASE);
+
+    command_entry_t *entry = entry_at(pos + pad);
+    entry->timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    entry->file_offset = file_offset;
+    char *text = (char *) (entry + 1);
+    memcpy(text, command, len);
+    if (add_newline) text[len] = '\n';
+    text[cmd_len] = 0;
+    count.fetch_add(1, std::memory_order_relaxed);
+
+    // Publish entry
+    uint32_t info = cmd_len | (((uint32_t) source << COMMAND_ENTRY_SOURCE_SHIFT) & COMMAND_ENTRY_SOURCE_MASK);
+    if (checksum >= 0) info |= COMMAND_ENTRY_CHECKSUM | ((uint32_t) checksum << COMMAND_ENTRY_CHECKSUM_SHIFT);
+    __atomic_store_n(&entry->info, info | COMMAND_ENTRY_READY, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/**
+ * Consumer only.
+ * Gets next entry to send, skipping padding and discarded entries.
+ * @return entry or nullptr if there's nothing to send yet
+ */
+const command_entry_t *CommandRing::peek() {
+    while (tail != head.load(std::memory_order_acquire)) {
+        command_entry_t *entry = entry_at(tail);
+        uint32_t info = __atomic_load_n(&entry->info, __ATOMIC_ACQUIRE);
+        if (!(info & COMMAND_ENTRY_READY)) return nullptr;     // Producer is still writing it
+        if (info & COMMAND_ENTRY_PAD) tail += size - (tail & (size - 1));
+        else if (info & COMMAND_ENTRY_DISCARDED) tail += entry_size(info & COMMAND_ENTRY_LEN_MASK);
+        else return entry;
+    }
+    return nullptr;
+}
+
+/**
+ * Consumer only.
+ * Marks entry returned by peek() as sent.
+ */
+void CommandRing::advance() {
+    const command_entry_t *entry = peek();
+    if (entry != nullptr) tail += entry_size(entry->info & COMMAND_ENTRY_LEN_MASK);
+}
+
+/**
+ * Internal function.
+ * Frees padding and discarded entries which are between confirmed and sent ones.
+ */
+void CommandRing::skip_unused() {
+    uint32_t pos = confirmed.load(std::memory_order_relaxed);
+    while (pos != tail) {
+        command_entry_t *entry = entry_at(pos);
+        uint32_t len;
+        if (entry->info & COMMAND_ENTRY_PAD) len = size - (pos & (size - 1));
+        else if (entry->info & COMMAND_ENTRY_DISCARDED) len = entry_size(entry->info & COMMAND_ENTRY_LEN_MASK);
+        else break;
+        memset(entry, 0, len);
+        pos += len;
+    }
+    confirmed.store(pos, std::memory_order_release);
+}
+
+/**
+ * Consumer only.
+ * Frees the oldest sent entry. Freed space is zeroed, so that producers reuse it
+ * with no stale ready flags in it.
+ */
+void CommandRing::release() {
+    skip_unused();
+    uint32_t pos = confirmed.load(std::memory_order_relaxed);
+    if (pos == tail) return;    // Nothing was sent
+
+    command_entry_t *entry = entry_at(pos);
+    uint32_t len = entry_size(entry->info & COMMAND_ENTRY_LEN_MASK);
+    memset(entry, 0, len);
+    count.fetch_sub(1, std::memory_order_relaxed);
+    confirmed.store(pos + len, std::memory_order_release);
+    skip_unused();
+}
+
+/**
+ * Consumer only.
+ * Drops every entry which was not sent yet. Entries producers are still writing are kept.
+ * @return number of dropped entries
+ */
+uint32_t CommandRing::discard() {
+    uint32_t cnt = 0;
+    uint32_t pos = tail;
+    uint32_t end = head.load(std::memory_order_acquire);
+    while (pos != end) {
+        command_entry_t *entry = entry_at(pos);
+        uint32_t info = __atomic_load_n(&entry->info, __ATOMIC_ACQUIRE);
+        if (!(info & COMMAND_ENTRY_READY)) break;
+        if (info & COMMAND_ENTRY_PAD) {
+            pos += size - (pos & (size - 1));
+            continue;
+        }
+        if (!(info & COMMAND_ENTRY_DISCARDED)) {
+            __atomic_store_n(&entry->info, info | COMMAND_ENTRY_DISCARDED, __ATOMIC_RELEASE);
+            cnt++;
+        }
+        pos += entry_size(info & COMMAND_ENTRY_LEN_MASK);
+    }
+    count.fetch_sub(cnt, std::memory_order_relaxed);
+
+    // Free dropped entries right away if nothing is in flight before them
+    peek();
+    skip_unused();
+    return cnt;
+}
+
+/**
+ * Consumer only.
+ * Moves send position back to the oldest unconfirmed entry.
+ */
+void CommandRing::rewind() {
+    tail = confirmed.load(std::memory_order_relaxed);
+}
+
+uint32_t CommandRing::get_count() const { return count.load(std::memory_order_relaxed); }
+uint32_t CommandRing::get_free() const {
+    return size - (head.load(std::memory_order_relaxed) - confirmed.load(std::memory_order_relaxed));
+}
+
+const char *CommandRing::get_command(const command_entry_t *entry) { return (const char *) (entry + 1); }
+uint16_t CommandRing::get_length(const command_entry_t *entry) { return entry->info & COMMAND_ENTRY_LEN_MASK; }
+uint8_t CommandRing::get_source(const command_entry_t *entry) {
+    return (entry->info & COMMAND_ENTRY_SOURCE_MASK) >> COMMAND_ENTRY_SOURCE_SHIFT;
+}
+int16_t CommandRing::get_checksum(const command_entry_t *entry) {
+    if (!(entry->info & COMMAND_ENTRY_CHECKSUM)) return -1;
+    return (int16_t) (entry->info >> COMMAND_ENTRY_CHECKSUM_SHIFT);
+}
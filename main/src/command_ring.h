@@ -0,0 +1,89 @@
+/*
+  command_ring.h - lock-free command ring buffer
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_COMMAND_RING_H
+#define ESP32_PRINT_COMMAND_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Entry header info word layout. Info is written last, so consumer never sees
+ * an entry which is not completely written.
+ */
+#define COMMAND_ENTRY_LEN_MASK      0x00000fff  // Command length including newline
+#define COMMAND_ENTRY_SOURCE_SHIFT  12
+#define COMMAND_ENTRY_SOURCE_MASK   0x0000f000
+#define COMMAND_ENTRY_READY         0x00010000  // Entry is completely written
+#define COMMAND_ENTRY_PAD           0x00020000  // Space till the end of buffer is not used
+#define COMMAND_ENTRY_DISCARDED     0x00040000  // Entry is dropped and must not be sent
+#define COMMAND_ENTRY_CHECKSUM      0x00080000  // Command XOR is known, it's in the top byte
+#define COMMAND_ENTRY_CHECKSUM_SHIFT 24
+
+enum CommandSource { COMMAND_SOURCE_PRINT, COMMAND_SOURCE_CONSOLE, COMMAND_SOURCE_STATUS, COMMAND_SOURCE_PRINTER };
+
+typedef struct {
+    uint32_t info;              // Length, source and flags
+    uint32_t timestamp;         // Time command was added, ms
+    uint32_t file_offset;       // Position in printed file right after the command
+} command_entry_t;
+
+/**
+ * Packed ring of variable length commands. Any number of tasks may add commands,
+ * while only one task (UART transmitter) reads them. Commands are read in two steps:
+ * first they are sent (tail moves) and then confirmed (confirmed moves), only confirmed
+ * commands free their space, so sent ones can be sent again.
+ */
+class CommandRing {
+private:
+    char *buffer;
+    uint32_t size;                      // Power of 2
+    std::atomic<uint32_t> head;         // End of space reserved by producers
+    std::atomic<uint32_t> confirmed;    // Start of space still in use
+    uint32_t tail;                      // Next entry to send, consumer only
+    std::atomic<uint32_t> count;        // Entries not yet confirmed
+
+    [[nodiscard]] command_entry_t *entry_at(uint32_t pos) const;
+    static uint32_t entry_size(uint32_t len);
+    void skip_unused();
+
+public:
+    explicit CommandRing(uint32_t size);
+    ~CommandRing();
+
+    bool push(const char *command, uint8_t source, uint32_t file_offset, int16_t checksum = -1);
+
+    const command_entry_t *peek();
+    void advance();
+    void release();
+    void rewind();
+    uint32_t discard();
+
+    [[nodiscard]] uint32_t get_count() const;
+    [[nodiscard]] uint32_t get_free() const;
+
+    static const char *get_command(const command_entry_t *entry);
+    static uint16_t get_length(const command_entry_t *entry);
+    static uint8_t get_source(const command_entry_t *entry);
+    static int16_t get_checksum(const command_entry_t *entry);
+};
+
+#endif //ESP32_PRINT_COMMAND_RING_H
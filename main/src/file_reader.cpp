@@ -0,0 +1,191 @@
+/*
+  file_reader.cpp - prefetching print file reader
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <sys/param.h>
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+
+#include "file_reader.h"
+
+static const char TAG[] = "esp3d-file-reader";
+
+FileReader::FileReader(uint8_t depth) {
+    this->depth = (depth > 0) ? depth : FILE_READER_DEPTH;
+    file = nullptr;
+    block = nullptr;
+    storage = nullptr;
+    stream = nullptr;
+    task_handle = nullptr;
+    done = nullptr;
+    eof = true;
+    stop_requested = false;
+    chunk_pos = 0;
+    chunk_len = 0;
+    stalls = 0;
+}
+
+FileReader::~FileReader() {
+    if (stream != nullptr) vStreamBufferDelete(stream);
+    heap_caps_free(storage);
+    free(block);
+}
+
+esp_err_t FileReader::init() {
+    // Prefetch buffer is large, so it goes to PSRAM, internal RAM is the last resort
+    size_t size = (size_t) depth * FILE_READER_BLOCK_SIZE;
+    storage = (uint8_t *) heap_caps_malloc(size + 1, MALLOC_CAP_SPIRAM);
+    if (storage == nullptr) {
+        ESP_LOGW(TAG, "No PSRAM, %d byte(s) read ahead in internal RAM", FILE_READER_BLOCK_SIZE * 2);
+        size = FILE_READER_BLOCK_SIZE * 2;
+        storage = (uint8_t *) heap_caps_malloc(size + 1, MALLOC_CAP_8BIT);
+    }
+    block = (uint8_t *) malloc(FILE_READER_BLOCK_SIZE);    // Internal RAM, SD card DMA reads there directly
+    done = xSemaphoreCreateBinary();
+    if ((storage == nullptr) || (block == nullptr) || (done == nullptr)) return ESP_ERR_NO_MEM;
+    stream = xStreamBufferCreateStatic(size, 1, storage, &stream_struct);
+    if (xTaskCreate(FileReader::task, "file_reader", FILE_READER_STACK_SIZE, this, tskIDLE_PRIORITY + 1,
+                    &task_handle) != pdPASS) return ESP_FAIL;
+    return ESP_OK;
+}
+
+/**
+ * Starts reading a file from its current position. Previous file must be stopped.
+ * @param f
+ * @return ESP_FAIL if other file is being read
+ */
+esp_err_t FileReader::start(FILE *f) {
+    if ((file != nullptr) || (task_handle == nullptr)) return ESP_FAIL;
+    xStreamBufferReset(stream);
+    chunk_pos = 0;
+    chunk_len = 0;
+    eof = false;
+    stop_requested = false;
+    file = f;
+    xTaskNotifyGive(task_handle);
+    return ESP_OK;
+}
+
+/**
+ * Stops reading and waits until reader task leaves the file, so that it may be closed.
+ * Must be called for every started file, whether it was read to the end or not.
+ */
+void FileReader::stop() {
+    if (file == nullptr) return;
+    stop_requested = true;
+    xSemaphoreTake(done, portMAX_DELAY);
+    file = nullptr;
+}
+
+/**
+ * Internal function.
+ * Takes next chunk of read ahead data, waits if there's none yet.
+ * @return false if file is over or reading was stopped
+ */
+bool FileReader::fill() {
+    chunk_pos = 0;
+    chunk_len = xStreamBufferReceive(stream, chunk, sizeof(chunk), 0);
+    if (chunk_len > 0) return true;
+
+    if (!eof) stalls++;
+    while (true) {
+        chunk_len = xStreamBufferReceive(stream, chunk, sizeof(chunk), pdMS_TO_TICKS(FILE_READER_WAIT));
+        if (chunk_len > 0) return true;
+        if (stop_requested || (eof && xStreamBufferIsEmpty(stream))) return false;
+    }
+}
+
+/**
+ * Gets next line of the file. Lines of any length are read as a whole, what does not fit
+ * into the buffer is skipped.
+ * @param line buffer, line is zero terminated and has no newline
+ * @param size buffer size
+ * @param consumed bytes line took in file, including newline
+ * @param truncated set if line did not fit
+ * @return false if there are no more lines
+ */
+bool FileReader::read_line(char *line, size_t size, size_t *consumed, bool *truncated) {
+    size_t len = 0;
+    *consumed = 0;
+    *truncated = false;
+    while (true) {
+        if ((chunk_pos == chunk_len) && !fill()) break;
+        char c = chunk[chunk_pos++];
+        (*consumed)++;
+        if (c == '\n') break;
+        if (len < size - 1) line[len++] = c;
+        else *truncated = true;
+    }
+    line[len] = 0;
+    return *consumed > 0;
+}
+
+/**
+ * Gets next bytes of the file.
+ * @param data
+ * @param len
+ * @return false if file is over before that
+ */
+bool FileReader::read(void *data, size_t len) {
+    auto p = (char *) data;
+    while (len > 0) {
+        if ((chunk_pos == chunk_len) && !fill()) return false;
+        size_t n = MIN(len, chunk_len - chunk_pos);
+        memcpy(p, &chunk[chunk_pos], n);
+        chunk_pos += n;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * Task function. Waits for a file to start and reads it ahead until prefetch buffer is full.
+ * @param args
+ */
+void FileReader::task(void *args) {
+    auto r = (FileReader *) args;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // File may start anywhere, i.e. when print is resumed, reads are kept block aligned anyway
+        long pos = ftell(r->file);
+        size_t skip = (pos > 0) ? pos % FILE_READER_BLOCK_SIZE : 0;
+        if ((skip > 0) && (fseek(r->file, pos - (long) skip, SEEK_SET) != 0)) skip = 0;
+
+        while (!r->stop_requested) {
+            size_t n = fread(r->block, 1, FILE_READER_BLOCK_SIZE, r->file);
+            size_t sent = MIN(skip, n);
+            skip = 0;
+            while ((sent < n) && !r->stop_requested) {
+                sent += xStreamBufferSend(r->stream, &r->block[sent], n - sent, pdMS_TO_TICKS(FILE_READER_WAIT));
+            }
+            if (n < FILE_READER_BLOCK_SIZE) {
+                if (ferror(r->file)) ESP_LOGE(TAG, "File read error");
+                break;
+            }
+        }
+        r->eof = true;
+        xSemaphoreGive(r->done);
+    }
+}
+
+uint32_t FileReader::get_stalls() const { return stalls; }
@@ -0,0 +1,77 @@
+/*
+  file_reader.h - prefetching print file reader
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_FILE_READER_H
+#define ESP32_PRINT_FILE_READER_H
+
+#include <cstdio>
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
+#include <freertos/task.h>
+
+#define FILE_READER_BLOCK_SIZE      4096    // bytes, multiple of SD card sector, so reads stay aligned
+#define FILE_READER_DEPTH           8       // Blocks read ahead by default
+#define FILE_READER_CHUNK_SIZE      512     // bytes taken from prefetch buffer at once
+#define FILE_READER_WAIT            100     // ms, how often tasks check if reading was stopped
+#define FILE_READER_STACK_SIZE      3072    // bytes
+
+/**
+ * Reads print job file ahead in a task of its own. File is read in large blocks into a buffer
+ * in PSRAM (if there's one), and lines are taken from that buffer, so SD card latency is
+ * hidden from the sender as long as there's something read ahead.
+ */
+class FileReader {
+private:
+    FILE *file;
+    uint8_t depth;                          // Blocks read ahead
+    uint8_t *block;                         // Block being read from file
+    uint8_t *storage;                       // Prefetch buffer
+    StaticStreamBuffer_t stream_struct{};
+    StreamBufferHandle_t stream;
+    TaskHandle_t task_handle;
+    SemaphoreHandle_t done;                 // Given when reader task leaves the file
+    volatile bool eof;
+    volatile bool stop_requested;
+
+    // Consumer side
+    char chunk[FILE_READER_CHUNK_SIZE]{};
+    size_t chunk_pos;
+    size_t chunk_len;
+    uint32_t stalls;                        // Times lines were asked for with nothing read ahead
+
+    bool fill();
+    [[noreturn]] static void task(void *args);
+
+public:
+    explicit FileReader(uint8_t depth);
+    ~FileReader();
+
+    esp_err_t init();
+    esp_err_t start(FILE *f);
+    bool read_line(char *line, size_t size, size_t *consumed, bool *truncated);
+    bool read(void *data, size_t len);
+    void stop();
+
+    [[nodiscard]] uint32_t get_stalls() const;
+};
+
+#endif //ESP32_PRINT_FILE_READER_H
@@ -0,0 +1,398 @@
+/*
+  gcode_cache.cpp - pre-processed G-code cache
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <sys/param.h>
+#include <cstring>
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+
+#include "gcode_cache.h"
+#include "sdcard.h"
+#include "uart.h"
+
+static const char TAG[] = "esp3d-gcode-cache";
+
+/**
+ * Internal function.
+ * FNV-1a hash, continued from given value.
+ */
+static uint32_t hash(uint32_t h, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t) data[i]) * 16777619;
+    return h;
+}
+
+static void cache_path(char *path, const char *name) {
+    snprintf(path, GCODE_CACHE_PATH_MAX, "%s/%s", GCODE_CACHE_DIR, name);
+}
+
+/**
+ * Internal function.
+ * Tells if a line is slicer's layer change comment. Cura and IdeaMaker put ';LAYER:<n>',
+ * PrusaSlicer and its forks ';LAYER_CHANGE', Simplify3D '; layer <n>, Z = <z>'.
+ */
+static bool is_layer_comment(const char *line) {
+    while (isspace((unsigned char) *line)) line++;
+    if (*line++ != ';') return false;
+    while (*line == ' ') line++;
+    if ((strncmp(line, "LAYER:", 6) == 0) || (strncmp(line, "LAYER_CHANGE", 12) == 0)) return true;
+    return (strncmp(line, "layer ", 6) == 0) && isdigit((unsigned char) line[6]);
+}
+
+/**
+ * Tells if a file is G-code by its extension.
+ * @param name
+ */
+bool gcode_cache_is_gcode(const char *name) {
+    const char *ext = strrchr(name, '.');
+    return (ext != nullptr) && ((strcasecmp(ext, ".gcode") == 0) || (strcasecmp(ext, ".gco") == 0) ||
+                                (strcasecmp(ext, ".g") == 0));
+}
+
+/**
+ * Opens cache of a G-code file. Cache is checked against the file, it's not used if the file
+ * was changed after cache was made.
+ * @param name source file name
+ * @param source opened source file, its position is not changed
+ * @param header filled with cache header
+ * @return cache positioned at the first record, or nullptr if there's no valid cache
+ */
+FILE *gcode_cache_open(const char *name, FILE *source, gcode_cache_header_t *header) {
+    char path[GCODE_CACHE_PATH_MAX];
+    cache_path(path, name);
+    if (!sdcard_has_file(path)) return nullptr;
+    FILE *f = sdcard_open_file(path, "rb");
+    if (f == nullptr) return nullptr;
+
+    struct stat st{};
+    bool valid = (fread(header, sizeof(gcode_cache_header_t), 1, f) == 1) && (header->magic == GCODE_CACHE_MAGIC) &&
+            (header->version == GCODE_CACHE_VERSION) && (header->record_size == sizeof(gcode_cache_record_t)) &&
+            sdcard_stat(name, &st) && (header->source_size == (uint32_t) st.st_size) &&
+            (header->source_mtime == (uint32_t) st.st_mtime);
+    if (valid) {
+        char *block = (char *) malloc(GCODE_CACHE_HASH_SIZE);
+        long pos = ftell(source);
+        fseek(source, 0, SEEK_SET);
+        size_t n = (block != nullptr) ? fread(block, 1, GCODE_CACHE_HASH_SIZE, source) : 0;
+        fseek(source, pos, SEEK_SET);
+        valid = (block != nullptr) && (hash(2166136261, block, n) == header->source_hash);
+        free(block);
+    }
+    if (!valid) {
+        ESP_LOGW(TAG, "Cache of '%s' is stale, file is printed as it is", name);
+        fclose(f);
+        return nullptr;
+    }
+
+    ESP_LOGI(TAG, "Printing '%s' from cache, %lu command(s), %lu min", name, (unsigned long) header->commands,
+             (unsigned long) header->total_time / 60000);
+    return f;
+}
+
+/**
+ * Internal function.
+ * Reads a table from cache, into PSRAM if there's one. Cache position is not changed.
+ */
+static void *read_table(FILE *f, uint32_t offset, uint32_t entries, size_t entry_size) {
+    if (entries == 0) return nullptr;
+    size_t size = entries * entry_size;
+    void *table = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (table == nullptr) table = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    if (table == nullptr) return nullptr;
+
+    long pos = ftell(f);
+    fseek(f, (long) offset, SEEK_SET);
+    size_t n = fread(table, entry_size, entries, f);
+    fseek(f, pos, SEEK_SET);
+    if (n != entries) {
+        heap_caps_free(table);
+        return nullptr;
+    }
+    return table;
+}
+
+/**
+ * Internal function.
+ * Grows a table which is being filled, in PSRAM if there's one.
+ * @return false if there's no memory
+ */
+static bool grow_table(void **table, uint32_t *size, size_t entry_size) {
+    uint32_t new_size = *size + 64;
+    void *p = heap_caps_realloc(*table, new_size * entry_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p == nullptr) p = heap_caps_realloc(*table, new_size * entry_size, MALLOC_CAP_8BIT);
+    if (p == nullptr) return false;
+    *table = p;
+    *size = new_size;
+    return true;
+}
+
+/**
+ * Reads offset table of a cache opened with gcode_cache_open(). Cache position is not changed.
+ * @param f
+ * @param header
+ * @return table, it's freed with heap_caps_free(), or nullptr if there's none
+ */
+gcode_cache_index_t *gcode_cache_read_index(FILE *f, const gcode_cache_header_t *header) {
+    return (gcode_cache_index_t *) read_table(f, header->index_offset, header->index_entries,
+                                              sizeof(gcode_cache_index_t));
+}
+
+/**
+ * Reads layer table of a cache opened with gcode_cache_open(). Cache position is not changed.
+ * @param f
+ * @param header
+ * @return table, it's freed with heap_caps_free(), or nullptr if there's none
+ */
+gcode_cache_layer_t *gcode_cache_read_layers(FILE *f, const gcode_cache_header_t *header) {
+    return (gcode_cache_layer_t *) read_table(f, header->layers_offset, header->layers, sizeof(gcode_cache_layer_t));
+}
+
+/**
+ * Deletes cache of a file, if there's one.
+ * @param name source file name
+ */
+void gcode_cache_delete(const char *name) {
+    char path[GCODE_CACHE_PATH_MAX];
+    cache_path(path, name);
+    sdcard_delete_file(path);
+}
+
+GcodeCacheWriter::GcodeCacheWriter() {
+    file = nullptr;
+    index = nullptr;
+    index_size = 0;
+    layers = nullptr;
+    layers_size = 0;
+    layer_next = {};
+    layer_comments = false;
+    layer_pending = false;
+    layer_z = 0;
+    source_offset = 0;
+    source_line = 0;
+    line_start = 0;
+    cache_offset = 0;
+    line_len = 0;
+    truncated = false;
+    failed = false;
+
+    // Printer independent stages only, per printer rules are applied when it prints
+    pipeline = new GcodePipeline(sink, this);
+    pipeline->add(new GcodeStripStage());
+    pipeline->add(new GcodeCanonicalStage());
+    estimator = new MotionEstimator();
+    pipeline->add(estimator);
+}
+
+GcodeCacheWriter::~GcodeCacheWriter() {
+    if (file != nullptr) fclose(file);
+    heap_caps_free(index);
+    heap_caps_free(layers);
+    delete pipeline;
+}
+
+/**
+ * Starts a cache for a file being uploaded. Cache of previous file with the same name is replaced.
+ * @param source_name
+ */
+esp_err_t GcodeCacheWriter::begin(const char *source_name) {
+    strncpy(name, source_name, sizeof(name) - 1);
+    char path[GCODE_CACHE_PATH_MAX];
+    cache_path(path, name);
+    if (sdcard_make_dir(GCODE_CACHE_DIR) != ESP_OK) return ESP_FAIL;
+    file = sdcard_open_file(path, "wb");
+    if (file == nullptr) return ESP_FAIL;
+
+    header = {
+            .magic = GCODE_CACHE_MAGIC,
+            .version = GCODE_CACHE_VERSION,
+            .record_size = sizeof(gcode_cache_record_t),
+            .source_size = 0,
+            .source_mtime = 0,
+            .source_hash = 2166136261,
+            .commands = 0,
+            .index_offset = 0,
+            .index_entries = 0,
+            .total_time = 0,
+            .layers_offset = 0,
+            .layers = 0
+    };
+    // Header is written once again when it's known, till then cache is not valid
+    fwrite(&header, sizeof(header), 1, file);
+    cache_offset = sizeof(header);
+    source_offset = 0;
+    source_line = 0;
+    line_start = 0;
+    layer_next = { .command = 0, .cache_offset = cache_offset, .source_offset = 0, .z = 0, .e = 0 };
+    layer_comments = false;
+    layer_pending = false;
+    layer_z = 0;
+    memset(last_pos, 0, sizeof(last_pos));
+    pipeline->reset();
+    return ESP_OK;
+}
+
+/**
+ * Internal function.
+ * Pipeline sink, writes a command record.
+ */
+void GcodeCacheWriter::sink(const char *command, uint32_t file_offset, void *context) {
+    ((GcodeCacheWriter *) context)->add(command, file_offset);
+}
+
+void GcodeCacheWriter::add(const char *command, uint32_t file_offset) {
+    size_t len = strlen(command);
+    if (len > COMMAND_MAX_LENGTH) {
+        // Print from cache would leave it out, so file is printed as it is and stops there instead
+        ESP_LOGE(TAG, "Command is too long, cache is not made: %.32s...", command);
+        failed = true;
+        return;
+    }
+
+    // Tables grow in PSRAM, if there's one
+    if (header.commands % GCODE_CACHE_INDEX_STEP == 0) {
+        if ((header.index_entries == index_size) &&
+            !grow_table((void **) &index, &index_size, sizeof(gcode_cache_index_t))) {
+            failed = true;
+            return;
+        }
+        index[header.index_entries++] = { .cache_offset = cache_offset, .source_offset = file_offset,
+                                          .source_line = source_line, .time = estimator->get_time() };
+    }
+
+    // Estimator has already taken the command, so its position is where the command moves to
+    float pos[4];
+    for (uint8_t i = 0; i < 4; i++) pos[i] = estimator->get_position(i);
+    bool extrudes = (pos[3] > last_pos[3]) && ((pos[0] != last_pos[0]) || (pos[1] != last_pos[1]));
+    if (layer_pending) {
+        add_layer({ .command = header.commands, .cache_offset = cache_offset, .source_offset = layer_next.source_offset,
+                    .z = NAN, .e = last_pos[3] });
+        layer_pending = false;
+    } else if (!layer_comments && extrudes && ((header.layers == 0) || (pos[2] != layer_z))) {
+        layer_next.z = pos[2];
+        add_layer(layer_next);
+    }
+    if (extrudes) {
+        if ((header.layers > 0) && std::isnan(layers[header.layers - 1].z)) layers[header.layers - 1].z = pos[2];
+        layer_z = pos[2];
+    }
+    if (failed) return;
+
+    gcode_cache_record_t record = { .len = (uint8_t) len, .checksum = 0, .source_offset = file_offset };
+    for (size_t i = 0; i < len; i++) record.checksum ^= (uint8_t) command[i];
+    if ((fwrite(&record, sizeof(record), 1, file) != 1) || (fwrite(command, 1, len, file) != len)) failed = true;
+    cache_offset += sizeof(record) + len;
+    header.commands++;
+    if (extrudes) layer_next = { .command = header.commands, .cache_offset = cache_offset,
+                                 .source_offset = file_offset, .z = pos[2], .e = pos[3] };
+    memcpy(last_pos, pos, sizeof(last_pos));
+}
+
+/**
+ * Internal function.
+ * Adds an entry to layer table.
+ */
+void GcodeCacheWriter::add_layer(const gcode_cache_layer_t &layer) {
+    if ((header.layers == layers_size) && !grow_table((void **) &layers, &layers_size, sizeof(gcode_cache_layer_t))) {
+        failed = true;
+        return;
+    }
+    layers[header.layers++] = layer;
+}
+
+/**
+ * Internal function.
+ * Runs a complete line through pipeline.
+ */
+void GcodeCacheWriter::process_line() {
+    line[line_len] = 0;
+    source_line++;
+    if (is_layer_comment(line)) {
+        // Layers found by height so far were start G-code, like purge line
+        if (!layer_comments) header.layers = 0;
+        layer_comments = true;
+        layer_pending = true;
+        layer_next.source_offset = line_start;
+    }
+    // Too long line is only good if it's a comment after all, otherwise file can't be printed as it is
+    if (truncated && (strchr(line, ';') == nullptr)) {
+        ESP_LOGE(TAG, "Line %lu of '%s' is longer than %d bytes, it can't be printed", (unsigned long) source_line,
+                 name, GCODE_LINE_MAX - 1);
+        failed = true;
+    } else pipeline->process(line, source_offset);
+    line_len = 0;
+    truncated = false;
+    line_start = source_offset;
+}
+
+/**
+ * Takes next part of uploaded file.
+ * @param data
+ * @param len
+ */
+void GcodeCacheWriter::write(const char *data, size_t len) {
+    if ((file == nullptr) || failed) return;
+    if (source_offset < GCODE_CACHE_HASH_SIZE) {
+        header.source_hash = hash(header.source_hash, data, MIN(len, GCODE_CACHE_HASH_SIZE - source_offset));
+    }
+    for (size_t i = 0; i < len; i++) {
+        source_offset++;
+        if (data[i] == '\n') process_line();
+        else if (line_len < GCODE_LINE_MAX - 1) line[line_len++] = data[i];
+        else truncated = true;
+    }
+}
+
+/**
+ * Completes the cache. Source file must be closed by then, since its size and time go to cache.
+ * @param success false if upload failed, cache is deleted then
+ */
+esp_err_t GcodeCacheWriter::end(bool success) {
+    if (file == nullptr) return ESP_FAIL;
+    if (success && !failed) {
+        if (line_len > 0) process_line();
+        pipeline->flush();
+        header.total_time = estimator->get_time();
+        header.index_offset = cache_offset;
+        if (header.index_entries > 0) fwrite(index, sizeof(gcode_cache_index_t), header.index_entries, file);
+        header.layers_offset = header.index_offset + header.index_entries * sizeof(gcode_cache_index_t);
+        if (header.layers > 0) fwrite(layers, sizeof(gcode_cache_layer_t), header.layers, file);
+
+        struct stat st{};
+        if (sdcard_stat(name, &st)) {
+            header.source_size = st.st_size;
+            header.source_mtime = st.st_mtime;
+            fseek(file, 0, SEEK_SET);
+            fwrite(&header, sizeof(header), 1, file);
+        } else failed = true;
+    }
+    bool ok = (fflush(file) == 0) && success && !failed;
+    fclose(file);
+    file = nullptr;
+    if (!ok) {
+        ESP_LOGE(TAG, "Cache of '%s' was not made", name);
+        gcode_cache_delete(name);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Cache of '%s' is made, %lu command(s), %lu layer(s)", name, (unsigned long) header.commands,
+             (unsigned long) header.layers);
+    return ESP_OK;
+}
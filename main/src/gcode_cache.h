@@ -0,0 +1,130 @@
+/*
+  gcode_cache.h - pre-processed G-code cache
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_GCODE_CACHE_H
+#define ESP32_PRINT_GCODE_CACHE_H
+
+#include <cstdio>
+#include <cstdint>
+#include <esp_err.h>
+
+#include "gcode_pipeline.h"
+#include "motion_estimator.h"
+
+#define GCODE_CACHE_DIR         "esp3d/cache"
+#define GCODE_CACHE_MAGIC       0x43443345  // 'E3DC'
+#define GCODE_CACHE_VERSION     3
+#define GCODE_CACHE_HASH_SIZE   4096        // bytes of source file hashed to tell it was not replaced
+#define GCODE_CACHE_INDEX_STEP  256         // Commands between offset table entries
+#define GCODE_CACHE_PATH_MAX    96
+
+/**
+ * Cache file is the header, then records, each one followed by its command, then offset table,
+ * then layer table. Commands are what pipeline makes of source lines, so they're sent as they are.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t source_size;           // Source file is considered changed if it has other size,
+    uint32_t source_mtime;          // modification time
+    uint32_t source_hash;           // or other beginning
+    uint32_t commands;
+    uint32_t index_offset;          // Offset table position in cache file
+    uint32_t index_entries;
+    uint32_t total_time;            // ms, estimated print time
+    uint32_t layers_offset;         // Layer table position in cache file
+    uint32_t layers;
+} gcode_cache_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t len;                    // Command length, no newline
+    uint8_t checksum;               // XOR of command bytes
+    uint32_t source_offset;         // Position in source file right after the command
+} gcode_cache_record_t;
+
+typedef struct {
+    uint32_t cache_offset;          // Record of command number (entry index * GCODE_CACHE_INDEX_STEP)
+    uint32_t source_offset;
+    uint32_t source_line;           // Line number of the command in source file, from 1
+    uint32_t time;                  // ms, estimated time to run commands up to this one, including it
+} gcode_cache_index_t;
+
+/**
+ * Layer starts with slicer's layer comment (';LAYER:', ';LAYER_CHANGE') if file has them,
+ * or else with the first move after the last extruding move below it.
+ */
+typedef struct {
+    uint32_t command;               // Number of the first command of the layer
+    uint32_t cache_offset;          // Its record
+    uint32_t source_offset;         // Where layer starts in source file
+    float z;                        // mm, height layer is printed at
+    float e;                        // mm, extruder position when layer starts
+} gcode_cache_layer_t;
+
+/**
+ * Makes cache of a G-code file while the file itself is uploaded.
+ */
+class GcodeCacheWriter {
+private:
+    FILE *file;
+    char name[GCODE_CACHE_PATH_MAX]{};  // Source file name
+    GcodePipeline *pipeline;
+    MotionEstimator *estimator;
+    gcode_cache_header_t header{};
+    gcode_cache_index_t *index;
+    uint32_t index_size;
+    gcode_cache_layer_t *layers;
+    uint32_t layers_size;
+    gcode_cache_layer_t layer_next;     // Where the next layer starts, if extruding move at other height comes
+    bool layer_comments;                // File has layer comments, height changes are not looked at then
+    bool layer_pending;                 // Layer comment was met, layer starts with the next command
+    float layer_z;
+    float last_pos[4]{};                // Position after previous command
+    uint32_t source_offset;
+    uint32_t source_line;
+    uint32_t line_start;                // Source offset of the line being processed
+    uint32_t cache_offset;
+    char line[GCODE_LINE_MAX]{};        // Line split between two writes
+    size_t line_len;
+    bool truncated;
+    bool failed;
+
+    void process_line();
+    void add_layer(const gcode_cache_layer_t &layer);
+    void add(const char *command, uint32_t file_offset);
+    static void sink(const char *command, uint32_t file_offset, void *context);
+
+public:
+    GcodeCacheWriter();
+    ~GcodeCacheWriter();
+
+    esp_err_t begin(const char *source_name);
+    void write(const char *data, size_t len);
+    esp_err_t end(bool success);
+};
+
+bool gcode_cache_is_gcode(const char *name);
+FILE *gcode_cache_open(const char *name, FILE *source, gcode_cache_header_t *header);
+gcode_cache_index_t *gcode_cache_read_index(FILE *f, const gcode_cache_header_t *header);
+gcode_cache_layer_t *gcode_cache_read_layers(FILE *f, const gcode_cache_header_t *header);
+void gcode_cache_delete(const char *name);
+
+#endif //ESP32_PRINT_GCODE_CACHE_H
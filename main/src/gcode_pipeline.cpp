@@ -0,0 +1,310 @@
+/*
+  gcode_pipeline.cpp - streaming G-code transform pipeline
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "gcode_pipeline.h"
+
+GcodeStage::GcodeStage() {
+    next = nullptr;
+    pipeline = nullptr;
+}
+
+/**
+ * Passes a line to the next stage, or to sink if this stage is the last one.
+ * Line may be changed by next stages.
+ * @param line zero terminated, no newline
+ */
+void GcodeStage::emit(char *line) {
+    if (next != nullptr) next->process(line);
+    else if (pipeline != nullptr) pipeline->sink(line, pipeline->file_offset, pipeline->sink_context);
+}
+
+/**
+ * Passes a line which was held back, with position in file it came from.
+ * @param line zero terminated, no newline
+ * @param file_offset position in file right after the line
+ */
+void GcodeStage::emit(char *line, uint32_t file_offset) {
+    if (pipeline == nullptr) return;
+    uint32_t current = pipeline->file_offset;
+    pipeline->file_offset = file_offset;
+    emit(line);
+    pipeline->file_offset = current;
+}
+
+/**
+ * Gets position in file right after the line being processed.
+ */
+uint32_t GcodeStage::get_file_offset() const { return (pipeline != nullptr) ? pipeline->file_offset : 0; }
+
+/**
+ * Called at the end of file. Stages which hold lines back override it to emit them.
+ */
+void GcodeStage::flush() {
+    if (next != nullptr) next->flush();
+}
+
+/**
+ * Called when a new job starts. Stages which keep state override it to forget it.
+ */
+void GcodeStage::reset() {
+    if (next != nullptr) next->reset();
+}
+
+GcodePipeline::GcodePipeline(void (*sink)(const char *, uint32_t, void *), void *context) {
+    first = nullptr;
+    last = nullptr;
+    this->sink = sink;
+    sink_context = context;
+    file_offset = 0;
+}
+
+GcodePipeline::~GcodePipeline() {
+    while (first != nullptr) {
+        GcodeStage *next = first->next;
+        delete first;
+        first = next;
+    }
+}
+
+/**
+ * Adds a stage to the end of the chain. Pipeline owns the stage and deletes it.
+ * @param stage
+ */
+void GcodePipeline::add(GcodeStage *stage) {
+    stage->pipeline = this;
+    if (last != nullptr) last->next = stage;
+    else first = stage;
+    last = stage;
+}
+
+/**
+ * Runs a line read from file through the stages.
+ * @param line zero terminated, it's changed in place
+ * @param file_offset position in file right after the line
+ */
+void GcodePipeline::process(char *line, uint32_t file_offset) {
+    this->file_offset = file_offset;
+    if (first != nullptr) first->process(line);
+    else sink(line, file_offset, sink_context);
+}
+
+void GcodePipeline::flush() {
+    if (first != nullptr) first->flush();
+}
+
+void GcodePipeline::reset() {
+    file_offset = 0;
+    if (first != nullptr) first->reset();
+}
+
+/**
+ * Commands which take a string after their code, i.e. file name or message. The string may have
+ * ';' and '*' in it, so it is not a comment or checksum.
+ * @param line command with no line number and no leading whitespace
+ * @return where the string starts or nullptr if command takes no string
+ */
+const char *gcode_string_argument(const char *line) {
+    if ((line[0] != 'M') && (line[0] != 'm')) return nullptr;
+    char *end;
+    long code = strtol(&line[1], &end, 10);
+    if ((end == &line[1]) || !((*end == ' ') || (*end == 0))) return nullptr;
+    switch (code) {
+        case 0: case 1: case 16: case 23: case 28: case 30: case 32: case 33: case 117: case 118: case 928:
+            return end;
+        default:
+            return nullptr;
+    }
+}
+
+void GcodeStripStage::process(char *line) {
+    char *r = line, *w = line;
+    while ((*r == ' ') || (*r == '\t')) r++;
+
+    // Line number from file is dropped, port numbers lines by itself
+    bool numbered = ((*r == 'N') || (*r == 'n')) && isdigit(r[1]);
+    if (numbered) {
+        r++;
+        while (isdigit(*r)) r++;
+        while ((*r == ' ') || (*r == '\t')) r++;
+    }
+
+    // String goes as it is, only line end and checksum of a numbered line are dropped
+    if (gcode_string_argument(r) != nullptr) {
+        size_t len = strlen(r);
+        while ((len > 0) && ((r[len - 1] == '\n') || (r[len - 1] == '\r'))) len--;
+        if (numbered) {
+            size_t end = len;
+            while ((end > 0) && isdigit(r[end - 1])) end--;
+            if ((end > 0) && (end < len) && (r[end - 1] == '*')) len = end - 1;
+        }
+        memmove(line, r, len);
+        line[len] = 0;
+        emit(line);
+        return;
+    }
+
+    bool space = false;
+    for (; *r != 0; r++) {
+        char c = *r;
+        if ((c == ';') || (c == '*') || (c == '\n') || (c == '\r')) break;    // Comment or checksum
+        if ((c == ' ') || (c == '\t')) {
+            space = true;
+            continue;
+        }
+        if (space) *w++ = ' ';
+        space = false;
+        *w++ = c;
+    }
+    *w = 0;
+    if (w != line) emit(line);
+}
+
+GcodeCanonicalStage::GcodeCanonicalStage() {
+    motion = -1;
+}
+
+void GcodeCanonicalStage::reset() {
+    motion = -1;
+    GcodeStage::reset();
+}
+
+/**
+ * Internal function.
+ * Writes a number in its shortest form: '+010.500' becomes '10.5', '-0.0' becomes '0'.
+ * Output is never longer than input.
+ * @param p number start, moved past the number
+ * @param out
+ * @return bytes written, 0 if there's no number
+ */
+size_t GcodeCanonicalStage::canonical_number(const char **p, char *out) {
+    const char *s = *p;
+    bool negative = false;
+    if ((*s == '+') || (*s == '-')) negative = (*s++ == '-');
+    const char *int_start = s;
+    while (isdigit(*s)) s++;
+    const char *int_end = s;
+    const char *frac_start = s, *frac_end = s;
+    bool dot = (*s == '.');
+    if (dot) {
+        frac_start = ++s;
+        while (isdigit(*s)) s++;
+        frac_end = s;
+    }
+    if ((int_start == int_end) && !dot) return 0;   // Flag with no value, i.e. 'G28 X'
+
+    while ((int_end - int_start > 1) && (*int_start == '0')) int_start++;
+    while ((frac_end > frac_start) && (frac_end[-1] == '0')) frac_end--;
+    bool zero = (frac_end == frac_start);
+    for (const char *c = int_start; c < int_end; c++) if (*c != '0') zero = false;
+
+    size_t n = 0;
+    if (zero) out[n++] = '0';
+    else {
+        if (negative) out[n++] = '-';
+        memcpy(&out[n], int_start, int_end - int_start);
+        n += int_end - int_start;
+        if (frac_end > frac_start) {
+            out[n++] = '.';
+            memcpy(&out[n], frac_start, frac_end - frac_start);
+            n += frac_end - frac_start;
+        }
+    }
+    *p = s;
+    return n;
+}
+
+/**
+ * Line is expected to come from strip stage, so it has no comments and words are split
+ * by single spaces.
+ */
+void GcodeCanonicalStage::process(char *line) {
+    if (line[0] == 0) return;
+    char out[GCODE_LINE_MAX + 4];
+    size_t n = 0;
+    char first = (char) toupper(line[0]);
+
+    // String is copied as it is, only the code is written in canonical form
+    const char *string = gcode_string_argument(line);
+    if (string != nullptr) {
+        n = sprintf(out, "M%ld", strtol(&line[1], nullptr, 10));
+        size_t len = strlen(string);
+        if (n + len > GCODE_LINE_MAX) len = GCODE_LINE_MAX - n;
+        memcpy(&out[n], string, len);
+        out[n + len] = 0;
+        emit(out);
+        return;
+    }
+
+    // Lines with no command code
+    bool command = true;                    // First word is command code
+    if ((strchr("XYZEIJ", first) != nullptr) && (motion >= 0)) {
+        n = sprintf(out, "G%d ", motion);
+        command = false;
+    } else if ((first == 'F') && (strchr(line, ' ') == nullptr)) {
+        n = sprintf(out, "G1 ");
+        command = false;
+    } else if ((first != 'G') && (first != 'M') && (first != 'T')) {
+        command = false;                    // Parameters of a modal command printer keeps
+    }
+
+    const char *p = line;
+    while (*p != 0) {
+        if (!isalpha(*p)) {
+            out[n++] = *p++;
+            continue;
+        }
+        char letter = (char) toupper(*p++);
+        out[n++] = letter;
+        size_t start = n;
+        n += canonical_number(&p, &out[n]);
+        if (!command) continue;
+
+        command = false;
+        out[n] = 0;
+        int code = atoi(&out[start]);
+        if ((letter == 'G') && (code >= 0) && (code <= 3) && (n > start)) motion = code;
+    }
+    out[n] = 0;
+    emit(out);
+}
+
+GcodeRulesStage::GcodeRulesStage(const gcode_rule_t *rules, uint8_t rules_cnt) {
+    this->rules = rules;
+    this->rules_cnt = rules_cnt;
+}
+
+void GcodeRulesStage::process(char *line) {
+    for (uint8_t i = 0; i < rules_cnt; i++) {
+        size_t len = strlen(rules[i].from);
+        if ((strncmp(line, rules[i].from, len) != 0) || ((line[len] != 0) && (line[len] != ' '))) continue;
+        if (rules[i].to == nullptr) return;
+
+        char out[GCODE_LINE_MAX];
+        snprintf(out, sizeof(out), "%s%s", rules[i].to, &line[len]);
+        emit(out);
+        return;
+    }
+    emit(line);
+}
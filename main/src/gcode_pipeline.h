@@ -0,0 +1,135 @@
+/*
+  gcode_pipeline.h - streaming G-code transform pipeline
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_GCODE_PIPELINE_H
+#define ESP32_PRINT_GCODE_PIPELINE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define GCODE_LINE_MAX      256     // bytes, longer lines are read in parts
+#define GCODE_RULES_MAX     8       // Drop and replace rules per printer
+
+/**
+ * User rule. Lines starting with 'from' word(s) are dropped if there's no 'to',
+ * otherwise 'from' is replaced with 'to'. Rules see canonical lines, i.e. 'M106 S255'.
+ */
+typedef struct {
+    char *from;
+    char *to;
+} gcode_rule_t;
+
+class GcodePipeline;
+
+const char *gcode_string_argument(const char *line);
+
+/**
+ * One step of G-code transformation. Stage gets lines one by one and emits any number
+ * of lines for each, so it may drop, change, split or join them. Stages which hold lines
+ * back emit them on flush.
+ */
+class GcodeStage {
+private:
+    GcodeStage *next;
+    GcodePipeline *pipeline;
+
+    friend class GcodePipeline;
+
+protected:
+    void emit(char *line);
+    void emit(char *line, uint32_t file_offset);
+    [[nodiscard]] uint32_t get_file_offset() const;
+
+public:
+    GcodeStage();
+    virtual ~GcodeStage() = default;
+
+    virtual void process(char *line) = 0;
+    virtual void flush();
+    virtual void reset();
+};
+
+/**
+ * Chain of stages between file reader and printer. Lines are passed through stages in
+ * the order they were added, whatever comes out of the last one goes to sink.
+ */
+class GcodePipeline {
+private:
+    GcodeStage *first;
+    GcodeStage *last;
+    void (*sink)(const char *line, uint32_t file_offset, void *context);
+    void *sink_context;
+    uint32_t file_offset;                   // Position in file right after the line being processed
+
+    friend class GcodeStage;
+
+public:
+    GcodePipeline(void (*sink)(const char *line, uint32_t file_offset, void *context), void *context);
+    ~GcodePipeline();
+
+    void add(GcodeStage *stage);
+    void process(char *line, uint32_t file_offset);
+    void flush();
+    void reset();
+};
+
+/**
+ * Drops comments, line numbers and checksums which came with the file, and extra whitespace.
+ * String arguments of commands like M117 or M23 are left as they are, ';' and '*' included.
+ */
+class GcodeStripStage : public GcodeStage {
+public:
+    void process(char *line) override;
+};
+
+/**
+ * Writes lines in one form: upper case codes, numbers with no plus sign, leading or trailing
+ * zeros. Lines with no command are completed if it's known what they mean: 'F' only lines
+ * become 'G1 F', axis only lines repeat last motion command. Other parameter only lines, i.e.
+ * 'S' of a modal command, go to printer as they are.
+ */
+class GcodeCanonicalStage : public GcodeStage {
+private:
+    int motion;                             // Last G0-G3 command, -1 if there was none
+
+    static size_t canonical_number(const char **p, char *out);
+
+public:
+    GcodeCanonicalStage();
+
+    void process(char *line) override;
+    void reset() override;
+};
+
+/**
+ * Applies user drop and replace rules.
+ */
+class GcodeRulesStage : public GcodeStage {
+private:
+    const gcode_rule_t *rules;
+    uint8_t rules_cnt;
+
+public:
+    GcodeRulesStage(const gcode_rule_t *rules, uint8_t rules_cnt);
+
+    void process(char *line) override;
+};
+
+#endif //ESP32_PRINT_GCODE_PIPELINE_H
@@ -0,0 +1,196 @@
+/*
+  job_queue.cpp - persistent print job queue
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <esp_log.h>
+
+#include "job_queue.h"
+#include "sdcard.h"
+#include "utils.h"
+
+static const char TAG[] = "esp3d-job-queue";
+
+JobQueue::JobQueue(uint8_t printer) {
+    snprintf(path, sizeof(path), "%s%d", JOB_QUEUE_FILE, printer);
+    count = 0;
+    mutex = xSemaphoreCreateMutex();
+}
+
+JobQueue::~JobQueue() {
+    for (uint8_t i = 0; i < count; i++) free(jobs[i]);
+    vSemaphoreDelete(mutex);
+}
+
+/**
+ * Reads queue saved before restart, one file name per line.
+ */
+esp_err_t JobQueue::load() {
+    if (!sdcard_has_file(path)) return ESP_OK;
+    FILE *f = sdcard_open_file(path, "r");
+    if (f == nullptr) return ESP_FAIL;
+    char name[JOB_QUEUE_NAME_MAX];
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    while ((count < JOB_QUEUE_MAX) && (fgets(name, sizeof(name), f) != nullptr)) {
+        name[strcspn(name, "\r\n")] = 0;
+        if (name[0] != 0) jobs[count++] = strdup(name);
+    }
+    xSemaphoreGive(mutex);
+    fclose(f);
+    if (count > 0) ESP_LOGI(TAG, "%d job(s) queued", count);
+    return ESP_OK;
+}
+
+/**
+ * Internal function.
+ * Writes queue to SD card. Mutex must be taken.
+ */
+esp_err_t JobQueue::save() {
+    if (count == 0) return sdcard_delete_file(path);
+    FILE *f = sdcard_open_file(path, "w");
+    if (f == nullptr) {
+        ESP_LOGE(TAG, "Queue was not saved");
+        return ESP_FAIL;
+    }
+    for (uint8_t i = 0; i < count; i++) fprintf(f, "%s\n", jobs[i]);
+    fclose(f);
+    return ESP_OK;
+}
+
+/**
+ * Adds a file to the end of queue.
+ * @param name
+ * @return ESP_ERR_NO_MEM if queue is full
+ */
+esp_err_t JobQueue::add(const char *name) {
+    if ((name[0] == 0) || (strlen(name) >= JOB_QUEUE_NAME_MAX) || (strchr(name, '\n') != nullptr)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    esp_err_t res = ESP_ERR_NO_MEM;
+    if (count < JOB_QUEUE_MAX) {
+        jobs[count++] = strdup(name);
+        res = save();
+    }
+    xSemaphoreGive(mutex);
+    return res;
+}
+
+/**
+ * Removes a job from queue.
+ * @param position counting from 0
+ */
+esp_err_t JobQueue::remove(uint8_t position) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    esp_err_t res = ESP_ERR_INVALID_ARG;
+    if (position < count) {
+        free(jobs[position]);
+        memmove(&jobs[position], &jobs[position + 1], (count - position - 1) * sizeof(char *));
+        count--;
+        res = save();
+    }
+    xSemaphoreGive(mutex);
+    return res;
+}
+
+/**
+ * Moves a job to other place in queue, jobs in between are shifted.
+ * @param from
+ * @param to
+ */
+esp_err_t JobQueue::move(uint8_t from, uint8_t to) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    esp_err_t res = ESP_ERR_INVALID_ARG;
+    if ((from < count) && (to < count)) {
+        char *job = jobs[from];
+        if (from < to) memmove(&jobs[from], &jobs[from + 1], (to - from) * sizeof(char *));
+        else memmove(&jobs[to + 1], &jobs[to], (from - to) * sizeof(char *));
+        jobs[to] = job;
+        res = save();
+    }
+    xSemaphoreGive(mutex);
+    return res;
+}
+
+void JobQueue::clear() {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < count; i++) free(jobs[i]);
+    count = 0;
+    save();
+    xSemaphoreGive(mutex);
+}
+
+/**
+ * Gets the next job, it stays in queue.
+ * @param name
+ * @param size
+ * @return false if queue is empty
+ */
+bool JobQueue::peek(char *name, size_t size) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool res = (count > 0);
+    if (res) {
+        strncpy(name, jobs[0], size - 1);
+        name[size - 1] = 0;
+    }
+    xSemaphoreGive(mutex);
+    return res;
+}
+
+/**
+ * Removes a job which has been started. Queue may be changed since job was peeked, so it's
+ * found by its name.
+ * @param name
+ */
+void JobQueue::take(const char *name) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < count; i++) {
+        if (strcmp(jobs[i], name) != 0) continue;
+        free(jobs[i]);
+        memmove(&jobs[i], &jobs[i + 1], (count - i - 1) * sizeof(char *));
+        count--;
+        save();
+        break;
+    }
+    xSemaphoreGive(mutex);
+}
+
+/**
+ * Lists jobs as JSON array of file names.
+ * @param buf
+ * @param size JOB_QUEUE_JSON_SIZE fits any queue
+ * @return length of JSON or 0 if it did not fit
+ */
+size_t JobQueue::to_json(char *buf, size_t size) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    size_t len = snprintf(buf, size, "[");
+    for (uint8_t i = 0; (i < count) && (len + 2 < size); i++) {
+        if (i > 0) buf[len++] = ',';
+        buf[len++] = '"';
+        len += json_escape(&buf[len], size - len, jobs[i]);
+        if (len < size) len += snprintf(&buf[len], size - len, "\"");
+    }
+    if (len < size) len += snprintf(&buf[len], size - len, "]");
+    xSemaphoreGive(mutex);
+    return (len < size) ? len : 0;
+}
+
+uint8_t JobQueue::get_count() const { return count; }
@@ -0,0 +1,64 @@
+/*
+  job_queue.h - persistent print job queue
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_JOB_QUEUE_H
+#define ESP32_PRINT_JOB_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#define JOB_QUEUE_MAX           16
+#define JOB_QUEUE_FILE          "esp3d/queue"   // Printer number is appended
+#define JOB_QUEUE_NAME_MAX      96
+#define JOB_QUEUE_JSON_SIZE     (JOB_QUEUE_MAX * (JOB_QUEUE_NAME_MAX * 6 + 3) + 3)    // Every name escaped, brackets
+
+/**
+ * Files a printer prints one after another. Queue is kept on SD card, so it's there after restart.
+ * It's changed by web API and taken by print task, so every call is guarded.
+ */
+class JobQueue {
+private:
+    char path[32]{};
+    char *jobs[JOB_QUEUE_MAX]{};
+    uint8_t count;
+    SemaphoreHandle_t mutex;
+
+    esp_err_t save();
+
+public:
+    explicit JobQueue(uint8_t printer);
+    ~JobQueue();
+
+    esp_err_t load();
+    esp_err_t add(const char *name);
+    esp_err_t remove(uint8_t position);
+    esp_err_t move(uint8_t from, uint8_t to);
+    void clear();
+    bool peek(char *name, size_t size);
+    void take(const char *name);
+    size_t to_json(char *buf, size_t size);
+
+    [[nodiscard]] uint8_t get_count() const;
+};
+
+#endif //ESP32_PRINT_JOB_QUEUE_H
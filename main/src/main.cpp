@@ -20,6 +20,7 @@
 
 #include <esp_event.h>
 #include <nvs_flash.h>
+#include <driver/gpio.h>
 
 #include "wifi.h"
 #include "sdcard.h"
@@ -29,7 +30,7 @@
 #include "camera.h"
 
 Camera camera;
-Printer printer;
+Printer *printers[PRINTERS_MAX];
 Server server;
 Settings settings;
 
@@ -57,7 +58,11 @@ void app_main(void) {
     if (settings.load() == ESP_OK) {
         wifi_connect(settings.get_ssid(), settings.get_password(), settings.get_ip(), settings.get_netmask());
         server.start();
-        if (printer.init() != ESP_OK) ESP_LOGE(TAG, "No printer interface initialized!");
+        for (uint8_t i = 0; i < PRINTERS_MAX; i++) {
+            if (!settings.get_printer(i)->enabled) continue;
+            printers[i] = new Printer(i);
+            if (printers[i]->init() != ESP_OK) ESP_LOGE(TAG, "No printer %d interface initialized!", i);
+        }
         if (camera.init() != ESP_OK) ESP_LOGW(TAG, "No camera available");
     }
 }
@@ -0,0 +1,221 @@
+/*
+  motion_estimator.cpp - G-code print time estimator
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "motion_estimator.h"
+
+MotionEstimator::MotionEstimator() {
+    feedrate = MOTION_FEEDRATE / 60.0f;
+    acceleration = MOTION_ACCELERATION;
+    relative = false;
+    relative_e = false;
+    pending = false;
+    pending_len = 0;
+    pending_entry = 0;
+    pending_speed = 0;
+    time_us = 0;
+}
+
+void MotionEstimator::reset() {
+    memset(pos, 0, sizeof(pos));
+    feedrate = MOTION_FEEDRATE / 60.0f;
+    acceleration = MOTION_ACCELERATION;
+    relative = false;
+    relative_e = false;
+    pending = false;
+    time_us = 0;
+    GcodeStage::reset();
+}
+
+/**
+ * Internal function.
+ * Time a move takes with trapezoidal speed profile. If there's no room to reach cruise speed,
+ * the move accelerates to a peak and slows down at once.
+ * @param len mm
+ * @param v0 entry speed, mm/s
+ * @param v1 exit speed, mm/s
+ * @param v_max cruise speed, mm/s
+ * @param a acceleration, mm/s^2
+ * @return seconds
+ */
+float MotionEstimator::move_time(float len, float v0, float v1, float v_max, float a) {
+    float d_acc = (v_max * v_max - v0 * v0) / (2 * a);
+    float d_dec = (v_max * v_max - v1 * v1) / (2 * a);
+    if (d_acc + d_dec <= len) return (v_max - v0) / a + (v_max - v1) / a + (len - d_acc - d_dec) / v_max;
+    float v_peak = sqrtf((2 * a * len + v0 * v0 + v1 * v1) / 2);
+    if (v_peak >= v0) return (v_peak - v0) / a + (v_peak - v1) / a;
+    // Too short to slow down to v1: planner would have started braking moves ago, and those were
+    // counted as cruising at v0. Only what braking adds over that is left to count here.
+    float d_brake = (v0 * v0 - v1 * v1) / (2 * a);
+    return (v0 - v1) / a - (d_brake - len) / v0;
+}
+
+/**
+ * Internal function.
+ * Highest speed printer may go through the junction of pending move and the next one,
+ * Marlin's junction deviation rule.
+ */
+float MotionEstimator::junction_speed(const float *dir, float speed) const {
+    // Extruder only moves have zero direction, so they stop
+    if (((pending_dir[0] == 0) && (pending_dir[1] == 0) && (pending_dir[2] == 0)) ||
+        ((dir[0] == 0) && (dir[1] == 0) && (dir[2] == 0))) return 0;
+    float cos_theta = -(pending_dir[0] * dir[0] + pending_dir[1] * dir[1] + pending_dir[2] * dir[2]);
+    float v_max = fminf(pending_speed, speed);
+    if (cos_theta > 0.999999f) return 0;                // Reversal
+    if (cos_theta < -0.999999f) return v_max;           // Straight line
+    float sin_theta_d2 = sqrtf(0.5f * (1.0f - cos_theta));
+    float v = sqrtf(acceleration * MOTION_JUNCTION_DEVIATION * sin_theta_d2 / (1.0f - sin_theta_d2));
+    return fminf(v, v_max);
+}
+
+/**
+ * Internal function.
+ * Adds time of pending move, now that its exit speed is known.
+ */
+void MotionEstimator::finish_pending(float exit_speed) {
+    if (!pending) return;
+    // Can't exit faster than it accelerates to from entry
+    float reachable = sqrtf(pending_entry * pending_entry + 2 * acceleration * pending_len);
+    if (exit_speed > reachable) exit_speed = reachable;
+    time_us += (uint64_t) (move_time(pending_len, pending_entry, exit_speed, pending_speed, acceleration) * 1e6f);
+    pending = false;
+}
+
+/**
+ * Internal function.
+ * Moves to target, pending move is completed with the speed of the junction to this one.
+ */
+void MotionEstimator::add_move(const float *target, float len, float speed, const float *dir) {
+    memcpy(pos, target, sizeof(pos));
+    if ((len <= 0) || (speed <= 0)) return;
+
+    float entry = 0;
+    if (pending) {
+        entry = junction_speed(dir, speed);
+        finish_pending(entry);
+        // Previous move may have been too short to reach junction speed
+        entry = fminf(entry, sqrtf(pending_entry * pending_entry + 2 * acceleration * pending_len));
+    }
+    pending = true;
+    pending_len = len;
+    pending_entry = entry;
+    pending_speed = speed;
+    memcpy(pending_dir, dir, sizeof(pending_dir));
+}
+
+/**
+ * Line is expected to be canonical.
+ */
+void MotionEstimator::process(char *line) {
+    char command = line[0];
+    int code = atoi(&line[1]);
+
+    // Parameters, NAN if there's none
+    float values[26];
+    for (float &v : values) v = NAN;
+    for (char *p = strchr(line, ' '); p != nullptr; p = strchr(p, ' ')) {
+        p++;
+        if ((*p >= 'A') && (*p <= 'Z')) values[*p - 'A'] = strtof(p + 1, nullptr);
+    }
+    auto has = [&values](char letter) { return !std::isnan(values[letter - 'A']); };
+    auto value = [&values](char letter) { return values[letter - 'A']; };
+
+    if ((command == 'G') && (code >= 0) && (code <= 3)) {
+        if (has('F')) feedrate = value('F') / 60.0f;
+        float target[4];
+        const char axes[4] = { 'X', 'Y', 'Z', 'E' };
+        for (int i = 0; i < 4; i++) {
+            bool rel = (i == 3) ? relative_e : relative;
+            target[i] = has(axes[i]) ? (rel ? pos[i] + value(axes[i]) : value(axes[i])) : pos[i];
+        }
+        float delta[3] = { target[0] - pos[0], target[1] - pos[1], target[2] - pos[2] };
+        float len = sqrtf(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]);
+        float dir[3] = { 0, 0, 0 };
+        if (len > 0) for (int i = 0; i < 3; i++) dir[i] = delta[i] / len;
+
+        if ((code >= 2) && (has('I') || has('J'))) {
+            // Arc length from its center, direction is taken along the chord
+            float i = has('I') ? value('I') : 0, j = has('J') ? value('J') : 0;
+            float r = sqrtf(i * i + j * j);
+            float a0 = atan2f(-j, -i), a1 = atan2f(target[1] - pos[1] - j, target[0] - pos[0] - i);
+            float angle = (code == 2) ? a0 - a1 : a1 - a0;
+            if (angle <= 0) angle += 2 * (float) M_PI;
+            len = sqrtf(r * angle * r * angle + delta[2] * delta[2]);
+        }
+        if (len == 0) len = fabsf(target[3] - pos[3]);     // Extruder only move
+        add_move(target, len, feedrate, dir);
+    } else if (command == 'G') {
+        switch (code) {
+            case 4:
+                finish_pending(0);
+                if (has('P')) time_us += (uint64_t) (value('P') * 1000);
+                else if (has('S')) time_us += (uint64_t) (value('S') * 1000000);
+                break;
+            case 28:
+                finish_pending(0);
+                time_us += (uint64_t) MOTION_HOMING_TIME * 1000;
+                if (!has('X') && !has('Y') && !has('Z')) pos[0] = pos[1] = pos[2] = 0;
+                else for (int i = 0; i < 3; i++) if (has((char) ('X' + i))) pos[i] = 0;
+                break;
+            case 90: relative = false; break;
+            case 91: relative = true; break;
+            case 92: {
+                const char axes[4] = { 'X', 'Y', 'Z', 'E' };
+                for (int i = 0; i < 4; i++) if (has(axes[i])) pos[i] = value(axes[i]);
+                break;
+            }
+            default: break;
+        }
+    } else if (command == 'M') {
+        switch (code) {
+            case 82: relative_e = false; break;
+            case 83: relative_e = true; break;
+            case 204:
+                if (has('S')) acceleration = value('S');
+                else if (has('P')) acceleration = value('P');
+                if (acceleration <= 0) acceleration = MOTION_ACCELERATION;
+                break;
+            default: break;
+        }
+    }
+    emit(line);
+}
+
+void MotionEstimator::flush() {
+    finish_pending(0);
+    GcodeStage::flush();
+}
+
+/**
+ * Gets estimated time of everything passed so far, but the last move.
+ * @return ms
+ */
+uint32_t MotionEstimator::get_time() const { return (uint32_t) (time_us / 1000); }
+
+/**
+ * Gets position after everything passed so far.
+ * @param axis 0..3 for X, Y, Z, E
+ * @return mm
+ */
+float MotionEstimator::get_position(uint8_t axis) const { return (axis < 4) ? pos[axis] : 0; }
@@ -0,0 +1,73 @@
+/*
+  motion_estimator.h - G-code print time estimator
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_MOTION_ESTIMATOR_H
+#define ESP32_PRINT_MOTION_ESTIMATOR_H
+
+#include <cstdint>
+
+#include "gcode_pipeline.h"
+
+#define MOTION_ACCELERATION         1000    // mm/s^2, until G-code sets it with M204
+#define MOTION_FEEDRATE             1500    // mm/min, until G-code sets it
+#define MOTION_JUNCTION_DEVIATION   0.013f  // mm, Marlin's default
+#define MOTION_HOMING_TIME          15000   // ms G28 takes
+
+/**
+ * Estimates how long printer takes to run G-code, the way Marlin's planner moves: each move
+ * accelerates from its entry speed, cruises and slows down to its exit speed, and speed at
+ * the junction of two moves is limited by the angle between them. Only one move is looked
+ * ahead, so the estimate is a bit optimistic on long chains of short moves. Heating waits
+ * are not counted. Lines pass through as they are.
+ */
+class MotionEstimator : public GcodeStage {
+private:
+    float pos[4]{};                 // X, Y, Z, E, mm
+    float feedrate;                 // mm/s
+    float acceleration;             // mm/s^2
+    bool relative;                  // G91
+    bool relative_e;                // M83
+
+    // Previous move, its time is known when its exit speed is, i.e. when the next move comes
+    bool pending;
+    float pending_len;
+    float pending_entry;            // mm/s
+    float pending_speed;
+    float pending_dir[3]{};         // Unit vector, zero for extruder only moves
+
+    uint64_t time_us;
+
+    void add_move(const float *target, float len, float speed, const float *dir);
+    void finish_pending(float exit_speed);
+    [[nodiscard]] float junction_speed(const float *dir, float speed) const;
+    static float move_time(float len, float v0, float v1, float v_max, float a);
+
+public:
+    MotionEstimator();
+
+    void process(char *line) override;
+    void flush() override;
+    void reset() override;
+
+    [[nodiscard]] uint32_t get_time() const;
+    [[nodiscard]] float get_position(uint8_t axis) const;
+};
+
+#endif //ESP32_PRINT_MOTION_ESTIMATOR_H
@@ -0,0 +1,155 @@
+/*
+  print_journal.cpp - print job recovery journal
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/param.h>
+#include <nvs.h>
+#include <esp_log.h>
+
+#include "print_journal.h"
+
+static const char TAG[] = "esp3d-journal";
+
+/**
+ * Internal function.
+ * Journal of each printer has a key of its own.
+ */
+static void journal_key(char *key, uint8_t printer) {
+    sprintf(key, "journal%d", printer);
+}
+
+/**
+ * Saves journal to NVS. It's not meant to be called for every command, NVS spreads writes over
+ * its pages, still each one wears flash out a bit.
+ * @param printer
+ * @param journal
+ */
+esp_err_t print_journal_save(uint8_t printer, const print_journal_t *journal) {
+    char key[16];
+    journal_key(key, printer);
+    nvs_handle_t handle;
+    esp_err_t res = nvs_open(PRINT_JOURNAL_NAMESPACE, NVS_READWRITE, &handle);
+    if (res != ESP_OK) return res;
+    res = nvs_set_blob(handle, key, journal, sizeof(print_journal_t));
+    if (res == ESP_OK) res = nvs_commit(handle);
+    nvs_close(handle);
+    if (res != ESP_OK) ESP_LOGE(TAG, "Journal was not saved: %s", esp_err_to_name(res));
+    return res;
+}
+
+/**
+ * Loads journal of a print job which was not finished.
+ * @param printer
+ * @param journal
+ * @return false if there's no such job
+ */
+bool print_journal_load(uint8_t printer, print_journal_t *journal) {
+    char key[16];
+    journal_key(key, printer);
+    nvs_handle_t handle;
+    if (nvs_open(PRINT_JOURNAL_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return false;
+    size_t size = sizeof(print_journal_t);
+    esp_err_t res = nvs_get_blob(handle, key, journal, &size);
+    nvs_close(handle);
+    return (res == ESP_OK) && (size == sizeof(print_journal_t)) && (journal->version == PRINT_JOURNAL_VERSION);
+}
+
+/**
+ * Deletes journal, job it was kept for is over.
+ * @param printer
+ */
+void print_journal_clear(uint8_t printer) {
+    char key[16];
+    journal_key(key, printer);
+    nvs_handle_t handle;
+    if (nvs_open(PRINT_JOURNAL_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return;
+    if (nvs_erase_key(handle, key) == ESP_OK) nvs_commit(handle);
+    nvs_close(handle);
+}
+
+/**
+ * Updates modal state with a printed command. Command must be canonical, as pipeline
+ * makes it: upper case codes, words separated by one space, no comments.
+ * @param modal
+ * @param command
+ */
+void print_journal_track(print_modal_t *modal, const char *command) {
+    if ((command[0] != 'G') && (command[0] != 'M')) return;
+    int code = atoi(&command[1]);
+    if (command[0] == 'G') {
+        if ((code < 0) || ((code > 3) && (code != 90) && (code != 91) && (code != 92))) return;
+        if (code == 90) modal->relative = false;
+        else if (code == 91) modal->relative = true;
+        else for (const char *p = strchr(command, ' '); p != nullptr; p = strchr(p + 1, ' ')) {
+            float value = strtof(&p[2], nullptr);
+            switch (p[1]) {
+                case 'Z': modal->z = ((code != 92) && modal->relative) ? modal->z + value : value; break;
+                case 'E': modal->e = ((code != 92) && modal->relative_e) ? modal->e + value : value; break;
+                case 'F': if (code != 92) modal->feedrate = value; break;
+                default: break;
+            }
+        }
+    } else {
+        switch (code) {
+            case 82: modal->relative_e = false; break;
+            case 83: modal->relative_e = true; break;
+            case 106: {
+                // Only the first fan is kept, it's the part cooling one
+                const char *p = strstr(command, " P");
+                if ((p != nullptr) && (atoi(&p[2]) != 0)) break;
+                const char *s = strstr(command, " S");
+                modal->fan = (s != nullptr) ? (uint8_t) MIN(MAX(atoi(&s[2]), 0), 255) : 255;
+                break;
+            }
+            case 107: modal->fan = 0; break;
+            default: break;
+        }
+    }
+}
+
+/**
+ * Makes commands that get printer ready to go on with the job: it's heated, Z is lifted off
+ * the print and X and Y are homed. Z is not homed, the print is in the way, so printer is told
+ * Z is where it was left. Then the state job had is set back.
+ * @param journal
+ * @param buf commands separated with newlines
+ * @param size
+ * @return length of commands, or 0 if buffer is too small
+ */
+size_t print_journal_preamble(const print_journal_t *journal, char *buf, size_t size) {
+    const print_modal_t *modal = &journal->modal;
+    char fan[16], feedrate[16];
+    if (modal->fan > 0) sprintf(fan, "M106 S%d", modal->fan); else strcpy(fan, "M107");
+    if (modal->feedrate > 0) sprintf(feedrate, "G1 F%.0f", modal->feedrate); else feedrate[0] = 0;
+    int len = snprintf(buf, size,
+                       "M140 S%.0f\nM104 S%.0f\n"
+                       "G92 Z%.3f\nG91\nG1 Z%d F%d\nG90\nG28 X Y\n"
+                       "M190 S%.0f\nM109 S%.0f\n"
+                       "%s\nG92 E%.5f\n%s\n"
+                       "G1 Z%.3f F%d\n%s\n%s\n",
+                       journal->temp_bed, journal->temp_hot_end,
+                       modal->z, PRINT_JOURNAL_LIFT, PRINT_JOURNAL_Z_FEEDRATE,
+                       journal->temp_bed, journal->temp_hot_end,
+                       modal->relative_e ? "M83" : "M82", modal->e, fan,
+                       modal->z, PRINT_JOURNAL_Z_FEEDRATE, feedrate, modal->relative ? "G91" : "G90");
+    return ((len > 0) && ((size_t) len < size)) ? len : 0;
+}
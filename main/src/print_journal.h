@@ -0,0 +1,63 @@
+/*
+  print_journal.h - print job recovery journal
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_PRINT_JOURNAL_H
+#define ESP32_PRINT_PRINT_JOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <esp_err.h>
+
+#define PRINT_JOURNAL_NAMESPACE "esp3d"     // NVS namespace
+#define PRINT_JOURNAL_VERSION   2
+#define PRINT_JOURNAL_NAME_MAX  96
+#define PRINT_JOURNAL_LIFT      2           // mm Z is lifted off the print before X and Y are homed
+#define PRINT_JOURNAL_Z_FEEDRATE 600        // mm/min
+
+/**
+ * Modal state print commands leave printer in.
+ */
+typedef struct {
+    float z, e;                     // mm
+    float feedrate;                 // mm/min
+    uint8_t fan;                    // 0..255
+    bool relative;                  // G91
+    bool relative_e;                // M83
+} print_modal_t;
+
+/**
+ * What it takes to resume a print job after the module or printer was restarted.
+ */
+typedef struct {
+    uint16_t version;
+    char file_name[PRINT_JOURNAL_NAME_MAX];
+    uint32_t file_offset;           // Position in file right after the last command printer confirmed
+    print_modal_t modal;            // State after that command
+    float temp_hot_end;             // Target temperatures
+    float temp_bed;
+} print_journal_t;
+
+esp_err_t print_journal_save(uint8_t printer, const print_journal_t *journal);
+bool print_journal_load(uint8_t printer, print_journal_t *journal);
+void print_journal_clear(uint8_t printer);
+void print_journal_track(print_modal_t *modal, const char *command);
+size_t print_journal_preamble(const print_journal_t *journal, char *buf, size_t size);
+
+#endif //ESP32_PRINT_PRINT_JOURNAL_H
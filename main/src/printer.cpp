@@ -20,25 +20,41 @@
 
 #include <cmath>
 #include <cstring>
+#include <esp_heap_caps.h>
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
 
 #include "server.h"
 #include "printer.h"
+#include "reports.h"
 #include "settings.h"
+#include "sdcard.h"
+#include "uart_transport.h"
+#include "virtual_printer.h"
 
-#define TIMEOUT_VALUE                   5000
+#define TIMEOUT_VALUE                   5000    // ms printer may say nothing at all before it is considered gone
+#define BUSY_TIMEOUT_VALUE              10000   // ms to wait for next busy keepalive or for a move to finish
 #define COMMAND_PING                    "M105\n"
+#define COMMAND_CAPABILITIES            "M115\n"
+#define CAPS_TIMEOUT                    3000    // ms to wait for M115 answer
+#define COMMAND_AUTOREPORT_TEMP         "M155 S2\n"    // Report temperatures every 2 seconds
+#define COMMAND_AUTOREPORT_POSITION     "M154 S2\n"    // Report position every 2 seconds
+#define AUTOREPORT_TIMEOUT              6000    // ms without reports after which auto-report is considered off
+#define POLL_INTERVAL_IDLE              1000    // ms
+#define POLL_INTERVAL_PRINTING          5000    // ms, polls take slots motion commands could use
+#define COMMAND_CANCEL_WAIT             "M108"  // Breaks heating waits
+#define COMMAND_QUICK_STOP              "M410"  // Drops planned moves
+#define COMMAND_KILL                    "M112"
 #define PRINTER_TASK_STACK_SIZE         4096
 #define PRINTER_TASK_STATE_STACK_SIZE   2048
 
-extern Printer printer;
 extern Server server;
 extern Settings settings;
 
 static const char TAG[] = "esp3d-printer";
 
-Printer::Printer() {
+Printer::Printer(uint8_t index) {
+    this->index = index;
     state = {
             .connected = false,
             .status = PRINTER_IDLE,
@@ -48,145 +64,433 @@ Printer::Printer() {
             .temp_hot_end_target = 0,
             .temp_bed = 0,
             .temp_bed_target = 0,
+            .pos_x = 0,
+            .pos_y = 0,
+            .pos_z = 0,
+            .pos_e = 0,
+            .caps_requested = false,
+            .caps_time = 0,
+            .autoreport = AUTOREPORT_UNKNOWN,
+            .temp_report_time = 0,
+            .poll_time = 0,
+            .advanced_ok = false,
+            .planner_free = -1,
+            .buffer_free = -1,
             .printing_stop = false,
+            .printing_failed = false,
             .print_file = nullptr,
+            .print_cache = nullptr,
+            .print_cache_commands = 0,
+            .print_time_total = 0,
+            .print_time_index = nullptr,
+            .print_time_index_entries = 0,
+            .print_layers = nullptr,
+            .print_layers_cnt = 0,
+            .journal = {},
+            .job_changing = false,
+            .job_boundary = 0,
+            .journal_time = 0,
+            .recovery = {},
+            .has_recovery = false,
+            .progress_reported = -1,
+            .remaining_reported = -1,
             .print_file_bytes = 0,
-            .print_file_bytes_sent = 0
+            .print_file_bytes_sent = 0,
+            .sd_print_bytes = 0,
+            .sd_print_file_bytes = 0,
+            .last_report = {}
     };
+    caps = {};
     last_sent_command_time = 0;
+    last_report_time = 0;
+    report_received = false;
     uart = nullptr;
+    transfer = nullptr;
+    pipeline = nullptr;
+    cache_pipeline = nullptr;
+    arc_fitter = nullptr;
+    cache_arc_fitter = nullptr;
+    reader = nullptr;
+    queue = nullptr;
 }
 
 /**
- * Parses Marlin temperature report string and updates the status,
- * which looks like this: T:248.34 /245.00 B:100.81 /100.00 @:33 B@:128 W:9
+ * Updates the status with Marlin temperature report.
  * @param report
  */
 void Printer::parse_temperature_report(const char *report) {
-    ESP_LOGI(TAG, "Parsing temperature report");
-
-    unsigned short flag = 0, cnt = 0, pos = 0;
-    char val[10];
-    do {
-        unsigned short len;
-        switch (report[cnt]) {
-            case 'T': flag = (1 << 0); break;
-            case 'B': flag = (1 << 1); break;
-            case '@': if (flag & (1 << 1)) flag = ((1 << 2) | (1 << 1)); else flag = ((1 << 2) | (1 << 0)); break;
-            case ':': case '/':  // Save position
-                pos = cnt + 1;
-                if (report[cnt] == '/') flag |= (1 << 3);       // Target
-                break;
-            case 'W': flag = (1 << 5); break;
-            case ' ': case 0: // 0 is EOL
-                len = (cnt - pos > 9) ? 10 : cnt - pos;
-                strncpy(val, &report[pos], len);
-                val[len] = 0;
-                char *end;
-                float val_f = strtof(val, &end);
-                if (flag & (1 << 0)) {
-                    if (flag & (1 << 3)) { state.temp_hot_end_target = val_f; flag = 0; }
-                    else if (flag & (1 << 2)) { } // Power
-                    else state.temp_hot_end = val_f;
-                } else if (flag & (1 << 1)) {
-                    if (flag & (1 << 3)) { state.temp_bed_target = val_f; flag = 0; }
-                    else if (flag & (1 << 2)) { } // Power
-                    else state.temp_bed = val_f;
-                }
-                break;
-        }
-    } while (report[cnt++] != 0);
+    report_parse_temperatures(report, &state.temp_hot_end, &state.temp_hot_end_target, &state.temp_bed,
+                              &state.temp_bed_target);
+    state.temp_report_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (state.autoreport == AUTOREPORT_REQUESTED) {
+        ESP_LOGI(TAG, "Printer reports temperatures by itself, polling disabled");
+        state.autoreport = AUTOREPORT_ON;
+    }
+    state.status_updated = true;
+}
 
+/**
+ * Updates the status with Marlin position report.
+ * @param report
+ */
+void Printer::parse_position_report(const char *report) {
+    report_parse_position(report, &state.pos_x, &state.pos_y, &state.pos_z, &state.pos_e);
     state.status_updated = true;
 }
 
+/**
+ * Sliding window follows free buffer slots, when printer reports them with 'ok' (ADVANCED_OK).
+ * @param report
+ */
+void Printer::parse_ok_report(const char *report) {
+    int planner_free, buffer_free;
+    if (report_parse_ok(report, &planner_free, &buffer_free)) {
+        if (!state.advanced_ok) ESP_LOGI(TAG, "Printer reports free buffer slots, sliding window enabled");
+        state.advanced_ok = true;
+        state.planner_free = planner_free;
+        state.buffer_free = buffer_free;
+        uart->set_free_slots(buffer_free);
+    }
+}
+
 /**
  * UART calls this method to get to know if it can send a command once again,
- * because there was a timeout.
+ * because there was a timeout. Timeout depends on command printer is working on: lost
+ * lines are noticed as soon as printer is late compared to its usual answers, while
+ * busy printer is waited for as long as it sends keepalives.
  * @return
  */
 bool Printer::is_timeout() {
     if (last_sent_command_time == 0) return false; // It can't be timeout when no command sent
-    if (uart->is_locked()) return false;
+    unsigned int timeout = uart->is_locked() ? BUSY_TIMEOUT_VALUE : uart->get_response_timeout();
+
+    // 'ok' for a move waits for planner to free a block, which takes as long as the move
+    if (state.advanced_ok && (state.planner_free == 0) && (timeout < BUSY_TIMEOUT_VALUE)) {
+        timeout = BUSY_TIMEOUT_VALUE;
+    }
+
     unsigned int current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    return ((current_time - last_sent_command_time) > TIMEOUT_VALUE); // 5sec is a timeout
+    return ((current_time - last_sent_command_time) > timeout);
 }
 
+/**
+ * Lost lines are re-sent by UART, printer is considered gone only if it says nothing at all.
+ * Lines are not timed as they come, timeouts are far apart enough to tell when printer spoke.
+ */
 void Printer::on_timeout() {
+    unsigned int current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    last_sent_command_time = current_time;
+    if (report_received) {
+        report_received = false;
+        last_report_time = current_time;
+    }
+    if (current_time - last_report_time < TIMEOUT_VALUE) return;
+
     state.connected = false;
+    state.caps_requested = false;           // Printer may come back with other firmware or settings
+    state.autoreport = AUTOREPORT_UNKNOWN;
     state.status_updated = true;
 }
 
 /**
  * When UART sends data to printer it calls this method to let printer know,
- * that command was sent and handle this fact i.e. start counting seconds to timeout.
+ * that command was sent and handle this fact i.e. start counting time to timeout.
+ * Time is counted from the oldest command printer hasn't answered.
  */
 void Printer::command_sent() {
-    last_sent_command_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (last_sent_command_time == 0) last_sent_command_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
 }
 
-bool Printer::parse_report(const char *report) {
-    strcpy(state.last_report, report); // Save last report
-
+/**
+ * Parses a line received from printer. Line is zero terminated and has no newline.
+ * Line type is told by its first bytes and the line is passed to its handler in place.
+ * @param report
+ * @param len length of the line
+ * @return true if it confirms a command
+ */
+bool Printer::parse_report(const char *report, size_t len) {
 #ifdef DEBUG
     ESP_LOGI(TAG, "Got report %s", report);
 #endif
+    report_received = true;
 
-    // ok - confirmed message from printer. Each sent command MUST be answered with
-    // 'ok'. Even if it was unknown command, Marlin answers 'ok' with preceding 'echo'.
-    if ((report[0] == 'o') && (report[1] == 'k')) {
-        last_sent_command_time = 0; // Reset timeout
+    switch (report[0]) {
+        case 'o':
+            // ok - confirmed message from printer. Each sent command MUST be answered with
+            // 'ok'. Even if it was unknown command, Marlin answers 'ok' with preceding 'echo'.
+            if (report[1] == 'k') return parse_ok(report);
+            break;
+        case 'T':
+            if (report[1] == ':') {
+                parse_temperature_report(report);
+                return false;
+            }
+            break;
+        case ' ':
+            if ((report[1] == 'T') && (report[2] == ':')) {
+                parse_temperature_report(&report[1]);
+                return false;
+            }
+            break;
+        case 'X':
+            if (report[1] == ':') {
+                parse_position_report(report);
+                return false;
+            }
+            break;
+        case 'R':
+            // Printer asks to re-send lines starting from given one, it is followed by 'ok'
+            if (strncmp(report, "Resend:", 7) == 0) {
+                uart->resend(strtoul(&report[7], nullptr, 10));
+                return false;
+            }
+            break;
+        case 'r':
+            if ((report[1] == 's') && (report[2] == ' ')) {
+                uart->resend(strtoul(&report[3], nullptr, 10));
+                return false;
+            }
+            break;
+        case 'e':
+            if (strncmp(report, "echo:", 5) == 0) parse_echo_report(&report[5]);
+            break;
+        case 'E':
+            if (strncmp(report, "Error:", 6) == 0) parse_error_report(&report[6]);
+            break;
+        case '/':
+            if (strncmp(report, "//action:", 9) == 0) parse_action(&report[9]);
+            break;
+        case 'S':
+        case 'N':
+        case 'D':
+            if (parse_sd_report(report)) return false;
+            break;
+        case 'F':
+        case 'C':
+            if (caps_parse_line(report, &caps)) {
+                if (report[0] == 'F') ESP_LOGI(TAG, "Printer firmware: %s", caps.firmware_name);
+                return false;
+            }
+            break;
+        case 's':
+            if (strcmp(report, "start") == 0) {                 // Printer was reset
+                state.caps_requested = false;
+                state.autoreport = AUTOREPORT_UNKNOWN;
+            }
+            break;
+        case 'm':
+            if (strncmp(report, "measured", 8) == 0) ESP_LOGI(TAG, "Got probe report %s", report);
+            break;
+        default:
+            break;
+    }
+
+    // Save last message, reports and confirmations are too frequent and parsed already
+    if (len >= sizeof(state.last_report)) len = sizeof(state.last_report) - 1;
+    memcpy(state.last_report, report, len);
+    state.last_report[len] = 0;
+    return false;
+}
+
+/**
+ * Internal function.
+ * Handles 'ok', which confirms a command.
+ * @param report
+ * @return true
+ */
+bool Printer::parse_ok(const char *report) {
+    // Reset timeout or restart it if there are more commands in flight
+    last_sent_command_time = (uart->get_in_flight() > 1) ? xTaskGetTickCount() * portTICK_PERIOD_MS : 0;
+    parse_ok_report(report);
 #ifdef DEBUG
-        ESP_LOGI(TAG, "Confirmed #%lu", uart->get_command_id_confirmed());
+    ESP_LOGI(TAG, "Confirmed #%lu", uart->get_command_id_confirmed());
 #endif
-        if ((report[2] != 0) && (report[2] != '\n')) {
-            // Temperature report may be after 'ok', so we need to get it here
-            if (strncmp(&report[3], "T:", 2) == 0) parse_temperature_report(&report[3]);
-        }
-        if (state.status == PRINTER_BUSY) state.status = PRINTER_IDLE;
-        state.connected = true;
-        uart->lock(false);
-        return true;
+    if ((report[2] != 0) && (report[2] != '\n')) {
+        // Temperature report may be after 'ok', so we need to get it here
+        if (strncmp(&report[3], "T:", 2) == 0) parse_temperature_report(&report[3]);
     }
+    if (state.status == PRINTER_BUSY) state.status = PRINTER_IDLE;
+    state.connected = true;
+    uart->lock(false);
+    return true;
+}
 
-    if (strncmp(report, "echo:busy: ", 11) == 0) {
+/**
+ * Internal function.
+ * Handles 'echo:' messages, the ones which matter are busy keepalive and unknown command.
+ * @param msg message after 'echo:'
+ */
+void Printer::parse_echo_report(const char *msg) {
+    if (strncmp(msg, "busy: ", 6) == 0) {
+        // Printer is alive and working on a command, so timeout starts over
+        if (last_sent_command_time != 0) last_sent_command_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
         uart->lock(true);
-        if (state.status != PRINTER_PRINTING) state.status = PRINTER_BUSY;
+        if ((state.status != PRINTER_PRINTING) && (state.status != PRINTER_TRANSFERRING)) state.status = PRINTER_BUSY;
+    } else if (strncmp(msg, "Unknown command: \"M155", 22) == 0) {
+        ESP_LOGI(TAG, "Printer can't report temperatures by itself, polling enabled");
+        state.autoreport = AUTOREPORT_OFF;
     }
-    else if (strncmp(report, "T:", 2) == 0) parse_temperature_report(report);
-    else if (strncmp(report, " T:", 3) == 0) parse_temperature_report(&report[1]);
-    else if (strncmp(report, "X:", 2) == 0) ESP_LOGI(TAG, "Got position report %s", report);
-    else if (strncmp(report, "measured", 8) == 0) ESP_LOGI(TAG, "Got probe report %s", report);
+}
 
-    return false;
+/**
+ * Internal function.
+ * Handles 'Error:' messages. Line errors are followed by resend request and are handled there,
+ * but when printer halts, print job can't go on.
+ * @param msg message after 'Error:'
+ */
+void Printer::parse_error_report(const char *msg) {
+    if (strncmp(msg, "Printer halted", 14) == 0) {
+        ESP_LOGE(TAG, "Printer halted");
+        if (state.status == PRINTER_PRINTING) state.printing_stop = true;
+    } else ESP_LOGW(TAG, "Printer error: %s", msg);
+}
+
+/**
+ * Internal function.
+ * Handles host actions printer asks for, i.e. when job is cancelled from printer's display.
+ * @param action action after '//action:'
+ */
+void Printer::parse_action(const char *action) {
+    if (strcmp(action, "cancel") == 0) {
+        ESP_LOGI(TAG, "Printer asks to cancel print job");
+        if (state.status == PRINTER_PRINTING) stop();
+    } else if ((strcmp(action, "pause") == 0) || (strcmp(action, "paused") == 0)) {
+        ESP_LOGI(TAG, "Printer paused");
+    } else if ((strcmp(action, "resume") == 0) || (strcmp(action, "resumed") == 0)) {
+        ESP_LOGI(TAG, "Printer resumed");
+    }
 }
 
 /**
- * Task function. Printer ping cycle. Executed every second if there's nothing in buffer to send.
+ * Internal function.
+ * Parses printer's own SD card print status (M27), which looks like this:
+ * SD printing byte 1234/56789, Not SD printing or Done printing file.
+ * @param report
+ * @return true if it was SD status
+ */
+bool Printer::parse_sd_report(const char *report) {
+    if (strncmp(report, "SD printing byte ", 17) == 0) {
+        char *end;
+        state.sd_print_bytes = strtoul(&report[17], &end, 10);
+        state.sd_print_file_bytes = (*end == '/') ? strtoul(end + 1, nullptr, 10) : 0;
+    } else if ((strcmp(report, "Not SD printing") == 0) || (strcmp(report, "Done printing file") == 0)) {
+        state.sd_print_bytes = 0;
+        state.sd_print_file_bytes = 0;
+    } else return false;
+    state.status_updated = true;
+    return true;
+}
+
+/**
+ * Internal function.
+ * Makes printer report its status. When printer gets connected, it's asked for its capabilities
+ * with M115. Then it's asked to report temperatures and position by itself (M155, M154) if it can,
+ * or if it didn't answer M115. If it can't, or reports stop coming, temperatures are polled
+ * with M105, less often while printing.
+ */
+void Printer::request_status() {
+    // Commands are not sent during transfer, but its progress is reported
+    if (state.status == PRINTER_TRANSFERRING) {
+        state.status_updated = true;
+        return;
+    }
+
+    unsigned int current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (state.connected && !state.caps_requested) {
+        caps = {};
+        send_cmd(COMMAND_CAPABILITIES, COMMAND_SOURCE_STATUS, 0, portMAX_DELAY);
+        state.caps_requested = true;
+        state.caps_time = current_time;
+        return;
+    }
+
+    switch (state.autoreport) {
+        case AUTOREPORT_UNKNOWN:
+            if (!state.connected) break;
+            if (!caps.received && (current_time - state.caps_time < CAPS_TIMEOUT)) return;    // Wait for M115 answer
+            if (caps.received && !caps.serial_xon_xoff && (uart->get_flow_control() == FLOW_CONTROL_XON_XOFF)) {
+                ESP_LOGW(TAG, "Printer does not support XON/XOFF, sending is paced by 'ok' instead");
+                uart->set_flow_control(FLOW_CONTROL_NONE);
+            }
+            if ((arc_fitter != nullptr) && (caps.received && caps.arc_support)) {
+                arc_fitter->set_enabled(true);
+                cache_arc_fitter->set_enabled(true);
+            } else if (arc_fitter != nullptr) {
+                ESP_LOGW(TAG, "Printer does not support arcs (ARC_SUPPORT), G-code is sent as it is");
+            }
+            if (caps.received && !caps.autoreport_temp) {
+                ESP_LOGI(TAG, "Printer can't report temperatures by itself, polling enabled");
+                state.autoreport = AUTOREPORT_OFF;
+                break;
+            }
+            // Position auto-report is optional, printer without it just answers 'Unknown command'
+            send_cmd(COMMAND_AUTOREPORT_TEMP, COMMAND_SOURCE_STATUS, 0, portMAX_DELAY);
+            if (!caps.received || caps.autoreport_pos) {
+                send_cmd(COMMAND_AUTOREPORT_POSITION, COMMAND_SOURCE_STATUS, 0, portMAX_DELAY);
+            }
+            state.temp_report_time = current_time;
+            state.autoreport = AUTOREPORT_REQUESTED;
+            return;
+        case AUTOREPORT_REQUESTED:
+        case AUTOREPORT_ON:
+            if (current_time - state.temp_report_time < AUTOREPORT_TIMEOUT) return;
+            ESP_LOGW(TAG, "Printer does not report temperatures by itself, polling enabled");
+            state.autoreport = AUTOREPORT_OFF;
+            break;
+        case AUTOREPORT_OFF:
+            break;
+    }
+
+    if (state.status_requested || (state.status == PRINTER_BUSY)) return;
+    unsigned int interval = (state.status == PRINTER_PRINTING) ? POLL_INTERVAL_PRINTING : POLL_INTERVAL_IDLE;
+    if (current_time - state.poll_time < interval) return;
+
+    // Wait until ping request is added
+    send_cmd(COMMAND_PING, COMMAND_SOURCE_STATUS, 0, portMAX_DELAY);
+    state.poll_time = current_time;
+    state.status_requested = true;
+}
+
+/**
+ * Task function. Printer status cycle. Sends status to web clients when it's updated
+ * and requests it from printer.
  * @param args
  */
 [[noreturn]] void Printer::task_status_report(void *args) {
     auto p = (Printer *) args;
     while (true) {
         if (p->state.status_updated) {
-            server.send_status_ws();
+            server.send_status_ws(p);
             p->state.status_updated = false;
             p->state.status_requested = false;
-        } else if (!p->state.status_requested && (p->state.status != PRINTER_BUSY)) {
-            // Wait until ping request is added
-            while (p->get_uart()->send(COMMAND_PING) == 0) vTaskDelay(10 / portTICK_PERIOD_MS);
-            p->state.status_requested = true;
-        }
-        vTaskDelay(500 / portTICK_PERIOD_MS);  // Wait 0.5 sec, total cycle request-update takes ~1sec
+        } else p->request_status();
+        p->report_progress();
+        p->save_journal();
+        vTaskDelay(500 / portTICK_PERIOD_MS);  // Wait 0.5 sec
     }
 }
 
 [[noreturn]] void Printer::task_state_log(void *args) {
     auto p = (Printer *) args;
     while (true) {
-        ESP_LOGI(TAG, "Command log: sent #%lu, lock: %d, last report: '%s'",
-                 p->uart->get_command_id_sent(), p->uart->is_locked(), p->state.last_report);
-        //ESP_LOGI(TAG, "Command log: head #%d, tail #%d", p->uart->get_buffer_head(), p->uart->get_buffer_tail());
+        int64_t latency, latency_avg, latency_max;
+        p->uart->get_ok_tx_latency(&latency, &latency_avg, &latency_max);
+        ESP_LOGI(TAG, "Printer %d command log: sent #%lu, in flight: %d/%d, lock: %d, last report: '%s'",
+                 p->index, p->uart->get_command_id_sent(), p->uart->get_in_flight(), p->uart->get_window(),
+                 p->uart->is_locked(), p->state.last_report);
+        ESP_LOGI(TAG, "ok -> TX latency: last %lldus, avg %lldus, max %lldus", latency, latency_avg, latency_max);
+        ESP_LOGI(TAG, "Response timeout: commands %lums, moves %lums",
+                 (unsigned long) p->uart->get_class_timeout(RESPONSE_CLASS_FAST),
+                 (unsigned long) p->uart->get_class_timeout(RESPONSE_CLASS_MOVE));
+        p->uart->get_stop_latency(&latency, &latency_max);
+        ESP_LOGI(TAG, "Stop latency: last %lldus, max %lldus", latency, latency_max);
+        ESP_LOGI(TAG, "Command log: %lu command(s) queued", (unsigned long) p->uart->get_queued());
+        ESP_LOGI(TAG, "File reader: %lu stall(s)", (unsigned long) p->reader->get_stalls());
+        auto arcs = (p->state.print_cache != nullptr) ? p->cache_arc_fitter : p->arc_fitter;
+        if (arcs != nullptr) {
+            ESP_LOGI(TAG, "Arc fitting: %lu command(s) and %lu bytes less this job",
+                     (unsigned long) arcs->get_commands_saved(), (unsigned long) arcs->get_bytes_saved());
+        }
         vTaskDelay(1000 / portTICK_PERIOD_MS);  // Wait 1 sec
     }
 }
@@ -196,48 +500,156 @@ void Printer::task_print(void *arg) {
     while (true) {
         auto f = p->get_opened_file();
         if (f != nullptr) {
-            char line[80];
             ESP_LOGI(TAG, "Starting print...");
             p->state.status = PRINTER_PRINTING;
-            while (fgets(line, 80, f) != nullptr) {
-#ifdef DEBUG
-                ESP_LOGI(TAG, "Got line: %s", line);
-#endif
-                p->state.print_file_bytes_sent += strlen(line); // To track progress
-                if ((line[0] != 'G') && (line[0] != 'M')) continue; // Send only M and G codes
-                while (!p->send_cmd(line)) {
-                    // If we haven't managed to send because buffer was full,
-                    // then we wait 100ms and try again.
-                    vTaskDelay(100 / portTICK_PERIOD_MS); // 100ms delay
-                }
-
-                // Handle print stop signal
-                if (p->state.printing_stop) {
-                    p->state.printing_stop = false;
-                    p->state.print_file = nullptr;
-                    p->send_stop_script();
-                    break;
-                }
-
-                vPortYield();
+            p->reader->start((p->state.print_cache != nullptr) ? p->state.print_cache : f);
+            while (true) {
+                if (p->state.print_cache != nullptr) p->print_cache(p->state.print_cache_commands);
+                else p->print_lines();
+                p->reader->stop();
+                if (p->state.printing_stop || !p->next_job()) break;
+            }
+
+            // Print was stopped, so drop whatever was added after that and let the next job go. M410
+            // leaves commands printer had buffered, so the next job waits until they are done.
+            if (p->state.printing_stop) {
+                while (p->uart->is_stopping()) vTaskDelay(UART_RX_WAIT_MS / portTICK_PERIOD_MS);
+                p->uart->release_stream();
+                p->state.printing_stop = false;
             }
             p->state.status = PRINTER_IDLE;
-            p->stop();
+            p->finish(p->state.printing_failed);
+            p->state.printing_failed = false;
             ESP_LOGI(TAG, "Ended print.");
         }
         vTaskDelay(1000 / portTICK_PERIOD_MS); // 100ms delay
     }
 }
 
-esp_err_t Printer::init() {
-    uart = new SerialPort((int) settings.get_baud_rate(), GPIO_NUM_12, GPIO_NUM_13);
+/**
+ * Internal function.
+ * Prints G-code file as it is, every line goes through the pipeline. File reader must be started.
+ */
+void Printer::print_lines() {
+    char line[GCODE_LINE_MAX];
+    size_t len;
+    bool truncated;
+    pipeline->reset();
+    while (!state.printing_stop && reader->read_line(line, GCODE_LINE_MAX, &len, &truncated)) {
+#ifdef DEBUG
+        ESP_LOGI(TAG, "Got line: %s", line);
+#endif
+        // Too long line is only good if it's a comment after all, a command is not skipped silently
+        if (truncated && (strchr(line, ';') == nullptr)) {
+            ESP_LOGE(TAG, "Line at byte %lu is longer than %d bytes, print job stopped: %.32s...",
+                     (unsigned long) state.print_file_bytes_sent, GCODE_LINE_MAX - 1, line);
+            stop();
+            break;
+        }
+        state.print_file_bytes_sent += len; // To track progress
+        // Sink waits until printer confirms something if buffer is full
+        pipeline->process(line, state.print_file_bytes_sent);
+        vPortYield();
+    }
+    if (!state.printing_stop) pipeline->flush();
+}
+
+/**
+ * Internal function.
+ * Prints G-code from cache made at upload. Commands are ready to be sent with their checksums,
+ * only user rules and arc fitting are applied if they are on. File reader must be started on the cache
+ * positioned at the first record.
+ * Cache which ends before all its commands are read stops the job with an error.
+ * @param commands records in cache
+ */
+void Printer::print_cache(uint32_t commands) {
+    char command[COMMAND_MAX_LENGTH + 1];
+    gcode_cache_record_t record;
+    if (cache_pipeline != nullptr) cache_pipeline->reset();
+    for (uint32_t i = 0; (i < commands) && !state.printing_stop; i++) {
+        if (!reader->read(&record, sizeof(record)) || (record.len > COMMAND_MAX_LENGTH) ||
+            !reader->read(command, record.len)) {
+            // Job did not get to its end, so it's not done: journal is kept to resume it
+            if (state.printing_stop) break;
+            ESP_LOGE(TAG, "Cache is cut short or broken at command %lu of %lu, print job stopped",
+                     (unsigned long) i, (unsigned long) commands);
+            state.printing_failed = true;
+            stop();
+            break;
+        }
+        command[record.len] = 0;
+        state.print_file_bytes_sent = record.source_offset;
+        if (cache_pipeline != nullptr) cache_pipeline->process(command, record.source_offset);
+        else print_command(command, record.source_offset, record.checksum);
+        vPortYield();
+    }
+    if ((cache_pipeline != nullptr) && !state.printing_stop) cache_pipeline->flush();
+}
+
+/**
+ * Connects printer as its settings say and starts its tasks.
+ * @param transport connection to printer, nullptr to make it from settings
+ */
+esp_err_t Printer::init(Transport *transport) {
+    // Virtual printer is put instead of UART to try streaming with no printer connected
+    const printer_settings_t *config = settings.get_printer(index);
+    if ((config == nullptr) || !config->enabled) return ESP_ERR_INVALID_ARG;
+    if (transport == nullptr) {
+        if (config->virtual_printer != nullptr) transport = new VirtualPrinter(config->virtual_printer);
+        else transport = new UartTransport((uart_port_t) config->uart, (gpio_num_t) config->rxd_pin,
+                                           (gpio_num_t) config->txd_pin, config->rts_pin, config->cts_pin);
+    }
+
+    uart = new SerialPort(transport, (int) config->baud_rate);
+    uart->set_callback_context(this);
+    uart->set_baud_rate_callback(baud_rate_callback);
     esp_err_t res = uart->init();
     if (res != ESP_OK) return res;
+    uart->set_line_numbers(config->checksum);
+    if (config->flow_control != FLOW_CONTROL_NONE) uart->set_flow_control(config->flow_control);
 
     uart->set_sent_callback(sent_callback);
     uart->set_response_callback(receive_callback);
     uart->set_timeout_callback(is_timeout_callback, on_timeout_callback);
 
+    pipeline = new GcodePipeline(print_line_callback, this);
+    pipeline->add(new GcodeStripStage());
+    pipeline->add(new GcodeCanonicalStage());
+    if (config->gcode_rules_cnt > 0) pipeline->add(new GcodeRulesStage(config->gcode_rules, config->gcode_rules_cnt));
+    if (config->arc_tolerance > 0) {
+        arc_fitter = new ArcFitter(config->arc_tolerance);
+        pipeline->add(arc_fitter);
+    }
+
+    // Cache has canonical lines already
+    if ((config->gcode_rules_cnt > 0) || (config->arc_tolerance > 0)) {
+        cache_pipeline = new GcodePipeline(print_line_callback, this);
+        if (config->gcode_rules_cnt > 0) {
+            cache_pipeline->add(new GcodeRulesStage(config->gcode_rules, config->gcode_rules_cnt));
+        }
+        if (config->arc_tolerance > 0) {
+            cache_arc_fitter = new ArcFitter(config->arc_tolerance);
+            cache_pipeline->add(cache_arc_fitter);
+        }
+    }
+
+    state.has_recovery = print_journal_load(index, &state.recovery);
+    if (state.has_recovery) {
+        ESP_LOGW(TAG, "Printer %d was printing '%s' before restart, it may be resumed", index,
+                 state.recovery.file_name);
+    }
+
+    queue = new JobQueue(index);
+    queue->load();
+
+    reader = new FileReader(config->prefetch);
+    res = reader->init();
+    if (res != ESP_OK) return res;
+
+    transfer = new BinaryTransfer(uart);
+    res = transfer->init();
+    if (res != ESP_OK) return res;
+
     xTaskCreate(Printer::task_status_report, "printer_task_report", PRINTER_TASK_STACK_SIZE, this, tskIDLE_PRIORITY, nullptr);
     xTaskCreate(Printer::task_print, "printer_task_print", PRINTER_TASK_STACK_SIZE, this, tskIDLE_PRIORITY, nullptr);
     xTaskCreate(Printer::task_state_log, "printer_task_state", PRINTER_TASK_STATE_STACK_SIZE, this, tskIDLE_PRIORITY, nullptr);
@@ -245,55 +657,522 @@ esp_err_t Printer::init() {
     return ESP_OK;
 }
 
-esp_err_t Printer::start(FILE *f) {
-    if (state.print_file != nullptr) return ESP_FAIL;
-    fseek(f, 0, SEEK_END);              // Determine file size
-    state.print_file_bytes = ftell(f);
-    rewind(f);                          // Go back
+/**
+ * Internal function.
+ * Opens cache of a job file, if file has one, and reads cache tables.
+ * @param job
+ * @param f
+ * @param name file name, to find its cache
+ */
+void Printer::load_job(print_job_t *job, FILE *f, const char *name) {
+    *job = { .file = f, .cache = nullptr, .header = {}, .index = nullptr, .layers = nullptr };
+    if (name != nullptr) job->cache = gcode_cache_open(name, f, &job->header);
+    if (job->cache != nullptr) {
+        job->index = gcode_cache_read_index(job->cache, &job->header);
+        job->layers = gcode_cache_read_layers(job->cache, &job->header);
+    }
+}
+
+/**
+ * Internal function.
+ * Makes loaded job the current one. Job does not start until file is set.
+ */
+void Printer::set_job(const print_job_t *job) {
+    long pos = ftell(job->file);
+    fseek(job->file, 0, SEEK_END);      // Determine file size
+    state.print_file_bytes = ftell(job->file);
+    fseek(job->file, pos, SEEK_SET);    // Go back
     state.print_file_bytes_sent = 0;
+    state.print_cache = job->cache;
+    state.print_cache_commands = job->header.commands;
+    state.print_time_index = job->index;
+    state.print_time_index_entries = (job->index != nullptr) ? job->header.index_entries : 0;
+    state.print_time_total = (job->index != nullptr) ? job->header.total_time : 0;
+    state.print_layers = job->layers;
+    state.print_layers_cnt = (job->layers != nullptr) ? job->header.layers : 0;
+    state.progress_reported = -1;
+    state.remaining_reported = -1;
+    state.journal = { .version = PRINT_JOURNAL_VERSION, .file_name = {}, .file_offset = 0, .modal = {},
+                      .temp_hot_end = 0, .temp_bed = 0 };
+}
+
+/**
+ * Internal function.
+ * Opens print job, and its cache if file has one. Job does not start until file is set.
+ */
+esp_err_t Printer::open_job(FILE *f, const char *name) {
+    // Print task switches queued jobs with no file set for a moment, but it's printing all along
+    if ((state.print_file != nullptr) || (state.status == PRINTER_TRANSFERRING) ||
+        (state.status == PRINTER_PRINTING)) return ESP_FAIL;
+    rewind(f);
+    print_job_t job;
+    load_job(&job, f, name);
+    set_job(&job);
+    state.job_changing = false;
+    uart->set_confirmed_offset(0);
+    uart->set_confirmed_modal(&state.journal.modal);
+    return ESP_OK;
+}
+
+/**
+ * Internal function.
+ * Goes on with the next job from queue when the current one is read to its end. Next job is
+ * set at once and its commands are queued right behind the ones printer still has, so there's
+ * no pause. Offsets printer confirms belong to the previous file till it's done with it, so journal
+ * of the next job waits till then, and the previous one stays in NVS meanwhile. Modal state goes
+ * on from the previous job, printer keeps it as well. File reader must be stopped.
+ * @return true if next job is set
+ */
+bool Printer::next_job() {
+    char name[JOB_QUEUE_NAME_MAX];
+    while (queue->peek(name, sizeof(name))) {
+        FILE *f = sdcard_open_file(name, "r");
+        if (f == nullptr) {
+            ESP_LOGE(TAG, "Queued file '%s' does not exist, skipped", name);
+            queue->take(name);
+            continue;
+        }
+        print_job_t job;
+        load_job(&job, f, name);
+        queue->take(name);
+        finish(true);
+        set_job(&job);
+        state.job_boundary = uart->get_stream_queued();
+        state.job_changing = true;
+        begin_job(f, name);
+        reader->start((job.cache != nullptr) ? job.cache : f);
+        ESP_LOGI(TAG, "Next job from queue, '%s'", name);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Starts the first job from queue. Printer must be idle.
+ * @return ESP_ERR_NOT_FOUND if queue is empty
+ */
+esp_err_t Printer::start_queue() {
+    char name[JOB_QUEUE_NAME_MAX];
+    if (!queue->peek(name, sizeof(name))) return ESP_ERR_NOT_FOUND;
+    if ((get_status() != PRINTER_IDLE) || (state.print_file != nullptr)) return ESP_FAIL;
+    FILE *f = sdcard_open_file(name, "r");
+    if (f == nullptr) return ESP_ERR_NOT_FOUND;
+    esp_err_t res = start(f, name);
+    if (res != ESP_OK) {
+        fclose(f);
+        return res;
+    }
+    queue->take(name);
+    return ESP_OK;
+}
+
+/**
+ * Internal function.
+ * Lets print task take opened job. Its journal replaces the one of unfinished job, if there was one.
+ */
+void Printer::begin_job(FILE *f, const char *name) {
+    // Job of unknown file can't be found after restart
+    memset(state.journal.file_name, 0, sizeof(state.journal.file_name));
+    if ((name != nullptr) && (settings.get_journal() > 0)) {
+        strncpy(state.journal.file_name, name, PRINT_JOURNAL_NAME_MAX - 1);
+    }
+    state.journal_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    state.has_recovery = false;
     state.print_file = f;
+}
+
+/**
+ * Internal function.
+ * Moves opened job to the command which ends at given file position. Cache is found
+ * with offset table, so only a few records are read.
+ * @param f job file
+ * @param offset position in file right after a command
+ */
+esp_err_t Printer::seek(FILE *f, uint32_t offset) {
+    if (offset > state.print_file_bytes) return ESP_ERR_INVALID_ARG;
+    if (state.print_cache == nullptr) {
+        if (fseek(f, (long) offset, SEEK_SET) != 0) return ESP_FAIL;
+    } else {
+        // Last offset table entry before the position, then records up to it
+        const gcode_cache_index_t *index = state.print_time_index;
+        uint32_t command = 0, lo = 0, hi = state.print_time_index_entries;
+        while (hi - lo > 1) {
+            uint32_t mid = (lo + hi) / 2;
+            if (index[mid].source_offset <= offset) lo = mid; else hi = mid;
+        }
+        long pos = (long) sizeof(gcode_cache_header_t);
+        if ((hi > 0) && (index[lo].source_offset <= offset)) {
+            pos = (long) index[lo].cache_offset;
+            command = lo * GCODE_CACHE_INDEX_STEP;
+        }
+        gcode_cache_record_t record;
+        while (command < state.print_cache_commands) {
+            if ((fseek(state.print_cache, pos, SEEK_SET) != 0) ||
+                (fread(&record, sizeof(record), 1, state.print_cache) != 1)) return ESP_FAIL;
+            if (record.source_offset > offset) break;
+            pos += (long) (sizeof(record) + record.len);
+            command++;
+        }
+        if (fseek(state.print_cache, pos, SEEK_SET) != 0) return ESP_FAIL;
+        state.print_cache_commands -= command;
+    }
+    state.print_file_bytes_sent = offset;
+    uart->set_confirmed_offset(offset);
     return ESP_OK;
 }
 
+/**
+ * Starts print job. File is printed from its cache if there's a valid one.
+ * Job may start from a layer other than the first one if file has cache, to resume a print
+ * which was interrupted. Printer must be heated and homed then, only extruder position is set.
+ * File is not closed if job does not start.
+ * @param f
+ * @param name file name, to find its cache
+ * @param layer layer to start from, counting from 0
+ * @return ESP_ERR_NOT_SUPPORTED if job can't start from given layer
+ */
+esp_err_t Printer::start(FILE *f, const char *name, uint32_t layer) {
+    esp_err_t res = open_job(f, name);
+    if (res != ESP_OK) return res;
+    if (layer > 0) {
+        if (layer >= state.print_layers_cnt) {
+            ESP_LOGE(TAG, "File has no layer %lu or it has no cache", (unsigned long) layer);
+            finish();
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        const gcode_cache_layer_t *l = &state.print_layers[layer];
+        fseek(state.print_cache, (long) l->cache_offset, SEEK_SET);
+        state.print_cache_commands -= l->command;
+        state.print_file_bytes_sent = l->source_offset;
+
+        char cmd[32];
+        sprintf(cmd, "G92 E%.5f", l->e);
+        print_command(cmd, l->source_offset);
+        ESP_LOGI(TAG, "Starting from layer %lu, Z=%.2f", (unsigned long) layer, l->z);
+    }
+    begin_job(f, name);
+    return ESP_OK;
+}
+
+/**
+ * Resumes print job which was not finished before module or printer was restarted. Printer is
+ * heated, X and Y are homed and the state job had is set back, then job goes on from the last
+ * command printer had confirmed. Z is not homed, it's assumed it was not moved.
+ * @return ESP_ERR_NOT_FOUND if there's no such job or its file is gone
+ */
+esp_err_t Printer::resume() {
+    if (!state.has_recovery) return ESP_ERR_NOT_FOUND;
+    if (get_status() != PRINTER_IDLE) return ESP_FAIL;
+    print_journal_t journal = state.recovery;
+    FILE *f = sdcard_open_file(journal.file_name, "r");
+    if (f == nullptr) return ESP_ERR_NOT_FOUND;
+
+    esp_err_t res = open_job(f, journal.file_name);
+    if (res == ESP_OK) res = seek(f, journal.file_offset);
+    if (res != ESP_OK) {
+        finish();
+        fclose(f);
+        return res;
+    }
+
+    // Modal state goes on from where it was, the file is not read before the position
+    state.journal = journal;
+    uart->set_confirmed_modal(&journal.modal);
+    char preamble[320];
+    size_t len = print_journal_preamble(&journal, preamble, sizeof(preamble));
+    char *save = nullptr;
+    for (char *cmd = strtok_r(preamble, "\n", &save); (len > 0) && (cmd != nullptr);
+         cmd = strtok_r(nullptr, "\n", &save)) {
+        print_command(cmd, journal.file_offset);
+    }
+    ESP_LOGI(TAG, "Resuming '%s' from %lu of %lu bytes", journal.file_name, (unsigned long) journal.file_offset,
+             state.print_file_bytes);
+    begin_job(f, journal.file_name);
+    return ESP_OK;
+}
+
+/**
+ * Forgets job which was not finished before restart, it's not going to be resumed.
+ */
+void Printer::discard_recovery() {
+    if (!state.has_recovery) return;
+    state.has_recovery = false;
+    print_journal_clear(index);
+}
+
+/**
+ * Stops print job. Heating waits and planned moves are aborted at once, commands which
+ * were not sent yet are dropped, then printer is parked with stop script.
+ * Print task closes the file when it notices the job was stopped.
+ */
 esp_err_t Printer::stop() {
-    if (state.print_file == nullptr) return ESP_FAIL;
+    if (state.status == PRINTER_TRANSFERRING) {
+        transfer->abort();
+        return ESP_OK;
+    }
+    if ((state.print_file == nullptr) || state.printing_stop) return ESP_FAIL;
     state.printing_stop = true;
+    // Without EMERGENCY_PARSER printer reads M108 only after heating is done, so it's useless
+    if (caps.emergency_parser || !caps.received) uart->emergency(COMMAND_CANCEL_WAIT);
+    uart->emergency(COMMAND_QUICK_STOP);
+    send_stop_script();
+    return ESP_OK;
+}
+
+/**
+ * Kills printer with M112. It has to be reset after that.
+ */
+void Printer::emergency_stop() {
+    if (state.print_file != nullptr) state.printing_stop = true;
+    uart->emergency(COMMAND_KILL);
+}
+
+/**
+ * Copies a file to printer's SD card with binary file transfer (Marlin BINARY_FILE_TRANSFER),
+ * so printer can print it by itself. Printer must be idle. File is closed when it's copied.
+ * @param f
+ * @param name file name on printer's SD card
+ * @return ESP_ERR_NOT_SUPPORTED if printer firmware reported it can't do that
+ */
+esp_err_t Printer::start_transfer(FILE *f, const char *name) {
+    if ((get_status() != PRINTER_IDLE) || (state.print_file != nullptr)) return ESP_FAIL;
+    if (caps.received && !caps.binary_file_transfer) {
+        ESP_LOGE(TAG, "Printer firmware has no binary file transfer");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    state.status = PRINTER_TRANSFERRING;
+    if (transfer->start(f, name, transfer_done_callback, this) != ESP_OK) {
+        state.status = PRINTER_IDLE;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void Printer::transfer_done(bool success) {
+    if (!success) ESP_LOGE(TAG, "File was not copied to printer");
+    state.status = PRINTER_IDLE;
+    state.status_updated = true;
+}
+
+/**
+ * Internal function.
+ * Closes print job file.
+ * @param keep_journal journal is left in NVS, the next job's one replaces it
+ */
+void Printer::finish(bool keep_journal) {
     state.print_file_bytes = 0;
     state.print_file_bytes_sent = 0;
+    if (state.print_cache != nullptr) {
+        fclose(state.print_cache);
+        state.print_cache = nullptr;
+    }
+    state.print_time_total = 0;
+    state.print_time_index_entries = 0;
+    heap_caps_free(state.print_time_index);
+    state.print_time_index = nullptr;
+    state.print_layers_cnt = 0;
+    heap_caps_free(state.print_layers);
+    state.print_layers = nullptr;
+    if (state.journal.file_name[0] != 0) {
+        if (!keep_journal) print_journal_clear(index);
+        state.journal.file_name[0] = 0;
+    }
     if (state.print_file != nullptr) {
         fclose(state.print_file);
         state.print_file = nullptr;
     }
-    return ESP_OK;
 }
 
+/**
+ * Internal function.
+ * Adds stop script to emergency queue, so it goes right after emergency commands. Nothing waits
+ * for room in the queue, a command which does not fit is skipped.
+ */
 void Printer::send_stop_script() {
     ESP_LOGI(TAG, "Sending stop script commands");
     for (auto &i : stop_script) {
-        while (!send_cmd(i)) asm volatile("nop");
+        if (send_cmd(i, COMMAND_SOURCE_PRINTER) == 0) ESP_LOGE(TAG, "Stop script command %s was not sent", i);
     }
 }
 
-unsigned long int Printer::send_cmd(const char *cmd) { return uart->send(cmd); }
+/**
+ * Queues a command of print job, waiting for room if there's none. Port tracks modal state
+ * of commands it sends, so journal gets the state of the ones printer confirmed. Command printer
+ * can't take stops the job, it is not skipped silently.
+ * @param command
+ * @param file_offset position in file right after the command
+ * @param checksum XOR of command bytes if it's known, -1 otherwise
+ */
+void Printer::print_command(const char *command, uint32_t file_offset, int16_t checksum) {
+    if (state.printing_stop) return;
+    if (strlen(command) > uart->get_command_max_length()) {
+        ESP_LOGE(TAG, "Command before byte %lu is longer than %u characters printer takes, print job stopped: %.32s...",
+                 (unsigned long) file_offset, (unsigned) uart->get_command_max_length(), command);
+        stop();
+        return;
+    }
+    if (uart->send(command, COMMAND_SOURCE_PRINT, file_offset, portMAX_DELAY, checksum) == 0) {
+        ESP_LOGE(TAG, "Command before byte %lu was not queued, print job stopped", (unsigned long) file_offset);
+        stop();
+    }
+}
+
+unsigned long int Printer::send_cmd(const char *cmd, uint8_t source, uint32_t file_offset, TickType_t wait) {
+    return uart->send(cmd, source, file_offset, wait);
+}
 SerialPort *Printer::get_uart() { return uart; }
+uint8_t Printer::get_index() const { return index; }
+JobQueue *Printer::get_queue() const { return queue; }
+const printer_caps_t *Printer::get_caps() const { return &caps; }
+bool Printer::has_advanced_ok() const { return state.advanced_ok; }
 float Printer::get_temp_bed() const { return state.temp_bed; }
 float Printer::get_temp_bed_target() const { return state.temp_bed_target; }
 float Printer::get_temp_hot_end() const { return state.temp_hot_end; }
+void Printer::get_position(float *x, float *y, float *z, float *e) const {
+    *x = state.pos_x; *y = state.pos_y; *z = state.pos_z; *e = state.pos_e;
+}
 float Printer::get_temp_hot_end_target() const { return state.temp_hot_end_target; }
 PrinterStatus Printer::get_status() const { if (state.connected) return state.status; else return PRINTER_DISCONNECTED; }
 void Printer::set_status(PrinterStatus st) { state.status = st; }
 FILE *Printer::get_opened_file() const { return state.print_file; }
 
 float Printer::get_progress() const {
+    if (state.status == PRINTER_TRANSFERRING) return roundf(transfer->get_progress() * 100) / 100;
+    if ((get_opened_file() != nullptr) && (state.print_time_total != 0)) {     // Time it takes is known
+        return roundf(((float) get_time_printed() / (float) state.print_time_total) * 100) / 100;
+    }
     if ((get_opened_file() != nullptr) && (state.print_file_bytes != 0)) {
         return roundf(((float)state.print_file_bytes_sent / (float)state.print_file_bytes) * 100) / 100;
+    } else if (state.sd_print_file_bytes != 0) {        // Printer prints from its own card
+        return roundf(((float)state.sd_print_bytes / (float)state.sd_print_file_bytes) * 100) / 100;
     } else return 0;
 }
 
+/**
+ * Internal function.
+ * Estimated time printer takes to get to the command being sent, interpolated between
+ * offset table entries.
+ * @return ms
+ */
+uint32_t Printer::get_time_printed() const {
+    const gcode_cache_index_t *index = state.print_time_index;
+    uint32_t offset = state.print_file_bytes_sent;
+    if ((index == nullptr) || (state.print_time_index_entries == 0)) return 0;
+
+    // Last entry at or before the offset
+    uint32_t lo = 0, hi = state.print_time_index_entries;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (index[mid].source_offset <= offset) lo = mid; else hi = mid;
+    }
+    uint32_t offset_next = state.print_file_bytes, time_next = state.print_time_total;
+    if (lo + 1 < state.print_time_index_entries) {
+        offset_next = index[lo + 1].source_offset;
+        time_next = index[lo + 1].time;
+    }
+    if ((offset <= index[lo].source_offset) || (offset_next <= index[lo].source_offset)) return index[lo].time;
+    if (offset >= offset_next) return time_next;
+    return index[lo].time + (uint32_t) ((uint64_t) (time_next - index[lo].time) * (offset - index[lo].source_offset) /
+                                        (offset_next - index[lo].source_offset));
+}
+
+/**
+ * Estimated time left to print.
+ * @return seconds, -1 if it's unknown
+ */
+int32_t Printer::get_remaining_time() const {
+    if ((get_opened_file() == nullptr) || (state.print_time_total == 0)) return -1;
+    uint32_t printed = get_time_printed();
+    return (printed < state.print_time_total) ? (int32_t) ((state.print_time_total - printed) / 1000) : 0;
+}
+
+/**
+ * Internal function.
+ * Saves journal of job being printed, once in a while and only if printer has confirmed
+ * something since. It's done here rather than when 'ok' comes, so journal takes nothing
+ * from sending, and NVS is not written too often.
+ */
+void Printer::save_journal() {
+    if ((state.status != PRINTER_PRINTING) || state.printing_stop || (state.journal.file_name[0] == 0)) return;
+    unsigned int current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (current_time - state.journal_time < settings.get_journal() * 1000) return;
+    if (state.job_changing) {
+        // Confirmed offset is still the one in previous queued job's file
+        if ((int32_t) (uart->get_stream_done() - state.job_boundary) < 0) return;
+        state.job_changing = false;
+    }
+    uint32_t offset = uart->get_confirmed_offset();
+    if ((offset == 0) || (offset == state.journal.file_offset)) return;
+
+    // Modal state is the one after the same confirmed command as the offset, so they match
+    state.journal.file_offset = offset;
+    print_journal_t journal = state.journal;
+    uart->get_confirmed_modal(&journal.modal);
+    journal.temp_hot_end = state.temp_hot_end_target;
+    journal.temp_bed = state.temp_bed_target;
+    print_journal_save(index, &journal);
+    state.journal_time = current_time;
+}
+
+/**
+ * Layer being printed, it's the one the command being sent belongs to.
+ * @return layer number counting from 0, or 0 if layers are unknown
+ */
+uint32_t Printer::get_layer() const {
+    const gcode_cache_layer_t *layers = state.print_layers;
+    if ((get_opened_file() == nullptr) || (layers == nullptr) || (state.print_layers_cnt == 0)) return 0;
+    uint32_t lo = 0, hi = state.print_layers_cnt;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (layers[mid].source_offset < state.print_file_bytes_sent) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Number of layers in file being printed.
+ * @return 0 if it's unknown
+ */
+uint32_t Printer::get_layers() const { return (get_opened_file() != nullptr) ? state.print_layers_cnt : 0; }
+
+/**
+ * File of job which was not finished before restart.
+ * @return nullptr if there's no such job
+ */
+const char *Printer::get_recovery_file() const { return state.has_recovery ? state.recovery.file_name : nullptr; }
+
+/**
+ * Internal function.
+ * Shows print progress and time left on printer's display with M73, when it changes.
+ */
+void Printer::report_progress() {
+    if (!caps.progress || (state.status != PRINTER_PRINTING) || (state.print_time_total == 0)) return;
+    int progress = (int) (get_progress() * 100);
+    int remaining = (get_remaining_time() + 59) / 60;
+    if ((progress == state.progress_reported) && (remaining == state.remaining_reported)) return;
+
+    char cmd[32];
+    sprintf(cmd, "M73 P%d R%d", progress, remaining);
+    if (send_cmd(cmd, COMMAND_SOURCE_STATUS) == 0) return;     // Next time then
+    state.progress_reported = progress;
+    state.remaining_reported = remaining;
+}
+
 /**
  * Callbacks
  */
-void sent_callback() { printer.command_sent(); }
-bool receive_callback(const char *report) { return printer.parse_report(report); }
-bool is_timeout_callback() { return printer.is_timeout(); }
-void on_timeout_callback() { printer.on_timeout(); }
+void sent_callback(void *context) { ((Printer *) context)->command_sent(); }
+bool receive_callback(const char *report, size_t len, void *context) {
+    return ((Printer *) context)->parse_report(report, len);
+}
+bool is_timeout_callback(void *context) { return ((Printer *) context)->is_timeout(); }
+void on_timeout_callback(void *context) { ((Printer *) context)->on_timeout(); }
+void transfer_done_callback(bool success, void *context) { ((Printer *) context)->transfer_done(success); }
+void baud_rate_callback(int baud, void *context) {
+    // Saved, so that next time printer is found at once
+    uint8_t index = ((Printer *) context)->get_index();
+    if (settings.set_baud_rate(index, baud) != ESP_OK) ESP_LOGE(TAG, "Printer %d baud rate %d was not saved", index, baud);
+}
+void print_line_callback(const char *line, uint32_t file_offset, void *context) {
+    ((Printer *) context)->print_command(line, file_offset);
+}
@@ -25,19 +25,31 @@
 
 #include "sdkconfig.h"
 #include "uart.h"
+#include "capabilities.h"
+#include "binary_transfer.h"
+#include "gcode_pipeline.h"
+#include "arc_fitter.h"
+#include "file_reader.h"
+#include "gcode_cache.h"
+#include "print_journal.h"
+#include "job_queue.h"
 
 /**
- * Callbacks definitions
+ * Callbacks definitions, context is the printer they are called for
  */
-void sent_callback();
-bool receive_callback(const char *report);
-bool is_timeout_callback();
-void on_timeout_callback();
+void sent_callback(void *context);
+bool receive_callback(const char *report, size_t len, void *context);
+bool is_timeout_callback(void *context);
+void on_timeout_callback(void *context);
+void transfer_done_callback(bool success, void *context);
+void baud_rate_callback(int baud, void *context);
+void print_line_callback(const char *line, uint32_t file_offset, void *context);
 
 /**
  * Printer class definition
  */
-enum PrinterStatus { PRINTER_DISCONNECTED, PRINTER_IDLE, PRINTER_BUSY, PRINTER_PRINTING };
+enum PrinterStatus { PRINTER_DISCONNECTED, PRINTER_IDLE, PRINTER_BUSY, PRINTER_PRINTING, PRINTER_TRANSFERRING };
+enum AutoReport { AUTOREPORT_UNKNOWN, AUTOREPORT_REQUESTED, AUTOREPORT_ON, AUTOREPORT_OFF };
 
 typedef struct {
     bool connected;
@@ -48,33 +60,108 @@ typedef struct {
     float temp_hot_end_target;
     float temp_bed;             // Heat bed temperature
     float temp_bed_target;
+    float pos_x, pos_y, pos_z, pos_e;   // Position reported by printer
+
+    bool caps_requested;        // M115 was sent
+    unsigned int caps_time;     // When M115 was sent, ms
+    enum AutoReport autoreport; // Printer sends temperatures by itself (Marlin M155)
+    unsigned int temp_report_time;  // When temperatures were last reported, ms
+    unsigned int poll_time;         // When temperatures were last requested, ms
+
+    bool advanced_ok;           // Printer reports free buffer slots with 'ok' (Marlin ADVANCED_OK)
+    int planner_free;           // Free planner blocks reported with last 'ok'
+    int buffer_free;            // Free command buffer slots reported with last 'ok'
 
     bool printing_stop;         // Flags printer to stop its job
+    bool printing_failed;       // Job was stopped by an error, its journal is kept to resume it
     FILE *print_file;           // Descriptor of G-code file
+    FILE *print_cache;          // Its cache made at upload, if it's printed from there
+    uint32_t print_cache_commands;
+    uint32_t print_time_total;              // ms, estimated print time, 0 if it's unknown
+    gcode_cache_index_t *print_time_index;  // Estimated time at file offsets
+    uint32_t print_time_index_entries;
+    gcode_cache_layer_t *print_layers;      // Where layers start, from cache
+    uint32_t print_layers_cnt;
+    print_journal_t journal;                // State of job being printed, to resume it later
+    bool job_changing;                      // Printer still has commands of the previous queued job
+    uint32_t job_boundary;                  // Print commands queued before the current job
+    unsigned int journal_time;              // When journal was last saved, ms
+    print_journal_t recovery;               // Journal of job which was not finished before restart
+    bool has_recovery;
+    int progress_reported;                  // Last M73 sent to printer, percent and minutes left
+    int remaining_reported;
     unsigned long int print_file_bytes;
     unsigned long int print_file_bytes_sent;
+    unsigned long int sd_print_bytes;       // Printer's own SD card print status (M27)
+    unsigned long int sd_print_file_bytes;
 
     char last_report[256];
 } printer_state_t;
 
+/**
+ * Print job file with its cache and tables, opened before it's handed to print task.
+ */
+typedef struct {
+    FILE *file;
+    FILE *cache;
+    gcode_cache_header_t header;
+    gcode_cache_index_t *index;
+    gcode_cache_layer_t *layers;
+} print_job_t;
+
 class Printer {
 private:
+    uint8_t         index;                  // Number of printer in settings
     SerialPort      *uart;
+    BinaryTransfer  *transfer;
+    GcodePipeline   *pipeline;              // Transforms printed G-code before it's sent
+    GcodePipeline   *cache_pipeline;        // User rules and arcs only, for G-code from cache
+    ArcFitter       *arc_fitter;            // Arc stages of both pipelines, nullptr if it's off
+    ArcFitter       *cache_arc_fitter;
+    FileReader      *reader;                // Reads print job file ahead
+    JobQueue        *queue;                 // Jobs printed after the current one
     printer_state_t state;
+    printer_caps_t  caps;
 
     char stop_script[4][32] = { "M104 S0\n", "M140 S0\n", "G28\n", "M84\n" };
 
     // Variables to identify a timeout happened
     unsigned int    last_sent_command_time;
+    unsigned int    last_report_time;       // When a timeout found printer had said something, ms
+    bool            report_received;        // Any line received from printer since the last timeout
 
     void send_stop_script();
+    void finish(bool keep_journal = false);
+    void print_lines();
+    void print_cache(uint32_t commands);
+    static void load_job(print_job_t *job, FILE *f, const char *name);
+    void set_job(const print_job_t *job);
+    esp_err_t open_job(FILE *f, const char *name);
+    bool next_job();
+    esp_err_t seek(FILE *f, uint32_t offset);
+    void begin_job(FILE *f, const char *name);
+    void save_journal();
+    [[nodiscard]] uint32_t get_time_printed() const;
+    void report_progress();
+
+    bool parse_ok(const char *report);
+    void parse_echo_report(const char *msg);
+    void parse_error_report(const char *msg);
+    void parse_action(const char *action);
+    bool parse_sd_report(const char *report);
 
 public:
-    Printer();
+    explicit Printer(uint8_t index);
 
-    esp_err_t init();
-    esp_err_t start(FILE *f);
+    esp_err_t init(Transport *transport = nullptr);
+    esp_err_t start(FILE *f, const char *name = nullptr, uint32_t layer = 0);
+    esp_err_t resume();
+    esp_err_t start_queue();
+    void discard_recovery();
     esp_err_t stop();
+    void emergency_stop();
+    esp_err_t start_transfer(FILE *f, const char *name);
+    void transfer_done(bool success);
 
     void set_status(PrinterStatus st);
     [[nodiscard]] FILE *get_opened_file() const;
@@ -82,19 +169,33 @@ public:
     bool is_timeout();
     void on_timeout();
     void command_sent();
-    bool parse_report(const char *report);
+    bool parse_report(const char *report, size_t len);
     void parse_temperature_report(const char *report);
+    void parse_position_report(const char *report);
+    void parse_ok_report(const char *report);
 
-    unsigned long int send_cmd(const char *cmd);
+    void print_command(const char *command, uint32_t file_offset, int16_t checksum = -1);
+    unsigned long int send_cmd(const char *cmd, uint8_t source = COMMAND_SOURCE_CONSOLE, uint32_t file_offset = 0,
+                               TickType_t wait = 0);
     SerialPort *get_uart();
+    [[nodiscard]] uint8_t get_index() const;
+    [[nodiscard]] JobQueue *get_queue() const;
+    [[nodiscard]] const printer_caps_t *get_caps() const;
+    [[nodiscard]] bool has_advanced_ok() const;
     [[nodiscard]] PrinterStatus get_status() const;
     [[nodiscard]] float get_temp_hot_end() const;
     [[nodiscard]] float get_temp_hot_end_target() const;
     [[nodiscard]] float get_temp_bed() const;
     [[nodiscard]] float get_temp_bed_target() const;
+    void get_position(float *x, float *y, float *z, float *e) const;
     [[nodiscard]] float get_progress() const;
+    [[nodiscard]] int32_t get_remaining_time() const;
+    [[nodiscard]] uint32_t get_layer() const;
+    [[nodiscard]] uint32_t get_layers() const;
+    [[nodiscard]] const char *get_recovery_file() const;
 
 private:
+    void request_status();
     [[noreturn]] static void task_status_report(void *arg);
     [[noreturn]] static void task_print(void *arg);
     [[noreturn]] static void task_state_log(void *arg);
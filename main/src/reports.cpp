@@ -0,0 +1,108 @@
+/*
+  reports.cpp - parsers of Marlin temperature, position and ADVANCED_OK reports
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cstdlib>
+#include <cstring>
+
+#include "reports.h"
+
+/**
+ * Parses Marlin temperature report, which looks like this: T:248.34 /245.00 B:100.81 /100.00 @:33 B@:128 W:9
+ * Values are read in place in one pass. Only the values found in report are updated.
+ * @param report
+ */
+void report_parse_temperatures(const char *report, float *hot_end, float *hot_end_target, float *bed, float *bed_target) {
+    const char *p = report;
+    float *target = nullptr;
+    while (*p != 0) {
+        if (*p == ' ') {
+            p++;
+            continue;
+        }
+
+        char *end;
+        if ((p[1] == ':') && ((p[0] == 'T') || (p[0] == 'B'))) {
+            float *current = (p[0] == 'T') ? hot_end : bed;
+            target = (p[0] == 'T') ? hot_end_target : bed_target;
+            *current = strtof(&p[2], &end);
+        } else if ((p[0] == '/') && (target != nullptr)) {
+            *target = strtof(&p[1], &end);
+            target = nullptr;
+        } else {
+            // Other extruders, heater power and such are not used
+            target = nullptr;
+            end = (char *) strchr(p, ' ');
+            if (end == nullptr) break;
+        }
+        if (end == p) break;
+        p = end;
+    }
+}
+
+/**
+ * Parses Marlin position report (M114 or M154 auto-report), which looks like this:
+ * X:10.00 Y:20.00 Z:0.30 E:0.00 Count X:800 Y:1600 Z:120
+ * Stepper counts are not used. Only the axes found in report are updated.
+ * @param report
+ */
+void report_parse_position(const char *report, float *x, float *y, float *z, float *e) {
+    const char *p = report;
+    while ((*p != 0) && (strncmp(p, "Count", 5) != 0)) {
+        if (p[1] == ':') {
+            char *end;
+            float val = strtof(&p[2], &end);
+            switch (p[0]) {
+                case 'X': *x = val; break;
+                case 'Y': *y = val; break;
+                case 'Z': *z = val; break;
+                case 'E': *e = val; break;
+                default: break;
+            }
+            p = end;
+        } else p++;
+        while (*p == ' ') p++;
+    }
+}
+
+/**
+ * Parses fields Marlin adds to 'ok' when ADVANCED_OK is enabled, which looks like this:
+ * ok N10 P15 B3 (N - last line number, P - free planner blocks, B - free command buffer slots).
+ * Temperature report may follow 'ok' as well, it's not touched here.
+ * @param report
+ * @param planner_free -1 if printer did not report it
+ * @param buffer_free -1 if printer did not report it
+ * @return true if free buffer slots were reported
+ */
+bool report_parse_ok(const char *report, int *planner_free, int *buffer_free) {
+    *planner_free = -1;
+    *buffer_free = -1;
+    const char *p = report + 2;
+    while (*p == ' ') {
+        p++;
+        char field = *p++;
+        if ((*p < '0') || (*p > '9')) break;    // Not a number, i.e. 'T:' of temperature report
+        char *end;
+        long val = strtol(p, &end, 10);
+        if (field == 'P') *planner_free = (int) val;
+        else if (field == 'B') *buffer_free = (int) val;
+        p = end;
+    }
+    return *buffer_free >= 0;
+}
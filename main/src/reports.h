@@ -0,0 +1,28 @@
+/*
+  reports.h - parsers of Marlin temperature, position and ADVANCED_OK reports
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_REPORTS_H
+#define ESP32_PRINT_REPORTS_H
+
+void report_parse_temperatures(const char *report, float *hot_end, float *hot_end_target, float *bed, float *bed_target);
+void report_parse_position(const char *report, float *x, float *y, float *z, float *e);
+bool report_parse_ok(const char *report, int *planner_free, int *buffer_free);
+
+#endif //ESP32_PRINT_REPORTS_H
@@ -57,6 +57,32 @@ bool sdcard_has_file(const char *name) {
     return (stat(path, &st) == 0);
 }
 
+bool sdcard_stat(const char *name, struct stat *st) {
+    if (sdcard_mount(&sdcard_state.card) != ESP_OK) {
+        ESP_LOGE(TAG, "SD card not mounted");
+        return false;
+    }
+    char path[255];
+    sprintf(path, "%s/%s", MOUNT_POINT, name);
+    return (stat(path, st) == 0);
+}
+
+/**
+ * Creates a directory if there's none.
+ * @param name
+ */
+esp_err_t sdcard_make_dir(const char *name) {
+    if (sdcard_mount(&sdcard_state.card) != ESP_OK) {
+        ESP_LOGE(TAG, "SD card not mounted");
+        return ESP_FAIL;
+    }
+    char path[255];
+    sprintf(path, "%s/%s", MOUNT_POINT, name);
+    struct stat st{};
+    if (stat(path, &st) == 0) return S_ISDIR(st.st_mode) ? ESP_OK : ESP_FAIL;
+    return (mkdir(path, 0755) == 0) ? ESP_OK : ESP_FAIL;
+}
+
 FILE *sdcard_open_file(const char *name, const char *mode) {
     if (sdcard_mount(&sdcard_state.card) != ESP_OK) {
         ESP_LOGE(TAG, "SD card not mounted");
@@ -124,7 +150,7 @@ esp_err_t sdcard_mount(sdmmc_card_t* card) {
     if (!sdcard_state.is_mounted) {
         esp_vfs_fat_sdmmc_mount_config_t mount_config = {
                 .format_if_mount_failed = false,
-                .max_files = 5,
+                .max_files = 8,     // Print job and its cache for each printer, upload and its cache
                 .allocation_unit_size = 16 * 1024,
                 .disk_status_check_enable = true
         };
@@ -36,12 +36,16 @@
 #include <esp_vfs_fat.h>
 #include <esp_http_server.h>
 
+#ifndef MOUNT_POINT
 #define MOUNT_POINT         "/sdcard"
+#endif
 
 void sdcard_init();
 esp_err_t sdcard_mount(sdmmc_card_t* card);
 void sdcard_umount();
 bool sdcard_has_file(const char *name);
+bool sdcard_stat(const char *name, struct stat *st);
+esp_err_t sdcard_make_dir(const char *name);
 bool sdcard_get_files(void (*send_proc)(const char *file_entry_chunk, void *),
                       void (*err_send_proc)(const char *error, void *),
                       const char *selected, void *ctx);
@@ -23,6 +23,7 @@
 #include "sdcard.h"
 #include "multipart.h"
 #include "printer.h"
+#include "settings.h"
 #include "camera.h"
 
 #include "resources/include/server_main_html.h"
@@ -34,8 +35,9 @@
 
 static const char TAG[] = "esp3d-print-http";
 
-extern Printer printer;
+extern Printer *printers[PRINTERS_MAX];
 extern Camera camera;
+extern Settings settings;
 
 #define TYPE_TEXT_CSS                   "text/css"
 #define TYPE_TEXT_JAVASCRIPT            "text/javascript"
@@ -46,12 +48,12 @@ extern Camera camera;
 #define UPLOAD_FILE_NAME_MAX_LEN        48
 #define UPLOAD_PART_BUFFER_SIZE         4096
 #define UPLOAD_CONTENT_TYPE_MAX_LENGTH  256
-#define COMMAND_MAX_LENGTH              64
 
-const char *Server::printer_state_str() {
-    switch (printer.get_status()) {
+const char *Server::printer_state_str(const Printer *printer) {
+    switch (printer->get_status()) {
         case PRINTER_BUSY: return "Working";
         case PRINTER_PRINTING: return "Printing";
+        case PRINTER_TRANSFERRING: return "Transferring";
         case PRINTER_IDLE: return "Idle";
         default: return "Unknown";
     }
@@ -80,6 +82,7 @@ int8_t Server::upload_data_callback(const char *data, size_t len, void *context)
     }
     if (ctx->upload_file != nullptr) fwrite(data, 1, len, ctx->upload_file);
     else return ESP_FAIL;
+    if (ctx->upload_cache != nullptr) ctx->upload_cache->write(data, len);
     return ESP_OK;
 }
 
@@ -100,6 +103,17 @@ int8_t Server::upload_data_start_callback(parser_state_t *parser, void *context)
             ESP_LOGE(TAG, "%s", "Failed to open file for writing");
             return ESP_FAIL;
         }
+
+        // Old cache must not stay for a new file with the same name
+        gcode_cache_delete(fn);
+        if (settings.get_gcode_cache() && gcode_cache_is_gcode(fn)) {
+            ctx->upload_cache = new GcodeCacheWriter();
+            if (ctx->upload_cache->begin(fn) != ESP_OK) {
+                ESP_LOGE(TAG, "Can't make cache of '%s'", fn);
+                delete ctx->upload_cache;
+                ctx->upload_cache = nullptr;
+            }
+        }
     }
     return ESP_OK;
 }
@@ -120,6 +134,7 @@ esp_err_t Server::post_handler(httpd_req_t *req) {
     ESP_LOGI(TAG, "Got file size %d", req->content_len);
 
     ctx->upload_file = nullptr;
+    ctx->upload_cache = nullptr;
     ctx->upload_buffer = (char *) malloc(UPLOAD_PART_BUFFER_SIZE);
 
     parser_config_t mp_parser;
@@ -152,6 +167,11 @@ esp_err_t Server::post_handler(httpd_req_t *req) {
     if (ctx->upload_file != nullptr)  { fflush(ctx->upload_file); fclose(ctx->upload_file); }
     free(ctx->upload_buffer);
     ctx->upload_file = nullptr;
+    if (ctx->upload_cache != nullptr) {
+        ctx->upload_cache->end(res == ESP_OK);     // File is closed, so its size and time are final
+        delete ctx->upload_cache;
+        ctx->upload_cache = nullptr;
+    }
 
     if (res == ESP_OK) {
         httpd_resp_sendstr_chunk(req, R"({"result":"ok"})");
@@ -178,23 +198,61 @@ esp_err_t Server::get_printer_handler(httpd_req_t *req) {
     send_cors_headers(req);
 
     auto ctx = (context_t *) req->user_ctx;
-    if (strcmp(req->uri, "/printer/status") == 0) {
+
+    // Printer number goes after '/printer/', with no number it's the first printer
+    const char *action = &req->uri[9];
+    uint8_t index = 0;
+    if ((action[0] >= '0') && (action[0] <= '9') && (action[1] == '/')) {
+        index = action[0] - '0';
+        action += 2;
+    }
+    Printer *printer = (index < PRINTERS_MAX) ? printers[index] : nullptr;
+    if (printer == nullptr) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, R"({"error":"No such printer"})");
+        return ESP_OK;
+    }
+
+    if (strcmp(action, "status") == 0) {
         httpd_resp_set_type(req, TYPE_APPLICATION_JSON);
-        char str[64];
-        sprintf(str, R"({"status":"%s","hot_end":"%.2f","bed":"%.2f"})", printer_state_str(),
-                printer.get_temp_hot_end(), printer.get_temp_bed());
-        httpd_resp_send(req, str, HTTPD_RESP_USE_STRLEN);
-    } else if (strcmp(req->uri, "/printer/photo") == 0) {
+        char recovery[PRINT_JOURNAL_NAME_MAX * 6];
+        const char *recovery_file = printer->get_recovery_file();
+        json_escape(recovery, sizeof(recovery), (recovery_file != nullptr) ? recovery_file : "");
+        const size_t size = CAPS_JSON_SIZE + sizeof(recovery) + 256;
+        auto caps = (char *) malloc(CAPS_JSON_SIZE);
+        auto str = (char *) malloc(size);
+        if ((caps == nullptr) || (str == nullptr)) {
+            free(caps);
+            free(str);
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, R"({"error":"Out of memory"})");
+            return ESP_OK;
+        }
+        if (caps_to_json(printer->get_caps(), caps, CAPS_JSON_SIZE) == 0) strcpy(caps, "null");
+        int len = snprintf(str, size,
+                           R"({"status":"%s","hot_end":"%.2f","bed":"%.2f","advanced_ok":%s,"caps":%s,"recovery":"%s"})",
+                           printer_state_str(printer), printer->get_temp_hot_end(), printer->get_temp_bed(),
+                           printer->has_advanced_ok() ? "true" : "false", caps, recovery);
+        if ((len > 0) && (len < (int) size)) httpd_resp_send(req, str, HTTPD_RESP_USE_STRLEN);
+        else httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, R"({"error":"Status does not fit"})");
+        free(caps);
+        free(str);
+    } else if (strcmp(action, "photo") == 0) {
         httpd_resp_set_type(req, TYPE_IMAGE_JPEG);
         uint8_t number = camera.take_photo();
-    } else if (strncmp(req->uri, "/printer/send?cmd=", 18) == 0) {
-        if (printer.get_status() == PRINTER_IDLE) {
-            size_t len = MIN(strlen(req->uri) - 18, COMMAND_MAX_LENGTH);
-            char *cmd = (char *) malloc(len);
-            strcpy(cmd, &req->uri[18]);
+    } else if (strncmp(action, "send?cmd=", 9) == 0) {
+        // Console commands go ahead of print stream, so they may be sent while printing
+        PrinterStatus status = printer->get_status();
+        if ((status == PRINTER_IDLE) || (status == PRINTER_PRINTING)) {
+            size_t len = MIN(strlen(action) - 9, COMMAND_MAX_LENGTH);
+            char *cmd = (char *) malloc(len + 1);
+            memcpy(cmd, &action[9], len);
+            cmd[len] = 0;
             ESP_LOGI(TAG, "Got command: %s", cmd);
-            unsigned long cmd_id = printer.send_cmd(cmd);
+            unsigned long cmd_id = printer->send_cmd(cmd);
             free(cmd);
+            if (cmd_id == 0) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, R"({"error":"Command queue is full"})");
+                return ESP_OK;
+            }
 
             char *result = (char *)malloc(64);
             sprintf(result, R"({"result":"ok","cmd":"%lu"})", cmd_id);
@@ -204,7 +262,42 @@ esp_err_t Server::get_printer_handler(httpd_req_t *req) {
         } else {
             httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, R"({"error":"Can't send command"})");
         }
-    } else if (strcmp(req->uri, "/printer/start") == 0) {
+    } else if ((strcmp(action, "start") == 0) || (strncmp(action, "start?layer=", 12) == 0)) {
+        // Print may be resumed from a layer, counting from 0
+        uint32_t layer = (action[5] == '?') ? strtoul(&action[12], nullptr, 10) : 0;
+        httpd_resp_set_type(req, TYPE_APPLICATION_JSON);
+        if (ctx->selected_file != nullptr) {
+            FILE *f = sdcard_open_file(ctx->selected_file, "r");
+            if (f == nullptr) {
+                httpd_resp_send(req, R"({"error":"File does not exist"})", HTTPD_RESP_USE_STRLEN);
+                return ESP_OK;
+            }
+            esp_err_t res = printer->start(f, ctx->selected_file, layer);
+            if (res != ESP_OK) {
+                fclose(f);
+                httpd_resp_send(req, (res == ESP_ERR_NOT_SUPPORTED) ?
+                                     R"({"error":"File has no such layer or it was not cached"})" :
+                                     R"({"error":"Can't start print job"})", HTTPD_RESP_USE_STRLEN);
+                return ESP_OK;
+            }
+            httpd_resp_send(req, R"({"result":"ok"})", HTTPD_RESP_USE_STRLEN);
+        } else {
+            httpd_resp_send(req, R"({"error":"File is not selected!"})", HTTPD_RESP_USE_STRLEN);
+        }
+    } else if (strcmp(action, "resume") == 0) {
+        httpd_resp_set_type(req, TYPE_APPLICATION_JSON);
+        esp_err_t res = printer->resume();
+        if (res != ESP_OK) {
+            httpd_resp_send(req, (res == ESP_ERR_NOT_FOUND) ? R"({"error":"There's no print job to resume"})" :
+                                 R"({"error":"Can't resume print job"})", HTTPD_RESP_USE_STRLEN);
+            return ESP_OK;
+        }
+        httpd_resp_send(req, R"({"result":"ok"})", HTTPD_RESP_USE_STRLEN);
+    } else if (strcmp(action, "discard") == 0) {
+        httpd_resp_set_type(req, TYPE_APPLICATION_JSON);
+        printer->discard_recovery();
+        httpd_resp_send(req, R"({"result":"ok"})", HTTPD_RESP_USE_STRLEN);
+    } else if (strcmp(action, "transfer") == 0) {
         httpd_resp_set_type(req, TYPE_APPLICATION_JSON);
         if (ctx->selected_file != nullptr) {
             FILE *f = sdcard_open_file(ctx->selected_file, "r");
@@ -212,20 +305,47 @@ esp_err_t Server::get_printer_handler(httpd_req_t *req) {
                 httpd_resp_send(req, R"({"error":"File does not exist"})", HTTPD_RESP_USE_STRLEN);
                 return ESP_OK;
             }
-            if (printer.start(f) != ESP_OK) {
-                httpd_resp_send(req, R"({"error":"Can't start print job"})", HTTPD_RESP_USE_STRLEN);
+            esp_err_t res = printer->start_transfer(f, ctx->selected_file);
+            if (res != ESP_OK) {
+                fclose(f);
+                httpd_resp_send(req, (res == ESP_ERR_NOT_SUPPORTED) ?
+                                     R"({"error":"Printer can't receive files"})" :
+                                     R"({"error":"Can't copy file to printer"})", HTTPD_RESP_USE_STRLEN);
                 return ESP_OK;
             }
             httpd_resp_send(req, R"({"result":"ok"})", HTTPD_RESP_USE_STRLEN);
         } else {
             httpd_resp_send(req, R"({"error":"File is not selected!"})", HTTPD_RESP_USE_STRLEN);
         }
-    } else if (strcmp(req->uri, "/printer/stop") == 0) {
-        if ((printer.get_status() == PRINTER_PRINTING) && (printer.stop() == ESP_OK)) {
+    } else if (strncmp(action, "queue", 5) == 0) {
+        httpd_resp_set_type(req, TYPE_APPLICATION_JSON);
+        if (handle_queue(printer, &action[5], ctx->selected_file) != ESP_OK) {
+            httpd_resp_send(req, R"({"error":"Can't change print job queue"})", HTTPD_RESP_USE_STRLEN);
+            return ESP_OK;
+        }
+        auto result = (char *) malloc(JOB_QUEUE_JSON_SIZE + 32);
+        if (result == nullptr) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, R"({"error":"Out of memory"})");
+            return ESP_OK;
+        }
+        size_t len = sprintf(result, R"({"result":"ok","jobs":)");
+        size_t jobs_len = printer->get_queue()->to_json(&result[len], JOB_QUEUE_JSON_SIZE);
+        if (jobs_len > 0) {
+            sprintf(&result[len + jobs_len], "}");
+            httpd_resp_send(req, result, HTTPD_RESP_USE_STRLEN);
+        } else httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, R"({"error":"Job list does not fit"})");
+        free(result);
+    } else if (strcmp(action, "stop") == 0) {
+        PrinterStatus status = printer->get_status();
+        if (((status == PRINTER_PRINTING) || (status == PRINTER_TRANSFERRING)) && (printer->stop() == ESP_OK)) {
             httpd_resp_send(req, R"({"result":"ok"})", HTTPD_RESP_USE_STRLEN);
         } else {
             httpd_resp_send(req, R"({"error":"Printer is not printing. Nothing to stop."})", HTTPD_RESP_USE_STRLEN);
         }
+    } else if (strcmp(action, "emergency") == 0) {
+        httpd_resp_set_type(req, TYPE_APPLICATION_JSON);
+        printer->emergency_stop();
+        httpd_resp_send(req, R"({"result":"ok"})", HTTPD_RESP_USE_STRLEN);
     } else {
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, R"({"error":"Bad request"})");
     }
@@ -233,6 +353,39 @@ esp_err_t Server::get_printer_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+/**
+ * Changes print job queue as request query asks: '?add' adds selected file, '?add=<name>' adds
+ * a file by name, '?remove=<n>', '?move=<from>,<to>', '?clear' and '?start', which starts
+ * the first job if printer is idle. No query only lists jobs.
+ * @param printer
+ * @param query
+ * @param selected_file
+ */
+esp_err_t Server::handle_queue(Printer *printer, const char *query, const char *selected_file) {
+    JobQueue *queue = printer->get_queue();
+    if (query[0] == 0) return ESP_OK;
+    if (strcmp(query, "?add") == 0) {
+        return (selected_file != nullptr) ? queue->add(selected_file) : ESP_ERR_INVALID_ARG;
+    } else if (strncmp(query, "?add=", 5) == 0) {
+        char *name = (char *) malloc(strlen(query) + 1);
+        url_decode(name, &query[5]);
+        esp_err_t res = sdcard_has_file(name) ? queue->add(name) : ESP_ERR_NOT_FOUND;
+        free(name);
+        return res;
+    } else if (strncmp(query, "?remove=", 8) == 0) {
+        return queue->remove(atoi(&query[8]));
+    } else if (strncmp(query, "?move=", 6) == 0) {
+        const char *to = strchr(query, ',');
+        return (to != nullptr) ? queue->move(atoi(&query[6]), atoi(&to[1])) : ESP_ERR_INVALID_ARG;
+    } else if (strcmp(query, "?clear") == 0) {
+        queue->clear();
+        return ESP_OK;
+    } else if (strcmp(query, "?start") == 0) {
+        return printer->start_queue();
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
 esp_err_t Server::get_files_handler(httpd_req_t *req) {
     send_cors_headers(req);
 
@@ -248,11 +401,17 @@ esp_err_t Server::get_files_handler(httpd_req_t *req) {
             return ESP_OK;
         }
     } else if (strncmp(req->uri, "/files/?delete", 14) == 0) {
-        if (printer.get_status() == PRINTER_PRINTING) {
-            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, R"({ "error" : "Can't delete file while printing" })");
-            return ESP_OK;
+        for (uint8_t i = 0; i < PRINTERS_MAX; i++) {
+            // File of a job or of a transfer to printer's SD card is being read
+            PrinterStatus status = (printers[i] != nullptr) ? printers[i]->get_status() : PRINTER_IDLE;
+            if ((status == PRINTER_PRINTING) || (status == PRINTER_TRANSFERRING)) {
+                httpd_resp_send_err(req, HTTPD_404_NOT_FOUND,
+                                    R"({ "error" : "Can't delete file while printing or copying to printer" })");
+                return ESP_OK;
+            }
         }
         if (ctx->selected_file != nullptr) {
+            gcode_cache_delete(ctx->selected_file);
             if (sdcard_delete_file(ctx->selected_file) != ESP_OK) {
                 httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, R"({ "error" : "Could not delete file" })");
                 return ESP_OK;
@@ -313,13 +472,21 @@ esp_err_t Server::get_resource_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-esp_err_t Server::send_status_ws() const {
-    char str[200];
-    sprintf(str, R"({"status":"%s","hot_end":"%.2f","hot_end_target":"%.2f","bed":"%.2f","bed_target":"%.2f","progress":%.2f})",
-            printer_state_str(),
-            printer.get_temp_hot_end(), printer.get_temp_hot_end_target(),
-            printer.get_temp_bed(), printer.get_temp_bed_target(),
-            printer.get_progress());
+esp_err_t Server::send_status_ws(const Printer *printer) const {
+    char str[512];
+    float x, y, z, e;
+    printer->get_position(&x, &y, &z, &e);
+    int len = snprintf(str, sizeof(str), R"({"printer":%d,"status":"%s","hot_end":"%.2f","hot_end_target":"%.2f","bed":"%.2f","bed_target":"%.2f","progress":%.2f,)"
+                 R"("remaining":%ld,"layer":%lu,"layers":%lu,"position":{"x":%.2f,"y":%.2f,"z":%.2f,"e":%.2f}})",
+            printer->get_index(), printer_state_str(printer),
+            printer->get_temp_hot_end(), printer->get_temp_hot_end_target(),
+            printer->get_temp_bed(), printer->get_temp_bed_target(),
+            printer->get_progress(), (long) printer->get_remaining_time(),
+            (unsigned long) printer->get_layer(), (unsigned long) printer->get_layers(), x, y, z, e);
+    if ((len < 0) || (len >= (int) sizeof(str))) {
+        ESP_LOGE(TAG, "Status does not fit in %d bytes, not sent", (int) sizeof(str));
+        return ESP_FAIL;
+    }
     ESP_LOGI(TAG, "Send status to WS: %s", str);
     send_ws(str);
 
@@ -367,12 +534,14 @@ void Server::start() {
     server = nullptr;
     context = (context_t *) malloc(sizeof(context_t));
     context->upload_file = nullptr;
+    context->upload_cache = nullptr;
     context->upload_buffer = nullptr;
     context->selected_file = nullptr;
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG(); /* Generate default configuration */
     config.lru_purge_enable = true;
     config.uri_match_fn = httpd_uri_match_wildcard;
+    config.stack_size = 8192;   // Uploaded G-code is pre-processed in server task
 
     httpd_uri_t uri_get_main = { .uri = "/", .method = HTTP_GET, .handler = get_main_handler, .user_ctx = context,
                                  .is_websocket = false, .handle_ws_control_frames = false };
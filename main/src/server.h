@@ -23,6 +23,7 @@
 
 #include "sdkconfig.h"
 #include "multipart.h"
+#include "gcode_cache.h"
 
 #include <esp_http_server.h>
 
@@ -30,10 +31,13 @@ typedef struct context_t {
     char *upload_buffer;
     FILE *upload_file;
     char *selected_file;
+    GcodeCacheWriter *upload_cache;     // Cache made of G-code being uploaded
 
     httpd_handle_t  ws_hd;
 } context_t;
 
+class Printer;
+
 class Server {
 public:
     context_t       *context;
@@ -42,13 +46,14 @@ public:
     void start();
     void stop() const;
     esp_err_t send_ws(const char *string) const;
-    esp_err_t send_status_ws() const;
+    esp_err_t send_status_ws(const Printer *printer) const;
 
 private:
-    static const char *printer_state_str();
+    static const char *printer_state_str(const Printer *printer);
     static void server_chunk_send(const char *chunk, void *context);
     static void server_err_send(const char *err, void *context);
     static void send_cors_headers(httpd_req_t *req);
+    static esp_err_t handle_queue(Printer *printer, const char *query, const char *selected_file);
 
     static esp_err_t post_handler(httpd_req_t *req);
     static esp_err_t options_handler(httpd_req_t *req);
@@ -18,6 +18,10 @@
   along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
 */
 
+#include <cstdlib>
+#include <cstring>
+#include <sys/param.h>
+
 #include "settings.h"
 #include "sdcard.h"
 
@@ -25,9 +29,20 @@ static const char TAG[] = "esp3d-settings";
 
 static const char settings_ip[] = "ip=";
 static const char settings_mask[] = "netmask=";
+static const char settings_gcode_cache[] = "gcode_cache=";
+static const char settings_journal[] = "journal=";
 static const char settings_ssid[] = "ssid=";
 static const char settings_password[] = "password=";
 static const char settings_baud_rate[] = "baudrate=";
+static const char settings_checksum[] = "checksum=";
+static const char settings_virtual_printer[] = "virtual_printer=";
+static const char settings_flow_control[] = "flow_control=";
+static const char settings_uart[] = "uart=";
+static const char settings_prefetch[] = "prefetch=";
+static const char settings_gcode_drop[] = "gcode_drop=";
+static const char settings_gcode_replace[] = "gcode_replace=";
+static const char settings_arc_fitting[] = "arc_fitting=";
+static const char settings_printer_prefix[] = "printer";
 
 #define SETTINGS_MAX_LEN    128
 #define SETTINGS_FILE       "esp3d/settings"
@@ -37,7 +52,32 @@ Settings::Settings() {
     password = nullptr;
     ip = nullptr;
     netmask = nullptr;
-    baud_rate = 250000;
+    gcode_cache = false;
+    journal = 10;
+    for (auto &printer : printers) {
+        printer = {
+                .enabled = false,
+                .uart = -1,
+                .rxd_pin = -1,
+                .txd_pin = -1,
+                .baud_rate = 250000,
+                .checksum = false,
+                .virtual_printer = nullptr,
+                .flow_control = FLOW_CONTROL_NONE,
+                .rts_pin = -1,
+                .cts_pin = -1,
+                .gcode_rules = {},
+                .gcode_rules_cnt = 0,
+                .prefetch = 0,
+                .arc_tolerance = 0
+        };
+    }
+
+    // First printer is always there, on the pins ESP32-CAM has free
+    printers[0].enabled = true;
+    printers[0].uart = 2;
+    printers[0].rxd_pin = 12;
+    printers[0].txd_pin = 13;
 }
 
 esp_err_t Settings::load() {
@@ -56,13 +96,23 @@ esp_err_t Settings::load() {
         if (extract(&password, str, settings_password)) continue;
         if (extract(&ip, str, settings_ip)) continue;
         if (extract(&netmask, str, settings_mask)) continue;
-
-        char *baud_str;
-        if (extract(&baud_str, str, settings_baud_rate)) {
-            baud_rate = atoi(baud_str);
-            free(baud_str);
+        char *value;
+        if (extract(&value, str, settings_gcode_cache)) {
+            gcode_cache = (atoi(value) != 0);
+            free(value);
             continue;
         }
+        if (extract(&value, str, settings_journal)) {
+            journal = strtoul(value, nullptr, 10);
+            free(value);
+            continue;
+        }
+
+        // Settings of other printers than the first one have 'printer<n>.' prefix
+        if ((strncmp(str, settings_printer_prefix, 7) == 0) && (str[7] > '0') && (str[7] < '0' + PRINTERS_MAX) &&
+            (str[8] == '.')) {
+            load_printer(&printers[str[7] - '0'], &str[9]);
+        } else load_printer(&printers[0], str);
     }
 
     fclose(f);
@@ -70,6 +120,54 @@ esp_err_t Settings::load() {
     return ESP_OK;
 }
 
+/**
+ * Internal function.
+ * Parses a printer setting line with no prefix.
+ */
+void Settings::load_printer(printer_settings_t *printer, const char *str) {
+    if (extract(&printer->virtual_printer, str, settings_virtual_printer)) {
+        printer->enabled = true;
+        return;
+    }
+
+    char *value;
+    if (extract(&value, str, settings_uart)) {
+        if (sscanf(value, "%d,%d,%d", &printer->uart, &printer->rxd_pin, &printer->txd_pin) == 3) printer->enabled = true;
+    } else if (extract(&value, str, settings_baud_rate)) {
+        printer->baud_rate = atoi(value);
+    } else if (extract(&value, str, settings_flow_control)) {
+        if (strncmp(value, "rtscts,", 7) == 0) {
+            printer->flow_control = FLOW_CONTROL_RTS_CTS;
+            sscanf(&value[7], "%d,%d", &printer->rts_pin, &printer->cts_pin);
+        } else if (strcmp(value, "xonxoff") == 0) printer->flow_control = FLOW_CONTROL_XON_XOFF;
+    } else if (extract(&value, str, settings_checksum)) {
+        printer->checksum = (atoi(value) != 0);
+    } else if (extract(&value, str, settings_prefetch)) {
+        printer->prefetch = (uint8_t) MIN(atoi(value), 255);
+    } else if (extract(&value, str, settings_arc_fitting)) {
+        printer->arc_tolerance = MAX(strtof(value, nullptr), 0.0f);
+    } else if (printer->gcode_rules_cnt < GCODE_RULES_MAX) {
+        // Rule strings are kept, 'to' points into the same string as 'from'
+        gcode_rule_t *rule = &printer->gcode_rules[printer->gcode_rules_cnt];
+        if (extract(&rule->from, str, settings_gcode_drop)) {
+            rule->to = nullptr;
+            printer->gcode_rules_cnt++;
+        } else if (extract(&rule->from, str, settings_gcode_replace)) {
+            rule->to = strchr(rule->from, ',');
+            if (rule->to == nullptr) {
+                ESP_LOGE(TAG, "G-code replace rule '%s' has no replacement", rule->from);
+                free(rule->from);
+                rule->from = nullptr;
+                return;
+            }
+            *rule->to++ = 0;
+            printer->gcode_rules_cnt++;
+        }
+        return;
+    } else return;
+    free(value);
+}
+
 bool Settings::extract(char **setting, const char *str, const char *name) {
     if (strncmp(str, name, strlen(name)) == 0) {
         size_t l = strlen(str) - strlen(name);
@@ -81,15 +179,82 @@ bool Settings::extract(char **setting, const char *str, const char *name) {
     return false;
 }
 
+/**
+ * Internal function.
+ * Writes a setting to settings file, replacing the line with the same name or adding
+ * a new one. Other lines are kept as they are.
+ * @param name setting name with '='
+ * @param value
+ */
+esp_err_t Settings::save_value(const char *name, const char *value) {
+    // Settings file is small, so it's read as a whole
+    char *content = nullptr;
+    size_t size = 0;
+    FILE *f = sdcard_open_file(SETTINGS_FILE, "r");
+    if (f != nullptr) {
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        rewind(f);
+        content = (char *) malloc(size + 1);
+        if (content == nullptr) {
+            fclose(f);
+            return ESP_ERR_NO_MEM;
+        }
+        size = fread(content, 1, size, f);
+        content[size] = 0;
+        fclose(f);
+    }
+
+    f = sdcard_open_file(SETTINGS_FILE, "w");
+    if (f == nullptr) {
+        ESP_LOGE(TAG, "Can't write settings file");
+        free(content);
+        return ESP_FAIL;
+    }
+    bool replaced = false;
+    char *line = content;
+    while ((line != nullptr) && (*line != 0)) {
+        char *next = strchr(line, '\n');
+        size_t len = (next != nullptr) ? next - line + 1 : strlen(line);
+        if (strncmp(line, name, strlen(name)) == 0) {
+            fprintf(f, "%s%s\n", name, value);
+            replaced = true;
+        } else fwrite(line, 1, len, f);
+        line = (next != nullptr) ? next + 1 : nullptr;
+    }
+    if (!replaced) fprintf(f, "%s%s\n", name, value);
+    fclose(f);
+    free(content);
+
+    return ESP_OK;
+}
+
 void Settings::unload() {
     free(ip);
     free(netmask);
     free(ssid);
     free(password);
+    for (auto &printer : printers) {
+        free(printer.virtual_printer);
+        for (uint8_t i = 0; i < printer.gcode_rules_cnt; i++) free(printer.gcode_rules[i].from);
+    }
 }
 
 char *Settings::get_ip() const { return ip; }
 char *Settings::get_netmask() const { return netmask; }
+bool Settings::get_gcode_cache() const { return gcode_cache; }
+unsigned int Settings::get_journal() const { return journal; }
 char *Settings::get_ssid() const { return ssid; }
 char *Settings::get_password() const { return password; }
-unsigned int Settings::get_baud_rate() const { return baud_rate; }
+const printer_settings_t *Settings::get_printer(uint8_t index) const {
+    return (index < PRINTERS_MAX) ? &printers[index] : nullptr;
+}
+esp_err_t Settings::set_baud_rate(uint8_t index, unsigned int rate) {
+    if (index >= PRINTERS_MAX) return ESP_ERR_INVALID_ARG;
+    printers[index].baud_rate = rate;
+    char name[24], value[16];
+    if (index == 0) strcpy(name, settings_baud_rate);
+    else sprintf(name, "%s%d.%s", settings_printer_prefix, index, settings_baud_rate);
+    sprintf(value, "%u", rate);
+    return save_value(name, value);
+}
@@ -25,16 +25,46 @@
 #include <cstdio>
 #include <esp_err.h>
 
+#include "transport.h"
+#include "gcode_pipeline.h"
+
+#define PRINTERS_MAX        2   // Printers one module drives, each one needs its own UART
+
+/**
+ * Printer connection settings. Settings of the first printer have no prefix,
+ * the ones of the others start with 'printer<n>.', i.e. 'printer1.baudrate=250000'.
+ */
+typedef struct {
+    bool enabled;
+    int uart;                   // UART port number
+    int rxd_pin;
+    int txd_pin;
+    unsigned int baud_rate;
+    bool checksum;
+    char *virtual_printer;
+    FlowControl flow_control;
+    int rts_pin;
+    int cts_pin;
+    gcode_rule_t gcode_rules[GCODE_RULES_MAX];  // Applied to printed G-code
+    uint8_t gcode_rules_cnt;
+    uint8_t prefetch;           // Print file blocks read ahead, 0 for default
+    float arc_tolerance;        // mm G1 moves may be off G2/G3 arcs they are replaced with, 0 if it's off
+} printer_settings_t;
+
 class Settings {
 private:
     char *ssid;
     char *password;
     char *ip;
     char *netmask;
+    bool gcode_cache;           // G-code is pre-processed at upload
+    unsigned int journal;       // Seconds between print journal saves, 0 if it's off
 
-    unsigned int baud_rate;
+    printer_settings_t printers[PRINTERS_MAX]{};
 
     bool extract(char **setting, const char *str, const char *name);
+    void load_printer(printer_settings_t *printer, const char *str);
+    esp_err_t save_value(const char *name, const char *value);
 
 public:
     explicit Settings();
@@ -44,9 +74,12 @@ public:
 
     [[nodiscard]] char *get_ip() const;
     [[nodiscard]] char *get_netmask() const;
+    [[nodiscard]] bool get_gcode_cache() const;
+    [[nodiscard]] unsigned int get_journal() const;
     [[nodiscard]] char *get_ssid() const;
     [[nodiscard]] char *get_password() const;
-    [[nodiscard]] unsigned int get_baud_rate() const;
+    [[nodiscard]] const printer_settings_t *get_printer(uint8_t index) const;
+    esp_err_t set_baud_rate(uint8_t index, unsigned int rate);
 };
 
 #endif //ESP32_PRINT_SETTINGS_H
@@ -0,0 +1,56 @@
+/*
+  transport.h - printer connection transport
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_TRANSPORT_H
+#define ESP32_PRINT_TRANSPORT_H
+
+#include <cstddef>
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+
+enum TransportEvent { TRANSPORT_EVENT_NONE, TRANSPORT_EVENT_DATA, TRANSPORT_EVENT_OVERFLOW,
+                      TRANSPORT_EVENT_FRAME_ERROR };
+enum FlowControl { FLOW_CONTROL_NONE, FLOW_CONTROL_RTS_CTS, FLOW_CONTROL_XON_XOFF };
+
+/**
+ * Byte stream between SerialPort and printer. SerialPort knows nothing about what is behind it,
+ * so the same streaming code talks to a real UART or to a simulated printer.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    virtual esp_err_t init(int baud) = 0;
+    virtual void set_baud_rate(int baud) = 0;
+    virtual esp_err_t set_flow_control(FlowControl mode) = 0;
+
+    virtual int write(const void *data, size_t len) = 0;
+    virtual int read(void *data, size_t len, TickType_t wait) = 0;
+    virtual size_t available() = 0;
+    virtual void flush_input() = 0;
+
+    /**
+     * Waits until something is received or receive fails.
+     * @return TRANSPORT_EVENT_NONE if nothing happened in given time
+     */
+    virtual TransportEvent wait_event(TickType_t wait) = 0;
+};
+
+#endif //ESP32_PRINT_TRANSPORT_H
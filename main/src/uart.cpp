@@ -18,217 +18,990 @@
   along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
 */
 
+#include <cstdio>
+#include <cstdlib>
 #include <ctime>
+#include <sys/param.h>
+#include <esp_timer.h>
 #include "uart.h"
-#include "server.h"
+#include "gcode_pipeline.h"
 
 //#define DEBUG
 
 static const char TAG[] = "esp3d-print-uart";
 
-extern Server server;
-
-SerialPort::SerialPort(int baud, gpio_num_t rxd_pin, gpio_num_t txd_pin) {
+SerialPort::SerialPort(Transport *transport, int baud) {
+    this->transport = transport;
     this->baud = baud;
-    this->rxd_pin = rxd_pin;
-    this->txd_pin = txd_pin;
+    this->frame_errors = 0;
+    this->baud_rate_callback = nullptr;
     this->locked = false;
+    this->busy_seen = false;
     this->str_pos = 0;
-    this->task_rx_tx = nullptr;
+    this->str_overflow = false;
+    this->task_rx = nullptr;
+    this->task_tx = nullptr;
+    this->window_mutex = xSemaphoreCreateRecursiveMutex();
+    for (int i = 0; i < COMMAND_QUEUE_COUNT; i++) {
+        queues[i] = new CommandRing((i == COMMAND_QUEUE_STREAM) ? COMMAND_RING_SIZE : COMMAND_RING_SIZE_SMALL);
+        queue_space[i] = xSemaphoreCreateBinary();
+    }
+    priority_burst = 0;
+    stream_held = false;
+    queues_held = false;
+    raw_handler = nullptr;
+    raw_context = nullptr;
     this->rx_buffer = (char *) malloc(UART_TMP_BUF_SIZE);
 
+    ok_time = 0;
+    ok_tx_latency_last = 0;
+    ok_tx_latency_avg = 0;
+    ok_tx_latency_max = 0;
+    emergency_time = 0;
+    stop_latency_last = 0;
+    stop_latency_max = 0;
+
     this->printer_response_timeout_callback = nullptr;
     this->printer_response_parse_callback = nullptr;
     this->printer_command_sent_callback = nullptr;
+    this->printer_on_timeout_callback = nullptr;
+    this->callback_context = nullptr;
 
-    // Create command buffer
     command_id_cnt = 0;
     command_id_sent = 0;
-    command_buffer_head = 0;
-    command_buffer_tail = 0;
+
+    // Stop-and-wait until printer tells us it has more room
+    in_flight = 0;
+    in_flight_first = 0;
+    in_flight_emergency = 0;
+    in_flight_bytes = 0;
+    confirmed_offset = 0;
+    stream_queued = 0;
+    stream_done = 0;
+    window = 1;
+    printer_free_slots = -1;
+    flow_control = FLOW_CONTROL_NONE;
+    tx_paused = false;
+
+    line_numbers = false;
+    confirmed_line = 0;
+    skip_ok = 0;
+    line_sync = false;
+    resend_ignore_line = 0;
+    resend_ignore_cnt = 0;
 }
 
-void SerialPort::set_sent_callback(void (*callback)()) { printer_command_sent_callback = callback; }
-void SerialPort::set_response_callback(bool (*callback)(const char *)) { printer_response_parse_callback = callback; }
-void SerialPort::set_timeout_callback(bool (*resp_timeout_callback)(), void (*on_timeout_callback)()) {
+/**
+ * Sets the context every callback is called with, i.e. the printer this port belongs to.
+ * Must be set before port is initialized, since baud rate callback may be called from init().
+ * @param context
+ */
+void SerialPort::set_callback_context(void *context) { callback_context = context; }
+void SerialPort::set_sent_callback(void (*callback)(void *)) { printer_command_sent_callback = callback; }
+void SerialPort::set_response_callback(bool (*callback)(const char *, size_t, void *)) {
+    printer_response_parse_callback = callback;
+}
+void SerialPort::set_baud_rate_callback(void (*callback)(int, void *)) { baud_rate_callback = callback; }
+void SerialPort::set_timeout_callback(bool (*resp_timeout_callback)(void *), void (*on_timeout_callback)(void *)) {
     printer_response_timeout_callback = resp_timeout_callback;
     printer_on_timeout_callback = on_timeout_callback;
 }
 
 /**
- * Adds a command string to buffer to be sent via UART.
+ * Internal function.
+ * Chooses a queue for a command. Commands Marlin handles as soon as it receives them
+ * (EMERGENCY_PARSER) are not kept waiting behind anything.
+ */
+static uint8_t queue_for(const char *command, uint8_t source) {
+    if ((source == COMMAND_SOURCE_CONSOLE) && (command[0] == 'M') &&
+            ((strncmp(command, "M112", 4) == 0) || (strncmp(command, "M410", 4) == 0) ||
+             (strncmp(command, "M108", 4) == 0)) &&
+            ((command[4] < '0') || (command[4] > '9'))) {
+        return COMMAND_QUEUE_EMERGENCY;
+    }
+    switch (source) {
+        case COMMAND_SOURCE_PRINT: return COMMAND_QUEUE_STREAM;
+        case COMMAND_SOURCE_STATUS: return COMMAND_QUEUE_STATUS;
+        case COMMAND_SOURCE_PRINTER: return COMMAND_QUEUE_EMERGENCY;
+        default: return COMMAND_QUEUE_CONSOLE;
+    }
+}
+
+/**
+ * Adds a command to the queue of its source.
  * @param command
- * @return enqueued command number if added successfully or 0 if buffer was full
+ * @param source where command came from, defines its priority
+ * @param file_offset position in printed file right after the command
+ * @param wait how long to wait for room in the queue, 0 to fail at once when it's full
+ * @return command ID or 0 if command was not added
  */
-unsigned long SerialPort::send(const char *command) {
+unsigned long SerialPort::send(const char *command, uint8_t source, uint32_t file_offset, TickType_t wait,
+                               int16_t checksum) {
 #ifdef DEBUG
     ESP_LOGI(TAG, "uart_send start");
 #endif
-    uint8_t next_head = command_buffer_head + 1;
-    if (next_head == COMMAND_BUFFER_SIZE) next_head = 0;
-
-    // Cannot add - buffer is full or full of unconfirmed messages
-    if (next_head == command_buffer_tail) return 0;
+    if (strlen(command) > get_command_max_length()) {
+        ESP_LOGE(TAG, "Command is longer than %u characters, not sent", (unsigned) get_command_max_length());
+        return 0;
+    }
 
-    // Allocate memory in a buffer and copy command, reserve 1 character in case
-    // when there's no \n in the end, and we need to add it.
-    uint8_t len = strlen(command);
-    char *ptr = command_buffer[command_buffer_head];
-    strcpy(ptr, command);
-    if (ptr[len-1] != '\n') {   // add newline character if last character is not
-        ptr[len] = '\n';        // a new line then set next to \n and add \0
-        ptr[len+1] = 0;
+    // Cannot add - queue is full or full of unconfirmed messages, so wait until printer confirms something
+    uint8_t q = queue_for(command, source);
+    TickType_t start = xTaskGetTickCount();
+    while (!queues[q]->push(command, source, file_offset, checksum)) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= wait) return 0;
+        xSemaphoreTake(queue_space[q], (wait == portMAX_DELAY) ? portMAX_DELAY : wait - elapsed);
     }
-    command_buffer_head = next_head;
 
 #ifdef DEBUG
-    ESP_LOGI(TAG, "uart_send done: >> %s", ptr);
+    ESP_LOGI(TAG, "uart_send done: >> %s", command);
 #endif
 
-    // Increment command ID
-    auto id = command_id_cnt; command_id_cnt = id + 1;
+    unsigned long id = command_id_cnt.fetch_add(1) + 1;
+    if (q == COMMAND_QUEUE_STREAM) stream_queued.fetch_add(1);
+    wake_transmitter();
 
-    return command_id_cnt;
+    return id;
+}
+
+/**
+ * Internal function.
+ * Lets transmit task know there may be something to send.
+ */
+void SerialPort::wake_transmitter() {
+    if (task_tx != nullptr) xTaskNotifyGive(task_tx);
 }
 
 esp_err_t SerialPort::init() {
-    uart_config_t uart_config = {
-            .baud_rate = baud,
-            .data_bits = UART_DATA_8_BITS,
-            .parity = UART_PARITY_DISABLE,
-            .stop_bits = UART_STOP_BITS_1,
-            .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-            .rx_flow_ctrl_thresh = 122,
-            .source_clk = UART_SCLK_DEFAULT
-    };
-    esp_err_t err_uart = uart_param_config(UART, &uart_config);
-    if (err_uart == ESP_OK) err_uart = uart_set_pin(UART, rxd_pin, txd_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-    if (err_uart == ESP_OK) err_uart = uart_driver_install(UART, UART_TMP_BUF_SIZE, UART_TMP_BUF_SIZE, 0, nullptr, 0);
-    if (err_uart != ESP_OK) {
-        ESP_LOGE(TAG, "UART init failed with error 0x%x", err_uart);
-        return err_uart;
-    }
-
-    ESP_LOGI(TAG, "UART initialized");
-
-    xTaskCreate(SerialPort::rx_tx_task, "uart_rx_tx_task", UART_TASK_STACK_SIZE, this, UART_TASK_PRIORITY, &task_rx_tx);
+    esp_err_t err = transport->init(baud);
+    if (err != ESP_OK) return err;
+
+    // Printer may be off yet, then we keep the rate we were given and probe again on frame errors
+    if (!probe_baud_rate()) {
+        ESP_LOGW(TAG, "Printer does not answer, using %d baud", baud);
+        transport->set_baud_rate(baud);
+    }
+    transport->flush_input();
+
+    xTaskCreate(SerialPort::tx_task, "uart_tx_task", UART_TASK_STACK_SIZE, this, UART_TASK_PRIORITY, &task_tx);
+    xTaskCreate(SerialPort::rx_task, "uart_rx_task", UART_TASK_STACK_SIZE, this, UART_TASK_PRIORITY, &task_rx);
 
     return ESP_OK;
 }
 
 /**
- * Task function. Main printer communication cycle.
+ * Task function. Receives printer responses. Sleeps until transport reports an event,
+ * or for a while to check for response timeout.
  * @param args
  */
-void SerialPort::rx_tx_task(void *args) {
+void SerialPort::rx_task(void *args) {
     auto serialPort = (SerialPort *)args;
     serialPort->str_pos = 0;
 
-    bool can_send = true;
     while (true) {
-        can_send = serialPort->receive() || can_send;
-        if (can_send) can_send = !serialPort->transmit();
-        vPortYield();
+        switch (serialPort->transport->wait_event(pdMS_TO_TICKS(UART_RX_WAIT_MS))) {
+            case TRANSPORT_EVENT_DATA:
+                serialPort->receive();
+                break;
+            case TRANSPORT_EVENT_OVERFLOW:
+                // We've lost some data, so the line being received is broken
+                ESP_LOGW(TAG, "UART receive buffer overflow");
+                serialPort->str_pos = 0;
+                serialPort->str_overflow = false;
+                break;
+            case TRANSPORT_EVENT_FRAME_ERROR:
+                ESP_LOGW(TAG, "UART frame error");
+                if (++serialPort->frame_errors >= UART_PROBE_ERRORS) serialPort->reprobe();
+                break;
+            default:
+                break;
+        }
+        serialPort->check_timeout();
+    }
+}
+
+/**
+ * Task function. Sends commands while printer has room for them, then sleeps until
+ * a command is added or printer confirms one.
+ * @param args
+ */
+void SerialPort::tx_task(void *args) {
+    auto serialPort = (SerialPort *)args;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (serialPort->transmit());
     }
 }
 
+/**
+ * Internal function.
+ * Looks for a newline a word at a time.
+ * @return pointer to newline or end if there's none
+ */
+static const char *find_newline(const char *p, const char *end) {
+    while (((uintptr_t) p & 3) && (p < end)) {
+        if (*p == '\n') return p;
+        p++;
+    }
+    while (p + 4 <= end) {
+        uint32_t word;
+        memcpy(&word, p, 4);
+        word ^= 0x0a0a0a0a;                                                 // Newlines become zero bytes
+        if ((word - 0x01010101) & ~word & 0x80808080) break;                // Has a zero byte
+        p += 4;
+    }
+    while ((p < end) && (*p != '\n')) p++;
+    return p;
+}
+
+/**
+ * Internal function.
+ * Adds a part of the line to temporary string. If it does not fit, the line is marked
+ * as overflown, so it is dropped when it ends.
+ */
+void SerialPort::append_partial(const char *data, size_t len) {
+    if (str_overflow) return;
+    if (str_pos + len > UART_TMP_BUF_SIZE - 1) {
+        str_overflow = true;
+        return;
+    }
+    memcpy(&str[str_pos], data, len);
+    str_pos += len;
+    str[str_pos] = 0;
+}
+
+/**
+ * Internal function.
+ * Passes one received line to printer, carriage return and empty lines are skipped.
+ * @return true if printer confirmed a command with it
+ */
+bool SerialPort::dispatch(char *line, size_t len) {
+    if ((len > 0) && (line[len - 1] == '\r')) line[--len] = 0;
+    if (len == 0) return false;
+    frame_errors = 0;
+    if (printer_response_parse_callback == nullptr) {
+        ESP_LOGE(TAG, "Response process callback was not set!");
+        return false;
+    }
+
+    bool ok_received = false;
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
+    bool taken = (raw_handler != nullptr) && raw_handler(line, len, raw_context);
+    if (!taken && printer_response_parse_callback(line, len, callback_context)) {
+        confirm();
+        ok_received = true;
+    }
+    xSemaphoreGiveRecursive(window_mutex);
+    return ok_received;
+}
+
+/**
+ * Internal function.
+ * Takes XON and XOFF out of received data, so they don't break lines, and pauses
+ * or resumes sending. Transmitter is woken up after every receive anyway.
+ * @return data length left
+ */
+size_t SerialPort::strip_flow_control(char *data, size_t len) {
+    if ((memchr(data, ASCII_XOFF, len) == nullptr) && (memchr(data, ASCII_XON, len) == nullptr)) return len;
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == ASCII_XOFF) tx_paused = true;
+        else if (data[i] == ASCII_XON) tx_paused = false;
+        else data[out++] = data[i];
+    }
+    return out;
+}
+
 /* Receive cycle */
 bool SerialPort::receive() {
     bool ok_received = false;
-    int len = uart_read_bytes(UART, rx_buffer, UART_TMP_BUF_SIZE - 1, 0);
-    if (len > 0) {
+    size_t buffered = transport->available();
+    while (buffered > 0) {
+        int len = transport->read(rx_buffer, MIN(buffered, UART_TMP_BUF_SIZE - 1), 0);
+        if (len <= 0) break;
+        buffered -= len;
 #ifdef DEBUG
         esp_log_write(ESP_LOG_INFO, TAG, "uart_receive start");
-#endif
-        uint16_t cnt = 0;
-
-#ifdef DEBUG
         char str_t[128];
         int l = (len > 127) ? 127 : len;
         memcpy(str_t, rx_buffer, l); str_t[l] = 0;
         esp_log_write(ESP_LOG_INFO, TAG, "<%d:%s>\n", len, str_t);
-        // Workaround(!!!)
-        // There's a bug in IDF that corrupts an answer from printer,
-        // so we can't get confirmation. I decided that any string starting with 'ok'
-        // is enough to be certain that printer confirmed our previous command.
-        /*if ((len >= 2) && (rx_buffer[0] == 'o') && (rx_buffer[1] == 'k')) {
-            printer_response_parse_callback(str_t);
-            ok_received = true;
-            cnt = 2;
-        }*/
 #endif
 
-        // Parse the rest of the string
-        do {
-            if (rx_buffer[cnt] == '\n') {
-                str[str_pos] = 0;
-                if (str_pos > 0) {
-                    if (printer_response_parse_callback != nullptr)
-                        ok_received = printer_response_parse_callback(str) || ok_received;
-                    else ESP_LOGE(TAG, "Response process callback was not set!");
-                    str_pos = 0;
-                }
+        if (flow_control == FLOW_CONTROL_XON_XOFF) len = (int) strip_flow_control(rx_buffer, len);
+
+        // Lines which are completely in receive buffer are parsed right there, only the ones
+        // split between reads are gathered in a temporary string.
+        const char *end = rx_buffer + len;
+        char *line = rx_buffer;
+        while (line < end) {
+            char *eol = (char *) find_newline(line, end);
+            size_t line_len = eol - line;
+            if (eol == end) {                           // Line continues in the next read
+                append_partial(line, line_len);
+                break;
+            }
+
+            if (str_pos > 0 || str_overflow) {
+                append_partial(line, line_len);
+                if (!str_overflow) ok_received = dispatch(str, str_pos) || ok_received;
+                else ESP_LOGW(TAG, "Response is longer than %d bytes, dropped", UART_TMP_BUF_SIZE - 1);
+                str_pos = 0;
+                str_overflow = false;
             } else {
-                str[str_pos++] = rx_buffer[cnt];
-                str[str_pos] = 0;
+                *eol = 0;
+                ok_received = dispatch(line, line_len) || ok_received;
             }
-        } while (++cnt < len);
+            line = eol + 1;
+        }
 #ifdef DEBUG
         ESP_LOGI(TAG, "uart_receive done");
 #endif
-    } else {
-        if (printer_response_timeout_callback != nullptr) {
-            bool timeout_triggered = printer_response_timeout_callback();
-            if (timeout_triggered) {
-                if (printer_on_timeout_callback != nullptr) printer_on_timeout_callback();
-                ESP_LOGI(TAG, "Response timeout triggered, re-sending last command");
-
-                // Rewind to previous command
-                if (command_id_sent > 0) {
-                    auto id = command_id_sent; command_id_sent = id - 1; // Increment sent command ID
-                }
-                uint8_t tail = (command_buffer_tail == 0) ? COMMAND_BUFFER_SIZE : command_buffer_tail - 1;
-                command_buffer_tail = tail;
-                return true;
-            }
-        }
     }
 
+    // Printer confirmed or asked for something, so there may be room for more commands
+    wake_transmitter();
+
     return ok_received;
 }
 
 /**
  * Internal function.
- * Sends command from buffer's tail, but does not increment buffer confirmed pointer.
- * It should be incremented a bit later when confirmation comes from printer.
+ * Asks printer if there's a response timeout and re-sends unconfirmed commands if so.
+ */
+void SerialPort::check_timeout() {
+    if (printer_response_timeout_callback == nullptr) return;
+    if (!printer_response_timeout_callback(callback_context)) return;
+
+    if (printer_on_timeout_callback != nullptr) printer_on_timeout_callback(callback_context);
+    ESP_LOGI(TAG, "Response timeout triggered, re-sending %d unconfirmed command(s)", in_flight);
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
+    tx_paused = false;                      // XON may be lost as well
+    if (emergency_time != 0) {
+        ESP_LOGW(TAG, "Printer did not answer after emergency stop");
+        emergency_time = 0;
+    }
+    rewind();
+    xSemaphoreGiveRecursive(window_mutex);
+    wake_transmitter();
+}
+
+/**
+ * Internal function.
+ * Picks the next command to send. Queues go in order of priority, but when print stream has been
+ * waiting for COMMAND_PRIORITY_BURST commands, it gets its turn, so that printing does not stall.
+ * @param queue queue the command is in
+ * @return command or nullptr if there's nothing to send
+ */
+const command_entry_t *SerialPort::schedule(uint8_t *queue) {
+    if (queues_held) return nullptr;
+    const command_entry_t *stream = stream_held ? nullptr : queues[COMMAND_QUEUE_STREAM]->peek();
+    for (uint8_t q = COMMAND_QUEUE_EMERGENCY; q < COMMAND_QUEUE_STREAM; q++) {
+        if ((q != COMMAND_QUEUE_EMERGENCY) && (stream != nullptr) && (priority_burst >= COMMAND_PRIORITY_BURST)) break;
+        const command_entry_t *entry = queues[q]->peek();
+        if (entry != nullptr) {
+            *queue = q;
+            return entry;
+        }
+    }
+    *queue = COMMAND_QUEUE_STREAM;
+    return stream;
+}
+
+/**
+ * Internal function.
+ * Checks if printer has room for a command. Printer is considered to have room when number
+ * of unconfirmed commands fits in the window and their total length fits in printer's receive buffer.
+ * With flow control printer pauses sending by itself, so only commands in flight are limited.
+ */
+bool SerialPort::can_transmit(const command_entry_t *entry) const {
+    if (entry == nullptr) return false;                       // Nothing to send
+    if (tx_paused) return false;                              // Printer sent XOFF
+    if (line_sync) return false;                              // Line numbers start over once M110 is answered
+    if (in_flight == 0) return true;                          // Nothing in flight, always can send
+    if (flow_control != FLOW_CONTROL_NONE) return in_flight < COMMAND_IN_FLIGHT_MAX;
+    if (in_flight >= window) return false;
+    size_t len = CommandRing::get_length(entry) + (line_numbers ? LINE_NUMBER_OVERHEAD : 0);
+    return (in_flight_bytes + len) <= PRINTER_RX_BUFFER_SIZE;
+}
+
+/**
+ * Internal function.
+ * Tells how long printer may take to answer a command. Moves wait for a free planner block,
+ * homing, probing, heating and dwelling take as long as they take.
+ */
+static uint8_t response_class(const char *command) {
+    char letter = command[0];
+    long code = strtol(&command[1], nullptr, 10);
+    if (letter == 'G') {
+        if ((code >= 0) && (code <= 3)) return RESPONSE_CLASS_MOVE;
+        if ((code == 4) || (code == 28) || (code == 29) || ((code >= 33) && (code <= 35)) || (code == 76)) {
+            return RESPONSE_CLASS_LONG;
+        }
+    } else if (letter == 'M') {
+        if ((code == 0) || (code == 1) || (code == 48) || (code == 109) || (code == 190) || (code == 191) ||
+            (code == 303) || (code == 400) || (code == 600)) return RESPONSE_CLASS_LONG;
+    }
+    return RESPONSE_CLASS_FAST;
+}
+
+/**
+ * Internal function.
+ * Adds 'ok' latency to histogram of its response class. Old answers fade out,
+ * so the histogram follows printer when it gets slower or faster.
+ * @param response_class
+ * @param latency ms
+ */
+void SerialPort::add_latency(uint8_t response_class, uint32_t latency) {
+    uint8_t bucket = 31 - __builtin_clz(latency | 1);
+    if (bucket >= LATENCY_BUCKETS) bucket = LATENCY_BUCKETS - 1;
+    latency_hist[response_class][bucket]++;
+    if (++latency_samples[response_class] < LATENCY_SAMPLES_MAX) return;
+
+    latency_samples[response_class] = 0;
+    for (auto &cnt : latency_hist[response_class]) {
+        cnt /= 2;
+        latency_samples[response_class] += cnt;
+    }
+}
+
+/**
+ * Internal function.
+ * Formats a command as Marlin expects it in line numbered mode: N<line> <command>*<checksum>,
+ * where checksum is XOR of all bytes before '*'. Comments are cut off, because printer drops them
+ * together with the checksum. Printer takes the last '*' as checksum, so '*' in a string is fine.
+ * @param buf room for COMMAND_MAX_LENGTH + LINE_NUMBER_OVERHEAD bytes
+ * @param command
+ * @param line
+ * @param command_checksum XOR of command bytes if it's known, command is not scanned then
+ * @return formatted line length
+ */
+size_t SerialPort::format_line(char *buf, const char *command, unsigned long line, int16_t command_checksum) {
+    size_t len = sprintf(buf, "N%lu ", line);
+    uint8_t checksum = 0;
+    if (command_checksum >= 0) {
+        // Command is clean already, only line number is added to its checksum
+        checksum = (uint8_t) command_checksum;
+        for (size_t i = 0; i < len; i++) checksum ^= (uint8_t) buf[i];
+        size_t cmd_len = strlen(command);
+        if ((cmd_len > 0) && (command[cmd_len - 1] == '\n')) cmd_len--;
+        memcpy(&buf[len], command, cmd_len);
+        len += cmd_len;
+        return len + sprintf(&buf[len], "*%d\n", checksum);
+    }
+
+    // String argument may have ';' in it, it's not a comment there
+    const size_t max_len = COMMAND_MAX_LENGTH + LINE_NUMBER_OVERHEAD - 6;   // Room for '*ccc\n' and terminator
+    char comment = (gcode_string_argument(command) != nullptr) ? 0 : ';';
+    for (const char *c = command; (*c != 0) && (*c != comment) && (*c != '\n') && (*c != '\r') && (len < max_len); c++) {
+        buf[len++] = *c;
+    }
+    while ((len > 0) && (buf[len - 1] == ' ')) len--;
+
+    for (size_t i = 0; i < len; i++) checksum ^= (uint8_t) buf[i];
+    len += sprintf(&buf[len], "*%d\n", checksum);
+
+    return len;
+}
+
+/**
+ * Internal function.
+ * Sends commands from buffers' tails, but does not increment buffers' confirmed pointers.
+ * They should be incremented a bit later when confirmations come from printer. Every command
+ * printer has room for is gathered into one write, while each one is still tracked in flight.
+ * @return true if anything was sent
  */
 bool SerialPort::transmit() {
-    uint8_t tail = command_buffer_tail;
-    if (tail == command_buffer_head) return false;            // Empty buffer
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
 
 #ifdef DEBUG
     ESP_LOGI(TAG, "uart_transmit_from_buffer start ");
 #endif
 
-    uart_write_bytes(UART, command_buffer[tail], strlen(command_buffer[tail]));
-    if (++tail == COMMAND_BUFFER_SIZE) tail = 0;        // Increment transmit pointer
-    command_buffer_tail = tail;
-    auto id = command_id_sent; command_id_sent = id + 1; // Increment sent command ID
-    if (printer_command_sent_callback != nullptr) printer_command_sent_callback();
+    size_t batch_len = 0;
+    bool sent = false;
+    uint8_t q;
+    const command_entry_t *entry;
+    while (can_transmit(entry = schedule(&q))) {
+        const char *command = CommandRing::get_command(entry);
+        size_t len;
+        if (line_numbers) {
+            if (batch_len + COMMAND_MAX_LENGTH + LINE_NUMBER_OVERHEAD > sizeof(tx_buffer)) break;
+            len = format_line(&tx_buffer[batch_len], command, confirmed_line + in_flight_lines(),
+                              CommandRing::get_checksum(entry));
+            batch_len += len;
+        } else {
+            len = CommandRing::get_length(entry);
+            if (batch_len + len <= sizeof(tx_buffer)) {
+                memcpy(&tx_buffer[batch_len], command, len);
+                batch_len += len;
+            } else if (batch_len > 0) break;                // Goes with the next write
+            else transport->write(command, len);           // Too long to gather, written as it is
+        }
+
+        queues[q]->advance();                               // Increment transmit pointer
+        priority_burst = (q == COMMAND_QUEUE_STREAM) ? 0 : priority_burst + 1;
+        uint8_t slot = (in_flight_first + in_flight) % COMMAND_IN_FLIGHT_SLOTS;
+        in_flight_len[slot] = len;
+        in_flight_queue[slot] = q;
+        in_flight_class[slot] = response_class(command);
+        in_flight_time[slot] = (uint32_t) (esp_timer_get_time() / 1000);
+        in_flight_offset[slot] = (q == COMMAND_QUEUE_STREAM) ? entry->file_offset : 0;
+        if (q == COMMAND_QUEUE_STREAM) print_journal_track(&sent_modal, command);
+        in_flight_modal[slot] = sent_modal;
+        in_flight = in_flight + 1;
+        in_flight_bytes = in_flight_bytes + len;
+        auto id = command_id_sent; command_id_sent = id + 1; // Increment sent command ID
+        if (printer_command_sent_callback != nullptr) printer_command_sent_callback(callback_context);
+        sent = true;
+    }
+    if (batch_len > 0) transport->write(tx_buffer, batch_len);
+
+    // Measure how long the command waited since printer had confirmed previous one
+    if (sent && (ok_time != 0)) {
+        ok_tx_latency_last = esp_timer_get_time() - ok_time;
+        ok_tx_latency_avg = (ok_tx_latency_avg * 15 + ok_tx_latency_last) / 16;
+        if (ok_tx_latency_last > ok_tx_latency_max) ok_tx_latency_max = ok_tx_latency_last;
+        ok_time = 0;
+    }
+    xSemaphoreGiveRecursive(window_mutex);
 
 #ifdef DEBUG
     ESP_LOGI(TAG, "uart_transmit_from_buffer done");
 #endif
 
+    return sent;
+}
+
+/**
+ * Internal function.
+ * Printer confirmed the oldest command in flight, so its slot can be freed. If printer
+ * reported its free command slots along with confirmation, the window is adjusted,
+ * otherwise we keep the window we had.
+ */
+void SerialPort::confirm() {
+    if (skip_ok > 0) skip_ok--;
+    else if (line_sync) line_sync = false;  // M110 went before anything in flight
+    else if (in_flight == 0) return;    // Not ours, i.e. printer just started
+    else {
+        uint8_t q = in_flight_queue[in_flight_first];
+        if (q < COMMAND_QUEUE_COUNT) {
+            queues[q]->release();
+            xSemaphoreGive(queue_space[q]);
+            confirmed_line = confirmed_line + 1;
+            if (q == COMMAND_QUEUE_STREAM) stream_done = stream_done + 1;
+        } else in_flight_emergency = in_flight_emergency - 1;
+
+        // Answers delayed by busy printer tell nothing about how fast it answers
+        if (!busy_seen) {
+            add_latency(in_flight_class[in_flight_first],
+                        (uint32_t) (esp_timer_get_time() / 1000) - in_flight_time[in_flight_first]);
+        }
+        in_flight_bytes = in_flight_bytes - in_flight_len[in_flight_first];
+        if (in_flight_offset[in_flight_first] != 0) confirmed_offset = in_flight_offset[in_flight_first];
+        confirmed_modal = in_flight_modal[in_flight_first];
+        in_flight = in_flight - 1;
+        in_flight_first = (in_flight_first + 1) % COMMAND_IN_FLIGHT_SLOTS;
+
+        // Start measuring latency only if a command is ready to go
+        ok_time = has_pending() ? esp_timer_get_time() : 0;
+
+        // B leaves out commands printer holds, which are still in flight, so they are added back.
+        // It also counts the command being answered, Marlin frees its slot right after 'ok'.
+        int16_t free_slots = printer_free_slots;
+        if (free_slots >= 0) {
+            int w = in_flight + 1 + free_slots;
+            window = (w < 1) ? 1 : ((w > COMMAND_WINDOW_MAX) ? COMMAND_WINDOW_MAX : w);
+        }
+    }
+
+    busy_seen = false;
+
+    // Printer answered everything it had got before and along with emergency commands, so it has stopped
+    if ((emergency_time != 0) && (in_flight_emergency == 0)) {
+        stop_latency_last = esp_timer_get_time() - emergency_time;
+        if (stop_latency_last > stop_latency_max) stop_latency_max = stop_latency_last;
+        emergency_time = 0;
+        ESP_LOGI(TAG, "Printer stopped in %lldus", stop_latency_last);
+    }
+}
+
+/**
+ * Writes an emergency command (M108, M410 or M112) to printer ahead of everything queued. Commands
+ * not sent yet are dropped and print stream is held until release_stream() is called. Marlin's
+ * EMERGENCY_PARSER handles these commands as soon as they are received; they may go with
+ * no line number whatever mode is set. Still the line goes to printer's command buffer as any
+ * other, so every one but M112 is answered with an 'ok' after the commands printer had got
+ * before it. It takes a slot in flight, so that 'ok' confirms nothing else. M410 does not drop
+ * commands printer has buffered, so printer has stopped only when that 'ok' comes.
+ * @param command
+ */
+void SerialPort::emergency(const char *command) {
+    char line[16];
+    size_t len = snprintf(line, sizeof(line), "%s\n", command);
+    if (len >= sizeof(line)) return;
+
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
+    transport->write(line, len);
+    if (emergency_time == 0) emergency_time = esp_timer_get_time();
+    if (strncmp(command, "M112", 4) == 0) {
+        // Printer is killed, nothing is going to be answered
+    } else if (in_flight < COMMAND_IN_FLIGHT_SLOTS) {
+        uint8_t slot = (in_flight_first + in_flight) % COMMAND_IN_FLIGHT_SLOTS;
+        in_flight_len[slot] = len;
+        in_flight_queue[slot] = COMMAND_QUEUE_COUNT;
+        in_flight_class[slot] = RESPONSE_CLASS_FAST;
+        in_flight_time[slot] = (uint32_t) (esp_timer_get_time() / 1000);
+        in_flight_offset[slot] = 0;
+        in_flight_modal[slot] = sent_modal;
+        in_flight = in_flight + 1;
+        in_flight_bytes = in_flight_bytes + len;
+        in_flight_emergency = in_flight_emergency + 1;
+    } else {
+        ESP_LOGW(TAG, "No slot in flight for %s, its 'ok' may confirm a command too early", command);
+        skip_ok++;
+    }
+
+    stream_held = true;
+    uint32_t dropped = 0;
+    for (int i = 0; i < COMMAND_QUEUE_COUNT; i++) {
+        uint32_t cnt = queues[i]->discard();
+        if (i == COMMAND_QUEUE_STREAM) stream_done = stream_done + cnt;
+        dropped += cnt;
+        xSemaphoreGive(queue_space[i]);         // Wake producers waiting for room, so they can see they should stop
+    }
+    xSemaphoreGiveRecursive(window_mutex);
+
+    ESP_LOGW(TAG, "Emergency command %s sent, %lu queued command(s) dropped", command, (unsigned long) dropped);
+}
+
+/**
+ * Stops or resumes sending commands from queues. Commands may be added to queues meanwhile,
+ * they are sent when queues are resumed.
+ * @param hold
+ */
+void SerialPort::hold(bool hold) {
+    queues_held = hold;
+    if (!hold) wake_transmitter();
+}
+
+/**
+ * Sets a handler which gets received lines before printer does, i.e. to talk to printer
+ * in other than G-code protocol. Handler is called from receiving task.
+ * @param handler returns true if it took the line, nullptr to remove handler
+ * @param context passed to handler
+ */
+void SerialPort::set_raw_handler(bool (*handler)(const char *, size_t, void *), void *context) {
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
+    raw_context = context;
+    raw_handler = handler;
+    xSemaphoreGiveRecursive(window_mutex);
+}
+
+/**
+ * Writes data to printer as it is, bypassing queues.
+ */
+void SerialPort::write_raw(const void *data, size_t len) {
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
+    transport->write(data, len);
+    xSemaphoreGiveRecursive(window_mutex);
+}
+
+/**
+ * Resumes print stream held by emergency(). Whatever print job added meanwhile is dropped.
+ */
+void SerialPort::release_stream() {
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
+    stream_done = stream_done + queues[COMMAND_QUEUE_STREAM]->discard();
+    stream_held = false;
+    queues_held = false;
+    raw_handler = nullptr;
+    raw_context = nullptr;
+    xSemaphoreGiveRecursive(window_mutex);
+}
+
+/**
+ * Tells if printer has not answered emergency commands yet, i.e. it still executes
+ * commands it had got before M410.
+ */
+bool SerialPort::is_stopping() const { return emergency_time != 0; }
+
+/**
+ * Internal function.
+ * Moves transmit pointer back to the oldest unconfirmed command, so everything in flight
+ * is sent once again. Emergency commands are not sent again, their answers are considered lost.
+ */
+void SerialPort::rewind() {
+    resend_ignore_cnt = 0;
+    auto id = command_id_sent; command_id_sent = id - in_flight_lines();
+    for (auto queue : queues) queue->rewind();
+    in_flight = 0;
+    in_flight_bytes = 0;
+    in_flight_emergency = 0;
+    sent_modal = confirmed_modal;
+    if (line_sync) set_line_number(confirmed_line - 1);  // M110 may be lost as well
+}
+
+/**
+ * Internal function.
+ * Number of commands in flight which were taken from queues, i.e. have line numbers.
+ */
+uint8_t SerialPort::in_flight_lines() const { return in_flight - in_flight_emergency; }
+
+/**
+ * Printer asked to re-send starting from given line (Marlin 'Resend: N' or 'rs N'). Lines before it
+ * were accepted by printer, so they stay in flight waiting for their 'ok's, the rest is sent again.
+ * Every resend request is followed by an 'ok' which confirms nothing.
+ * @param line
+ */
+void SerialPort::resend(unsigned long line) {
+    if (!line_numbers) return;
+    skip_ok++;
+
+    // Nothing numbered goes before M110 is answered, so it's M110 printer didn't take
+    if (line_sync) {
+        resend_ignore_cnt = 0;
+        set_line_number(confirmed_line - 1);
+        return;
+    }
+
+    // Each line we've sent after the broken one produces the same request, only the first one counts
+    if ((resend_ignore_cnt > 0) && (line == resend_ignore_line)) {
+        resend_ignore_cnt--;
+        return;
+    }
+
+    uint8_t lines = in_flight_lines();
+    if ((line < confirmed_line) || (line > confirmed_line + lines)) {
+        // Printer's line counter doesn't match ours (i.e. it was reset), so set it and re-send everything
+        ESP_LOGW(TAG, "Resend of line %lu requested, but we have lines %lu..%lu, resetting line number",
+                 line, confirmed_line, confirmed_line + lines);
+        rewind();
+        set_line_number(confirmed_line - 1);
+        return;
+    }
+
+    auto accepted = (uint8_t) (line - confirmed_line);
+    ESP_LOGI(TAG, "Re-sending from line %lu, %d line(s) in flight", line, lines - accepted);
+    resend_ignore_line = line;
+    resend_ignore_cnt = lines - accepted - 1;
+
+    // Keep accepted commands in flight and rewind to the first broken one. Commands are sent from
+    // each queue in order, so accepted ones are the first sent from their queues. Emergency commands
+    // were accepted with no line number, they stay in flight wherever they are.
+    uint16_t bytes = 0;
+    uint8_t kept = 0, numbered = 0;
+    for (auto queue : queues) queue->rewind();
+    for (uint8_t i = 0; i < in_flight; i++) {
+        uint8_t from = (in_flight_first + i) % COMMAND_IN_FLIGHT_SLOTS;
+        uint8_t q = in_flight_queue[from];
+        if (q < COMMAND_QUEUE_COUNT) {
+            if (numbered++ >= accepted) continue;
+            queues[q]->advance();
+        }
+        uint8_t to = (in_flight_first + kept++) % COMMAND_IN_FLIGHT_SLOTS;
+        in_flight_len[to] = in_flight_len[from];
+        in_flight_queue[to] = q;
+        in_flight_class[to] = in_flight_class[from];
+        in_flight_time[to] = in_flight_time[from];
+        in_flight_offset[to] = in_flight_offset[from];
+        in_flight_modal[to] = in_flight_modal[from];
+        bytes += in_flight_len[to];
+    }
+    sent_modal = (kept > 0) ? in_flight_modal[(in_flight_first + kept - 1) % COMMAND_IN_FLIGHT_SLOTS] : confirmed_modal;
+    auto id = command_id_sent; command_id_sent = id - (lines - accepted);
+    in_flight = kept;
+    in_flight_bytes = bytes;
+}
+
+/**
+ * Internal function.
+ * Checks if printer talks at given baud rate. Printer is asked for M115 and is considered to talk
+ * if it answers with 'ok' (or firmware name) with no frame errors. UART tasks must not be reading meanwhile.
+ * @param rate
+ * @return true if printer answered
+ */
+bool SerialPort::probe(int rate) {
+    transport->set_baud_rate(rate);
+    transport->flush_input();
+    transport->write("\nM115\n", 6);   // Newline ends whatever garbage printer got before
+
+    bool answered = false;
+    size_t pos = 0;
+    int64_t end = esp_timer_get_time() + UART_PROBE_TIMEOUT * 1000;
+    while (esp_timer_get_time() < end) {
+        char c;
+        if (transport->read(&c, 1, 10 / portTICK_PERIOD_MS) <= 0) continue;
+        if ((c != '\n') && (c != '\r') && ((c < ' ') || (c > '~'))) return false;    // Garbage, wrong rate
+        if (c != '\n') {
+            if (pos < UART_TMP_BUF_SIZE - 1) str[pos++] = c;
+            continue;
+        }
+        str[pos] = 0;
+        if (strncmp(str, "FIRMWARE_NAME:", 14) == 0) answered = true;
+        else if ((str[0] == 'o') && (str[1] == 'k')) return true;     // Everything printer had to say is read
+        pos = 0;
+    }
+    return answered;
+}
+
+/**
+ * Internal function.
+ * Looks for baud rate printer talks at. Current rate is tried first, then known rates from the fastest one.
+ * @return true if printer answered at some rate
+ */
+bool SerialPort::probe_baud_rate() {
+    static const int rates[] = UART_BAUD_RATES;
+    int found = 0;
+    if (probe(baud)) found = baud;
+    for (size_t i = 0; (found == 0) && (i < sizeof(rates) / sizeof(rates[0])); i++) {
+        if ((rates[i] != baud) && probe(rates[i])) found = rates[i];
+    }
+    str_pos = 0;
+    str_overflow = false;
+    if (found == 0) return false;
+
+    ESP_LOGI(TAG, "Printer answers at %d baud", found);
+    if (found != baud) {
+        baud = found;
+        if (baud_rate_callback != nullptr) baud_rate_callback(baud, callback_context);
+    }
     return true;
 }
 
+/**
+ * Internal function.
+ * Called from receiving task when frame errors keep coming, i.e. printer's baud rate was changed.
+ * Nothing is sent meanwhile, everything in flight is sent again after that.
+ */
+void SerialPort::reprobe() {
+    ESP_LOGW(TAG, "Too many frame errors, probing baud rate");
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
+    if (!probe_baud_rate()) transport->set_baud_rate(baud);
+    transport->flush_input();
+    frame_errors = 0;
+
+    // Printer might have got broken lines, so its line number is set again
+    if (line_numbers) set_line_number(confirmed_line - 1);
+    rewind();
+    xSemaphoreGiveRecursive(window_mutex);
+    wake_transmitter();
+}
+
+/**
+ * Internal function.
+ * Sets printer's current line number with M110 bypassing command buffer. M110 is accepted
+ * whatever line number printer expects. It's answered with 'ok' which should not confirm anything,
+ * or with a resend request if it was broken on its way. Queues wait for that, so the answer can't
+ * be taken for one of theirs.
+ * @param line
+ */
+void SerialPort::set_line_number(unsigned long line) {
+    char cmd[24];
+    sprintf(cmd, "M110 N%lu", line);
+    size_t len = format_line(tx_buffer, cmd, line);
+    transport->write(tx_buffer, len);
+    line_sync = true;
+}
+
+/**
+ * Enables or disables line numbers and checksums. Printer's line counter is reset
+ * before the first line numbered command goes out.
+ * @param enable
+ */
+void SerialPort::set_line_numbers(bool enable) {
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
+    if (enable && !line_numbers) {
+        confirmed_line = 1;
+        set_line_number(0);
+    } else if (!enable && line_sync) {
+        line_sync = false;              // Its 'ok' is still to come
+        skip_ok++;
+    }
+    line_numbers = enable;
+    xSemaphoreGiveRecursive(window_mutex);
+}
+
+/**
+ * Sets streaming mode. With flow control printer pauses sending with CTS line or XOFF, so
+ * commands are sent as fast as the line takes them, and 'ok's only confirm them. Otherwise
+ * sending is paced by 'ok's.
+ * @param mode
+ */
+esp_err_t SerialPort::set_flow_control(FlowControl mode) {
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
+    esp_err_t err = transport->set_flow_control(mode);
+    if (err == ESP_OK) {
+        flow_control = mode;
+        tx_paused = false;
+        ESP_LOGI(TAG, "Flow control: %s", (mode == FLOW_CONTROL_RTS_CTS) ? "RTS/CTS" :
+                                          ((mode == FLOW_CONTROL_XON_XOFF) ? "XON/XOFF" : "none"));
+    }
+    xSemaphoreGiveRecursive(window_mutex);
+    wake_transmitter();
+    return err;
+}
+
+FlowControl SerialPort::get_flow_control() const { return flow_control; }
+
+/**
+ * Printer reported how many free slots it has in its command buffer (Marlin ADVANCED_OK).
+ * Window is recalculated on next confirmation.
+ * @param free_slots
+ */
+void SerialPort::set_free_slots(unsigned int free_slots) {
+    printer_free_slots = (int16_t) ((free_slots > COMMAND_WINDOW_MAX) ? COMMAND_WINDOW_MAX : free_slots);
+}
+
 unsigned long int SerialPort::get_command_id_sent() const {
     return command_id_sent;
 }
 
+unsigned long int SerialPort::get_command_id_confirmed() const {
+    return command_id_sent - in_flight_lines();
+}
+
+/**
+ * Gets position in printed file right after the last print command printer confirmed,
+ * i.e. where print may be resumed from.
+ */
+uint32_t SerialPort::get_confirmed_offset() const { return confirmed_offset; }
+void SerialPort::set_confirmed_offset(uint32_t offset) { confirmed_offset = offset; }
+
+/**
+ * Gets modal state print commands printer confirmed have left it in. It goes along with
+ * confirmed offset, so print may be resumed with it. Print commands in flight are not taken
+ * into account, and commands of other sources are not tracked at all.
+ * @param modal
+ */
+void SerialPort::get_confirmed_modal(print_modal_t *modal) {
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
+    *modal = confirmed_modal;
+    xSemaphoreGiveRecursive(window_mutex);
+}
+
+/**
+ * Sets modal state print job starts with. Print commands must not be in flight.
+ * @param modal
+ */
+void SerialPort::set_confirmed_modal(const print_modal_t *modal) {
+    xSemaphoreTakeRecursive(window_mutex, portMAX_DELAY);
+    confirmed_modal = *modal;
+    sent_modal = *modal;
+    xSemaphoreGiveRecursive(window_mutex);
+}
+
+/**
+ * Counts print commands, so that it's known when printer is done with the ones queued
+ * before some moment: it is when get_stream_done() gets to what get_stream_queued() was then.
+ */
+uint32_t SerialPort::get_stream_queued() const { return stream_queued.load(); }
+uint32_t SerialPort::get_stream_done() const { return stream_done; }
+
 void SerialPort::lock(bool lock) {
     this->locked = lock;
+    if (lock) busy_seen = true;
 }
 
 bool SerialPort::is_locked() const {
@@ -236,15 +1009,81 @@ bool SerialPort::is_locked() const {
 }
 
 /**
- * Defines how many unconfirmed commands printer can bear. Technically this is its command buffer
- * size.
- *
- * @param size
- * @return
+ * Gets time printer may take to answer the oldest command in flight, after that the line
+ * is considered lost. Timeout is derived from answers measured for commands of the same
+ * class. Commands are only re-sent that fast with line numbers, so printer drops the ones
+ * it has got already. Otherwise a command would be executed twice.
+ * @return ms
  */
-int SerialPort::get_buffer_head() const { return command_buffer_head; }
-int SerialPort::get_buffer_tail() const { return command_buffer_tail; }
+uint32_t SerialPort::get_response_timeout() const {
+    if (in_flight == 0) return RESPONSE_TIMEOUT_DEFAULT;
+    auto response_class = (ResponseClass) in_flight_class[in_flight_first];
+    if (response_class == RESPONSE_CLASS_LONG) return RESPONSE_TIMEOUT_LONG;
+    if (!line_numbers) return RESPONSE_TIMEOUT_DEFAULT;
+    return get_class_timeout(response_class);
+}
+
+uint32_t SerialPort::get_class_timeout(ResponseClass response_class) const {
+    if (response_class == RESPONSE_CLASS_LONG) return RESPONSE_TIMEOUT_LONG;
+    uint16_t samples = latency_samples[response_class];
+    if (samples < LATENCY_SAMPLES_MIN) return RESPONSE_TIMEOUT_DEFAULT;
+
+    // 99th percentile, rounded up to the bucket's upper bound
+    const uint16_t *hist = latency_hist[response_class];
+    uint16_t above = 0;
+    int bucket = LATENCY_BUCKETS - 1;
+    while ((bucket > 0) && (above + hist[bucket] <= samples / 100)) above += hist[bucket--];
+    uint32_t timeout = (2u << bucket) * RESPONSE_TIMEOUT_FACTOR;
+    return (timeout < RESPONSE_TIMEOUT_MIN) ? RESPONSE_TIMEOUT_MIN :
+           ((timeout > RESPONSE_TIMEOUT_DEFAULT) ? RESPONSE_TIMEOUT_DEFAULT : timeout);
+}
+
+/**
+ * Number of commands waiting to be sent or confirmed.
+ */
+uint32_t SerialPort::get_queued() const {
+    uint32_t cnt = 0;
+    for (auto queue : queues) cnt += queue->get_count();
+    return cnt;
+}
+
+/**
+ * Internal function.
+ * Checks if any queue has a command to send.
+ */
+bool SerialPort::has_pending() {
+    for (auto queue : queues) if (queue->peek() != nullptr) return true;
+    return false;
+}
+
+uint8_t SerialPort::get_in_flight() const { return in_flight; }
+uint8_t SerialPort::get_window() const { return window; }
+
+/**
+ * Longest command printer takes. Marlin's MAX_CMD_SIZE holds the line with its terminating zero,
+ * and with line numbers on, 'N<n> ' and '*<checksum>' as well.
+ * @return characters
+ */
+size_t SerialPort::get_command_max_length() const {
+    return COMMAND_MAX_LENGTH - 1 - (line_numbers ? LINE_NUMBER_OVERHEAD : 0);
+}
+int SerialPort::get_baud_rate() const { return baud; }
+
+void SerialPort::get_ok_tx_latency(int64_t *last, int64_t *avg, int64_t *max) const {
+    *last = ok_tx_latency_last;
+    *avg = ok_tx_latency_avg;
+    *max = ok_tx_latency_max;
+}
+
+void SerialPort::get_stop_latency(int64_t *last, int64_t *max) const {
+    *last = stop_latency_last;
+    *max = stop_latency_max;
+}
 
 SerialPort::~SerialPort() {
+    for (int i = 0; i < COMMAND_QUEUE_COUNT; i++) {
+        delete queues[i];
+        vSemaphoreDelete(queue_space[i]);
+    }
     free(rx_buffer);
 }
@@ -23,64 +23,203 @@
 
 #include <cstring>
 #include <esp_log.h>
-#include <driver/uart.h>
-#include <driver/gpio.h>
-
-#define COMMAND_BUFFER_SIZE     32
-#define COMMAND_MAX_LENGTH      64
-
-#define UART                    UART_NUM_2
-#define UART_TASK_PRIORITY      tskIDLE_PRIORITY
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "command_ring.h"
+#include "print_journal.h"
+#include "transport.h"
+
+#define COMMAND_RING_SIZE       2048    // bytes, power of 2, print stream queue
+#define COMMAND_RING_SIZE_SMALL 512     // bytes, power of 2, console, status and emergency queues
+#define COMMAND_PRIORITY_BURST  4       // Commands console and status may send in a row while print stream waits
+#define COMMAND_MAX_LENGTH      96      // Marlin's MAX_CMD_SIZE
+#define COMMAND_WINDOW_MAX      8       // Max commands sent but not yet confirmed by printer
+#define COMMAND_IN_FLIGHT_MAX   32      // Max commands sent but not yet confirmed with flow control
+#define COMMAND_IN_FLIGHT_SLOTS (COMMAND_IN_FLIGHT_MAX + 4)    // Room for emergency commands on top of that
+#define PRINTER_RX_BUFFER_SIZE  128     // Marlin's default RX_BUFFER_SIZE, bytes
+#define LINE_NUMBER_OVERHEAD    16      // Max bytes 'N<n> ' and '*<checksum>' add to a command
+
+#define UART_TASK_PRIORITY      (tskIDLE_PRIORITY + 6)  // Tasks block on events, so they may preempt HTTP server
 #define UART_TASK_STACK_SIZE    4096    // bytes
 #define UART_TMP_BUF_SIZE       512     // bytes
+#define UART_RX_WAIT_MS         20      // How often to check for response timeout when nothing is received
+#define UART_PROBE_TIMEOUT      300     // ms to wait for printer to answer at a baud rate
+#define UART_PROBE_ERRORS       16      // Frame errors in a row after which baud rate is probed again
+#define RESPONSE_TIMEOUT_MIN    30      // ms, shortest time to wait for 'ok' before lines are considered lost
+#define RESPONSE_TIMEOUT_DEFAULT 5000   // ms, until enough answers are measured or with no line numbers
+#define RESPONSE_TIMEOUT_LONG   300000  // ms, homing, heating and such with no busy keepalive
+#define RESPONSE_TIMEOUT_FACTOR 4       // Timeout is this times 99th percentile of 'ok' latency
+#define LATENCY_BUCKETS         16      // Histogram buckets, bucket n holds latencies up to 2^(n+1) ms
+#define LATENCY_SAMPLES_MIN     32      // Answers to measure before timeout adapts
+#define LATENCY_SAMPLES_MAX     1024    // Histogram is halved when it has this many answers
+#define ASCII_XON               0x11
+#define ASCII_XOFF              0x13
+#define UART_BAUD_RATES         { 2000000, 1000000, 921600, 500000, 460800, 250000, 230400, 115200 }
+
+// Command queues in order of priority
+enum CommandQueue { COMMAND_QUEUE_EMERGENCY, COMMAND_QUEUE_CONSOLE, COMMAND_QUEUE_STATUS, COMMAND_QUEUE_STREAM,
+                    COMMAND_QUEUE_COUNT };
+
+// How long printer may take to answer a command
+enum ResponseClass { RESPONSE_CLASS_FAST, RESPONSE_CLASS_MOVE, RESPONSE_CLASS_LONG, RESPONSE_CLASS_COUNT };
 
 class SerialPort {
 private:
     int baud;
-    gpio_num_t txd_pin;
-    gpio_num_t rxd_pin;
+    uint8_t frame_errors;                       // Frame errors since last line was received
+    Transport *transport;
 
-    volatile unsigned int command_id_cnt;
+    std::atomic<unsigned long> command_id_cnt;
     volatile unsigned int command_id_sent;
 
-    char command_buffer[COMMAND_BUFFER_SIZE][COMMAND_MAX_LENGTH]{};
-    uint8_t command_buffer_head;
-    volatile uint8_t command_buffer_tail;
+    CommandRing *queues[COMMAND_QUEUE_COUNT]{};
+    SemaphoreHandle_t queue_space[COMMAND_QUEUE_COUNT]{};  // Given when a queue frees an entry
+    uint8_t priority_burst;                     // Commands sent ahead of waiting print stream
+    volatile bool stream_held;                  // Print stream is not sent after emergency stop
+    volatile bool queues_held;                  // Nothing is sent from queues, i.e. during binary transfer
     bool locked;
-
-    TaskHandle_t task_rx_tx;
-
-    void (*printer_command_sent_callback)();
-    bool (*printer_response_parse_callback)(const char *resp);
-    bool (*printer_response_timeout_callback)();
-    void (*printer_on_timeout_callback)();
+    bool busy_seen;                             // Printer sent busy keepalive since last 'ok'
+
+    // Sliding window, commands sent but not confirmed are in flight
+    volatile uint8_t in_flight;
+    volatile uint16_t in_flight_bytes;
+    volatile uint8_t window;
+    volatile int16_t printer_free_slots;        // Reported by ADVANCED_OK, -1 if unknown
+
+    // With flow control printer paces sending by itself, 'ok's only confirm commands
+    FlowControl flow_control;
+    volatile bool tx_paused;                    // Printer sent XOFF
+    uint8_t in_flight_first;
+    volatile uint8_t in_flight_emergency;       // Emergency commands in flight, they have no line number
+    uint8_t in_flight_len[COMMAND_IN_FLIGHT_SLOTS]{}; // Bytes sent for each command in flight
+    uint8_t in_flight_queue[COMMAND_IN_FLIGHT_SLOTS]{}; // Queue each command in flight was taken from, COMMAND_QUEUE_COUNT if none
+    uint8_t in_flight_class[COMMAND_IN_FLIGHT_SLOTS]{}; // Response class of each command in flight
+    uint32_t in_flight_time[COMMAND_IN_FLIGHT_SLOTS]{}; // When each command in flight was sent, ms
+    uint32_t in_flight_offset[COMMAND_IN_FLIGHT_SLOTS]{}; // Printed file position after each command in flight
+    print_modal_t in_flight_modal[COMMAND_IN_FLIGHT_SLOTS]{}; // Print modal state after each command in flight
+    volatile uint32_t confirmed_offset;         // Printed file position after the last confirmed command
+    std::atomic<uint32_t> stream_queued;        // Print commands ever queued
+    volatile uint32_t stream_done;              // and confirmed or dropped
+    print_modal_t sent_modal{};                 // Print modal state after the last sent command
+    print_modal_t confirmed_modal{};            // and after the last confirmed one
+
+    // 'ok' latency histograms, one per response class
+    uint16_t latency_hist[RESPONSE_CLASS_COUNT][LATENCY_BUCKETS]{};
+    uint16_t latency_samples[RESPONSE_CLASS_COUNT]{};
+
+    // Line numbered mode, line number of a command is confirmed_line + its position in flight
+    bool line_numbers;
+    volatile unsigned long confirmed_line;
+    uint8_t skip_ok;                            // 'ok's that follow resend requests, they confirm nothing
+    volatile bool line_sync;                    // M110 is not answered yet, nothing else is sent meanwhile
+    unsigned long resend_ignore_line;
+    uint8_t resend_ignore_cnt;                  // Duplicate resend requests expected for the same line
+    char tx_buffer[PRINTER_RX_BUFFER_SIZE + COMMAND_MAX_LENGTH + LINE_NUMBER_OVERHEAD]{}; // Commands written at once
+
+    TaskHandle_t task_rx;
+    TaskHandle_t task_tx;
+    SemaphoreHandle_t window_mutex;             // Guards window state shared by RX and TX tasks
+
+    // 'ok' to next command transmit latency, microseconds
+    int64_t ok_time;
+    int64_t ok_tx_latency_last;
+    int64_t ok_tx_latency_avg;
+    int64_t ok_tx_latency_max;
+
+    // Emergency command to printer answering everything it had, microseconds
+    int64_t emergency_time;
+    int64_t stop_latency_last;
+    int64_t stop_latency_max;
+
+    // Callbacks get the context, so each printer gets calls of its own port
+    void (*printer_command_sent_callback)(void *context);
+    bool (*printer_response_parse_callback)(const char *resp, size_t len, void *context);
+    bool (*printer_response_timeout_callback)(void *context);
+    void (*printer_on_timeout_callback)(void *context);
+    void (*baud_rate_callback)(int baud, void *context);
+    void *callback_context;
+
+    // Lines raw handler takes are not passed to printer
+    bool (*raw_handler)(const char *line, size_t len, void *context);
+    void *raw_context;
 
     char *rx_buffer;
-    char str[UART_TMP_BUF_SIZE]{};
+    char str[UART_TMP_BUF_SIZE]{};              // Line split between two reads
     uint16_t str_pos;
+    bool str_overflow;
 
     bool receive();
+    size_t strip_flow_control(char *data, size_t len);
+    void append_partial(const char *data, size_t len);
+    bool dispatch(char *line, size_t len);
+    void check_timeout();
     bool transmit();
+    void wake_transmitter();
+    const command_entry_t *schedule(uint8_t *queue);
+    [[nodiscard]] bool can_transmit(const command_entry_t *entry) const;
+    [[nodiscard]] bool has_pending();
+    void confirm();
+    void add_latency(uint8_t response_class, uint32_t latency);
+    void rewind();
+    [[nodiscard]] uint8_t in_flight_lines() const;
+    bool probe(int rate);
+    bool probe_baud_rate();
+    void reprobe();
+    static size_t format_line(char *buf, const char *command, unsigned long line, int16_t command_checksum = -1);
+    void set_line_number(unsigned long line);
 
 public:
-    explicit        SerialPort(int baud, gpio_num_t rxd_pin, gpio_num_t txd_pin);
+                    SerialPort(Transport *transport, int baud);
                     ~SerialPort();
 
     esp_err_t       init();
-    unsigned long   send(const char *command);
+    unsigned long   send(const char *command, uint8_t source = COMMAND_SOURCE_CONSOLE, uint32_t file_offset = 0,
+                         TickType_t wait = 0, int16_t checksum = -1);
 
-    void set_sent_callback(void (*callback)());
-    void set_response_callback(bool (*callback)(const char *));
-    void set_timeout_callback(bool (*resp_timeout_callback)(), void (*on_timeout_callback)());
+    void set_callback_context(void *context);
+    void set_sent_callback(void (*callback)(void *));
+    void set_response_callback(bool (*callback)(const char *, size_t, void *));
+    void set_timeout_callback(bool (*resp_timeout_callback)(void *), void (*on_timeout_callback)(void *));
+    void set_baud_rate_callback(void (*callback)(int baud, void *));
 
-    [[noreturn]] static void rx_tx_task(void *args);
+    [[noreturn]] static void rx_task(void *args);
+    [[noreturn]] static void tx_task(void *args);
 
     [[nodiscard]] unsigned long int get_command_id_sent() const;
+    [[nodiscard]] unsigned long int get_command_id_confirmed() const;
+    [[nodiscard]] uint32_t get_confirmed_offset() const;
+    [[nodiscard]] uint32_t get_stream_queued() const;
+    [[nodiscard]] uint32_t get_stream_done() const;
+    void set_confirmed_offset(uint32_t offset);
+    void get_confirmed_modal(print_modal_t *modal);
+    void set_confirmed_modal(const print_modal_t *modal);
+
+    void emergency(const char *command);
+    void release_stream();
+    [[nodiscard]] bool is_stopping() const;
+
+    void hold(bool hold);
+    void set_raw_handler(bool (*handler)(const char *line, size_t len, void *context), void *context);
+    void write_raw(const void *data, size_t len);
+
+    void set_free_slots(unsigned int free_slots);
+    void set_line_numbers(bool enable);
+    esp_err_t set_flow_control(FlowControl mode);
+    [[nodiscard]] FlowControl get_flow_control() const;
+    void resend(unsigned long line);
+    [[nodiscard]] uint8_t get_in_flight() const;
+    [[nodiscard]] uint8_t get_window() const;
+    [[nodiscard]] size_t get_command_max_length() const;
+    [[nodiscard]] int get_baud_rate() const;
+    void get_ok_tx_latency(int64_t *last, int64_t *avg, int64_t *max) const;
+    [[nodiscard]] uint32_t get_response_timeout() const;
+    [[nodiscard]] uint32_t get_class_timeout(ResponseClass response_class) const;
+    void get_stop_latency(int64_t *last, int64_t *max) const;
 
     void lock(bool locked);
     [[nodiscard]] bool is_locked() const;
-    [[nodiscard]] int get_buffer_head() const;
-    [[nodiscard]] int get_buffer_tail() const;
+    [[nodiscard]] uint32_t get_queued() const;
 };
 
 #endif //ESP32_PRINT_UART_H
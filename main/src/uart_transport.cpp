@@ -0,0 +1,130 @@
+/*
+  uart_transport.cpp - ESP32 UART transport
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <esp_log.h>
+
+#include "uart_transport.h"
+
+static const char TAG[] = "esp3d-print-uart";
+
+UartTransport::UartTransport(uart_port_t port, gpio_num_t rxd_pin, gpio_num_t txd_pin, int rts_pin, int cts_pin) {
+    this->port = port;
+    this->rxd_pin = rxd_pin;
+    this->txd_pin = txd_pin;
+    this->rts_pin = rts_pin;
+    this->cts_pin = cts_pin;
+    this->uart_queue = nullptr;
+}
+
+esp_err_t UartTransport::init(int baud) {
+    uart_config_t uart_config = {
+            .baud_rate = baud,
+            .data_bits = UART_DATA_8_BITS,
+            .parity = UART_PARITY_DISABLE,
+            .stop_bits = UART_STOP_BITS_1,
+            .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+            .rx_flow_ctrl_thresh = 122,
+            .source_clk = UART_SCLK_DEFAULT
+    };
+    esp_err_t err_uart = uart_param_config(port, &uart_config);
+    if (err_uart == ESP_OK) err_uart = uart_set_pin(port, rxd_pin, txd_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    if (err_uart == ESP_OK) err_uart = uart_driver_install(port, UART_DRIVER_BUF_SIZE, UART_DRIVER_BUF_SIZE,
+                                                           UART_EVENT_QUEUE_SIZE, &uart_queue, 0);
+
+    // Get an event as soon as a line ends, or when FIFO fills up or line goes silent
+    if (err_uart == ESP_OK) err_uart = uart_enable_pattern_det_baud_intr(port, '\n', 1, 9, 0, 0);
+    if (err_uart == ESP_OK) err_uart = uart_pattern_queue_reset(port, UART_EVENT_QUEUE_SIZE);
+    if (err_uart == ESP_OK) err_uart = uart_set_rx_full_threshold(port, UART_RX_FULL_THRESHOLD);
+    if (err_uart == ESP_OK) err_uart = uart_set_rx_timeout(port, UART_RX_TIMEOUT);
+    if (err_uart != ESP_OK) {
+        ESP_LOGE(TAG, "UART init failed with error 0x%x", err_uart);
+        return err_uart;
+    }
+
+    ESP_LOGI(TAG, "UART initialized");
+    return ESP_OK;
+}
+
+void UartTransport::set_baud_rate(int baud) { uart_set_baudrate(port, baud); }
+
+/**
+ * Makes UART pause transmission when printer asks for it, either with CTS line or with XOFF
+ * character. RTS/CTS needs pins to be given.
+ * @param mode
+ */
+esp_err_t UartTransport::set_flow_control(FlowControl mode) {
+    if ((mode == FLOW_CONTROL_RTS_CTS) && ((rts_pin == UART_PIN_NO_CHANGE) || (cts_pin == UART_PIN_NO_CHANGE))) {
+        ESP_LOGE(TAG, "RTS and CTS pins are not set");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (mode == FLOW_CONTROL_RTS_CTS) {
+        err = uart_set_pin(port, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, rts_pin, cts_pin);
+    }
+    if (err == ESP_OK) {
+        err = uart_set_hw_flow_ctrl(port, (mode == FLOW_CONTROL_RTS_CTS) ? UART_HW_FLOWCTRL_CTS_RTS :
+                                          UART_HW_FLOWCTRL_DISABLE, UART_RTS_THRESHOLD);
+    }
+    if (err == ESP_OK) {
+        err = uart_set_sw_flow_ctrl(port, mode == FLOW_CONTROL_XON_XOFF, UART_XON_THRESHOLD, UART_XOFF_THRESHOLD);
+    }
+    if (err != ESP_OK) ESP_LOGE(TAG, "Can't set flow control, error 0x%x", err);
+    return err;
+}
+
+int UartTransport::write(const void *data, size_t len) { return uart_write_bytes(port, data, len); }
+
+int UartTransport::read(void *data, size_t len, TickType_t wait) { return uart_read_bytes(port, data, len, wait); }
+
+size_t UartTransport::available() {
+    size_t buffered = 0;
+    uart_get_buffered_data_len(port, &buffered);
+    return buffered;
+}
+
+void UartTransport::flush_input() {
+    uart_flush_input(port);
+    uart_pattern_queue_reset(port, UART_EVENT_QUEUE_SIZE);
+    xQueueReset(uart_queue);
+}
+
+TransportEvent UartTransport::wait_event(TickType_t wait) {
+    uart_event_t event;
+    if (!xQueueReceive(uart_queue, &event, wait)) return TRANSPORT_EVENT_NONE;
+    switch (event.type) {
+        case UART_DATA:
+            return TRANSPORT_EVENT_DATA;
+        case UART_PATTERN_DET:
+            // Positions of detected line ends are not used, everything buffered is read anyway
+            uart_pattern_queue_reset(port, UART_EVENT_QUEUE_SIZE);
+            return TRANSPORT_EVENT_DATA;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // We've lost some data, so the line being received is broken
+            flush_input();
+            return TRANSPORT_EVENT_OVERFLOW;
+        case UART_FRAME_ERR:
+        case UART_PARITY_ERR:
+            return TRANSPORT_EVENT_FRAME_ERROR;
+        default:
+            return TRANSPORT_EVENT_NONE;
+    }
+}
@@ -0,0 +1,63 @@
+/*
+  uart_transport.h - ESP32 UART transport
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_UART_TRANSPORT_H
+#define ESP32_PRINT_UART_TRANSPORT_H
+
+#include <driver/uart.h>
+#include <driver/gpio.h>
+#include <freertos/queue.h>
+
+#include "transport.h"
+
+#define UART_DRIVER_BUF_SIZE    512     // bytes
+#define UART_EVENT_QUEUE_SIZE   20
+#define UART_RX_FULL_THRESHOLD  64      // bytes
+#define UART_RX_TIMEOUT         2       // symbols of silence after which received data is reported
+#define UART_RTS_THRESHOLD      96      // bytes in RX FIFO to deassert RTS at
+#define UART_XOFF_THRESHOLD     112     // bytes in RX FIFO to send XOFF at
+#define UART_XON_THRESHOLD      32      // bytes in RX FIFO to send XON at
+
+class UartTransport : public Transport {
+private:
+    uart_port_t port;
+    gpio_num_t rxd_pin;
+    gpio_num_t txd_pin;
+    int rts_pin;
+    int cts_pin;
+    QueueHandle_t uart_queue;
+
+public:
+    UartTransport(uart_port_t port, gpio_num_t rxd_pin, gpio_num_t txd_pin,
+                  int rts_pin = UART_PIN_NO_CHANGE, int cts_pin = UART_PIN_NO_CHANGE);
+
+    esp_err_t init(int baud) override;
+    void set_baud_rate(int baud) override;
+    esp_err_t set_flow_control(FlowControl mode) override;
+
+    int write(const void *data, size_t len) override;
+    int read(void *data, size_t len, TickType_t wait) override;
+    size_t available() override;
+    void flush_input() override;
+
+    TransportEvent wait_event(TickType_t wait) override;
+};
+
+#endif //ESP32_PRINT_UART_TRANSPORT_H
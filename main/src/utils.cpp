@@ -18,8 +18,12 @@
   along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
 */
 
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
 
+#include "utils.h"
+
 short int get_x_digit(char digit) {
     if ((digit >= '0') && (digit <= '9')) return (short) (digit - '0');
     else if ((digit >= 'A') && (digit <= 'F')) return (short) (digit - 'A' + 0xa);
@@ -29,7 +33,7 @@ short int get_x_digit(char digit) {
 
 void url_decode(char *decoded_url, const char *url) {
     int cn = 0;
-    for (int i = 0; i < strlen(url); i++) {
+    for (size_t i = 0; i < strlen(url); i++) {
         if (url[i] == '%') {
             if (url[i] == 0) return;
             short d1 = get_x_digit(url[i + 1]);
@@ -52,7 +56,7 @@ void url_decode_utf8(wchar_t *decoded_url, const char *url) {
     uint8_t byte;
     char byte_cn = 0;
     char bytes = 1;
-    for (int i = 0; i < strlen(url); i++) {
+    for (size_t i = 0; i < strlen(url); i++) {
         if (url[i] == '%') {
             if (url[i] == 0) return;
             short d1 = get_x_digit(url[i + 1]);
@@ -84,3 +88,36 @@ void url_decode_utf8(wchar_t *decoded_url, const char *url) {
 
     decoded_url[cn] = '\0';
 }
+
+/**
+ * Copies a string escaping it to be put into JSON string. Escape sequences are never cut in half.
+ * @param dst
+ * @param size size of dst buffer, dst is always terminated
+ * @param src
+ * @return escaped string length, if it is size or more, the string did not fit
+ */
+size_t json_escape(char *dst, size_t size, const char *src) {
+    size_t len = 0;
+    for (const char *c = src; *c != 0; c++) {
+        char esc[8];
+        size_t esc_len;
+        switch (*c) {
+            case '"': esc_len = sprintf(esc, "\\\""); break;
+            case '\\': esc_len = sprintf(esc, "\\\\"); break;
+            case '\n': esc_len = sprintf(esc, "\\n"); break;
+            case '\r': esc_len = sprintf(esc, "\\r"); break;
+            case '\t': esc_len = sprintf(esc, "\\t"); break;
+            default:
+                if ((unsigned char) *c < ' ') esc_len = sprintf(esc, "\\u%04x", (unsigned char) *c);
+                else {
+                    esc[0] = *c;
+                    esc_len = 1;
+                }
+        }
+        if ((len < size) && (len + esc_len < size)) memcpy(&dst[len], esc, esc_len);
+        else if (len < size) dst[len] = 0;
+        len += esc_len;
+    }
+    if (len < size) dst[len] = 0;
+    return len;
+}
@@ -21,7 +21,10 @@
 #ifndef ESP32_PRINT_UTILS_H
 #define ESP32_PRINT_UTILS_H
 
+#include <cstddef>
+
 void url_decode(char *decoded_url, const char *url);
 void url_decode_utf8(wchar_t *decoded_url, const char *url);
+size_t json_escape(char *dst, size_t size, const char *src);
 
 #endif // ESP32_PRINT_UTILS_H
\ No newline at end of file
@@ -0,0 +1,562 @@
+/*
+  virtual_printer.cpp - simulated Marlin printer transport
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#include <cctype>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/param.h>
+#include <esp_log.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+
+#include "virtual_printer.h"
+
+static const char TAG[] = "esp3d-print-virtual";
+
+static const char *capabilities[] = {
+        "FIRMWARE_NAME:Marlin virtual printer (esp3D-print) SOURCE_CODE_URL:github.com/MarlinFirmware/Marlin "
+        "PROTOCOL_VERSION:1.0 MACHINE_TYPE:Virtual EXTRUDER_COUNT:1",
+        "Cap:AUTOREPORT_TEMP:1",
+        "Cap:AUTOREPORT_POS:1",
+        "Cap:EMERGENCY_PARSER:1",
+        "Cap:BINARY_FILE_TRANSFER:0",
+        "Cap:EXTENDED_M20:0",
+        "Cap:ARC_SUPPORT:1",
+        "Cap:PROGRESS:0"
+};
+
+/**
+ * Internal function.
+ * Finds a parameter in command, i.e. 'S' in 'M109 S200'.
+ * @return true if parameter is there
+ */
+static bool get_param(const char *cmd, char name, float *value) {
+    for (const char *p = strchr(cmd, ' '); p != nullptr; p = strchr(p + 1, ' ')) {
+        if (p[1] == name) {
+            *value = strtof(&p[2], nullptr);
+            return true;
+        }
+    }
+    return false;
+}
+
+VirtualPrinter::VirtualPrinter(const char *settings) {
+    config = { .planner_depth = 16, .buffer_size = 4, .ok_latency = 1, .noise = 0, .move_time = 20 };
+    if (settings != nullptr) {
+        unsigned int depth = config.planner_depth, bufsize = config.buffer_size, latency = config.ok_latency,
+                noise = config.noise, move_time = config.move_time;
+        sscanf(settings, "%u,%u,%u,%u,%u", &depth, &bufsize, &latency, &noise, &move_time);
+        config.planner_depth = MAX(1, MIN(depth, 255));
+        config.buffer_size = MAX(1, MIN(bufsize, VP_MAX_BUFSIZE));
+        config.ok_latency = latency;
+        config.noise = MIN(noise, 1000);
+        config.move_time = move_time;
+    }
+
+    rx = nullptr;
+    tx = nullptr;
+    tx_ready = nullptr;
+    write_mutex = nullptr;
+    line_start = true;
+    flow_control = false;
+    commands_first = 0;
+    commands_count = 0;
+    line_pos = 0;
+    last_line = 0;
+    executing = false;
+    exec_until = 0;
+    ok_at = 0;
+    busy_time = 0;
+    planned = 0;
+    block_end = 0;
+    relative = false;
+    hotend = VP_AMBIENT_TEMP;
+    hotend_target = 0;
+    bed = VP_AMBIENT_TEMP;
+    bed_target = 0;
+    temp_time = 0;
+    temp_interval = 0;
+    pos_interval = 0;
+    temp_report_time = 0;
+    pos_report_time = 0;
+    kill_request = false;
+    quickstop_request = false;
+    wait_cancel = false;
+    killed = false;
+    kill_time = 0;
+    stat_commands = 0;
+    stat_commands_logged = 0;
+    stat_buffer_peak = 0;
+    stat_underruns = 0;
+    stat_checksum_errors = 0;
+    stat_dropped = 0;
+    stat_time = 0;
+}
+
+esp_err_t VirtualPrinter::init(int /* baud */) {
+    rx = xStreamBufferCreate(VP_RX_BUFFER_SIZE, 1);
+    tx = xStreamBufferCreate(VP_TX_BUFFER_SIZE, 1);
+    tx_ready = xSemaphoreCreateBinary();
+    write_mutex = xSemaphoreCreateMutex();
+    if ((rx == nullptr) || (tx == nullptr) || (tx_ready == nullptr) || (write_mutex == nullptr)) return ESP_ERR_NO_MEM;
+
+    temp_time = stat_time = now();
+    xTaskCreate(VirtualPrinter::task, "virtual_printer", VP_TASK_STACK_SIZE, this, VP_TASK_PRIORITY, nullptr);
+
+    ESP_LOGI(TAG, "Virtual printer started: planner %d, buffer %d, ok latency %d ms, noise %d/1000, move %d ms",
+             config.planner_depth, config.buffer_size, config.ok_latency, config.noise, config.move_time);
+    return ESP_OK;
+}
+
+/**
+ * Task function. Reads commands, runs them one by one and moves simulation time on.
+ * Sleeps for a tick when there's nothing to do.
+ * @param args
+ */
+void VirtualPrinter::task(void *args) {
+    auto vp = (VirtualPrinter *) args;
+    while (true) {
+        vp->handle_emergency();
+        vp->update_planner();
+        vp->update_temperatures();
+
+        if (vp->killed) {
+            char discard[32];
+            xStreamBufferReceive(vp->rx, discard, sizeof(discard), 1);
+            if (now() - vp->kill_time < VP_RESTART_TIME) continue;
+            vp->killed = false;
+            vp->last_line = 0;
+            vp->line_pos = 0;
+            vp->temp_interval = vp->pos_interval = 0;
+            vp->respond("start");
+            continue;
+        }
+
+        vp->auto_report();
+
+        bool worked = false;
+        if (vp->commands_count > 0) {
+            if ((vp->ok_at == 0) && vp->execute(vp->commands[vp->commands_first].line)) {
+                vp->executing = false;
+                vp->ok_at = now() + vp->config.ok_latency;
+            }
+            if ((vp->ok_at != 0) && (now() >= vp->ok_at)) {
+                vp->send_ok();
+                worked = true;
+            }
+        }
+
+        // Nothing to do right now, so wait for next command or for a tick to pass
+        vp->receive(worked ? 0 : 1);
+        vp->log_stats();
+    }
+}
+
+int64_t VirtualPrinter::now() { return esp_timer_get_time() / 1000; }
+
+/**
+ * Internal function.
+ * Sends a line to host. Nothing waits for host, so what doesn't fit is lost.
+ */
+void VirtualPrinter::respond(const char *fmt, ...) {
+    char str[VP_MAX_CMD_SIZE * 2];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(str, sizeof(str) - 1, fmt, args);
+    va_end(args);
+    if (len < 0) return;
+    if (len > (int) sizeof(str) - 2) len = sizeof(str) - 2;
+    str[len++] = '\n';
+    xStreamBufferSend(tx, str, len, 0);
+    xSemaphoreGive(tx_ready);
+}
+
+/**
+ * Internal function.
+ * Looks for M108, M410 and M112 in data sent to printer as Marlin's emergency parser does,
+ * so they work even if command buffer is full.
+ */
+void VirtualPrinter::emergency_parse(const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (line_start) {
+            const char *p = &data[i];
+            size_t rest = len - i, j = 0;
+            if (p[0] == 'N') {
+                j = 1;
+                while ((j < rest) && isdigit((unsigned char) p[j])) j++;
+                while ((j < rest) && (p[j] == ' ')) j++;
+            }
+            if ((rest - j >= 4) && ((rest - j == 4) || !isdigit((unsigned char) p[j + 4]))) {
+                if (strncmp(&p[j], "M112", 4) == 0) kill_request = true;
+                else if (strncmp(&p[j], "M410", 4) == 0) quickstop_request = true;
+                else if (strncmp(&p[j], "M108", 4) == 0) wait_cancel = true;
+            }
+        }
+        line_start = (data[i] == '\n');
+    }
+}
+
+/**
+ * Internal function.
+ * Kills printer or drops planned moves, if emergency parser asked for it.
+ */
+void VirtualPrinter::handle_emergency() {
+    if (kill_request) {
+        kill_request = false;
+        killed = true;
+        kill_time = now();
+        commands_count = 0;
+        planned = 0;
+        executing = false;
+        ok_at = 0;
+        hotend_target = 0;
+        bed_target = 0;
+        respond("Error:Printer halted. kill() called!");
+        ESP_LOGW(TAG, "Killed, restarting in %d ms", VP_RESTART_TIME);
+    }
+    if (quickstop_request) {
+        quickstop_request = false;
+        planned = 0;
+    }
+}
+
+/**
+ * Internal function.
+ * Takes bytes from receive buffer while there's room for commands.
+ * @param wait ticks to wait for the first byte
+ */
+void VirtualPrinter::receive(TickType_t wait) {
+    if (commands_count >= config.buffer_size) {
+        if (wait > 0) vTaskDelay(wait);
+        return;
+    }
+
+    char c;
+    while ((commands_count < config.buffer_size) && (xStreamBufferReceive(rx, &c, 1, wait) > 0)) {
+        wait = 0;
+        if ((c == '\n') || (c == '\r')) {
+            if (line_pos > 0) {
+                line[line_pos] = 0;
+                accept_line();
+            }
+            line_pos = 0;
+        } else if (line_pos < VP_MAX_CMD_SIZE - 1) line[line_pos++] = c;
+    }
+}
+
+/**
+ * Internal function.
+ * Checks line number and checksum of a received line and puts it into command buffer.
+ */
+void VirtualPrinter::accept_line() {
+    char *comment = strchr(line, ';');
+    if (comment != nullptr) *comment = 0;
+    char *p = line;
+    while (*p == ' ') p++;
+
+    long number = -1;
+    if (*p == 'N') {
+        char *cmd;
+        number = strtol(p + 1, &cmd, 10);
+        while (*cmd == ' ') cmd++;
+        bool m110 = (strncmp(cmd, "M110", 4) == 0);
+        char *star = strchr(p, '*');
+        if (star == nullptr) {
+            request_resend("No Checksum with line number");
+            return;
+        }
+        if (!m110 && (number != last_line + 1)) {
+            request_resend("Line Number is not Last Line Number+1");
+            return;
+        }
+        uint8_t checksum = 0;
+        for (char *c = p; c < star; c++) checksum ^= *c;
+        if (checksum != strtol(star + 1, nullptr, 10)) {
+            stat_checksum_errors++;
+            request_resend("checksum mismatch");
+            return;
+        }
+        *star = 0;
+        last_line = number;
+        p = cmd;
+    }
+
+    size_t len = strlen(p);
+    while ((len > 0) && (p[len - 1] == ' ')) p[--len] = 0;
+    if (len == 0) return;
+
+    // M110 takes effect at once, lines following it are numbered from the new number
+    float n;
+    if ((strncmp(p, "M110", 4) == 0) && get_param(p, 'N', &n)) last_line = (long) n;
+
+    vp_command_t *command = &commands[(commands_first + commands_count) % VP_MAX_BUFSIZE];
+    strcpy(command->line, p);
+    command->number = number;
+    commands_count++;
+    if (commands_count > stat_buffer_peak) stat_buffer_peak = commands_count;
+}
+
+/**
+ * Internal function.
+ * Asks host to send lines again from the one following last good line. Whatever
+ * is in receive buffer is dropped before asking, as Marlin does, so lines sent again aren't.
+ */
+void VirtualPrinter::request_resend(const char *error) {
+    xStreamBufferReset(rx);
+    line_pos = 0;
+    respond("Error:%s, Last Line: %ld", error, last_line);
+    respond("Resend: %ld", last_line + 1);
+    respond("ok");
+}
+
+/**
+ * Internal function.
+ * Runs a command or a step of it.
+ * @return true when command is done and may be confirmed
+ */
+bool VirtualPrinter::execute(const char *cmd) {
+    int64_t t = now();
+    if (!executing) {
+        executing = true;
+        busy_time = t;
+        exec_until = 0;
+        if ((strncmp(cmd, "M109", 4) == 0) || (strncmp(cmd, "M190", 4) == 0)) wait_cancel = false;
+    } else if (t - busy_time >= VP_BUSY_INTERVAL) {
+        respond("echo:busy: processing");
+        busy_time = t;
+    }
+
+    char letter = cmd[0];
+    long code = strtol(&cmd[1], nullptr, 10);
+    float val;
+    if (letter == 'G') {
+        switch (code) {
+            case 0: case 1: case 2: case 3: {
+                if (planned >= config.planner_depth) return false;
+                if (planned == 0) block_end = t + config.move_time;
+                planned++;
+                const char axes[] = "XYZE";
+                for (int i = 0; i < 4; i++) {
+                    if (get_param(cmd, axes[i], &val)) pos[i] = relative ? pos[i] + val : val;
+                }
+                return true;
+            }
+            case 4:
+                if (planned > 0) return false;
+                if (exec_until == 0) {
+                    exec_until = t + 1;
+                    if (get_param(cmd, 'P', &val)) exec_until += (int64_t) val;
+                    if (get_param(cmd, 'S', &val)) exec_until += (int64_t) (val * 1000);
+                }
+                return t >= exec_until;
+            case 28:
+                if (planned > 0) return false;
+                if (exec_until == 0) exec_until = t + VP_HOMING_TIME;
+                if (t < exec_until) return false;
+                pos[0] = pos[1] = pos[2] = 0;
+                return true;
+            case 90: relative = false; return true;
+            case 91: relative = true; return true;
+            case 92: {
+                const char axes[] = "XYZE";
+                for (int i = 0; i < 4; i++) if (get_param(cmd, axes[i], &val)) pos[i] = val;
+                return true;
+            }
+            default:
+                return true;
+        }
+    }
+
+    if (letter == 'M') {
+        switch (code) {
+            case 104: if (get_param(cmd, 'S', &val)) hotend_target = val; return true;
+            case 140: if (get_param(cmd, 'S', &val)) bed_target = val; return true;
+            case 109:
+                if (get_param(cmd, 'S', &val)) hotend_target = val;
+                return wait_cancel || (fabsf(hotend - MAX(hotend_target, VP_AMBIENT_TEMP)) < VP_TEMP_WINDOW);
+            case 190:
+                if (get_param(cmd, 'S', &val)) bed_target = val;
+                return wait_cancel || (fabsf(bed - MAX(bed_target, VP_AMBIENT_TEMP)) < VP_TEMP_WINDOW);
+            case 400:
+                return planned == 0;
+            case 114:
+                report_position();
+                return true;
+            case 115:
+                for (const char *cap : capabilities) respond("%s", cap);
+                respond("Cap:SERIAL_XON_XOFF:%d", flow_control ? 1 : 0);
+                return true;
+            case 154:
+                pos_interval = get_param(cmd, 'S', &val) ? (uint8_t) val : 0;
+                pos_report_time = t;
+                return true;
+            case 155:
+                temp_interval = get_param(cmd, 'S', &val) ? (uint8_t) val : 0;
+                temp_report_time = t;
+                return true;
+            default:
+                return true;
+        }
+    }
+
+    respond("echo:Unknown command: \"%s\"", cmd);
+    return true;
+}
+
+/**
+ * Internal function.
+ * Confirms the first command in buffer and removes it. Like Marlin with ADVANCED_OK,
+ * 'ok' tells last line number and free planner and buffer slots, except for M105 which
+ * is answered with temperatures.
+ */
+void VirtualPrinter::send_ok() {
+    vp_command_t *cmd = &commands[commands_first];
+    if (strncmp(cmd->line, "M105", 4) == 0) report_temperatures("ok");
+    else respond("ok N%ld P%d B%d", last_line, config.planner_depth - planned, config.buffer_size - commands_count);
+
+    commands_first = (commands_first + 1) % VP_MAX_BUFSIZE;
+    commands_count--;
+    ok_at = 0;
+    stat_commands++;
+}
+
+/**
+ * Internal function.
+ * Finishes planned moves which took their time. Planner running dry while no command
+ * is waiting counts as underrun, that's when printer stutters.
+ */
+void VirtualPrinter::update_planner() {
+    int64_t t = now();
+    while ((planned > 0) && (t >= block_end)) {
+        planned--;
+        if (planned > 0) block_end += config.move_time;
+        else if (commands_count == 0) stat_underruns++;
+    }
+}
+
+/**
+ * Internal function.
+ * Heaters approach their targets as first order systems.
+ */
+void VirtualPrinter::update_temperatures() {
+    int64_t t = now();
+    float dt = (float) (t - temp_time) / 1000.0f;
+    if (dt < 0.1f) return;
+    temp_time = t;
+    hotend += (MAX(hotend_target, VP_AMBIENT_TEMP) - hotend) * (1.0f - expf(-dt / VP_HOTEND_TAU));
+    bed += (MAX(bed_target, VP_AMBIENT_TEMP) - bed) * (1.0f - expf(-dt / VP_BED_TAU));
+}
+
+void VirtualPrinter::report_temperatures(const char *prefix) {
+    respond("%s T:%.2f /%.2f B:%.2f /%.2f @:0 B@:0", prefix, hotend, hotend_target, bed, bed_target);
+}
+
+void VirtualPrinter::report_position() {
+    respond("X:%.2f Y:%.2f Z:%.2f E:%.2f Count X:0 Y:0 Z:0", pos[0], pos[1], pos[2], pos[3]);
+}
+
+/**
+ * Internal function.
+ * Sends temperatures and position as M155 and M154 asked.
+ */
+void VirtualPrinter::auto_report() {
+    int64_t t = now();
+    if ((temp_interval > 0) && (t - temp_report_time >= temp_interval * 1000)) {
+        report_temperatures("");
+        temp_report_time = t;
+    }
+    if ((pos_interval > 0) && (t - pos_report_time >= pos_interval * 1000)) {
+        report_position();
+        pos_report_time = t;
+    }
+}
+
+/**
+ * Internal function.
+ * Logs streaming statistics while commands are coming.
+ */
+void VirtualPrinter::log_stats() {
+    int64_t t = now();
+    if (t - stat_time < VP_STATS_INTERVAL) return;
+    if (stat_commands > stat_commands_logged) {
+        ESP_LOGI(TAG, "%lu cmd/s, planner underruns %lu, checksum errors %lu, dropped bytes %lu",
+                 (unsigned long) ((stat_commands - stat_commands_logged) * 1000 / (t - stat_time)),
+                 (unsigned long) stat_underruns, (unsigned long) stat_checksum_errors, (unsigned long) stat_dropped);
+    }
+    stat_commands_logged = stat_commands;
+    stat_time = t;
+}
+
+void VirtualPrinter::get_stats(vp_stats_t *stats) const {
+    stats->commands = stat_commands;
+    stats->underruns = stat_underruns;
+    stats->checksum_errors = stat_checksum_errors;
+    stats->dropped = stat_dropped;
+    stats->buffer_peak = stat_buffer_peak;
+}
+
+void VirtualPrinter::set_baud_rate(int /* baud */) {}
+
+esp_err_t VirtualPrinter::set_flow_control(FlowControl mode) {
+    flow_control = (mode != FLOW_CONTROL_NONE);
+    return ESP_OK;
+}
+
+/**
+ * Sends data to printer. Line noise is applied here, and what doesn't fit into
+ * printer's receive buffer is lost, just like with real UART, unless there's flow control.
+ */
+int VirtualPrinter::write(const void *data, size_t len) {
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    char buf[VP_RX_BUFFER_SIZE];
+    size_t done = 0;
+    while (done < len) {
+        size_t n = MIN(len - done, sizeof(buf));
+        memcpy(buf, (const char *) data + done, n);
+        if ((config.noise > 0) && (esp_random() % 1000 < config.noise)) {
+            // Line's leading 'N' is spared: Marlin runs a line with no number as it is, no host could tell
+            size_t i = esp_random() % n;
+            bool line_number = (buf[i] == 'N') && ((i == 0) ? line_start : (buf[i - 1] == '\n'));
+            if ((buf[i] != '\n') && !line_number) buf[i] ^= (char) (1 << (esp_random() % 7));
+        }
+        emergency_parse(buf, n);
+        stat_dropped += n - xStreamBufferSend(rx, buf, n, flow_control ? portMAX_DELAY : 0);
+        done += n;
+    }
+    xSemaphoreGive(write_mutex);
+    return (int) len;
+}
+
+int VirtualPrinter::read(void *data, size_t len, TickType_t wait) {
+    return (int) xStreamBufferReceive(tx, data, len, wait);
+}
+
+size_t VirtualPrinter::available() { return xStreamBufferBytesAvailable(tx); }
+
+void VirtualPrinter::flush_input() { xStreamBufferReset(tx); }
+
+TransportEvent VirtualPrinter::wait_event(TickType_t wait) {
+    if (available() == 0) xSemaphoreTake(tx_ready, wait);
+    return (available() > 0) ? TRANSPORT_EVENT_DATA : TRANSPORT_EVENT_NONE;
+}
@@ -0,0 +1,170 @@
+/*
+  virtual_printer.h - simulated Marlin printer transport
+  Part of esp3D-print
+
+  Copyright (c) 2023 Denis Pavlov
+
+  esp3D-print is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  esp3D-print is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the MIT License
+  along with esp3D-print. If not, see <https://opensource.org/license/mit/>.
+*/
+
+#ifndef ESP32_PRINT_VIRTUAL_PRINTER_H
+#define ESP32_PRINT_VIRTUAL_PRINTER_H
+
+#include <cstdint>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
+
+#include "transport.h"
+
+#define VP_TASK_PRIORITY        (tskIDLE_PRIORITY + 5)
+#define VP_TASK_STACK_SIZE      4096    // bytes
+#define VP_RX_BUFFER_SIZE       128     // bytes, Marlin's RX_BUFFER_SIZE, what doesn't fit is lost
+#define VP_TX_BUFFER_SIZE       1024    // bytes
+#define VP_MAX_CMD_SIZE         96      // Marlin's MAX_CMD_SIZE
+#define VP_MAX_BUFSIZE          32      // Max commands waiting for planner
+#define VP_HOMING_TIME          3000    // ms
+#define VP_BUSY_INTERVAL        2000    // ms, Marlin's DEFAULT_KEEPALIVE_INTERVAL
+#define VP_RESTART_TIME         3000    // ms from kill to 'start'
+#define VP_STATS_INTERVAL       5000    // ms
+#define VP_AMBIENT_TEMP         20.0f
+#define VP_HOTEND_TAU           4.0f    // s, hot end heats up as first order system
+#define VP_BED_TAU              10.0f   // s
+#define VP_TEMP_WINDOW          1.0f    // Marlin's TEMP_WINDOW
+
+/**
+ * Settings line 'virtual_printer=<planner depth>,<buffer size>,<ok latency ms>,<noise>,<move ms>'.
+ * Noise is the number of lines per 1000 which get a bit flipped on their way to printer.
+ */
+typedef struct {
+    uint8_t planner_depth;      // BLOCK_BUFFER_SIZE
+    uint8_t buffer_size;        // BUFSIZE, commands waiting for planner
+    uint16_t ok_latency;        // ms from command executed to 'ok'
+    uint16_t noise;             // corrupted lines per 1000
+    uint16_t move_time;         // ms every planned move takes
+} virtual_printer_config_t;
+
+/**
+ * Streaming statistics counted since printer was started.
+ */
+typedef struct {
+    uint32_t commands;          // Commands done
+    uint32_t underruns;         // Planner ran dry while no command was waiting
+    uint32_t checksum_errors;
+    uint32_t dropped;           // Bytes lost for lack of room in receive buffer
+    uint8_t buffer_peak;        // Most commands waiting in buffer at once
+} vp_stats_t;
+
+typedef struct {
+    char line[VP_MAX_CMD_SIZE];
+    long number;                // Line number, -1 if line had none
+} vp_command_t;
+
+/**
+ * Marlin printer simulated in a task, it's put instead of UART to run streaming with no printer
+ * connected. It checks line numbers and checksums, asks for resends, answers with ADVANCED_OK,
+ * fills its planner with moves taking given time, heats up, reports busy while waiting and handles
+ * M108, M410 and M112 as emergency parser does. With flow control, writing waits for room in its
+ * receive buffer, as if it paused host with XOFF or CTS. It logs commands per second and planner underruns,
+ * so streaming performance can be measured on a bench.
+ */
+class VirtualPrinter : public Transport {
+private:
+    virtual_printer_config_t config;
+    StreamBufferHandle_t rx;                // Host to printer
+    StreamBufferHandle_t tx;                // Printer to host
+    SemaphoreHandle_t tx_ready;
+    SemaphoreHandle_t write_mutex;
+    bool line_start;                        // Next written byte starts a line, emergency parser state
+    bool flow_control;                      // Host waits for room in receive buffer instead of losing data
+
+    // Command buffer
+    vp_command_t commands[VP_MAX_BUFSIZE]{};
+    uint8_t commands_first;
+    uint8_t commands_count;
+    char line[VP_MAX_CMD_SIZE]{};
+    uint8_t line_pos;
+    long last_line;
+
+    // Execution of the first command in buffer
+    bool executing;
+    int64_t exec_until;
+    int64_t ok_at;                          // 0 if command is not done yet
+    int64_t busy_time;
+
+    // Planner
+    uint8_t planned;
+    int64_t block_end;
+    float pos[4]{};
+    bool relative;
+
+    // Heaters
+    float hotend, hotend_target;
+    float bed, bed_target;
+    int64_t temp_time;
+    uint8_t temp_interval, pos_interval;    // Auto-report intervals, s
+    int64_t temp_report_time, pos_report_time;
+
+    // Emergency parser
+    volatile bool kill_request;
+    volatile bool quickstop_request;
+    volatile bool wait_cancel;
+    bool killed;
+    int64_t kill_time;
+
+    // Statistics
+    uint32_t stat_commands;
+    uint32_t stat_commands_logged;          // Commands done when statistics were logged last time
+    uint8_t stat_buffer_peak;
+    uint32_t stat_underruns;
+    uint32_t stat_checksum_errors;
+    volatile uint32_t stat_dropped;
+    int64_t stat_time;
+
+    static void task(void *args);
+    static int64_t now();
+
+    void respond(const char *fmt, ...);
+    void emergency_parse(const char *data, size_t len);
+    void handle_emergency();
+    void receive(TickType_t wait);
+    void accept_line();
+    void request_resend(const char *error);
+    bool execute(const char *cmd);
+    void send_ok();
+    void update_planner();
+    void update_temperatures();
+    void report_temperatures(const char *prefix);
+    void report_position();
+    void auto_report();
+    void log_stats();
+
+public:
+    explicit VirtualPrinter(const char *settings);
+
+    esp_err_t init(int baud) override;
+    void set_baud_rate(int baud) override;
+    esp_err_t set_flow_control(FlowControl mode) override;
+
+    int write(const void *data, size_t len) override;
+    int read(void *data, size_t len, TickType_t wait) override;
+    size_t available() override;
+    void flush_input() override;
+
+    TransportEvent wait_event(TickType_t wait) override;
+
+    void get_stats(vp_stats_t *stats) const;
+};
+
+#endif //ESP32_PRINT_VIRTUAL_PRINTER_H